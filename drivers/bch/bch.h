@@ -31,8 +31,10 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <semaphore.h>
+#include <sys/uio.h>
 #include "fs/fs.h"
 #include "disk.h"
+#include "los_list.h"
 #include "user_copy.h"
 
 /****************************************************************************
@@ -43,22 +45,262 @@
 #define MAX_OPENCNT       (255)                      /* Limit of uint8_t */
 #define DIOC_GETPRIV      (0x1000)
 
+/* IOCTL commands handled by the BCH layer itself */
+
+#define BCHIOC_GETCACHESTAT   (0x1001) /* Arg: struct bch_cachestat_s * */
+#define BCHIOC_RESETCACHESTAT (0x1002) /* Arg: None */
+#define BCHIOC_READV          (0x1003) /* Arg: struct bch_rwv_s * */
+#define BCHIOC_WRITEV         (0x1004) /* Arg: struct bch_rwv_s * */
+#define BCHIOC_AIOSUBMIT      (0x1005) /* Arg: struct bch_aiocb_s * */
+#define BCHIOC_AIOWAIT        (0x1006) /* Arg: struct bch_aiocb_s * */
+#define BCHIOC_GETIOSTAT      (0x1007) /* Arg: struct bch_iostat_s * */
+#define BCHIOC_RESETIOSTAT    (0x1008) /* Arg: None */
+
+/* Largest number of I/O vectors accepted by BCHIOC_READV/WRITEV */
+
+#define BCH_IOV_MAX       (16)
+
+/* Asynchronous request opcodes (aio_opcode) */
+
+#define BCH_AIO_READ      (0)
+#define BCH_AIO_WRITE     (1)
+
+/* Maximum number of asynchronous requests outstanding on one device and
+ * the largest transfer a single request may carry.
+ */
+
+#ifndef CONFIG_BCH_AIO_MAXREQS
+#  define CONFIG_BCH_AIO_MAXREQS 8
+#endif
+
+#ifndef CONFIG_BCH_AIO_MAXXFER
+#  define CONFIG_BCH_AIO_MAXXFER (64 * 1024)
+#endif
+
+#ifndef CONFIG_BCH_AIO_PRIORITY
+#  define CONFIG_BCH_AIO_PRIORITY 10
+#endif
+
+/* Number of sectors held in the BCH sector cache */
+
+#ifndef CONFIG_BCH_NCACHESECTORS
+#  define CONFIG_BCH_NCACHESECTORS 16
+#endif
+
+/* The cache is split into CONFIG_BCH_NSHARDS independently locked shards.
+ * Each group of CONFIG_BCH_SHARDSPAN consecutive sectors maps to the same
+ * shard, so that write-back runs are not broken up by the sharding.
+ */
+
+#ifndef CONFIG_BCH_NSHARDS
+#  define CONFIG_BCH_NSHARDS 4
+#endif
+
+#ifndef CONFIG_BCH_SHARDSPAN
+#  define CONFIG_BCH_SHARDSPAN 8
+#endif
+
+#if CONFIG_BCH_NSHARDS < 1 || CONFIG_BCH_SHARDSPAN < 1
+#  error CONFIG_BCH_NSHARDS and CONFIG_BCH_SHARDSPAN must be at least 1
+#endif
+
+#define BCH_SHARD_NSECTORS (CONFIG_BCH_NCACHESECTORS / CONFIG_BCH_NSHARDS)
+
+#if BCH_SHARD_NSECTORS < 1
+#  error CONFIG_BCH_NCACHESECTORS must be at least CONFIG_BCH_NSHARDS
+#endif
+
+/* Write-back.  Modified sectors stay in the cache until the number of
+ * dirty sectors in a shard reaches CONFIG_BCH_WRITEBACK_HIGHWATER, the
+ * oldest has waited CONFIG_BCH_WRITEBACK_DELAY milliseconds, or the device
+ * is synced or closed.  Adjacent dirty sectors are written back together
+ * in runs of up to CONFIG_BCH_WRITEBACK_MAXRUN sectors.
+ */
+
+#ifndef CONFIG_BCH_WRITEBACK_HIGHWATER
+#  define CONFIG_BCH_WRITEBACK_HIGHWATER ((BCH_SHARD_NSECTORS * 3 + 3) / 4)
+#endif
+
+#ifndef CONFIG_BCH_WRITEBACK_DELAY
+#  define CONFIG_BCH_WRITEBACK_DELAY 1000
+#endif
+
+#ifndef CONFIG_BCH_WRITEBACK_MAXRUN
+#  define CONFIG_BCH_WRITEBACK_MAXRUN BCH_SHARD_NSECTORS
+#endif
+
+/* Sequential read-ahead.  The window of each open file grows from
+ * CONFIG_BCH_READAHEAD_MIN up to CONFIG_BCH_READAHEAD_MAX sectors while
+ * reads stay sequential and shrinks again on seeks.  A maximum of zero
+ * disables read-ahead.
+ */
+
+#ifndef CONFIG_BCH_READAHEAD_MIN
+#  define CONFIG_BCH_READAHEAD_MIN 2
+#endif
+
+#ifndef CONFIG_BCH_READAHEAD_MAX
+#  define CONFIG_BCH_READAHEAD_MAX 16
+#endif
+
+#if CONFIG_BCH_READAHEAD_MAX > 0 && CONFIG_BCH_READAHEAD_MIN < 1
+#  error CONFIG_BCH_READAHEAD_MIN must be at least 1
+#endif
+
+/* Sector number of a cache entry that holds no data */
+
+#define BCH_NOSECTOR      ((unsigned long long)-1)
+
 /****************************************************************************
  * Public Types
  ****************************************************************************/
 
+/* Sector cache statistics returned by BCHIOC_GETCACHESTAT */
+
+struct bch_cachestat_s
+{
+  unsigned long hits;            /* Sector lookups satisfied by the cache */
+  unsigned long misses;          /* Sector lookups that read the device */
+  unsigned long evictions;       /* Valid entries recycled for another sector */
+  unsigned long writebacks;      /* Dirty sectors written back to the device */
+  unsigned long wbruns;          /* Multi-sector write-back device writes */
+  unsigned long rafills;         /* Device reads issued by read-ahead */
+  unsigned long rasectors;       /* Sectors prefetched by read-ahead */
+  unsigned long rahits;          /* Sectors served from the read-ahead buffer */
+};
+
+/* Device I/O statistics returned by BCHIOC_GETIOSTAT.  Comparing the
+ * requests made by users of the driver with the device traffic they caused
+ * shows the effect of the cache, read-ahead and write-back settings.
+ */
+
+struct bch_iostat_s
+{
+  uint32_t sectsize;             /* Sector size of the device in bytes */
+  unsigned long long rdrequests; /* Read requests completed for users */
+  unsigned long long rdbytes;    /* Bytes returned to users */
+  unsigned long long wrrequests; /* Write requests completed for users */
+  unsigned long long wrbytes;    /* Bytes accepted from users */
+  unsigned long long nreads;     /* Device read operations */
+  unsigned long long rdsectors;  /* Sectors read from the device */
+  unsigned long long rdnsec;     /* Time spent in device reads (ns) */
+  unsigned long long nwrites;    /* Device write operations */
+  unsigned long long wrsectors;  /* Sectors written to the device */
+  unsigned long long wrnsec;     /* Time spent in device writes (ns) */
+  unsigned long long nerrors;    /* Device operations that failed */
+};
+
+/* Argument of BCHIOC_READV and BCHIOC_WRITEV.  The transfer starts at the
+ * current file position, which is advanced by the number of bytes moved.
+ */
+
+struct bch_rwv_s
+{
+  const struct iovec *iov;       /* Array of user buffers */
+  int iovcnt;                    /* Number of entries in iov */
+};
+
+/* Asynchronous request control block.  The address of the block identifies
+ * the request between BCHIOC_AIOSUBMIT and BCHIOC_AIOWAIT.
+ */
+
+struct bch_aiocb_s
+{
+  int aio_opcode;                /* BCH_AIO_READ or BCH_AIO_WRITE */
+  loff_t aio_offset;             /* Byte offset on the device */
+  char *aio_buf;                 /* User buffer */
+  size_t aio_nbytes;             /* Number of bytes to transfer */
+};
+
+/* Kernel state of one asynchronous request */
+
+enum bchlib_aiostate_e
+{
+  BCH_AIO_QUEUED = 0,            /* Waiting for the worker */
+  BCH_AIO_RUNNING,               /* Being transferred by the worker */
+  BCH_AIO_DONE                   /* Finished, waiting to be reaped */
+};
+
+struct bchlib_aioreq_s
+{
+  LOS_DL_LIST node;              /* Link in the request queue */
+  const void *owner;             /* Open file that submitted the request */
+  const void *key;               /* User control block identifying it */
+  struct bch_aiocb_s cb;         /* Copy of the control block */
+  uint8_t state;                 /* See enum bchlib_aiostate_e */
+  ssize_t result;                /* Bytes transferred or negated errno */
+  sem_t done;                    /* Posted when the request is finished */
+  bool claimed;                  /* A task waits for it in bchlib_aiowait() */
+  uint8_t *buffer;               /* Kernel bounce buffer */
+};
+
+/* Per-open context.  Created on the first read through an open file and
+ * released when the file is closed.
+ */
+
+struct bchlib_handle_s
+{
+  LOS_DL_LIST node;              /* Link in the list of open contexts */
+  const void *owner;             /* Open file that owns the context */
+  loff_t nextpos;                /* Offset a sequential read would start at */
+  uint16_t window;               /* Current read-ahead window in sectors */
+};
+
+/* One entry of the sector cache */
+
+struct bchlib_cache_s
+{
+  LOS_DL_LIST node;              /* Link in the LRU list, most recent first */
+  struct bchlib_shard_s *shard;  /* Shard that the entry belongs to */
+  unsigned long long sector;     /* Absolute sector held, or BCH_NOSECTOR */
+  bool dirty;                    /* true: Data has been written to the buffer */
+  uint8_t *buffer;               /* One sector buffer */
+};
+
+/* One independently locked shard of the sector cache */
+
+struct bchlib_shard_s
+{
+  sem_t sem;                     /* Protects every field of the shard */
+  LOS_DL_LIST lru;               /* Entries in least-recently-used order */
+  struct bchlib_cache_s *entries; /* BCH_SHARD_NSECTORS entries */
+  uint16_t ndirty;               /* Number of dirty entries */
+  uint64_t dirtytime;            /* Tick count when the shard became dirty */
+  uint8_t *wbbuf;                /* Staging buffer for write-back runs */
+  struct bch_cachestat_s stat;   /* Cache statistics of this shard */
+};
+
 struct bchlib_s
 {
   struct Vnode *vnode;           /* I-node of the block driver */
   uint32_t sectsize;             /* The size of one sector on the device */
   unsigned long long nsectors;   /* Number of sectors supported by the device */
-  unsigned long long sector;     /* The current sector in the buffer */
-  sem_t sem;                     /* For atomic accesses to this structure */
+  sem_t sem;                     /* Protects references and open/close */
   uint8_t refs;                  /* Number of references */
-  bool dirty;                    /* true: Data has been written to the buffer */
   bool readonly;                 /* true: Only read operations are supported */
   bool unlinked;                 /* true: The driver has been unlinked */
-  uint8_t *buffer;               /* One sector buffer */
+  struct bchlib_cache_s *cache;  /* Array of CONFIG_BCH_NCACHESECTORS entries */
+  uint8_t *cachebuf;             /* Sector buffers backing the cache entries */
+  struct bchlib_shard_s shards[CONFIG_BCH_NSHARDS];
+  sem_t rasem;                   /* Protects read-ahead state and handles */
+  struct bch_cachestat_s stat;   /* Read-ahead statistics */
+  uint8_t *rabuf;                /* Read-ahead buffer, NULL if disabled */
+  uint8_t *raspare;              /* Buffer for the next fill, NULL while a fill runs */
+  unsigned int ragen;            /* Incremented when sectors are written */
+  unsigned long long rasector;   /* First absolute sector held in rabuf */
+  size_t racount;                /* Number of valid sectors in rabuf */
+  LOS_DL_LIST handles;           /* Per-open contexts */
+  sem_t iostatsem;               /* Protects iostat */
+  struct bch_iostat_s iostat;    /* Device I/O statistics */
+  sem_t aiosem;                  /* Protects the asynchronous request queue */
+  sem_t aiowork;                 /* Counts requests waiting for the worker */
+  sem_t aioexited;               /* Posted when the worker has stopped */
+  sem_t aioreaped;               /* Posted when a waiter has released a request */
+  uint8_t aioreapers;            /* Closes waiting on aioreaped */
+  LOS_DL_LIST aioqueue;          /* Outstanding requests in submission order */
+  uint8_t naio;                  /* Number of outstanding requests */
+  bool aiostarted;               /* true: The worker task is running */
+  bool aioexit;                  /* true: The worker task must stop */
   los_disk *disk;
   unsigned long long sectstart;
 };
@@ -82,12 +324,54 @@ EXTERN const struct file_operations_vfs bch_fops;
  ****************************************************************************/
 
 EXTERN void bchlib_semtake(struct bchlib_s *bch);
+EXTERN void bchlib_lock(sem_t *sem);
+EXTERN int  bchlib_devread(struct bchlib_s *bch, void *buffer,
+                           unsigned long long sector, size_t nsectors);
+EXTERN int  bchlib_devwrite(struct bchlib_s *bch, const void *buffer,
+                            unsigned long long sector, size_t nsectors);
+EXTERN void bchlib_account(struct bchlib_s *bch, bool write, ssize_t nbytes);
+EXTERN void bchlib_getiostat(struct bchlib_s *bch, struct bch_iostat_s *iostat);
+EXTERN void bchlib_resetiostat(struct bchlib_s *bch);
+EXTERN int  bchlib_cacheinit(struct bchlib_s *bch);
+EXTERN void bchlib_cachefree(struct bchlib_s *bch);
+EXTERN void bchlib_getstat(struct bchlib_s *bch, struct bch_cachestat_s *stat);
+EXTERN void bchlib_resetstat(struct bchlib_s *bch);
 EXTERN int  bchlib_flushsector(FAR struct bchlib_s *bch);
-EXTERN int  bchlib_readsector(struct bchlib_s *bch, unsigned long long sector);
+EXTERN int  bchlib_flushdue(struct bchlib_s *bch);
+EXTERN int  bchlib_readsector(struct bchlib_s *bch, unsigned long long sector,
+                              struct bchlib_cache_s **entry);
+EXTERN void bchlib_putsector(struct bchlib_s *bch, struct bchlib_cache_s *entry,
+                             bool dirty);
+EXTERN int  bchlib_syncrange(struct bchlib_s *bch, unsigned long long sector,
+                             size_t nsectors);
+EXTERN void bchlib_discardrange(struct bchlib_s *bch, unsigned long long sector,
+                                size_t nsectors);
+EXTERN void bchlib_rainit(struct bchlib_s *bch);
+EXTERN void bchlib_rafree(struct bchlib_s *bch);
+EXTERN void bchlib_readahead(struct bchlib_s *bch, const void *owner,
+                             loff_t offset, size_t len);
+EXTERN void bchlib_raclose(struct bchlib_s *bch, const void *owner);
+EXTERN int bchlib_racopy(struct bchlib_s *bch, unsigned long long sector,
+                         size_t nsectors, void *dest);
+EXTERN size_t bchlib_ragap(struct bchlib_s *bch, unsigned long long sector,
+                           size_t nsectors);
+EXTERN void bchlib_raupdate(struct bchlib_s *bch, unsigned long long sector,
+                            const uint8_t *data);
+EXTERN void bchlib_rainvalidate(struct bchlib_s *bch, unsigned long long sector,
+                                size_t nsectors);
+EXTERN void bchlib_aioinit(struct bchlib_s *bch);
+EXTERN void bchlib_aiostop(struct bchlib_s *bch);
+EXTERN int bchlib_aiosubmit(struct bchlib_s *bch, const void *owner,
+                            const void *key, const struct bch_aiocb_s *cb);
+EXTERN ssize_t bchlib_aiowait(struct bchlib_s *bch, const void *owner,
+                              const void *key);
+EXTERN void bchlib_aiocancel(struct bchlib_s *bch, const void *owner);
 EXTERN int bchlib_setup(const char *blkdev, bool readonly, void **handle);
 EXTERN int bchlib_teardown(void *handle);
 EXTERN ssize_t bchlib_read(void *handle, char *buffer, loff_t offset, size_t len);
 EXTERN ssize_t bchlib_write(void *handle, const char *buffer, loff_t offset, size_t len);
+EXTERN ssize_t bchlib_readv(void *handle, const struct iovec *iov, int iovcnt, loff_t offset);
+EXTERN ssize_t bchlib_writev(void *handle, const struct iovec *iov, int iovcnt, loff_t offset);
 
 #undef EXTERN
 #if defined(__cplusplus)
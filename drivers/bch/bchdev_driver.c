@@ -29,11 +29,13 @@
 #include <sys/ioctl.h>
 #include <unistd.h>
 #include <string.h>
+#include <limits.h>
 #include <fcntl.h>
 #include <sched.h>
 #include <errno.h>
 #include <poll.h>
 #include <assert.h>
+#include <securec.h>
 #include "bch.h"
 
 /****************************************************************************
@@ -53,6 +55,7 @@ static ssize_t bch_write(struct file *filep, const char *buffer,
                  size_t buflen);
 static int     bch_ioctl(struct file *filep, int cmd,
                  unsigned long arg);
+static int     bch_fsync(struct file *filep);
 #ifndef CONFIG_DISABLE_PSEUDOFS_OPERATIONS
 static int     bch_unlink(struct Vnode *vnode);
 #endif
@@ -69,6 +72,7 @@ const struct file_operations_vfs bch_fops =
   .write = bch_write,   /* write */
   .seek = bch_seek,    /* seek */
   .ioctl = bch_ioctl,   /* ioctl */
+  .fsync = bch_fsync,   /* fsync */
   .unlink = bch_unlink,  /* unlink */
 };
 
@@ -118,14 +122,22 @@ static int bch_close(struct file *filep)
 {
   struct Vnode *vnode = filep->f_vnode;
   struct bchlib_s *bch;
+  int flushret;
   int ret = OK;
 
   bch = (struct bchlib_s *)((struct drv_data *)vnode->data)->priv;
 
-  /* Flush any dirty pages remaining in the cache */
+  /* Finish or drop any asynchronous requests of this file */
+
+  bchlib_aiocancel(bch, filep);
+
+  /* Flush any dirty pages remaining in the cache.  Write-back is deferred,
+   * so this is the last chance to report data that did not reach the media.
+   */
 
   bchlib_semtake(bch);
-  (void)bchlib_flushsector(bch);
+  flushret = bchlib_flushsector(bch);
+  bchlib_raclose(bch, filep);
 
   /* Decrement the reference count (I don't use bchlib_decref() because I
    * want the entire close operation to be atomic wrt other driver
@@ -160,13 +172,13 @@ static int bch_close(struct file *filep)
              {
                 /* Return without releasing the stale semaphore */
 
-                return OK;
+                return (flushret < 0) ? flushret : OK;
              }
         }
     }
 
   bchlib_semgive(bch);
-  return ret;
+  return (ret == OK && flushret < 0) ? flushret : ret;
 }
 
 /****************************************************************************
@@ -245,14 +257,20 @@ static ssize_t bch_read(struct file *filep, char *buffer, size_t len)
 
   bch = (struct bchlib_s *)((struct drv_data *)vnode->data)->priv;
 
-  bchlib_semtake(bch);
+  /* The sector cache has its own, finer grained locking.  The open file
+   * keeps the device from being torn down underneath the transfer.
+   */
+
+  bchlib_readahead(bch, filep, filep->f_pos, len);
   ret = bchlib_read(bch, buffer, filep->f_pos, len);
   if (ret > 0)
     {
-      filep->f_pos += len;
+      filep->f_pos += ret;
     }
 
-  bchlib_semgive(bch);
+  bchlib_account(bch, false, ret);
+
+  (void)bchlib_flushdue(bch);
   return ret;
 }
 
@@ -270,19 +288,118 @@ static ssize_t bch_write(struct file *filep, const char *buffer, size_t len)
 
   if (!bch->readonly)
     {
-      bchlib_semtake(bch);
       ret = bchlib_write(bch, buffer, filep->f_pos, len);
       if (ret > 0)
         {
-          filep->f_pos += len;
+          filep->f_pos += ret;
         }
 
-      bchlib_semgive(bch);
+      bchlib_account(bch, true, ret);
     }
 
   return ret;
 }
 
+/****************************************************************************
+ * Name: bch_fsync
+ *
+ * Description:
+ *   Write all dirty sectors held in the cache back to the media
+ *
+ ****************************************************************************/
+
+static int bch_fsync(struct file *filep)
+{
+  struct Vnode *vnode = filep->f_vnode;
+  struct bchlib_s *bch;
+  int ret;
+
+  bch = (struct bchlib_s *)((struct drv_data *)vnode->data)->priv;
+
+  bchlib_semtake(bch);
+  ret = bchlib_flushsector(bch);
+  bchlib_semgive(bch);
+  return ret;
+}
+
+/****************************************************************************
+ * Name: bch_rwv
+ *
+ * Description:
+ *   Handle BCHIOC_READV and BCHIOC_WRITEV: one scatter/gather transfer at
+ *   the file position.
+ *
+ ****************************************************************************/
+
+static int bch_rwv(struct file *filep, struct bchlib_s *bch, int cmd,
+                   unsigned long arg)
+{
+  struct iovec iov[BCH_IOV_MAX];
+  struct bch_rwv_s rwv;
+  size_t total = 0;
+  ssize_t ret;
+  int i;
+
+  if (arg == 0)
+    {
+      return -EINVAL;
+    }
+
+  ret = LOS_CopyToKernel(&rwv, sizeof(struct bch_rwv_s),
+                         (const void *)((uintptr_t)arg), sizeof(struct bch_rwv_s));
+  if (ret != EOK)
+    {
+      return -EFAULT;
+    }
+
+  if (rwv.iov == NULL || rwv.iovcnt < 1 || rwv.iovcnt > BCH_IOV_MAX)
+    {
+      return -EINVAL;
+    }
+
+  ret = LOS_CopyToKernel(iov, sizeof(iov), rwv.iov, rwv.iovcnt * sizeof(struct iovec));
+  if (ret != EOK)
+    {
+      return -EFAULT;
+    }
+
+  /* The number of bytes transferred must be representable in the result */
+
+  for (i = 0; i < rwv.iovcnt; i++)
+    {
+      if (iov[i].iov_len > (size_t)SSIZE_MAX - total)
+        {
+          return -EINVAL;
+        }
+
+      total += iov[i].iov_len;
+    }
+
+  if (cmd == BCHIOC_WRITEV && bch->readonly)
+    {
+      return -EACCES;
+    }
+
+  if (cmd == BCHIOC_READV)
+    {
+      bchlib_readahead(bch, filep, filep->f_pos, total);
+      ret = bchlib_readv(bch, iov, rwv.iovcnt, filep->f_pos);
+    }
+  else
+    {
+      ret = bchlib_writev(bch, iov, rwv.iovcnt, filep->f_pos);
+    }
+
+  if (ret > 0)
+    {
+      filep->f_pos += ret;
+    }
+
+  bchlib_account(bch, cmd == BCHIOC_WRITEV, ret);
+  (void)bchlib_flushdue(bch);
+  return (int)ret;
+}
+
 /****************************************************************************
  * Name: bch_ioctl
  *
@@ -334,6 +451,104 @@ static int bch_ioctl(struct file *filep, int cmd, unsigned long arg)
         }
         break;
 
+      /* Return the sector cache statistics */
+
+      case BCHIOC_GETCACHESTAT:
+        {
+          struct bch_cachestat_s *stat =
+            (struct bch_cachestat_s *)((uintptr_t)arg);
+          struct bch_cachestat_s kstat;
+
+          if (stat == NULL)
+            {
+              ret = -EINVAL;
+              break;
+            }
+
+          bchlib_getstat(bch, &kstat);
+          ret = LOS_CopyFromKernel(stat, sizeof(struct bch_cachestat_s),
+                                   &kstat, sizeof(struct bch_cachestat_s));
+          ret = (ret != EOK) ? -EFAULT : OK;
+        }
+        break;
+
+      /* Zero the sector cache statistics */
+
+      case BCHIOC_RESETCACHESTAT:
+        {
+          bchlib_resetstat(bch);
+          ret = OK;
+        }
+        break;
+
+      /* Return the device I/O statistics */
+
+      case BCHIOC_GETIOSTAT:
+        {
+          struct bch_iostat_s *iostat =
+            (struct bch_iostat_s *)((uintptr_t)arg);
+          struct bch_iostat_s kiostat;
+
+          if (iostat == NULL)
+            {
+              ret = -EINVAL;
+              break;
+            }
+
+          bchlib_getiostat(bch, &kiostat);
+          ret = LOS_CopyFromKernel(iostat, sizeof(struct bch_iostat_s),
+                                   &kiostat, sizeof(struct bch_iostat_s));
+          ret = (ret != EOK) ? -EFAULT : OK;
+        }
+        break;
+
+      /* Zero the device I/O statistics */
+
+      case BCHIOC_RESETIOSTAT:
+        {
+          bchlib_resetiostat(bch);
+          ret = OK;
+        }
+        break;
+
+      /* Scatter/gather transfers at the file position */
+
+      case BCHIOC_READV:
+      case BCHIOC_WRITEV:
+        ret = bch_rwv(filep, bch, cmd, arg);
+        break;
+
+      /* Queue an asynchronous transfer */
+
+      case BCHIOC_AIOSUBMIT:
+        {
+          struct bch_aiocb_s cb;
+
+          if (arg == 0)
+            {
+              ret = -EINVAL;
+              break;
+            }
+
+          ret = LOS_CopyToKernel(&cb, sizeof(struct bch_aiocb_s),
+                                 (const void *)((uintptr_t)arg),
+                                 sizeof(struct bch_aiocb_s));
+          if (ret != EOK)
+            {
+              ret = -EFAULT;
+              break;
+            }
+
+          ret = bchlib_aiosubmit(bch, filep, (const void *)((uintptr_t)arg), &cb);
+        }
+        break;
+
+      /* Wait for an asynchronous transfer and reap its result */
+
+      case BCHIOC_AIOWAIT:
+        ret = (int)bchlib_aiowait(bch, filep, (const void *)((uintptr_t)arg));
+        break;
+
     /* Otherwise, pass the IOCTL command on to the contained block driver. */
 
     default:
@@ -0,0 +1,482 @@
+/****************************************************************************
+ * drivers/bch/bchlib_aio.c
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <assert.h>
+#include <securec.h>
+#include "los_task.h"
+#include "bch.h"
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: bchlib_aiofind
+ *
+ * Description:
+ *   Find the outstanding request submitted by 'owner' with control block
+ *   'key'.  Any request of 'owner' matches a NULL key.
+ *
+ * Assumptions:
+ *   Caller holds aiosem
+ *
+ ****************************************************************************/
+
+static struct bchlib_aioreq_s *bchlib_aiofind(struct bchlib_s *bch,
+                                              const void *owner,
+                                              const void *key)
+{
+  struct bchlib_aioreq_s *req;
+
+  LOS_DL_LIST_FOR_EACH_ENTRY(req, &bch->aioqueue, struct bchlib_aioreq_s, node)
+    {
+      if (req->owner == owner && (key == NULL || req->key == key))
+        {
+          return req;
+        }
+    }
+
+  return NULL;
+}
+
+/****************************************************************************
+ * Name: bchlib_aiofree
+ *
+ * Description:
+ *   Remove a finished request from the queue and free it
+ *
+ * Assumptions:
+ *   Caller holds aiosem
+ *
+ ****************************************************************************/
+
+static void bchlib_aiofree(struct bchlib_s *bch, struct bchlib_aioreq_s *req)
+{
+  LOS_ListDelete(&req->node);
+  bch->naio--;
+
+  (void)sem_destroy(&req->done);
+  free(req);
+}
+
+/****************************************************************************
+ * Name: bchlib_aioworker
+ *
+ * Description:
+ *   Worker task that performs queued requests one at a time, in submission
+ *   order, while the submitters go on with other work.
+ *
+ ****************************************************************************/
+
+static void *bchlib_aioworker(UINTPTR arg)
+{
+  struct bchlib_s *bch = (struct bchlib_s *)arg;
+  struct bchlib_aioreq_s *req;
+  ssize_t ret;
+
+  for (; ; )
+    {
+      while (sem_wait(&bch->aiowork) != 0)
+        {
+        }
+
+      bchlib_lock(&bch->aiosem);
+      if (bch->aioexit)
+        {
+          (void)sem_post(&bch->aiosem);
+          break;
+        }
+
+      /* Pick the oldest request that has not been started.  There may be
+       * none if it was cancelled after its work count was taken.
+       */
+
+      LOS_DL_LIST_FOR_EACH_ENTRY(req, &bch->aioqueue, struct bchlib_aioreq_s, node)
+        {
+          if (req->state == BCH_AIO_QUEUED)
+            {
+              break;
+            }
+        }
+
+      if (&req->node == &bch->aioqueue)
+        {
+          (void)sem_post(&bch->aiosem);
+          continue;
+        }
+
+      req->state = BCH_AIO_RUNNING;
+      (void)sem_post(&bch->aiosem);
+
+      /* Perform the transfer through the sector cache */
+
+      if (req->cb.aio_opcode == BCH_AIO_READ)
+        {
+          ret = bchlib_read(bch, (char *)req->buffer, req->cb.aio_offset,
+                            req->cb.aio_nbytes);
+        }
+      else
+        {
+          ret = bchlib_write(bch, (const char *)req->buffer, req->cb.aio_offset,
+                             req->cb.aio_nbytes);
+        }
+
+      bchlib_account(bch, req->cb.aio_opcode != BCH_AIO_READ, ret);
+      (void)bchlib_flushdue(bch);
+
+      bchlib_lock(&bch->aiosem);
+      req->result = ret;
+      req->state  = BCH_AIO_DONE;
+      (void)sem_post(&req->done);
+      (void)sem_post(&bch->aiosem);
+    }
+
+  (void)sem_post(&bch->aioexited);
+  return NULL;
+}
+
+/****************************************************************************
+ * Name: bchlib_aiostart
+ *
+ * Description:
+ *   Create the worker task the first time a request is submitted
+ *
+ * Assumptions:
+ *   Caller holds aiosem
+ *
+ ****************************************************************************/
+
+static int bchlib_aiostart(struct bchlib_s *bch)
+{
+  TSK_INIT_PARAM_S attr;
+  uint32_t taskid;
+  uint32_t ret;
+
+  if (bch->aiostarted)
+    {
+      return OK;
+    }
+
+  (void)memset_s(&attr, sizeof(TSK_INIT_PARAM_S), 0, sizeof(TSK_INIT_PARAM_S));
+
+  attr.pfnTaskEntry = (TSK_ENTRY_FUNC)bchlib_aioworker;
+  attr.uwStackSize  = LOSCFG_BASE_CORE_TSK_DEFAULT_STACK_SIZE;
+  attr.auwArgs[0]   = (UINTPTR)bch;
+  attr.usTaskPrio   = CONFIG_BCH_AIO_PRIORITY;
+  attr.pcName       = "bch_aio";
+  attr.uwResved     = LOS_TASK_STATUS_DETACHED;
+
+  ret = LOS_TaskCreate(&taskid, &attr);
+  if (ret != LOS_OK)
+    {
+      PRINTK("ERROR: Failed to create BCH aio task: %u\n", ret);
+      return -ENOMEM;
+    }
+
+  bch->aiostarted = true;
+  return OK;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: bchlib_aioinit
+ *
+ * Description:
+ *   Initialize the asynchronous request queue.  The worker task is only
+ *   created when the first request is submitted.
+ *
+ ****************************************************************************/
+
+void bchlib_aioinit(struct bchlib_s *bch)
+{
+  (void)sem_init(&bch->aiosem, 0, 1);
+  (void)sem_init(&bch->aiowork, 0, 0);
+  (void)sem_init(&bch->aioexited, 0, 0);
+  (void)sem_init(&bch->aioreaped, 0, 0);
+  LOS_ListInit(&bch->aioqueue);
+  bch->naio       = 0;
+  bch->aioreapers = 0;
+  bch->aiostarted = false;
+  bch->aioexit    = false;
+}
+
+/****************************************************************************
+ * Name: bchlib_aiostop
+ *
+ * Description:
+ *   Stop the worker task and release the queue.  Every open file has been
+ *   closed at this point, so no requests are outstanding.
+ *
+ ****************************************************************************/
+
+void bchlib_aiostop(struct bchlib_s *bch)
+{
+  DEBUGASSERT(bch->naio == 0);
+
+  if (bch->aiostarted)
+    {
+      bchlib_lock(&bch->aiosem);
+      bch->aioexit = true;
+      (void)sem_post(&bch->aiosem);
+      (void)sem_post(&bch->aiowork);
+
+      while (sem_wait(&bch->aioexited) != 0)
+        {
+        }
+
+      bch->aiostarted = false;
+    }
+
+  (void)sem_destroy(&bch->aioreaped);
+  (void)sem_destroy(&bch->aioexited);
+  (void)sem_destroy(&bch->aiowork);
+  (void)sem_destroy(&bch->aiosem);
+}
+
+/****************************************************************************
+ * Name: bchlib_aiosubmit
+ *
+ * Description:
+ *   Queue an asynchronous transfer described by 'cb' on behalf of 'owner'.
+ *   'key' is the user address of the control block and identifies the
+ *   request in bchlib_aiowait().  Write data is copied from the user buffer
+ *   before returning.
+ *
+ * Assumptions:
+ *   Called from the context of the submitting task.
+ *
+ ****************************************************************************/
+
+int bchlib_aiosubmit(struct bchlib_s *bch, const void *owner,
+                     const void *key, const struct bch_aiocb_s *cb)
+{
+  struct bchlib_aioreq_s *req;
+  int ret;
+
+  if (cb->aio_opcode != BCH_AIO_READ && cb->aio_opcode != BCH_AIO_WRITE)
+    {
+      return -EINVAL;
+    }
+
+  if (cb->aio_opcode == BCH_AIO_WRITE && bch->readonly)
+    {
+      return -EACCES;
+    }
+
+  if (cb->aio_buf == NULL || cb->aio_nbytes < 1 ||
+      cb->aio_nbytes > CONFIG_BCH_AIO_MAXXFER || cb->aio_offset < 0)
+    {
+      return -EINVAL;
+    }
+
+  req = (struct bchlib_aioreq_s *)malloc(sizeof(struct bchlib_aioreq_s) + cb->aio_nbytes);
+  if (req == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  req->owner  = owner;
+  req->key    = key;
+  req->cb     = *cb;
+  req->state  = BCH_AIO_QUEUED;
+  req->claimed = false;
+  req->result = 0;
+  req->buffer = (uint8_t *)(req + 1);
+  (void)sem_init(&req->done, 0, 0);
+
+  if (cb->aio_opcode == BCH_AIO_WRITE)
+    {
+      ret = LOS_CopyToKernel(req->buffer, cb->aio_nbytes, cb->aio_buf, cb->aio_nbytes);
+      if (ret != EOK)
+        {
+          ret = -EFAULT;
+          goto errout_with_req;
+        }
+    }
+
+  bchlib_lock(&bch->aiosem);
+  if (bch->naio >= CONFIG_BCH_AIO_MAXREQS)
+    {
+      ret = -EAGAIN;
+      goto errout_with_lock;
+    }
+
+  if (bchlib_aiofind(bch, owner, key) != NULL)
+    {
+      ret = -EBUSY;
+      goto errout_with_lock;
+    }
+
+  ret = bchlib_aiostart(bch);
+  if (ret < 0)
+    {
+      goto errout_with_lock;
+    }
+
+  LOS_ListTailInsert(&bch->aioqueue, &req->node);
+  bch->naio++;
+  (void)sem_post(&bch->aiosem);
+  (void)sem_post(&bch->aiowork);
+  return OK;
+
+errout_with_lock:
+  (void)sem_post(&bch->aiosem);
+
+errout_with_req:
+  (void)sem_destroy(&req->done);
+  free(req);
+  return ret;
+}
+
+/****************************************************************************
+ * Name: bchlib_aiowait
+ *
+ * Description:
+ *   Wait for the request identified by 'key' to finish, copy read data to
+ *   the user buffer and release the request.  Returns the number of bytes
+ *   transferred or a negated errno value; -EBUSY if another task already
+ *   waits for the request.
+ *
+ * Assumptions:
+ *   Called from the context of the submitting task.
+ *
+ ****************************************************************************/
+
+ssize_t bchlib_aiowait(struct bchlib_s *bch, const void *owner,
+                       const void *key)
+{
+  struct bchlib_aioreq_s *req;
+  ssize_t ret;
+
+  /* Claim the request, so that neither a second waiter nor
+   * bchlib_aiocancel() releases it while this task waits.
+   */
+
+  bchlib_lock(&bch->aiosem);
+  req = bchlib_aiofind(bch, owner, key);
+  if (req == NULL)
+    {
+      (void)sem_post(&bch->aiosem);
+      return -ENOENT;
+    }
+
+  if (req->claimed)
+    {
+      (void)sem_post(&bch->aiosem);
+      return -EBUSY;
+    }
+
+  req->claimed = true;
+  (void)sem_post(&bch->aiosem);
+
+  while (sem_wait(&req->done) != 0)
+    {
+    }
+
+  ret = req->result;
+  if (ret > 0 && req->cb.aio_opcode == BCH_AIO_READ)
+    {
+      if (LOS_CopyFromKernel(req->cb.aio_buf, req->cb.aio_nbytes,
+                             req->buffer, (size_t)ret) != EOK)
+        {
+          ret = -EFAULT;
+        }
+    }
+
+  /* Wake up any close that waits for this request to be released */
+
+  bchlib_lock(&bch->aiosem);
+  bchlib_aiofree(bch, req);
+  while (bch->aioreapers > 0)
+    {
+      bch->aioreapers--;
+      (void)sem_post(&bch->aioreaped);
+    }
+
+  (void)sem_post(&bch->aiosem);
+  return ret;
+}
+
+/****************************************************************************
+ * Name: bchlib_aiocancel
+ *
+ * Description:
+ *   Called when 'owner' is closed.  Requests that have not been started are
+ *   dropped, started ones are waited for, and all results are discarded.
+ *   Requests that a task waits for in bchlib_aiowait() are left to it, and
+ *   only their release is waited for.
+ *
+ ****************************************************************************/
+
+void bchlib_aiocancel(struct bchlib_s *bch, const void *owner)
+{
+  struct bchlib_aioreq_s *req;
+
+  bchlib_lock(&bch->aiosem);
+  while ((req = bchlib_aiofind(bch, owner, NULL)) != NULL)
+    {
+      if (req->claimed)
+        {
+          bch->aioreapers++;
+          (void)sem_post(&bch->aiosem);
+          while (sem_wait(&bch->aioreaped) != 0)
+            {
+            }
+
+          bchlib_lock(&bch->aiosem);
+          continue;
+        }
+
+      if (req->state == BCH_AIO_QUEUED)
+        {
+          /* Take back the work count posted for this request */
+
+          (void)sem_trywait(&bch->aiowork);
+        }
+      else
+        {
+          /* The worker owns the request until it posts 'done' */
+
+          (void)sem_post(&bch->aiosem);
+          while (sem_wait(&req->done) != 0)
+            {
+            }
+
+          bchlib_lock(&bch->aiosem);
+        }
+
+      bchlib_aiofree(bch, req);
+    }
+
+  (void)sem_post(&bch->aiosem);
+}
@@ -25,42 +25,137 @@
  ****************************************************************************/
 #include <sys/types.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <errno.h>
 #include <assert.h>
+#include <securec.h>
+#include "los_sys.h"
 #include "bch.h"
 
+
 /****************************************************************************
  * Private Functions
  ****************************************************************************/
 
 /****************************************************************************
- * Public Functions
+ * Name: bchlib_shard
+ *
+ * Description:
+ *   Return the shard that caches an absolute sector
+ *
  ****************************************************************************/
 
+static inline struct bchlib_shard_s *bchlib_shard(struct bchlib_s *bch,
+                                                  unsigned long long sector)
+{
+  return &bch->shards[(sector / CONFIG_BCH_SHARDSPAN) % CONFIG_BCH_NSHARDS];
+}
+
 /****************************************************************************
- * Name: bchlib_flushsector
+ * Name: bchlib_findentry
  *
  * Description:
- *   Flush the current contents of the sector buffer (if dirty)
+ *   Return the entry of a shard holding an absolute sector, or NULL
  *
  * Assumptions:
- *   Caller must assume mutual exclusion
+ *   Caller holds the shard semaphore
  *
  ****************************************************************************/
 
-int bchlib_flushsector(struct bchlib_s *bch)
+static struct bchlib_cache_s *bchlib_findentry(struct bchlib_shard_s *shard,
+                                               unsigned long long sector)
 {
-  int ret = OK;
+  int i;
 
-  /* Check if the sector has been modified and is out of synch with the
-   * media.
-   */
+  for (i = 0; i < BCH_SHARD_NSECTORS; i++)
+    {
+      if (shard->entries[i].sector == sector)
+        {
+          return &shard->entries[i];
+        }
+    }
+
+  return NULL;
+}
+
+/****************************************************************************
+ * Name: bchlib_cleanentry
+ *
+ * Description:
+ *   Mark a dirty entry as being in sync with the media
+ *
+ ****************************************************************************/
+
+static void bchlib_cleanentry(struct bchlib_s *bch, struct bchlib_cache_s *entry)
+{
+  struct bchlib_shard_s *shard = entry->shard;
+
+  bchlib_raupdate(bch, entry->sector, entry->buffer);
+  entry->dirty = false;
+  shard->ndirty--;
+  shard->stat.writebacks++;
+}
+
+/****************************************************************************
+ * Name: bchlib_writeback
+ *
+ * Description:
+ *   Write one cache entry back to the media if it is dirty.  Dirty entries
+ *   of the same shard holding the neighbouring sectors are gathered into
+ *   the same run and written with a single multi-sector device write.
+ *
+ * Assumptions:
+ *   Caller holds the shard semaphore
+ *
+ ****************************************************************************/
+
+static int bchlib_writeback(struct bchlib_s *bch, struct bchlib_cache_s *entry)
+{
+  struct bchlib_shard_s *shard = entry->shard;
+  struct bchlib_cache_s *other;
+  unsigned long long first;
+  size_t maxrun;
+  size_t count;
+  size_t i;
+  int ret;
+
+  if (!entry->dirty)
+    {
+      return OK;
+    }
+
+  /* Find the extent of the run of dirty sectors around this entry */
+
+  maxrun = (shard->wbbuf != NULL) ? CONFIG_BCH_WRITEBACK_MAXRUN : 1;
+  first  = entry->sector;
+  count  = 1;
+
+  while (count < maxrun && first > bch->sectstart)
+    {
+      other = bchlib_findentry(shard, first - 1);
+      if (other == NULL || !other->dirty)
+        {
+          break;
+        }
+
+      first--;
+      count++;
+    }
 
-  if (bch->dirty)
+  while (count < maxrun)
     {
-      /* Write the sector to the media */
+      other = bchlib_findentry(shard, first + count);
+      if (other == NULL || !other->dirty)
+        {
+          break;
+        }
 
-      ret = los_disk_write(bch->disk->disk_id, (const void *)bch->buffer, bch->sector, 1);
+      count++;
+    }
+
+  if (count == 1)
+    {
+      ret = bchlib_devwrite(bch, (const void *)entry->buffer, entry->sector, 1);
       if (ret < 0)
         {
           PRINTK("bchlib_flushsector Write failed: %d\n", ret);
@@ -69,45 +164,551 @@ int bchlib_flushsector(struct bchlib_s *bch)
 
       /* The sector is now in sync with the media */
 
-      bch->dirty = false;
+      bchlib_cleanentry(bch, entry);
+      return OK;
     }
 
-  return ret;
+  /* Gather the run into the staging buffer and write it in one go */
+
+  for (i = 0; i < count; i++)
+    {
+      other = bchlib_findentry(shard, first + i);
+      (void)memcpy_s(&shard->wbbuf[i * bch->sectsize], bch->sectsize,
+                     other->buffer, bch->sectsize);
+    }
+
+  ret = bchlib_devwrite(bch, (const void *)shard->wbbuf, first, count);
+  if (ret < 0)
+    {
+      PRINTK("bchlib_flushsector Write failed: %d\n", ret);
+      return ret;
+    }
+
+  /* The sectors are now in sync with the media */
+
+  for (i = 0; i < count; i++)
+    {
+      bchlib_cleanentry(bch, bchlib_findentry(shard, first + i));
+    }
+
+  shard->stat.wbruns++;
+  return OK;
 }
 
 /****************************************************************************
- * Name: bchlib_readsector
+ * Name: bchlib_invalidate
  *
  * Description:
- *   Flush the current contents of the sector buffer (if dirty)
+ *   Forget the contents of one cache entry and make it the first candidate
+ *   for reuse.
  *
  * Assumptions:
- *   Caller must assume mutual exclusion
+ *   Caller holds the shard semaphore
  *
  ****************************************************************************/
 
-int bchlib_readsector(struct bchlib_s *bch, unsigned long long sector)
+static void bchlib_invalidate(struct bchlib_cache_s *entry)
 {
-  int ret = OK;
+  struct bchlib_shard_s *shard = entry->shard;
+
+  if (entry->dirty)
+    {
+      entry->dirty = false;
+      shard->ndirty--;
+    }
+
+  entry->sector = BCH_NOSECTOR;
+
+  LOS_ListDelete(&entry->node);
+  LOS_ListTailInsert(&shard->lru, &entry->node);
+}
+
+/****************************************************************************
+ * Name: bchlib_flushshard
+ *
+ * Description:
+ *   Write back every dirty entry of one shard.  Runs are started from the
+ *   lowest dirty sector so that the device sees ascending writes.
+ *
+ * Assumptions:
+ *   Caller holds the shard semaphore
+ *
+ ****************************************************************************/
+
+static int bchlib_flushshard(struct bchlib_s *bch, struct bchlib_shard_s *shard)
+{
+  struct bchlib_cache_s *entry;
+  struct bchlib_cache_s *next;
+  int ret;
+  int i;
 
-  if (bch->sector != sector)
+  while (shard->ndirty > 0)
     {
-      ret = bchlib_flushsector(bch);
+      next = NULL;
+      for (i = 0; i < BCH_SHARD_NSECTORS; i++)
+        {
+          entry = &shard->entries[i];
+          if (entry->dirty && (next == NULL || entry->sector < next->sector))
+            {
+              next = entry;
+            }
+        }
+
+      ret = bchlib_writeback(bch, next);
       if (ret < 0)
         {
           return ret;
         }
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: bchlib_shouldflush
+ *
+ * Description:
+ *   Return true if a shard has reached its high-water mark or has held a
+ *   modification back for longer than the write-back delay.
+ *
+ * Assumptions:
+ *   Caller holds the shard semaphore
+ *
+ ****************************************************************************/
+
+static bool bchlib_shouldflush(struct bchlib_shard_s *shard)
+{
+  if (shard->ndirty == 0)
+    {
+      return false;
+    }
+
+  return shard->ndirty >= CONFIG_BCH_WRITEBACK_HIGHWATER ||
+         LOS_TickCountGet() - shard->dirtytime >= LOS_MS2Tick(CONFIG_BCH_WRITEBACK_DELAY);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: bchlib_cacheinit
+ *
+ * Description:
+ *   Allocate the sector cache and divide it among the shards.  All entries
+ *   start out empty.
+ *
+ ****************************************************************************/
+
+int bchlib_cacheinit(struct bchlib_s *bch)
+{
+  struct bchlib_shard_s *shard;
+  struct bchlib_cache_s *entry;
+  int i;
+  int j;
+
+  bch->cache = (struct bchlib_cache_s *)zalloc(CONFIG_BCH_NCACHESECTORS *
+                                               sizeof(struct bchlib_cache_s));
+  if (bch->cache == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  bch->cachebuf = (uint8_t *)malloc((size_t)CONFIG_BCH_NCACHESECTORS * bch->sectsize);
+  if (bch->cachebuf == NULL)
+    {
+      free(bch->cache);
+      bch->cache = NULL;
+      return -ENOMEM;
+    }
+
+  for (i = 0; i < CONFIG_BCH_NSHARDS; i++)
+    {
+      shard = &bch->shards[i];
+
+      (void)sem_init(&shard->sem, 0, 1);
+      LOS_ListInit(&shard->lru);
+      shard->entries = &bch->cache[i * BCH_SHARD_NSECTORS];
+      shard->ndirty  = 0;
+
+      /* The staging buffer for multi-sector write-back is optional; without
+       * it dirty sectors are written back one at a time.
+       */
+
+      shard->wbbuf = NULL;
+      if (CONFIG_BCH_WRITEBACK_MAXRUN > 1)
+        {
+          shard->wbbuf = (uint8_t *)malloc((size_t)CONFIG_BCH_WRITEBACK_MAXRUN * bch->sectsize);
+        }
+
+      for (j = 0; j < BCH_SHARD_NSECTORS; j++)
+        {
+          entry         = &shard->entries[j];
+          entry->shard  = shard;
+          entry->sector = BCH_NOSECTOR;
+          entry->dirty  = false;
+          entry->buffer = &bch->cachebuf[(size_t)(i * BCH_SHARD_NSECTORS + j) * bch->sectsize];
+          LOS_ListTailInsert(&shard->lru, &entry->node);
+        }
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: bchlib_cachefree
+ *
+ * Description:
+ *   Release the sector cache.  Dirty entries must have been flushed first.
+ *
+ ****************************************************************************/
+
+void bchlib_cachefree(struct bchlib_s *bch)
+{
+  struct bchlib_shard_s *shard;
+  int i;
+
+  if (bch->cache == NULL)
+    {
+      return;
+    }
+
+  for (i = 0; i < CONFIG_BCH_NSHARDS; i++)
+    {
+      shard = &bch->shards[i];
+      if (shard->wbbuf)
+        {
+          free(shard->wbbuf);
+          shard->wbbuf = NULL;
+        }
+
+      (void)sem_destroy(&shard->sem);
+    }
+
+  free(bch->cachebuf);
+  bch->cachebuf = NULL;
+  free(bch->cache);
+  bch->cache = NULL;
+}
+
+/****************************************************************************
+ * Name: bchlib_getstat
+ *
+ * Description:
+ *   Sum the statistics of all shards and of the read-ahead engine
+ *
+ ****************************************************************************/
+
+void bchlib_getstat(struct bchlib_s *bch, struct bch_cachestat_s *stat)
+{
+  struct bchlib_shard_s *shard;
+  int i;
+
+  bchlib_lock(&bch->rasem);
+  *stat = bch->stat;
+  (void)sem_post(&bch->rasem);
+
+  for (i = 0; i < CONFIG_BCH_NSHARDS; i++)
+    {
+      shard = &bch->shards[i];
+
+      bchlib_lock(&shard->sem);
+      stat->hits       += shard->stat.hits;
+      stat->misses     += shard->stat.misses;
+      stat->evictions  += shard->stat.evictions;
+      stat->writebacks += shard->stat.writebacks;
+      stat->wbruns     += shard->stat.wbruns;
+      (void)sem_post(&shard->sem);
+    }
+}
+
+/****************************************************************************
+ * Name: bchlib_resetstat
+ *
+ * Description:
+ *   Zero the statistics of all shards and of the read-ahead engine
+ *
+ ****************************************************************************/
+
+void bchlib_resetstat(struct bchlib_s *bch)
+{
+  struct bchlib_shard_s *shard;
+  int i;
+
+  bchlib_lock(&bch->rasem);
+  (void)memset_s(&bch->stat, sizeof(struct bch_cachestat_s), 0,
+                 sizeof(struct bch_cachestat_s));
+  (void)sem_post(&bch->rasem);
+
+  for (i = 0; i < CONFIG_BCH_NSHARDS; i++)
+    {
+      shard = &bch->shards[i];
+
+      bchlib_lock(&shard->sem);
+      (void)memset_s(&shard->stat, sizeof(struct bch_cachestat_s), 0,
+                     sizeof(struct bch_cachestat_s));
+      (void)sem_post(&shard->sem);
+    }
+}
+
+/****************************************************************************
+ * Name: bchlib_flushsector
+ *
+ * Description:
+ *   Flush the current contents of the sector cache (if dirty)
+ *
+ ****************************************************************************/
+
+int bchlib_flushsector(struct bchlib_s *bch)
+{
+  struct bchlib_shard_s *shard;
+  int ret = OK;
+  int i;
+
+  if (bch->cache == NULL)
+    {
+      return OK;
+    }
+
+  /* Write every sector that has been modified and is out of synch with
+   * the media.
+   */
+
+  for (i = 0; i < CONFIG_BCH_NSHARDS && ret >= 0; i++)
+    {
+      shard = &bch->shards[i];
+
+      bchlib_lock(&shard->sem);
+      ret = bchlib_flushshard(bch, shard);
+      (void)sem_post(&shard->sem);
+    }
+
+  return ret;
+}
+
+/****************************************************************************
+ * Name: bchlib_flushdue
+ *
+ * Description:
+ *   Flush every shard whose number of dirty sectors has reached the
+ *   high-water mark, or whose oldest modification has been held back for
+ *   longer than the write-back delay.
+ *
+ ****************************************************************************/
+
+int bchlib_flushdue(struct bchlib_s *bch)
+{
+  struct bchlib_shard_s *shard;
+  int ret = OK;
+  int i;
+
+  for (i = 0; i < CONFIG_BCH_NSHARDS && ret >= 0; i++)
+    {
+      shard = &bch->shards[i];
+
+      /* Shards that are clean are skipped without taking their lock */
+
+      if (shard->ndirty == 0)
+        {
+          continue;
+        }
+
+      bchlib_lock(&shard->sem);
+      if (bchlib_shouldflush(shard))
+        {
+          ret = bchlib_flushshard(bch, shard);
+        }
+
+      (void)sem_post(&shard->sem);
+    }
+
+  return ret;
+}
+
+/****************************************************************************
+ * Name: bchlib_readsector
+ *
+ * Description:
+ *   Look up an absolute sector, reading it from the media if it is not
+ *   already cached.  When its shard is full, the least recently used entry
+ *   is written back (if dirty) and reused.  On success the entry is
+ *   returned with its shard locked; release it with bchlib_putsector().
+ *
+ ****************************************************************************/
+
+int bchlib_readsector(struct bchlib_s *bch, unsigned long long sector,
+                      struct bchlib_cache_s **entryp)
+{
+  struct bchlib_shard_s *shard = bchlib_shard(bch, sector);
+  struct bchlib_cache_s *entry;
+  int ret;
+
+  bchlib_lock(&shard->sem);
+
+  /* Search the shard, most recently used first */
+
+  LOS_DL_LIST_FOR_EACH_ENTRY(entry, &shard->lru, struct bchlib_cache_s, node)
+    {
+      if (entry->sector == sector)
+        {
+          shard->stat.hits++;
+          goto found;
+        }
+    }
 
-      bch->sector = (unsigned long long)-1;
-      /* useRead is set TRUE, it'll use read block for not reading large data */
-      ret = los_disk_read(bch->disk->disk_id, (void *)bch->buffer, sector, 1, TRUE);
+  /* Miss.  Recycle the least recently used entry. */
+
+  shard->stat.misses++;
+  entry = LOS_DL_LIST_ENTRY(shard->lru.pstPrev, struct bchlib_cache_s, node);
+  if (entry->sector != BCH_NOSECTOR)
+    {
+      ret = bchlib_writeback(bch, entry);
+      if (ret < 0)
+        {
+          goto errout_with_lock;
+        }
+
+      shard->stat.evictions++;
+    }
+
+  bchlib_invalidate(entry);
+
+  /* Take the sector from the read-ahead buffer if it has been prefetched */
+
+  ret = bchlib_racopy(bch, sector, 1, entry->buffer);
+  if (ret == 0)
+    {
+      ret = bchlib_devread(bch, (void *)entry->buffer, sector, 1);
       if (ret < 0)
         {
           PRINTK("Read failed: %d\n", ret);
-          return ret;
+          goto errout_with_lock;
+        }
+    }
+
+  entry->sector = sector;
+
+found:
+  LOS_ListDelete(&entry->node);
+  LOS_ListHeadInsert(&shard->lru, &entry->node);
+  *entryp = entry;
+  return OK;
+
+errout_with_lock:
+  (void)sem_post(&shard->sem);
+  return ret;
+}
+
+/****************************************************************************
+ * Name: bchlib_putsector
+ *
+ * Description:
+ *   Release an entry returned by bchlib_readsector().  If 'dirty' is true
+ *   the caller has modified the buffer; the data is written back later, by
+ *   bchlib_flushdue(), eviction, fsync or close.
+ *
+ ****************************************************************************/
+
+void bchlib_putsector(struct bchlib_s *bch, struct bchlib_cache_s *entry,
+                      bool dirty)
+{
+  struct bchlib_shard_s *shard = entry->shard;
+
+  if (dirty && !entry->dirty)
+    {
+      if (shard->ndirty == 0)
+        {
+          shard->dirtytime = LOS_TickCountGet();
         }
-      bch->sector = sector;
+
+      entry->dirty = true;
+      shard->ndirty++;
     }
+
+  (void)sem_post(&shard->sem);
+}
+
+/****************************************************************************
+ * Name: bchlib_syncrange
+ *
+ * Description:
+ *   Write back any dirty cache entries that fall inside the range of
+ *   absolute sectors [sector, sector + nsectors).  Used before the range
+ *   is read directly from the media.
+ *
+ ****************************************************************************/
+
+int bchlib_syncrange(struct bchlib_s *bch, unsigned long long sector,
+                     size_t nsectors)
+{
+  struct bchlib_shard_s *shard;
+  struct bchlib_cache_s *entry;
+  int ret = OK;
+  int i;
+  int j;
+
+  for (i = 0; i < CONFIG_BCH_NSHARDS && ret >= 0; i++)
+    {
+      shard = &bch->shards[i];
+      if (shard->ndirty == 0)
+        {
+          continue;
+        }
+
+      bchlib_lock(&shard->sem);
+      for (j = 0; j < BCH_SHARD_NSECTORS && ret >= 0; j++)
+        {
+          entry = &shard->entries[j];
+          if (entry->dirty && entry->sector >= sector &&
+              entry->sector - sector < nsectors)
+            {
+              ret = bchlib_writeback(bch, entry);
+            }
+        }
+
+      (void)sem_post(&shard->sem);
+    }
+
   return ret;
 }
 
+/****************************************************************************
+ * Name: bchlib_discardrange
+ *
+ * Description:
+ *   Drop any read-ahead data and cache entries that fall inside the range
+ *   of absolute sectors [sector, sector + nsectors).  Used after the range
+ *   has been written directly to the media so that stale data is not
+ *   returned (or written back) later.  Read-ahead data goes first so that
+ *   a concurrent miss cannot move it back into the cache afterwards.
+ *
+ ****************************************************************************/
+
+void bchlib_discardrange(struct bchlib_s *bch, unsigned long long sector,
+                         size_t nsectors)
+{
+  struct bchlib_shard_s *shard;
+  struct bchlib_cache_s *entry;
+  int i;
+  int j;
+
+  bchlib_rainvalidate(bch, sector, nsectors);
+
+  for (i = 0; i < CONFIG_BCH_NSHARDS; i++)
+    {
+      shard = &bch->shards[i];
+
+      bchlib_lock(&shard->sem);
+      for (j = 0; j < BCH_SHARD_NSECTORS; j++)
+        {
+          entry = &shard->entries[j];
+          if (entry->sector != BCH_NOSECTOR && entry->sector >= sector &&
+              entry->sector - sector < nsectors)
+            {
+              bchlib_invalidate(entry);
+            }
+        }
+
+      (void)sem_post(&shard->sem);
+    }
+}
@@ -0,0 +1,172 @@
+/****************************************************************************
+ * drivers/bch/bchlib_devio.c
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <assert.h>
+#include <securec.h>
+#include "los_sys.h"
+#include "bch.h"
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: bchlib_devread
+ *
+ * Description:
+ *   Read whole absolute sectors from the media.  Every device access of the
+ *   BCH layer goes through bchlib_devread() and bchlib_devwrite() so that
+ *   it is counted and timed.
+ *
+ ****************************************************************************/
+
+int bchlib_devread(struct bchlib_s *bch, void *buffer,
+                   unsigned long long sector, size_t nsectors)
+{
+  uint64_t start;
+  int ret;
+
+  start = LOS_CurrNanosec();
+
+  /* useRead is set TRUE, it'll use read block for not reading large data */
+
+  ret = los_disk_read(bch->disk->disk_id, buffer, sector, nsectors, TRUE);
+
+  bchlib_lock(&bch->iostatsem);
+  bch->iostat.nreads++;
+  bch->iostat.rdnsec += LOS_CurrNanosec() - start;
+  if (ret >= 0)
+    {
+      bch->iostat.rdsectors += nsectors;
+    }
+  else
+    {
+      bch->iostat.nerrors++;
+    }
+
+  (void)sem_post(&bch->iostatsem);
+  return ret;
+}
+
+/****************************************************************************
+ * Name: bchlib_devwrite
+ *
+ * Description:
+ *   Write whole absolute sectors to the media
+ *
+ ****************************************************************************/
+
+int bchlib_devwrite(struct bchlib_s *bch, const void *buffer,
+                    unsigned long long sector, size_t nsectors)
+{
+  uint64_t start;
+  int ret;
+
+  start = LOS_CurrNanosec();
+  ret = los_disk_write(bch->disk->disk_id, buffer, sector, nsectors);
+
+  bchlib_lock(&bch->iostatsem);
+  bch->iostat.nwrites++;
+  bch->iostat.wrnsec += LOS_CurrNanosec() - start;
+  if (ret >= 0)
+    {
+      bch->iostat.wrsectors += nsectors;
+    }
+  else
+    {
+      bch->iostat.nerrors++;
+    }
+
+  (void)sem_post(&bch->iostatsem);
+  return ret;
+}
+
+/****************************************************************************
+ * Name: bchlib_account
+ *
+ * Description:
+ *   Record the result of a read or write request made by a user of the
+ *   driver, so that it can be compared with the device traffic it caused.
+ *
+ ****************************************************************************/
+
+void bchlib_account(struct bchlib_s *bch, bool write, ssize_t nbytes)
+{
+  if (nbytes <= 0)
+    {
+      return;
+    }
+
+  bchlib_lock(&bch->iostatsem);
+  if (write)
+    {
+      bch->iostat.wrrequests++;
+      bch->iostat.wrbytes += (unsigned long long)nbytes;
+    }
+  else
+    {
+      bch->iostat.rdrequests++;
+      bch->iostat.rdbytes += (unsigned long long)nbytes;
+    }
+
+  (void)sem_post(&bch->iostatsem);
+}
+
+/****************************************************************************
+ * Name: bchlib_getiostat
+ *
+ * Description:
+ *   Return a snapshot of the device I/O statistics
+ *
+ ****************************************************************************/
+
+void bchlib_getiostat(struct bchlib_s *bch, struct bch_iostat_s *iostat)
+{
+  bchlib_lock(&bch->iostatsem);
+  *iostat = bch->iostat;
+  (void)sem_post(&bch->iostatsem);
+
+  iostat->sectsize = bch->sectsize;
+}
+
+/****************************************************************************
+ * Name: bchlib_resetiostat
+ *
+ * Description:
+ *   Zero the device I/O statistics
+ *
+ ****************************************************************************/
+
+void bchlib_resetiostat(struct bchlib_s *bch)
+{
+  bchlib_lock(&bch->iostatsem);
+  (void)memset_s(&bch->iostat, sizeof(struct bch_iostat_s), 0,
+                 sizeof(struct bch_iostat_s));
+  (void)sem_post(&bch->iostatsem);
+}
@@ -47,6 +47,54 @@
  * Private Functions
  ****************************************************************************/
 
+/****************************************************************************
+ * Name: bchlib_readdirect
+ *
+ * Description:
+ *   Read whole absolute sectors into the user buffer, taking the parts that
+ *   are staged in the read-ahead buffer from there and the rest from the
+ *   media.
+ *
+ ****************************************************************************/
+
+static int bchlib_readdirect(struct bchlib_s *bch, char *buffer,
+                             unsigned long long sector, size_t nsectors)
+{
+  size_t nbytes;
+  size_t count;
+  int ret;
+
+  while (nsectors > 0)
+    {
+      ret = bchlib_racopy(bch, sector, nsectors, buffer);
+      if (ret < 0)
+        {
+          return ret;
+        }
+
+      count = (size_t)ret;
+      if (count == 0)
+        {
+          /* Stop short of the read-ahead buffer if it starts in range */
+
+          count = bchlib_ragap(bch, sector, nsectors);
+
+          ret = bchlib_devread(bch, (void *)buffer, sector, count);
+          if (ret < 0)
+            {
+              return ret;
+            }
+        }
+
+      nbytes    = count * bch->sectsize;
+      sector   += count;
+      nsectors -= count;
+      buffer   += nbytes;
+    }
+
+  return OK;
+}
+
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
@@ -63,6 +111,7 @@
 ssize_t bchlib_read(void *handle, char *buffer, loff_t offset, size_t len)
 {
   struct bchlib_s *bch = (struct bchlib_s *)handle;
+  struct bchlib_cache_s *entry;
   size_t   nsectors;
   unsigned long long   sector;
   uint16_t sectoffset;
@@ -96,7 +145,7 @@ ssize_t bchlib_read(void *handle, char *buffer, loff_t offset, size_t len)
     {
       /* Read the sector into the sector buffer */
 
-      ret = bchlib_readsector(bch, sector + bch->sectstart);
+      ret = bchlib_readsector(bch, sector + bch->sectstart, &entry);
       if (ret < 0)
         {
           return bytesread;
@@ -113,7 +162,8 @@ ssize_t bchlib_read(void *handle, char *buffer, loff_t offset, size_t len)
           nbytes = len;
         }
 
-      ret = LOS_CopyFromKernel(buffer, len, &bch->buffer[sectoffset], nbytes);
+      ret = LOS_CopyFromKernel(buffer, len, &entry->buffer[sectoffset], nbytes);
+      bchlib_putsector(bch, entry, false);
       if (ret != EOK)
         {
           PRINTK("ERROR: bchlib_read failed: %d\n", ret);
@@ -145,8 +195,15 @@ ssize_t bchlib_read(void *handle, char *buffer, loff_t offset, size_t len)
         {
           nsectors = bch->nsectors - sector;
         }
-      /* No need for reading large contiguous data, useRead(param 4) is set TRUE */
-      ret = los_disk_read(bch->disk->disk_id, (void *)buffer, sector + bch->sectstart, nsectors, TRUE);
+      /* Cached copies of these sectors may be newer than the media */
+
+      ret = bchlib_syncrange(bch, sector + bch->sectstart, nsectors);
+      if (ret < 0)
+        {
+          return bytesread;
+        }
+
+      ret = bchlib_readdirect(bch, buffer, sector + bch->sectstart, nsectors);
 
       if (ret < 0)
         {
@@ -175,7 +232,7 @@ ssize_t bchlib_read(void *handle, char *buffer, loff_t offset, size_t len)
     {
       /* Read the sector into the sector buffer */
 
-      ret = bchlib_readsector(bch, sector + bch->sectstart);
+      ret = bchlib_readsector(bch, sector + bch->sectstart, &entry);
       if (ret < 0)
         {
           return bytesread;
@@ -183,7 +240,8 @@ ssize_t bchlib_read(void *handle, char *buffer, loff_t offset, size_t len)
 
       /* Copy the head end of the sector to the user buffer */
 
-      ret = LOS_CopyFromKernel(buffer, len, bch->buffer, len);
+      ret = LOS_CopyFromKernel(buffer, len, entry->buffer, len);
+      bchlib_putsector(bch, entry, false);
       if (ret != EOK)
         {
           PRINTK("ERROR: bchlib_read failed: %d\n", ret);
@@ -197,3 +255,36 @@ ssize_t bchlib_read(void *handle, char *buffer, loff_t offset, size_t len)
 
   return bytesread;
 }
+
+/****************************************************************************
+ * Name: bchlib_readv
+ *
+ * Description:
+ *   Scatter read into the buffers described by 'iov', starting at 'offset'.
+ *   Stops at the first short transfer.
+ *
+ ****************************************************************************/
+
+ssize_t bchlib_readv(void *handle, const struct iovec *iov, int iovcnt, loff_t offset)
+{
+  ssize_t nread = 0;
+  ssize_t ret;
+  int i;
+
+  for (i = 0; i < iovcnt; i++)
+    {
+      ret = bchlib_read(handle, (char *)iov[i].iov_base, offset + nread, iov[i].iov_len);
+      if (ret < 0)
+        {
+          return (nread > 0) ? nread : ret;
+        }
+
+      nread += ret;
+      if ((size_t)ret < iov[i].iov_len)
+        {
+          break;
+        }
+    }
+
+  return nread;
+}
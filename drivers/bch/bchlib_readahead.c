@@ -0,0 +1,461 @@
+/****************************************************************************
+ * drivers/bch/bchlib_readahead.c
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <securec.h>
+#include <assert.h>
+#include "bch.h"
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: bchlib_findhandle
+ *
+ * Description:
+ *   Return the per-open context of 'owner', creating it on first use.
+ *   Returns NULL if there is no memory for a new context.
+ *
+ * Assumptions:
+ *   Caller holds rasem
+ *
+ ****************************************************************************/
+
+static struct bchlib_handle_s *bchlib_findhandle(struct bchlib_s *bch,
+                                                 const void *owner)
+{
+  struct bchlib_handle_s *handle;
+
+  LOS_DL_LIST_FOR_EACH_ENTRY(handle, &bch->handles, struct bchlib_handle_s, node)
+    {
+      if (handle->owner == owner)
+        {
+          return handle;
+        }
+    }
+
+  handle = (struct bchlib_handle_s *)malloc(sizeof(struct bchlib_handle_s));
+  if (handle == NULL)
+    {
+      return NULL;
+    }
+
+  /* A new context is treated as if it had just read up to offset zero, so
+   * a file that is read from the beginning starts read-ahead at once.
+   */
+
+  handle->owner   = owner;
+  handle->nextpos = 0;
+  handle->window  = 0;
+  LOS_ListHeadInsert(&bch->handles, &handle->node);
+  return handle;
+}
+
+/****************************************************************************
+ * Name: bchlib_rastaged
+ *
+ * Description:
+ *   Return the number of sectors (at most 'nsectors') starting at absolute
+ *   sector 'sector' that are held in the read-ahead buffer.
+ *
+ * Assumptions:
+ *   Caller holds rasem
+ *
+ ****************************************************************************/
+
+static size_t bchlib_rastaged(struct bchlib_s *bch, unsigned long long sector,
+                              size_t nsectors)
+{
+  unsigned long long avail;
+
+  if (bch->racount == 0 || sector < bch->rasector ||
+      sector - bch->rasector >= bch->racount)
+    {
+      return 0;
+    }
+
+  avail = bch->rasector + bch->racount - sector;
+  return (avail > nsectors) ? nsectors : (size_t)avail;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: bchlib_rainit
+ *
+ * Description:
+ *   Allocate the read-ahead buffer.  Read-ahead is an optimization only, so
+ *   failing to allocate the buffer simply leaves it disabled.
+ *
+ ****************************************************************************/
+
+void bchlib_rainit(struct bchlib_s *bch)
+{
+  (void)sem_init(&bch->rasem, 0, 1);
+  LOS_ListInit(&bch->handles);
+  bch->rabuf   = NULL;
+  bch->raspare = NULL;
+  bch->racount = 0;
+  bch->ragen   = 0;
+
+  /* Fills go to the spare buffer, which then takes the place of the one
+   * that is read from.
+   */
+
+  if (CONFIG_BCH_READAHEAD_MAX > 0)
+    {
+      bch->rabuf   = (uint8_t *)malloc((size_t)CONFIG_BCH_READAHEAD_MAX * bch->sectsize);
+      bch->raspare = (uint8_t *)malloc((size_t)CONFIG_BCH_READAHEAD_MAX * bch->sectsize);
+      if (bch->rabuf == NULL || bch->raspare == NULL)
+        {
+          free(bch->rabuf);
+          free(bch->raspare);
+          bch->rabuf   = NULL;
+          bch->raspare = NULL;
+          PRINTK("WARNING: No memory for BCH read-ahead, disabled\n");
+        }
+    }
+}
+
+/****************************************************************************
+ * Name: bchlib_rafree
+ *
+ * Description:
+ *   Release the read-ahead buffer and any remaining per-open contexts
+ *
+ ****************************************************************************/
+
+void bchlib_rafree(struct bchlib_s *bch)
+{
+  struct bchlib_handle_s *handle;
+  struct bchlib_handle_s *next;
+
+  LOS_DL_LIST_FOR_EACH_ENTRY_SAFE(handle, next, &bch->handles, struct bchlib_handle_s, node)
+    {
+      LOS_ListDelete(&handle->node);
+      free(handle);
+    }
+
+  free(bch->rabuf);
+  free(bch->raspare);
+  bch->rabuf   = NULL;
+  bch->raspare = NULL;
+
+  bch->racount = 0;
+  (void)sem_destroy(&bch->rasem);
+}
+
+/****************************************************************************
+ * Name: bchlib_readahead
+ *
+ * Description:
+ *   Called before 'owner' reads 'len' bytes at 'offset'.  Sequential reads
+ *   double the read-ahead window of the open file, other reads halve it.
+ *   If the window is open and the end of the request is not yet staged,
+ *   the request plus one window of following sectors is fetched into the
+ *   read-ahead buffer with a single device read.
+ *
+ *   The device read goes to the spare buffer without rasem held, so that
+ *   other readers can still copy what is staged.  Only one fill runs at a
+ *   time.
+ *
+ ****************************************************************************/
+
+void bchlib_readahead(struct bchlib_s *bch, const void *owner,
+                      loff_t offset, size_t len)
+{
+  struct bchlib_handle_s *handle;
+  unsigned long long first;
+  unsigned long long last;
+  unsigned int gen;
+  uint8_t *buf;
+  size_t count;
+  int ret;
+
+  if (bch->rabuf == NULL || len < 1 || offset < 0)
+    {
+      return;
+    }
+
+  bchlib_lock(&bch->rasem);
+
+  /* Adapt the window of this open file to its access pattern */
+
+  handle = bchlib_findhandle(bch, owner);
+  if (handle == NULL)
+    {
+      goto out;
+    }
+
+  if (offset == handle->nextpos)
+    {
+      if (handle->window == 0)
+        {
+          handle->window = CONFIG_BCH_READAHEAD_MIN;
+        }
+      else if (handle->window < CONFIG_BCH_READAHEAD_MAX)
+        {
+          handle->window <<= 1;
+          if (handle->window > CONFIG_BCH_READAHEAD_MAX)
+            {
+              handle->window = CONFIG_BCH_READAHEAD_MAX;
+            }
+        }
+    }
+  else
+    {
+      handle->window >>= 1;
+      if (handle->window < CONFIG_BCH_READAHEAD_MIN)
+        {
+          handle->window = 0;
+        }
+    }
+
+  handle->nextpos = offset + len;
+  if (handle->window == 0)
+    {
+      goto out;
+    }
+
+  /* Determine the sectors touched by this request */
+
+  first = offset / bch->sectsize;
+  last  = (offset + len - 1) / bch->sectsize;
+  if (first >= bch->nsectors)
+    {
+      goto out;
+    }
+
+  if (last >= bch->nsectors)
+    {
+      last = bch->nsectors - 1;
+    }
+
+  /* Requests this large are read directly from the media anyway */
+
+  count = (size_t)(last - first + 1);
+  if (count >= CONFIG_BCH_READAHEAD_MAX)
+    {
+      goto out;
+    }
+
+  /* Nothing to do while the end of the request is still staged */
+
+  if (bchlib_rastaged(bch, last + bch->sectstart, 1) > 0)
+    {
+      goto out;
+    }
+
+  count += handle->window;
+  if (count > CONFIG_BCH_READAHEAD_MAX)
+    {
+      count = CONFIG_BCH_READAHEAD_MAX;
+    }
+
+  if (first + count > bch->nsectors)
+    {
+      count = (size_t)(bch->nsectors - first);
+    }
+
+  buf = bch->raspare;
+  if (buf == NULL)
+    {
+      goto out;
+    }
+
+  bch->raspare = NULL;
+  gen = bch->ragen;
+  (void)sem_post(&bch->rasem);
+
+  ret = bchlib_devread(bch, (void *)buf, first + bch->sectstart, count);
+
+  /* Publish the new sectors unless some were written meanwhile, in which
+   * case the buffer may hold old data.  A failed fill is not fatal; the
+   * request itself will be read without read-ahead.
+   */
+
+  bchlib_lock(&bch->rasem);
+  if (ret >= 0 && gen == bch->ragen)
+    {
+      bch->raspare  = bch->rabuf;
+      bch->rabuf    = buf;
+      bch->rasector = first + bch->sectstart;
+      bch->racount  = count;
+      bch->stat.rafills++;
+      bch->stat.rasectors += count;
+    }
+  else
+    {
+      bch->raspare = buf;
+    }
+
+out:
+  (void)sem_post(&bch->rasem);
+}
+
+/****************************************************************************
+ * Name: bchlib_raclose
+ *
+ * Description:
+ *   Release the per-open context of 'owner'
+ *
+ ****************************************************************************/
+
+void bchlib_raclose(struct bchlib_s *bch, const void *owner)
+{
+  struct bchlib_handle_s *handle;
+
+  bchlib_lock(&bch->rasem);
+  LOS_DL_LIST_FOR_EACH_ENTRY(handle, &bch->handles, struct bchlib_handle_s, node)
+    {
+      if (handle->owner == owner)
+        {
+          LOS_ListDelete(&handle->node);
+          free(handle);
+          break;
+        }
+    }
+
+  (void)sem_post(&bch->rasem);
+}
+
+/****************************************************************************
+ * Name: bchlib_racopy
+ *
+ * Description:
+ *   Copy the sectors (at most 'nsectors') starting at absolute sector
+ *   'sector' that are held in the read-ahead buffer to 'dest', which may be
+ *   a kernel or a user buffer.  Returns the number of sectors copied, zero
+ *   if 'sector' is not staged, or a negated errno value.
+ *
+ ****************************************************************************/
+
+int bchlib_racopy(struct bchlib_s *bch, unsigned long long sector,
+                  size_t nsectors, void *dest)
+{
+  size_t count;
+  size_t nbytes;
+  int ret;
+
+  bchlib_lock(&bch->rasem);
+  count = bchlib_rastaged(bch, sector, nsectors);
+  if (count > 0)
+    {
+      nbytes = count * bch->sectsize;
+      ret = LOS_CopyFromKernel(dest, nbytes,
+                               &bch->rabuf[(size_t)(sector - bch->rasector) * bch->sectsize],
+                               nbytes);
+      if (ret != EOK)
+        {
+          (void)sem_post(&bch->rasem);
+          return -EFAULT;
+        }
+
+      bch->stat.rahits += count;
+    }
+
+  (void)sem_post(&bch->rasem);
+  return (int)count;
+}
+
+/****************************************************************************
+ * Name: bchlib_ragap
+ *
+ * Description:
+ *   Return the number of sectors (at most 'nsectors') starting at absolute
+ *   sector 'sector' that precede the read-ahead buffer, i.e. that have to
+ *   be read from the media.
+ *
+ ****************************************************************************/
+
+size_t bchlib_ragap(struct bchlib_s *bch, unsigned long long sector,
+                    size_t nsectors)
+{
+  size_t count = nsectors;
+
+  bchlib_lock(&bch->rasem);
+  if (bch->racount > 0 && bch->rasector > sector &&
+      bch->rasector - sector < nsectors)
+    {
+      count = (size_t)(bch->rasector - sector);
+    }
+
+  (void)sem_post(&bch->rasem);
+  return count;
+}
+
+/****************************************************************************
+ * Name: bchlib_raupdate
+ *
+ * Description:
+ *   A sector has been written to the media from 'data'.  Keep any staged
+ *   copy of it identical to the media.
+ *
+ ****************************************************************************/
+
+void bchlib_raupdate(struct bchlib_s *bch, unsigned long long sector,
+                     const uint8_t *data)
+{
+  bchlib_lock(&bch->rasem);
+  bch->ragen++;
+  if (bchlib_rastaged(bch, sector, 1) > 0)
+    {
+      (void)memcpy_s(&bch->rabuf[(size_t)(sector - bch->rasector) * bch->sectsize],
+                     bch->sectsize, data, bch->sectsize);
+    }
+
+  (void)sem_post(&bch->rasem);
+}
+
+/****************************************************************************
+ * Name: bchlib_rainvalidate
+ *
+ * Description:
+ *   The absolute sectors [sector, sector + nsectors) have been written
+ *   directly to the media.  Drop the read-ahead buffer if it overlaps them.
+ *
+ ****************************************************************************/
+
+void bchlib_rainvalidate(struct bchlib_s *bch, unsigned long long sector,
+                         size_t nsectors)
+{
+  bchlib_lock(&bch->rasem);
+  bch->ragen++;
+  if (bch->racount > 0 && sector < bch->rasector + bch->racount &&
+      bch->rasector < sector + nsectors)
+    {
+      bch->racount = 0;
+    }
+
+  (void)sem_post(&bch->rasem);
+}
@@ -33,12 +33,16 @@
  ****************************************************************************/
 
 /****************************************************************************
- * Name: bch_semtake
+ * Name: bchlib_lock
+ *
+ * Description:
+ *   Take one of the BCH semaphores, retrying if interrupted by a signal
+ *
  ****************************************************************************/
 
-void bchlib_semtake(struct bchlib_s *bch)
+void bchlib_lock(sem_t *sem)
 {
-  while (sem_wait(&bch->sem) != 0)
+  while (sem_wait(sem) != 0)
     {
       /* The only case that an error should occur here is if the wait was
        * awakened by a signal.
@@ -47,3 +51,12 @@ void bchlib_semtake(struct bchlib_s *bch)
       LOS_ASSERT(get_errno() == EINTR);
     }
 }
+
+/****************************************************************************
+ * Name: bch_semtake
+ ****************************************************************************/
+
+void bchlib_semtake(struct bchlib_s *bch)
+{
+  bchlib_lock(&bch->sem);
+}
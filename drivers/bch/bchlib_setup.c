@@ -102,11 +102,10 @@ int bchlib_setup(const char *blkdev, bool readonly, void **handle)
   /* Save the geometry info and complete initialization of the structure */
 
   (void)sem_init(&bch->sem, 0, 1);
+  (void)sem_init(&bch->iostatsem, 0, 1);
   bch->nsectors = geo.geo_nsectors;
   bch->sectsize = geo.geo_sectorsize;
-  bch->sector   = (size_t)-1;
   bch->readonly = readonly;
-  bch->dirty    = false;
   bch->unlinked = false;
 
   part = los_part_find(bch->vnode);
@@ -123,20 +122,28 @@ int bchlib_setup(const char *blkdev, bool readonly, void **handle)
       goto errout_with_bch;
     }
 
-  /* Allocate the sector I/O buffer */
+  /* Allocate the sector cache */
 
-  bch->buffer = (uint8_t *)malloc(bch->sectsize);
-  if (!bch->buffer)
+  ret = bchlib_cacheinit(bch);
+  if (ret < 0)
     {
-      PRINTK("ERROR: Failed to allocate sector buffer\n");
-      ret = -ENOMEM;
+      PRINTK("ERROR: Failed to allocate sector cache\n");
       goto errout_with_bch;
     }
 
+  /* Allocate the read-ahead buffer */
+
+  bchlib_rainit(bch);
+
+  /* Prepare the asynchronous request queue */
+
+  bchlib_aioinit(bch);
+
   *handle = bch;
   return OK;
 
 errout_with_bch:
+  (void)sem_destroy(&bch->iostatsem);
   (void)sem_destroy(&bch->sem);
   free(bch);
   return ret;
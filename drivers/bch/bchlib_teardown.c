@@ -53,6 +53,10 @@ int bchlib_teardown(void *handle)
       return -EBUSY;
     }
 
+  /* Stop the asynchronous request worker */
+
+  bchlib_aiostop(bch);
+
   /* Flush any pending data to the block driver */
 
   (void)bchlib_flushsector(bch);
@@ -63,11 +67,10 @@ int bchlib_teardown(void *handle)
 
   /* Free the BCH state structure */
 
-  if (bch->buffer)
-    {
-      free(bch->buffer);
-    }
+  bchlib_cachefree(bch);
+  bchlib_rafree(bch);
 
+  (void)sem_destroy(&bch->iostatsem);
   (void)sem_destroy(&bch->sem);
   free(bch);
   return OK;
@@ -47,6 +47,7 @@
 ssize_t bchlib_write(void *handle, const char *buffer, loff_t offset, size_t len)
 {
   struct bchlib_s *bch = (struct bchlib_s *)handle;
+  struct bchlib_cache_s *entry;
   size_t   nsectors;
   unsigned long long   sector;
   uint16_t sectoffset;
@@ -78,7 +79,7 @@ ssize_t bchlib_write(void *handle, const char *buffer, loff_t offset, size_t len
     {
       /* Read the full sector into the sector buffer */
 
-      ret = bchlib_readsector(bch, sector + bch->sectstart);
+      ret = bchlib_readsector(bch, sector + bch->sectstart, &entry);
       if (ret < 0)
         {
           return byteswritten;
@@ -95,13 +96,13 @@ ssize_t bchlib_write(void *handle, const char *buffer, loff_t offset, size_t len
           nbytes = len;
         }
 
-      ret = LOS_CopyToKernel(&bch->buffer[sectoffset], nbytes, buffer, nbytes);
+      ret = LOS_CopyToKernel(&entry->buffer[sectoffset], nbytes, buffer, nbytes);
+      bchlib_putsector(bch, entry, ret == EOK);
       if (ret != EOK)
         {
           PRINTK("ERROR: bchlib_write failed: %d\n", ret);
           return byteswritten;
         }
-      bch->dirty = true;
 
       /* Adjust pointers and counts */
 
@@ -128,7 +129,7 @@ ssize_t bchlib_write(void *handle, const char *buffer, loff_t offset, size_t len
     {
       /* Read the sector into the sector buffer */
 
-      ret = bchlib_readsector(bch, sector);
+      ret = bchlib_readsector(bch, sector + bch->sectstart, &entry);
       if (ret < 0)
         {
           return ret;
@@ -137,12 +138,12 @@ ssize_t bchlib_write(void *handle, const char *buffer, loff_t offset, size_t len
       /* Copy the data from the user buffer to the sector buffer */
 
       nbytes = len > bch->sectsize ? bch->sectsize : len;
-      memcpy(bch->buffer, buffer, nbytes);
-      bch->dirty = true;
+      memcpy(entry->buffer, buffer, nbytes);
+      bchlib_putsector(bch, entry, true);
 
       /* Write the sector back to the block device */
 
-      ret = bchlib_flushsector(bch);
+      ret = bchlib_syncrange(bch, sector + bch->sectstart, 1);
       if (ret < 0)
         {
           ferr("ERROR: Flush failed: %d\n", ret);
@@ -169,25 +170,28 @@ ssize_t bchlib_write(void *handle, const char *buffer, loff_t offset, size_t len
           nsectors = bch->nsectors - sector;
         }
 
-      /* Flush the dirty sector to keep the sector sequence */
+      /* Cached copies of these sectors are superseded.  Drop them first
+       * so that a concurrent write-back cannot overwrite the new data.
+       */
 
-      ret = bchlib_flushsector(bch);
-      if (ret < 0)
-        {
-          PRINTK("ERROR: Flush failed: %d\n", ret);
-          return ret;
-        }
+      bchlib_discardrange(bch, sector + bch->sectstart, nsectors);
 
-      /* Write the contiguous sectors */
+      /* Write the contiguous sectors.  Other dirty sectors stay in the
+       * cache; they are written back in runs later.
+       */
 
-      ret = los_disk_write(bch->disk->disk_id, (const void *)buffer,
-                           sector + bch->sectstart, nsectors);
+      ret = bchlib_devwrite(bch, (const void *)buffer,
+                            sector + bch->sectstart, nsectors);
       if (ret < 0)
         {
           PRINTK("ERROR: Write failed: %d\n", ret);
           return byteswritten;
         }
 
+      /* Drop copies that a concurrent reader may have cached meanwhile */
+
+      bchlib_discardrange(bch, sector + bch->sectstart, nsectors);
+
       /* Adjust pointers and counts */
 
       sector       += nsectors;
@@ -209,7 +213,7 @@ ssize_t bchlib_write(void *handle, const char *buffer, loff_t offset, size_t len
     {
       /* Read the sector into the sector buffer */
 
-      ret = bchlib_readsector(bch, sector + bch->sectstart);
+      ret = bchlib_readsector(bch, sector + bch->sectstart, &entry);
       if (ret < 0)
         {
           return byteswritten;
@@ -217,20 +221,59 @@ ssize_t bchlib_write(void *handle, const char *buffer, loff_t offset, size_t len
 
       /* Copy the head end of the sector from the user buffer */
 
-      ret = LOS_CopyToKernel(bch->buffer, len, buffer, len);
+      ret = LOS_CopyToKernel(entry->buffer, len, buffer, len);
+      bchlib_putsector(bch, entry, ret == EOK);
       if (ret != EOK)
         {
           PRINTK("ERROR: bchlib_write failed: %d\n", ret);
           return byteswritten;
         }
-      bch->dirty = true;
 
       /* Adjust counts */
 
       byteswritten += len;
-    } 
+    }
 #endif /* CONFIG_BCH_FORCE_INDIRECT */
 
+  /* Write back the cache if enough has accumulated or it is old enough.
+   * The data is safely cached, so a failure here is reported by the next
+   * explicit flush instead.
+   */
+
+  (void)bchlib_flushdue(bch);
   return byteswritten;
 }
 
+/****************************************************************************
+ * Name: bchlib_writev
+ *
+ * Description:
+ *   Gather write from the buffers described by 'iov', starting at 'offset'.
+ *   Stops at the first short transfer.
+ *
+ ****************************************************************************/
+
+ssize_t bchlib_writev(void *handle, const struct iovec *iov, int iovcnt, loff_t offset)
+{
+  ssize_t nwritten = 0;
+  ssize_t ret;
+  int i;
+
+  for (i = 0; i < iovcnt; i++)
+    {
+      ret = bchlib_write(handle, (const char *)iov[i].iov_base, offset + nwritten,
+                         iov[i].iov_len);
+      if (ret < 0)
+        {
+          return (nwritten > 0) ? nwritten : ret;
+        }
+
+      nwritten += ret;
+      if ((size_t)ret < iov[i].iov_len)
+        {
+          break;
+        }
+    }
+
+  return nwritten;
+}
@@ -0,0 +1,709 @@
+/****************************************************************************
+ * drivers/bch/host/bch_bench.c
+ * drivers/bch/bchlib_devio.c
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/* Host benchmark of the block-to-character layer.  The BCH sources are
+ * built unchanged against the simulated disk of bch_disk.c and driven
+ * through bch_fops, as the VFS would.  Every pattern is verified against a
+ * shadow copy of the device and reports the device traffic it caused.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include "los_sys.h"
+#include "bch.h"
+#include "bch_disk.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define BENCH_IOSIZE   4096          /* Transfer size of the aligned patterns */
+#define BENCH_MAXIO    (64 * 1024)   /* Largest single transfer */
+#define BENCH_NAIO     4             /* Requests in flight in the aio pattern */
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct bench_s
+{
+  struct Vnode vnode;            /* Character driver node */
+  struct drv_data drv;
+  struct bchlib_s *bch;
+  uint8_t *shadow;               /* Expected device contents */
+  uint8_t *buffer;               /* Transfer buffer */
+  size_t size;                   /* Size of the device in bytes */
+  size_t volume;                 /* Bytes to move per pattern */
+  unsigned long long ops;        /* Transfers issued by the pattern */
+  unsigned long long bytes;      /* Bytes moved by the pattern */
+};
+
+struct pattern_s
+{
+  const char *name;
+  int (*run)(struct bench_s *bench);
+};
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static int bench_seqread(struct bench_s *bench);
+static int bench_seqwrite(struct bench_s *bench);
+static int bench_randread(struct bench_s *bench);
+static int bench_randwrite(struct bench_s *bench);
+static int bench_unaligned(struct bench_s *bench);
+static int bench_mixed(struct bench_s *bench);
+static int bench_aio(struct bench_s *bench);
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static const struct pattern_s g_patterns[] =
+{
+  { "seqread",   bench_seqread   },
+  { "seqwrite",  bench_seqwrite  },
+  { "randread",  bench_randread  },
+  { "randwrite", bench_randwrite },
+  { "unaligned", bench_unaligned },
+  { "mixed",     bench_mixed     },
+  { "aio",       bench_aio       },
+};
+
+#define NPATTERNS (sizeof(g_patterns) / sizeof(g_patterns[0]))
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: bench_open / bench_close
+ ****************************************************************************/
+
+static int bench_open(struct bench_s *bench, struct file *filep)
+{
+  (void)memset(filep, 0, sizeof(struct file));
+  filep->f_vnode = &bench->vnode;
+  return bch_fops.open(filep);
+}
+
+static int bench_close(struct file *filep)
+{
+  return bch_fops.close(filep);
+}
+
+/****************************************************************************
+ * Name: bench_randoff
+ *
+ * Description:
+ *   Return a random offset at which 'len' bytes fit, aligned to 'align'
+ *
+ ****************************************************************************/
+
+static size_t bench_randoff(struct bench_s *bench, size_t len, size_t align)
+{
+  size_t span = (bench->size - len) / align + 1;
+
+  return ((size_t)random() % span) * align;
+}
+
+/****************************************************************************
+ * Name: bench_read
+ *
+ * Description:
+ *   Read at 'offset' through 'filep' and check the data against the shadow
+ *
+ ****************************************************************************/
+
+static int bench_read(struct bench_s *bench, struct file *filep,
+                      size_t offset, size_t len)
+{
+  ssize_t ret;
+
+  if (bch_fops.seek(filep, (off_t)offset, SEEK_SET) < 0)
+    {
+      return -EIO;
+    }
+
+  ret = bch_fops.read(filep, (char *)bench->buffer, len);
+  if (ret != (ssize_t)len)
+    {
+      fprintf(stderr, "read of %zu bytes at %zu returned %zd\n",
+              len, offset, ret);
+      return ret < 0 ? (int)ret : -EIO;
+    }
+
+  if (memcmp(bench->buffer, bench->shadow + offset, len) != 0)
+    {
+      fprintf(stderr, "data mismatch reading %zu bytes at %zu\n",
+              len, offset);
+      return -EIO;
+    }
+
+  bench->ops++;
+  bench->bytes += len;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: bench_write
+ *
+ * Description:
+ *   Write fresh random data at 'offset' and record it in the shadow
+ *
+ ****************************************************************************/
+
+static int bench_write(struct bench_s *bench, struct file *filep,
+                       size_t offset, size_t len)
+{
+  ssize_t ret;
+  size_t i;
+
+  for (i = 0; i < len; i++)
+    {
+      bench->buffer[i] = (uint8_t)random();
+    }
+
+  if (bch_fops.seek(filep, (off_t)offset, SEEK_SET) < 0)
+    {
+      return -EIO;
+    }
+
+  ret = bch_fops.write(filep, (const char *)bench->buffer, len);
+  if (ret != (ssize_t)len)
+    {
+      fprintf(stderr, "write of %zu bytes at %zu returned %zd\n",
+              len, offset, ret);
+      return ret < 0 ? (int)ret : -EIO;
+    }
+
+  (void)memcpy(bench->shadow + offset, bench->buffer, len);
+  bench->ops++;
+  bench->bytes += len;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: bench_seqread
+ ****************************************************************************/
+
+static int bench_seqread(struct bench_s *bench)
+{
+  struct file file;
+  size_t offset = 0;
+  int ret;
+
+  ret = bench_open(bench, &file);
+  while (ret >= 0 && bench->bytes < bench->volume)
+    {
+      if (offset + BENCH_IOSIZE > bench->size)
+        {
+          offset = 0;
+        }
+
+      ret = bench_read(bench, &file, offset, BENCH_IOSIZE);
+      offset += BENCH_IOSIZE;
+    }
+
+  return bench_close(&file) < 0 ? -EIO : ret;
+}
+
+/****************************************************************************
+ * Name: bench_seqwrite
+ ****************************************************************************/
+
+static int bench_seqwrite(struct bench_s *bench)
+{
+  struct file file;
+  size_t offset = 0;
+  int ret;
+
+  ret = bench_open(bench, &file);
+  while (ret >= 0 && bench->bytes < bench->volume)
+    {
+      if (offset + BENCH_IOSIZE > bench->size)
+        {
+          offset = 0;
+        }
+
+      ret = bench_write(bench, &file, offset, BENCH_IOSIZE);
+      offset += BENCH_IOSIZE;
+    }
+
+  return bench_close(&file) < 0 ? -EIO : ret;
+}
+
+/****************************************************************************
+ * Name: bench_randread
+ ****************************************************************************/
+
+static int bench_randread(struct bench_s *bench)
+{
+  struct file file;
+  int ret;
+
+  ret = bench_open(bench, &file);
+  while (ret >= 0 && bench->bytes < bench->volume)
+    {
+      ret = bench_read(bench, &file,
+                       bench_randoff(bench, BENCH_IOSIZE, bench->bch->sectsize),
+                       BENCH_IOSIZE);
+    }
+
+  return bench_close(&file) < 0 ? -EIO : ret;
+}
+
+/****************************************************************************
+ * Name: bench_randwrite
+ ****************************************************************************/
+
+static int bench_randwrite(struct bench_s *bench)
+{
+  struct file file;
+  int ret;
+
+  ret = bench_open(bench, &file);
+  while (ret >= 0 && bench->bytes < bench->volume)
+    {
+      ret = bench_write(bench, &file,
+                        bench_randoff(bench, BENCH_IOSIZE, bench->bch->sectsize),
+                        BENCH_IOSIZE);
+    }
+
+  return bench_close(&file) < 0 ? -EIO : ret;
+}
+
+/****************************************************************************
+ * Name: bench_unaligned
+ *
+ * Description:
+ *   Reads and writes of 1 to 3 sectors worth of bytes at byte offsets, so
+ *   that most transfers start and end inside a sector
+ *
+ ****************************************************************************/
+
+static int bench_unaligned(struct bench_s *bench)
+{
+  struct file file;
+  size_t len;
+  int ret;
+
+  ret = bench_open(bench, &file);
+  while (ret >= 0 && bench->bytes < bench->volume)
+    {
+      len = 1 + (size_t)random() % (3 * bench->bch->sectsize);
+      if (random() & 1)
+        {
+          ret = bench_read(bench, &file, bench_randoff(bench, len, 1), len);
+        }
+      else
+        {
+          ret = bench_write(bench, &file, bench_randoff(bench, len, 1), len);
+        }
+    }
+
+  return bench_close(&file) < 0 ? -EIO : ret;
+}
+
+/****************************************************************************
+ * Name: bench_mixed
+ *
+ * Description:
+ *   A sequential reader and a random writer on two open files.  About one
+ *   transfer in four is a write of up to BENCH_IOSIZE bytes.
+ *
+ ****************************************************************************/
+
+static int bench_mixed(struct bench_s *bench)
+{
+  struct file reader;
+  struct file writer;
+  size_t offset = 0;
+  size_t len;
+  int ret;
+
+  ret = bench_open(bench, &reader);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  ret = bench_open(bench, &writer);
+  if (ret < 0)
+    {
+      (void)bench_close(&reader);
+      return ret;
+    }
+
+  while (ret >= 0 && bench->bytes < bench->volume)
+    {
+      len = 1 + (size_t)random() % BENCH_IOSIZE;
+      if ((random() & 3) == 0)
+        {
+          ret = bench_write(bench, &writer, bench_randoff(bench, len, 1), len);
+        }
+      else
+        {
+          if (offset + len > bench->size)
+            {
+              offset = 0;
+            }
+
+          ret = bench_read(bench, &reader, offset, len);
+          offset += len;
+        }
+    }
+
+  if (bench_close(&writer) < 0 || bench_close(&reader) < 0)
+    {
+      return -EIO;
+    }
+
+  return ret;
+}
+
+/****************************************************************************
+ * Name: bench_aio
+ *
+ * Description:
+ *   Batches of BENCH_NAIO asynchronous random reads and writes
+ *
+ ****************************************************************************/
+
+static int bench_aio(struct bench_s *bench)
+{
+  static uint8_t buffers[BENCH_NAIO][BENCH_IOSIZE];
+  struct bch_aiocb_s cbs[BENCH_NAIO];
+  struct file file;
+  ssize_t nbytes;
+  size_t i;
+  int ret;
+  int k;
+
+  ret = bench_open(bench, &file);
+  while (ret >= 0 && bench->bytes < bench->volume)
+    {
+      /* Requests of one batch may overlap, so a batch is all reads or all
+       * writes and the shadow is updated in submission order.
+       */
+
+      bool write = (random() & 3) == 0;
+
+      for (k = 0; k < BENCH_NAIO && ret >= 0; k++)
+        {
+          cbs[k].aio_opcode = write ? BCH_AIO_WRITE : BCH_AIO_READ;
+          cbs[k].aio_nbytes = 1 + (size_t)random() % BENCH_IOSIZE;
+          cbs[k].aio_offset = bench_randoff(bench, cbs[k].aio_nbytes, 1);
+          cbs[k].aio_buf    = (char *)buffers[k];
+          if (write)
+            {
+              for (i = 0; i < cbs[k].aio_nbytes; i++)
+                {
+                  buffers[k][i] = (uint8_t)random();
+                }
+            }
+
+          ret = bch_fops.ioctl(&file, BCHIOC_AIOSUBMIT,
+                               (unsigned long)(uintptr_t)&cbs[k]);
+        }
+
+      for (k = 0; k < BENCH_NAIO && ret >= 0; k++)
+        {
+          nbytes = bch_fops.ioctl(&file, BCHIOC_AIOWAIT,
+                                  (unsigned long)(uintptr_t)&cbs[k]);
+          if (nbytes != (ssize_t)cbs[k].aio_nbytes)
+            {
+              fprintf(stderr, "aio of %zu bytes returned %zd\n",
+                      cbs[k].aio_nbytes, nbytes);
+              ret = -EIO;
+              break;
+            }
+
+          if (write)
+            {
+              (void)memcpy(bench->shadow + cbs[k].aio_offset, buffers[k],
+                           cbs[k].aio_nbytes);
+            }
+          else if (memcmp(buffers[k], bench->shadow + cbs[k].aio_offset,
+                          cbs[k].aio_nbytes) != 0)
+            {
+              fprintf(stderr, "data mismatch in aio read at %lld\n",
+                      (long long)cbs[k].aio_offset);
+              ret = -EIO;
+              break;
+            }
+
+          bench->ops++;
+          bench->bytes += cbs[k].aio_nbytes;
+        }
+    }
+
+  /* Close discards the requests of a failed batch */
+
+  return bench_close(&file) < 0 ? -EIO : ret;
+}
+
+/****************************************************************************
+ * Name: bench_run
+ *
+ * Description:
+ *   Run one pattern, verify the device contents and print one result line
+ *
+ ****************************************************************************/
+
+static int bench_run(struct bench_s *bench, const struct pattern_s *pattern)
+{
+  struct bch_cachestat_s cstat;
+  struct bch_diskstat_s dstat;
+  struct file file;
+  uint64_t start;
+  double seconds;
+  int ret;
+
+  if (bench_open(bench, &file) < 0)
+    {
+      return -EIO;
+    }
+
+  (void)bch_fops.ioctl(&file, BCHIOC_RESETCACHESTAT, 0);
+  (void)bch_fops.ioctl(&file, BCHIOC_RESETIOSTAT, 0);
+  (void)bench_close(&file);
+  bch_diskresetstat();
+
+  bench->ops   = 0;
+  bench->bytes = 0;
+  start        = LOS_CurrNanosec();
+
+  ret = pattern->run(bench);
+
+  seconds = (double)(LOS_CurrNanosec() - start) / 1e9;
+  if (ret < 0)
+    {
+      fprintf(stderr, "%s: failed: %d\n", pattern->name, ret);
+      return ret;
+    }
+
+  /* Closing the files flushed the cache, so the media must match */
+
+  if (memcmp(bch_diskdata(), bench->shadow, bench->size) != 0)
+    {
+      fprintf(stderr, "%s: device contents differ from the shadow\n",
+              pattern->name);
+      return -EIO;
+    }
+
+  bch_diskgetstat(&dstat);
+  if (bench_open(bench, &file) < 0)
+    {
+      return -EIO;
+    }
+
+  (void)bch_fops.ioctl(&file, BCHIOC_GETCACHESTAT,
+                       (unsigned long)(uintptr_t)&cstat);
+  (void)bench_close(&file);
+
+  printf("%-10s %8llu %10llu %8llu %8llu %10llu %10llu %9.2f %8lu %8lu %8lu\n",
+         pattern->name, bench->ops, bench->bytes,
+         dstat.nreads, dstat.nwrites,
+         dstat.rdsectors * bench->bch->sectsize,
+         dstat.wrsectors * bench->bch->sectsize,
+         seconds > 0 ? (double)bench->bytes / seconds / (1024 * 1024) : 0.0,
+         cstat.hits, cstat.misses, cstat.rahits);
+  return OK;
+}
+
+/****************************************************************************
+ * Name: show_usage
+ ****************************************************************************/
+
+static void show_usage(const char *progname)
+{
+  fprintf(stderr,
+          "USAGE: %s [-f <file>] [-n <sectors>] [-s <sectsize>] "
+          "[-l <us>] [-L <us>] [-v <bytes>] [-r <seed>] [pattern...]\n"
+          "  -f  Backing file of the disk (default: anonymous memory)\n"
+          "  -n  Sectors in the partition (default: 8192)\n"
+          "  -s  Sector size (default: 512)\n"
+          "  -l  Latency of each device operation in microseconds\n"
+          "  -L  Additional latency of each sector in microseconds\n"
+          "  -v  Bytes to transfer per pattern (default: 16 MiB)\n"
+          "  -r  Random seed\n"
+          "Patterns: seqread seqwrite randread randwrite unaligned mixed aio"
+          " (default: all)\n",
+          progname);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+int main(int argc, char **argv)
+{
+  struct bch_diskcfg_s cfg;
+  struct bench_s bench;
+  unsigned int seed = 1;
+  void *handle;
+  size_t i;
+  int failed = 0;
+  int ret;
+  int ch;
+
+  (void)memset(&cfg, 0, sizeof(struct bch_diskcfg_s));
+  (void)memset(&bench, 0, sizeof(struct bench_s));
+  cfg.sectsize  = 512;
+  cfg.nsectors  = 8192;
+  cfg.sectstart = 64;
+  bench.volume  = 16 * 1024 * 1024;
+
+  while ((ch = getopt(argc, argv, "f:n:s:l:L:v:r:h")) != -1)
+    {
+      switch (ch)
+        {
+          case 'f':
+            cfg.path = optarg;
+            break;
+
+          case 'n':
+            cfg.nsectors = strtoull(optarg, NULL, 0);
+            break;
+
+          case 's':
+            cfg.sectsize = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+
+          case 'l':
+            cfg.oplatency = (unsigned int)strtoul(optarg, NULL, 0);
+            break;
+
+          case 'L':
+            cfg.sectlatency = (unsigned int)strtoul(optarg, NULL, 0);
+            break;
+
+          case 'v':
+            bench.volume = (size_t)strtoull(optarg, NULL, 0);
+            break;
+
+          case 'r':
+            seed = (unsigned int)strtoul(optarg, NULL, 0);
+            break;
+
+          default:
+            show_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+  bench.size = (size_t)cfg.nsectors * cfg.sectsize;
+  if (cfg.sectsize == 0 || bench.size < BENCH_MAXIO)
+    {
+      fprintf(stderr, "The device must hold at least %d bytes\n",
+              BENCH_MAXIO);
+      return EXIT_FAILURE;
+    }
+
+  ret = bch_diskinit(&cfg);
+  if (ret < 0)
+    {
+      fprintf(stderr, "bch_diskinit failed: %d\n", ret);
+      return EXIT_FAILURE;
+    }
+
+  /* Fill the device with random data and keep a copy of it */
+
+  srandom(seed);
+  bench.shadow = (uint8_t *)malloc(bench.size);
+  bench.buffer = (uint8_t *)malloc(BENCH_MAXIO);
+  if (bench.shadow == NULL || bench.buffer == NULL)
+    {
+      fprintf(stderr, "Out of memory\n");
+      return EXIT_FAILURE;
+    }
+
+  for (i = 0; i < bench.size; i++)
+    {
+      bench.shadow[i] = (uint8_t)random();
+    }
+
+  (void)memcpy(bch_diskdata(), bench.shadow, bench.size);
+
+  ret = bchlib_setup("/dev/bench", false, &handle);
+  if (ret < 0)
+    {
+      fprintf(stderr, "bchlib_setup failed: %d\n", ret);
+      return EXIT_FAILURE;
+    }
+
+  bench.bch        = (struct bchlib_s *)handle;
+  bench.drv.ops    = &bch_fops;
+  bench.drv.priv   = handle;
+  bench.vnode.data = &bench.drv;
+
+  printf("sectsize %u, %llu sectors, latency %u us + %u us/sector\n",
+         cfg.sectsize, cfg.nsectors, cfg.oplatency, cfg.sectlatency);
+  printf("%-10s %8s %10s %8s %8s %10s %10s %9s %8s %8s %8s\n",
+         "pattern", "ops", "bytes", "devrd", "devwr", "devrdbytes",
+         "devwrbytes", "MiB/s", "hits", "misses", "rahits");
+
+  for (i = 0; i < NPATTERNS; i++)
+    {
+      if (optind < argc)
+        {
+          int j;
+
+          for (j = optind; j < argc; j++)
+            {
+              if (strcmp(argv[j], g_patterns[i].name) == 0)
+                {
+                  break;
+                }
+            }
+
+          if (j == argc)
+            {
+              continue;
+            }
+        }
+
+      if (bench_run(&bench, &g_patterns[i]) < 0)
+        {
+          failed++;
+        }
+    }
+
+  (void)bchlib_teardown(handle);
+  bch_diskdeinit();
+  free(bench.buffer);
+  free(bench.shadow);
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
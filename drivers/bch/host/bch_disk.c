@@ -0,0 +1,337 @@
+/****************************************************************************
+ * drivers/bch/host/bch_disk.c
+ * drivers/bch/bchlib_devio.c
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include "fs/fs.h"
+#include "disk.h"
+#include "bch_disk.h"
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct bch_diskcfg_s g_cfg;
+static uint8_t *g_media;         /* Whole disk, partition included */
+static size_t g_mediasize;
+static int g_mediafd = -1;
+static pthread_mutex_t g_statlock = PTHREAD_MUTEX_INITIALIZER;
+static struct bch_diskstat_s g_stat;
+
+static los_disk g_disk =
+{
+  .disk_id     = 0,
+  .disk_status = STAT_INUSED,
+  .disk_mutex  = PTHREAD_MUTEX_INITIALIZER,
+};
+static los_part g_part;
+static struct Vnode g_blkvnode;
+static struct drv_data g_blkdrv;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: bch_disklatency
+ *
+ * Description:
+ *   Sleep for the configured time of an operation on 'count' sectors
+ *
+ ****************************************************************************/
+
+static void bch_disklatency(uint32_t count)
+{
+  unsigned long long usec;
+  struct timespec ts;
+
+  usec = g_cfg.oplatency + (unsigned long long)g_cfg.sectlatency * count;
+  if (usec == 0)
+    {
+      return;
+    }
+
+  ts.tv_sec  = usec / 1000000;
+  ts.tv_nsec = (usec % 1000000) * 1000;
+  while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+    {
+    }
+}
+
+/****************************************************************************
+ * Name: bch_diskgeometry
+ ****************************************************************************/
+
+static int bch_diskgeometry(struct Vnode *vnode, struct geometry *geometry)
+{
+  geometry->geo_available    = true;
+  geometry->geo_writeenabled = true;
+  geometry->geo_nsectors     = g_cfg.sectstart + g_cfg.nsectors;
+  geometry->geo_sectorsize   = g_cfg.sectsize;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: bch_diskwrite
+ *
+ * Description:
+ *   Only its presence is checked; the BCH layer writes with los_disk_write
+ *
+ ****************************************************************************/
+
+static ssize_t bch_diskwrite(struct Vnode *vnode, const unsigned char *buffer,
+                             unsigned long long start_sector,
+                             unsigned int nsectors)
+{
+  return los_disk_write(g_disk.disk_id, buffer, start_sector, nsectors);
+}
+
+static const struct block_operations g_blkops =
+{
+  .geometry = bch_diskgeometry,
+  .write    = bch_diskwrite,
+};
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: bch_diskinit
+ *
+ * Description:
+ *   Create the simulated disk.  With a backing file the media is a shared
+ *   mapping of the file, which is extended to the size of the disk.
+ *
+ ****************************************************************************/
+
+int bch_diskinit(const struct bch_diskcfg_s *cfg)
+{
+  g_cfg       = *cfg;
+  g_mediasize = (size_t)(cfg->sectstart + cfg->nsectors) * cfg->sectsize;
+
+  if (cfg->path != NULL)
+    {
+      g_mediafd = open(cfg->path, O_RDWR | O_CREAT, 0644);
+      if (g_mediafd < 0)
+        {
+          return -errno;
+        }
+
+      if (ftruncate(g_mediafd, (off_t)g_mediasize) < 0)
+        {
+          (void)close(g_mediafd);
+          g_mediafd = -1;
+          return -errno;
+        }
+
+      g_media = mmap(NULL, g_mediasize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     g_mediafd, 0);
+    }
+  else
+    {
+      g_media = mmap(NULL, g_mediasize, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+
+  if (g_media == MAP_FAILED)
+    {
+      g_media = NULL;
+      if (g_mediafd >= 0)
+        {
+          (void)close(g_mediafd);
+          g_mediafd = -1;
+        }
+
+      return -ENOMEM;
+    }
+
+  g_part.disk_id      = g_disk.disk_id;
+  g_part.sector_start = cfg->sectstart;
+  g_part.sector_count = cfg->nsectors;
+  g_blkdrv.ops        = &g_blkops;
+  g_blkvnode.data     = &g_blkdrv;
+  bch_diskresetstat();
+  return OK;
+}
+
+/****************************************************************************
+ * Name: bch_diskdeinit
+ ****************************************************************************/
+
+void bch_diskdeinit(void)
+{
+  if (g_media != NULL)
+    {
+      (void)munmap(g_media, g_mediasize);
+      g_media = NULL;
+    }
+
+  if (g_mediafd >= 0)
+    {
+      (void)close(g_mediafd);
+      g_mediafd = -1;
+    }
+}
+
+/****************************************************************************
+ * Name: bch_diskdata
+ *
+ * Description:
+ *   Return the first byte of the partition, for verification
+ *
+ ****************************************************************************/
+
+uint8_t *bch_diskdata(void)
+{
+  return g_media + (size_t)g_cfg.sectstart * g_cfg.sectsize;
+}
+
+/****************************************************************************
+ * Name: bch_diskgetstat
+ ****************************************************************************/
+
+void bch_diskgetstat(struct bch_diskstat_s *stat)
+{
+  (void)pthread_mutex_lock(&g_statlock);
+  *stat = g_stat;
+  (void)pthread_mutex_unlock(&g_statlock);
+}
+
+/****************************************************************************
+ * Name: bch_diskresetstat
+ ****************************************************************************/
+
+void bch_diskresetstat(void)
+{
+  (void)pthread_mutex_lock(&g_statlock);
+  (void)memset(&g_stat, 0, sizeof(struct bch_diskstat_s));
+  (void)pthread_mutex_unlock(&g_statlock);
+}
+
+/****************************************************************************
+ * Name: los_disk_read
+ ****************************************************************************/
+
+int los_disk_read(int drvID, void *buf, uint64_t sector, uint32_t count,
+                  int useRead)
+{
+  if (drvID != g_disk.disk_id || buf == NULL ||
+      sector + count > g_cfg.sectstart + g_cfg.nsectors)
+    {
+      return -EINVAL;
+    }
+
+  bch_disklatency(count);
+  (void)memcpy(buf, g_media + sector * g_cfg.sectsize,
+               (size_t)count * g_cfg.sectsize);
+
+  (void)pthread_mutex_lock(&g_statlock);
+  g_stat.nreads++;
+  g_stat.rdsectors += count;
+  (void)pthread_mutex_unlock(&g_statlock);
+  return OK;
+}
+
+/****************************************************************************
+ * Name: los_disk_write
+ ****************************************************************************/
+
+int los_disk_write(int drvID, const void *buf, uint64_t sector,
+                   uint32_t count)
+{
+  if (drvID != g_disk.disk_id || buf == NULL ||
+      sector + count > g_cfg.sectstart + g_cfg.nsectors)
+    {
+      return -EINVAL;
+    }
+
+  bch_disklatency(count);
+  (void)memcpy(g_media + sector * g_cfg.sectsize, buf,
+               (size_t)count * g_cfg.sectsize);
+
+  (void)pthread_mutex_lock(&g_statlock);
+  g_stat.nwrites++;
+  g_stat.wrsectors += count;
+  (void)pthread_mutex_unlock(&g_statlock);
+  return OK;
+}
+
+/****************************************************************************
+ * Name: los_part_find
+ ****************************************************************************/
+
+los_part *los_part_find(struct Vnode *blkDriver)
+{
+  return (blkDriver == &g_blkvnode) ? &g_part : NULL;
+}
+
+/****************************************************************************
+ * Name: get_disk
+ ****************************************************************************/
+
+los_disk *get_disk(int id)
+{
+  return (id == g_disk.disk_id) ? &g_disk : NULL;
+}
+
+/****************************************************************************
+ * Name: open_blockdriver
+ *
+ * Description:
+ *   There is a single block device; any path opens it
+ *
+ ****************************************************************************/
+
+int open_blockdriver(const char *pathname, int mountflags,
+                     struct Vnode **vpp)
+{
+  if (g_media == NULL)
+    {
+      return -ENODEV;
+    }
+
+  *vpp = &g_blkvnode;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: close_blockdriver
+ ****************************************************************************/
+
+int close_blockdriver(struct Vnode *vnode)
+{
+  return OK;
+}
@@ -0,0 +1,69 @@
+/****************************************************************************
+ * drivers/bch/host/bch_disk.h
+ * drivers/bch/bchlib_devio.c
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+#ifndef __DRIVERS_BCH_HOST_BCH_DISK_H
+#define __DRIVERS_BCH_HOST_BCH_DISK_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdint.h>
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+/* Configuration of the simulated disk */
+
+struct bch_diskcfg_s
+{
+  const char *path;              /* Backing file, NULL for anonymous memory */
+  uint32_t sectsize;             /* Sector size in bytes */
+  unsigned long long nsectors;   /* Sectors in the partition */
+  unsigned long long sectstart;  /* First sector of the partition */
+  unsigned int oplatency;        /* Latency of every operation (us) */
+  unsigned int sectlatency;      /* Additional latency per sector (us) */
+};
+
+/* Operations seen by the simulated disk */
+
+struct bch_diskstat_s
+{
+  unsigned long long nreads;     /* los_disk_read() calls */
+  unsigned long long rdsectors;  /* Sectors read */
+  unsigned long long nwrites;    /* los_disk_write() calls */
+  unsigned long long wrsectors;  /* Sectors written */
+};
+
+/****************************************************************************
+ * Public Function Prototypes
+ ****************************************************************************/
+
+int  bch_diskinit(const struct bch_diskcfg_s *cfg);
+void bch_diskdeinit(void);
+uint8_t *bch_diskdata(void);
+void bch_diskgetstat(struct bch_diskstat_s *stat);
+void bch_diskresetstat(void);
+
+#endif /* __DRIVERS_BCH_HOST_BCH_DISK_H */
@@ -0,0 +1,193 @@
+/****************************************************************************
+ * drivers/bch/host/bch_os.c
+ * drivers/bch/bchlib_devio.c
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/* Host implementations of the kernel services used by drivers/bch */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include "fs/fs.h"
+#include "los_sys.h"
+#include "los_task.h"
+#include "securec.h"
+#include "user_copy.h"
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: bch_taskentry
+ ****************************************************************************/
+
+static void *bch_taskentry(void *arg)
+{
+  TSK_INIT_PARAM_S param = *(TSK_INIT_PARAM_S *)arg;
+
+  free(arg);
+  return param.pfnTaskEntry(param.auwArgs[0], param.auwArgs[1],
+                            param.auwArgs[2], param.auwArgs[3]);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: zalloc
+ ****************************************************************************/
+
+void *zalloc(size_t size)
+{
+  return calloc(1, size);
+}
+
+/****************************************************************************
+ * Name: memset_s
+ ****************************************************************************/
+
+int memset_s(void *dest, size_t destMax, int c, size_t count)
+{
+  if (dest == NULL || count > destMax)
+    {
+      return EINVAL;
+    }
+
+  (void)memset(dest, c, count);
+  return EOK;
+}
+
+/****************************************************************************
+ * Name: memcpy_s
+ ****************************************************************************/
+
+int memcpy_s(void *dest, size_t destMax, const void *src, size_t count)
+{
+  if (dest == NULL || src == NULL || count > destMax)
+    {
+      return EINVAL;
+    }
+
+  (void)memcpy(dest, src, count);
+  return EOK;
+}
+
+/****************************************************************************
+ * Name: LOS_CopyFromKernel
+ *
+ * Description:
+ *   The benchmark runs in a single address space
+ *
+ ****************************************************************************/
+
+int LOS_CopyFromKernel(void *dest, size_t max, const void *src, size_t count)
+{
+  return memcpy_s(dest, max, src, count);
+}
+
+/****************************************************************************
+ * Name: LOS_CopyToKernel
+ ****************************************************************************/
+
+int LOS_CopyToKernel(void *dest, size_t max, const void *src, size_t count)
+{
+  return memcpy_s(dest, max, src, count);
+}
+
+/****************************************************************************
+ * Name: LOS_CurrNanosec
+ ****************************************************************************/
+
+uint64_t LOS_CurrNanosec(void)
+{
+  struct timespec ts;
+
+  (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/****************************************************************************
+ * Name: LOS_TickCountGet
+ *
+ * Description:
+ *   One tick is one millisecond
+ *
+ ****************************************************************************/
+
+uint64_t LOS_TickCountGet(void)
+{
+  return LOS_CurrNanosec() / 1000000ULL;
+}
+
+/****************************************************************************
+ * Name: LOS_MS2Tick
+ ****************************************************************************/
+
+uint32_t LOS_MS2Tick(uint32_t millisec)
+{
+  return millisec;
+}
+
+/****************************************************************************
+ * Name: LOS_TaskCreate
+ *
+ * Description:
+ *   Run the task as a detached POSIX thread.  Priorities are ignored.
+ *
+ ****************************************************************************/
+
+uint32_t LOS_TaskCreate(uint32_t *taskID, TSK_INIT_PARAM_S *initParam)
+{
+  static uint32_t nexttask;
+  TSK_INIT_PARAM_S *param;
+  pthread_attr_t attr;
+  pthread_t thread;
+  int ret;
+
+  param = (TSK_INIT_PARAM_S *)malloc(sizeof(TSK_INIT_PARAM_S));
+  if (param == NULL)
+    {
+      return ENOMEM;
+    }
+
+  *param = *initParam;
+  (void)pthread_attr_init(&attr);
+  (void)pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  ret = pthread_create(&thread, &attr, bch_taskentry, param);
+  (void)pthread_attr_destroy(&attr);
+  if (ret != 0)
+    {
+      free(param);
+      return (uint32_t)ret;
+    }
+
+  *taskID = __atomic_add_fetch(&nexttask, 1, __ATOMIC_RELAXED);
+  return LOS_OK;
+}
@@ -0,0 +1,76 @@
+/****************************************************************************
+ * drivers/bch/host/include/disk.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/* Host build: the los_disk interface, backed by bch_disk.c. */
+
+#ifndef __DRIVERS_BCH_HOST_INCLUDE_DISK_H
+#define __DRIVERS_BCH_HOST_INCLUDE_DISK_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdint.h>
+#include <pthread.h>
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define TRUE  1
+#define FALSE 0
+
+#define STAT_UNUSED 0
+#define STAT_INUSED 1
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+struct Vnode;
+
+typedef struct
+{
+  int disk_id;
+  unsigned int disk_status;
+  pthread_mutex_t disk_mutex;
+} los_disk;
+
+typedef struct
+{
+  int disk_id;
+  unsigned long long sector_start;
+  unsigned long long sector_count;
+} los_part;
+
+/****************************************************************************
+ * Public Function Prototypes
+ ****************************************************************************/
+
+int los_disk_read(int drvID, void *buf, uint64_t sector, uint32_t count,
+                  int useRead);
+int los_disk_write(int drvID, const void *buf, uint64_t sector,
+                   uint32_t count);
+los_part *los_part_find(struct Vnode *blkDriver);
+los_disk *get_disk(int id);
+
+#endif /* __DRIVERS_BCH_HOST_INCLUDE_DISK_H */
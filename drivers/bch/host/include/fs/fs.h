@@ -0,0 +1,114 @@
+/****************************************************************************
+ * drivers/bch/host/include/fs/fs.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/* Host build: the subset of the kernel VFS interface used by drivers/bch. */
+
+#ifndef __DRIVERS_BCH_HOST_INCLUDE_FS_FS_H
+#define __DRIVERS_BCH_HOST_INCLUDE_FS_FS_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <errno.h>
+#include <limits.h>
+#include "los_list.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define OK              0
+#define ENOERR          0
+#define FAR
+#define PRINTK          printf
+#define PRINT_ERR       printf
+#define DEBUGASSERT(x)
+#define LOS_ASSERT(x)
+#define get_errno()     errno
+#define set_errno(e)    (errno = (e))
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+struct Vnode
+{
+  void *data;                    /* struct drv_data of the driver */
+};
+
+struct file
+{
+  struct Vnode *f_vnode;
+  loff_t f_pos;
+  int f_oflags;
+  void *f_priv;
+};
+
+struct file_operations_vfs
+{
+  int     (*open)(struct file *filep);
+  int     (*close)(struct file *filep);
+  ssize_t (*read)(struct file *filep, char *buffer, size_t buflen);
+  ssize_t (*write)(struct file *filep, const char *buffer, size_t buflen);
+  off_t   (*seek)(struct file *filep, off_t offset, int whence);
+  int     (*ioctl)(struct file *filep, int cmd, unsigned long arg);
+  int     (*fsync)(struct file *filep);
+  int     (*unlink)(struct Vnode *vnode);
+};
+
+struct drv_data
+{
+  const void *ops;               /* File or block operations */
+  void *priv;                    /* Driver private data */
+};
+
+struct geometry
+{
+  bool geo_available;
+  bool geo_writeenabled;
+  unsigned long long geo_nsectors;
+  unsigned int geo_sectorsize;
+};
+
+struct block_operations
+{
+  int     (*geometry)(struct Vnode *vnode, struct geometry *geometry);
+  ssize_t (*write)(struct Vnode *vnode, const unsigned char *buffer,
+                   unsigned long long start_sector, unsigned int nsectors);
+  int     (*ioctl)(struct Vnode *vnode, int cmd, unsigned long arg);
+};
+
+/****************************************************************************
+ * Public Function Prototypes
+ ****************************************************************************/
+
+void *zalloc(size_t size);
+int open_blockdriver(const char *pathname, int mountflags,
+                     struct Vnode **vpp);
+int close_blockdriver(struct Vnode *vnode);
+
+#endif /* __DRIVERS_BCH_HOST_INCLUDE_FS_FS_H */
@@ -0,0 +1,66 @@
+/****************************************************************************
+ * drivers/bch/host/include/los_task.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/* Host build: task creation, mapped onto POSIX threads. */
+
+#ifndef __DRIVERS_BCH_HOST_INCLUDE_LOS_TASK_H
+#define __DRIVERS_BCH_HOST_INCLUDE_LOS_TASK_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdint.h>
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define LOS_OK                                  0
+#define LOS_TASK_STATUS_DETACHED                0x0100
+#define LOSCFG_BASE_CORE_TSK_DEFAULT_STACK_SIZE 0x4000
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+typedef unsigned long UINTPTR;
+typedef void *(*TSK_ENTRY_FUNC)(UINTPTR param1, UINTPTR param2,
+                                UINTPTR param3, UINTPTR param4);
+
+typedef struct
+{
+  TSK_ENTRY_FUNC pfnTaskEntry;
+  uint16_t usTaskPrio;
+  UINTPTR auwArgs[4];
+  uint32_t uwStackSize;
+  char *pcName;
+  uint32_t uwResved;
+} TSK_INIT_PARAM_S;
+
+/****************************************************************************
+ * Public Function Prototypes
+ ****************************************************************************/
+
+uint32_t LOS_TaskCreate(uint32_t *taskID, TSK_INIT_PARAM_S *initParam);
+
+#endif /* __DRIVERS_BCH_HOST_INCLUDE_LOS_TASK_H */
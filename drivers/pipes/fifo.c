@@ -49,7 +49,7 @@ static const struct file_operations_vfs fifo_fops =
   .read = pipecommon_read,      /* read */
   .write = pipecommon_write,    /* write */
   .seek = NULL,                 /* seek */
-  .ioctl = NULL,                /* ioctl */
+  .ioctl = pipecommon_ioctl,    /* ioctl */
   .mmap = fifo_map,             /* mmap */
   .poll = NULL,                 /* poll */
 #ifndef CONFIG_DISABLE_PSEUDOFS_OPERATIONS
@@ -29,9 +29,13 @@
 #include <fcntl.h>
 #include <semaphore.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include "fs/driver.h"
+#include "fs/file.h"
 #include "los_init.h"
 
 #if CONFIG_DEV_PIPE_SIZE > 0
@@ -40,7 +44,16 @@
  * Pre-processor Definitions
  ****************************************************************************/
 
-#define MAX_PIPES 32
+/* Pipe minor numbers are kept in a bitmap of PIPE_NWORDS words.  A second
+ * level bitmap has a bit set for each of those words that is full, so a
+ * free number is found without scanning the allocated ones.
+ */
+
+#define PIPE_NWORDS      (CONFIG_DEV_PIPE_MAXPIPES / 32)
+#define PIPE_NFULLWORDS  ((PIPE_NWORDS + 31) / 32)
+
+#define PIPE_WORD(n)     ((n) >> 5)
+#define PIPE_BIT(n)      (1u << ((n) & 0x1f))
 
 /****************************************************************************
  * Private Types
@@ -72,7 +85,7 @@ static const struct file_operations_vfs pipe_fops =
   .read = pipecommon_read,      /* read */
   .write = pipecommon_write,    /* write */
   .seek = NULL,                 /* seek */
-  .ioctl = NULL,                /* ioctl */
+  .ioctl = pipecommon_ioctl,    /* ioctl */
   .mmap = pipe_map,             /* mmap */
   .poll = pipecommon_poll,      /* poll */
 #ifndef CONFIG_DISABLE_PSEUDOFS_OPERATIONS
@@ -80,9 +93,19 @@ static const struct file_operations_vfs pipe_fops =
 #endif
 };
 
-static sem_t  g_pipesem       = {NULL};
-static uint32_t g_pipeset     = 0;
-static uint32_t g_pipecreated = 0;
+static sem_t    g_pipesem = {NULL};
+static uint32_t g_pipeset[PIPE_NWORDS];          /* Minor numbers in use */
+static uint32_t g_pipefull[PIPE_NFULLWORDS];     /* Full words of g_pipeset */
+static uint32_t g_pipecreated[PIPE_NWORDS];      /* Device vnode exists */
+
+#ifdef CONFIG_DEV_PIPE_ANONYMOUS
+/* The vnodes of anonymous pipes, in blocks of 32 allocated on first use.
+ * Like a registered /dev/pipeN, a vnode is kept and reused by the next
+ * pipe with the same minor number.
+ */
+
+static struct Vnode **g_pipevnodes[PIPE_NWORDS];
+#endif
 
 /****************************************************************************
  * Private Functions
@@ -94,20 +117,36 @@ static uint32_t g_pipecreated = 0;
 
 static inline int pipe_allocate(void)
 {
+  uint32_t avail;
+  int fullndx;
+  int wordndx;
   int pipeno;
-  int ret = -ENFILE;
 
-  for (pipeno = 0; pipeno < MAX_PIPES; pipeno++)
+  for (fullndx = 0; fullndx < PIPE_NFULLWORDS; fullndx++)
     {
-      if ((g_pipeset & (1 << pipeno)) == 0)
+      avail = ~g_pipefull[fullndx];
+      if (avail == 0)
+        {
+          continue;
+        }
+
+      wordndx = (fullndx << 5) + ffs((int)avail) - 1;
+      if (wordndx >= PIPE_NWORDS)
         {
-          g_pipeset |= (1 << pipeno);
-          ret = pipeno;
           break;
         }
+
+      pipeno = (wordndx << 5) + ffs((int)~g_pipeset[wordndx]) - 1;
+      g_pipeset[wordndx] |= PIPE_BIT(pipeno);
+      if (g_pipeset[wordndx] == UINT32_MAX)
+        {
+          g_pipefull[PIPE_WORD(wordndx)] |= PIPE_BIT(wordndx);
+        }
+
+      return pipeno;
     }
 
-  return ret;
+  return -ENFILE;
 }
 
 /****************************************************************************
@@ -121,7 +160,8 @@ static inline void pipe_free(int pipeno)
   ret = sem_wait(&g_pipesem);
   if (ret == OK)
     {
-      g_pipeset &= ~(1 << pipeno);
+      g_pipeset[PIPE_WORD(pipeno)] &= ~PIPE_BIT(pipeno);
+      g_pipefull[PIPE_WORD(PIPE_WORD(pipeno))] &= ~PIPE_BIT(PIPE_WORD(pipeno));
       (void)sem_post(&g_pipesem);
     }
 }
@@ -162,7 +202,7 @@ static int pipe_close(struct file *filep)
  int pipe_unlink(struct Vnode *vnode)
 {
   struct pipe_dev_s *dev = ((struct drv_data *)vnode->data)->priv;
-  uint8_t pipeno = 0;
+  uint32_t pipeno = 0;
   int ret;
 
   if (dev != NULL)
@@ -174,7 +214,7 @@ static int pipe_close(struct file *filep)
   if (ret == 0)
     {
       (void)sem_wait(&g_pipesem);
-      g_pipecreated &= ~(1 << pipeno);
+      g_pipecreated[PIPE_WORD(pipeno)] &= ~PIPE_BIT(pipeno);
       (void)sem_post(&g_pipesem);
       /* Release the pipe when there are no further open references to it. */
       pipe_free(pipeno);
@@ -184,38 +224,42 @@ static int pipe_close(struct file *filep)
 #endif
 
 /****************************************************************************
- * Public Functions
- ****************************************************************************/
-
-/****************************************************************************
- * Name: pipe2
+ * Name: pipe_setdev
  *
  * Description:
- *   pipe() creates a pair of file descriptors, pointing to a pipe vnode,
- *   and  places them in the array pointed to by 'fd'. fd[0] is for reading,
- *   fd[1] is for writing.
- *
- *   NOTE: mkfifo2 is a special, non-standard, NuttX-only interface.  Since
- *   the NuttX FIFOs are based in in-memory, circular buffers, the ability
- *   to control the size of those buffers is critical for system tuning.
- *
- * Input Parameters:
- *   fd[2] - The user provided array in which to catch the pipe file
- *   descriptors
- *   bufsize - The size of the in-memory, circular buffer in bytes.
- *
- * Returned Value:
- *   0 is returned on success; otherwise, -1 is returned with errno set
- *   appropriately.
+ *   Attach a new device instance to a pipe vnode, freeing the one left
+ *   behind by the previous pipe with the same minor number.
  *
  ****************************************************************************/
 
+static void pipe_setdev(struct Vnode *vnode, struct pipe_dev_s *dev)
+{
+  struct pipe_dev_s *olddev = NULL;
+  struct drv_data *data = NULL;
+
+  data = (struct drv_data *)vnode->data;
+  olddev = (struct pipe_dev_s *)data->priv;
+  if (olddev != NULL)
+    {
+      if (olddev->d_buffer != NULL)
+        {
+          free(olddev->d_buffer);
+          olddev->d_buffer = NULL;
+        }
+      pipecommon_freedev(olddev);
+    }
+  data->priv = dev;
+}
+
+#ifndef CONFIG_DEV_PIPE_ANONYMOUS
+/****************************************************************************
+ * Name: UpdateDev
+ ****************************************************************************/
+
 static void UpdateDev(struct pipe_dev_s *dev)
 {
   int ret;
   struct Vnode *vnode = NULL;
-  struct pipe_dev_s *olddev = NULL;
-  struct drv_data *data = NULL;
 
   VnodeHold();
   ret = VnodeLookup(dev->name, &vnode, 0);
@@ -225,31 +269,164 @@ static void UpdateDev(struct pipe_dev_s *dev)
       PRINT_ERR("[%s,%d] failed. err: %d\n", __FUNCTION__, __LINE__, ret);
       return;
     }
-  data = (struct drv_data *)vnode->data;
-  olddev = (struct pipe_dev_s *)data->priv;
-  if (olddev != NULL)
+  pipe_setdev(vnode, dev);
+  VnodeDrop();
+  return;
+}
+#else
+/****************************************************************************
+ * Name: pipe_anonvnode
+ *
+ * Description:
+ *   Return the vnode of anonymous pipe 'pipeno', creating it with 'dev' as
+ *   its device on first use.  The vnode is not entered in the file system
+ *   name space.
+ *
+ * Assumptions:
+ *   The caller holds g_pipesem.
+ *
+ ****************************************************************************/
+
+static struct Vnode *pipe_anonvnode(int pipeno, struct pipe_dev_s *dev)
+{
+  struct Vnode **block = g_pipevnodes[PIPE_WORD(pipeno)];
+  struct Vnode *vnode = NULL;
+  struct drv_data *data = NULL;
+  int ret;
+
+  if (block == NULL)
     {
-      if (olddev->d_buffer != NULL)
+      block = (struct Vnode **)zalloc(32 * sizeof(struct Vnode *));
+      if (block == NULL)
         {
-          free(olddev->d_buffer);
-          olddev->d_buffer = NULL;
+          return NULL;
         }
-      pipecommon_freedev(olddev);
+
+      g_pipevnodes[PIPE_WORD(pipeno)] = block;
     }
+
+  if (block[pipeno & 0x1f] != NULL)
+    {
+      vnode = block[pipeno & 0x1f];
+      VnodeHold();
+      pipe_setdev(vnode, dev);
+      VnodeDrop();
+      return vnode;
+    }
+
+  data = (struct drv_data *)zalloc(sizeof(struct drv_data));
+  if (data == NULL)
+    {
+      return NULL;
+    }
+
+  data->ops  = (void *)&pipe_fops;
+  data->mode = 0660;
   data->priv = dev;
+
+  VnodeHold();
+  ret = VnodeAlloc(NULL, &vnode);
+  if (ret != OK)
+    {
+      VnodeDrop();
+      free(data);
+      return NULL;
+    }
+
+  vnode->type     = VNODE_TYPE_CHR;
+  vnode->data     = data;
+  vnode->mode     = 0660;
+  vnode->fop      = (struct file_operations_vfs *)&pipe_fops;
+  vnode->filePath = strdup(dev->name);
   VnodeDrop();
-  return;
+
+  block[pipeno & 0x1f] = vnode;
+  return vnode;
 }
 
+/****************************************************************************
+ * Name: pipe_anonopen
+ *
+ * Description:
+ *   Open an anonymous pipe vnode the way open() opens a driver, and return
+ *   the new file descriptor or a negated errno value.
+ *
+ ****************************************************************************/
+
+static int pipe_anonopen(struct Vnode *vnode, int oflags)
+{
+  struct file *filep = NULL;
+  int ret;
+
+  VnodeHold();
+  vnode->useCount++;
+  VnodeDrop();
+
+  filep = files_allocate(vnode, oflags, 0, NULL, FILE_START_FD);
+  if (filep == NULL)
+    {
+      ret = -EMFILE;
+      goto errout_with_count;
+    }
+
+  ret = pipecommon_open(filep);
+  if (ret < 0)
+    {
+      files_release(filep->fd);
+      goto errout_with_count;
+    }
+
+  return filep->fd;
+
+errout_with_count:
+  VnodeHold();
+  vnode->useCount--;
+  VnodeDrop();
+  return ret;
+}
+#endif /* CONFIG_DEV_PIPE_ANONYMOUS */
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: pipe2
+ *
+ * Description:
+ *   pipe() creates a pair of file descriptors, pointing to a pipe vnode,
+ *   and  places them in the array pointed to by 'fd'. fd[0] is for reading,
+ *   fd[1] is for writing.
+ *
+ *   NOTE: mkfifo2 is a special, non-standard, NuttX-only interface.  Since
+ *   the NuttX FIFOs are based in in-memory, circular buffers, the ability
+ *   to control the size of those buffers is critical for system tuning.
+ *
+ * Input Parameters:
+ *   fd[2] - The user provided array in which to catch the pipe file
+ *   descriptors
+ *   bufsize - The size of the in-memory, circular buffer in bytes.
+ *
+ * Returned Value:
+ *   0 is returned on success; otherwise, -1 is returned with errno set
+ *   appropriately.
+ *
+ ****************************************************************************/
+
 int pipe(int fd[2])
 {
   struct pipe_dev_s *dev = NULL;
-  char devname[16];
+#ifdef CONFIG_DEV_PIPE_ANONYMOUS
+  struct Vnode *vnode = NULL;
+#endif
+  char devname[32];
   int pipeno;
   int errcode;
   int ret;
+#ifndef CONFIG_DEV_PIPE_ANONYMOUS
   struct file *filep = NULL;
-  size_t bufsize = 1024;
+#endif
+  size_t bufsize = CONFIG_DEV_PIPE_SIZE;
 
   /* Get exclusive access to the pipe allocation data */
 
@@ -272,7 +449,11 @@ int pipe(int fd[2])
 
   /* Create a pathname to the pipe device */
 
+#ifdef CONFIG_DEV_PIPE_ANONYMOUS
+  snprintf_s(devname, sizeof(devname), sizeof(devname) - 1, "pipe:[%d]", pipeno);
+#else
   snprintf_s(devname, sizeof(devname), sizeof(devname) - 1, "/dev/pipe%d", pipeno);
+#endif
 
   /* No.. Allocate and initialize a new device structure instance */
 
@@ -286,9 +467,59 @@ int pipe(int fd[2])
 
   dev->d_pipeno = pipeno;
 
+#ifdef CONFIG_DEV_PIPE_ANONYMOUS
+  /* Create or reuse the vnode of the pipe */
+
+  vnode = pipe_anonvnode(pipeno, dev);
+  if (vnode == NULL)
+    {
+      (void)sem_post(&g_pipesem);
+      errcode = ENOMEM;
+      goto errout_with_dev;
+    }
+
+  (void)sem_post(&g_pipesem);
+
+  /* Get the write and read file descriptors */
+
+  fd[1] = pipe_anonopen(vnode, O_WRONLY);
+  if (fd[1] < 0)
+    {
+      errcode = -fd[1];
+      goto errout_with_vnode;
+    }
+
+  fd[0] = pipe_anonopen(vnode, O_RDONLY);
+  if (fd[0] < 0)
+    {
+      /* Closing the write descriptor releases the pipe number the way the
+       * last close of any pipe does.  The device stays attached to the
+       * vnode until the number is reused, so nothing is left to undo here
+       * and neither may be touched again.
+       */
+
+      errcode = -fd[0];
+      (void)close(fd[1]);
+      goto errout;
+    }
+
+  return OK;
+
+errout_with_vnode:
+  /* No descriptor was opened.  The vnode is kept for reuse, but it must
+   * not keep the device.
+   */
+
+  (void)sem_wait(&g_pipesem);
+  VnodeHold();
+  ((struct drv_data *)vnode->data)->priv = NULL;
+  VnodeDrop();
+  (void)sem_post(&g_pipesem);
+  goto errout_with_dev;
+#else
   /* Check if the pipe device has already been created */
 
-  if ((g_pipecreated & (1 << pipeno)) == 0)
+  if ((g_pipecreated[PIPE_WORD(pipeno)] & PIPE_BIT(pipeno)) == 0)
     {
       /* Register the pipe device */
 
@@ -302,7 +533,7 @@ int pipe(int fd[2])
 
       /* Remember that we created this device */
 
-       g_pipecreated |= (1 << pipeno);
+       g_pipecreated[PIPE_WORD(pipeno)] |= PIPE_BIT(pipeno);
     }
   else
     {
@@ -342,8 +573,9 @@ errout_with_wrfd:
 errout_with_driver:
   unregister_driver(devname);
   (void)sem_wait(&g_pipesem);
-  g_pipecreated &= ~(1 << pipeno);
+  g_pipecreated[PIPE_WORD(pipeno)] &= ~PIPE_BIT(pipeno);
   (void)sem_post(&g_pipesem);
+#endif /* CONFIG_DEV_PIPE_ANONYMOUS */
 
 errout_with_dev:
   if (dev)
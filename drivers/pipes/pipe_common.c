@@ -68,6 +68,10 @@
  ****************************************************************************/
 
 static void pipecommon_semtake(sem_t *sem);
+static ssize_t pipecommon_copyout(struct pipe_dev_s *dev, char *buffer,
+                                  size_t len);
+static ssize_t pipecommon_copyin(struct pipe_dev_s *dev, const char *buffer,
+                                 size_t len);
 
 /****************************************************************************
  * Private Functions
@@ -106,6 +110,294 @@ static void pipecommon_pollnotify(struct pipe_dev_s *dev,
   notify_poll_with_key(&dev->wq, eventset);
 }
 
+/****************************************************************************
+ * Name: pipecommon_splicewait
+ *
+ * Description:
+ *   Wait until no splice holds the span 'flag' refers to.  A splice works
+ *   on the buffer without holding d_bfsem, so other readers (for
+ *   PIPE_FLAG_RDSPLICE) or writers (for PIPE_FLAG_WRSPLICE) must not move
+ *   the same index meanwhile.  The caller holds d_bfsem, which is released
+ *   while waiting.
+ *
+ ****************************************************************************/
+
+static void pipecommon_splicewait(struct pipe_dev_s *dev, uint8_t flag)
+{
+  while ((dev->d_flags & flag) != 0)
+    {
+      dev->d_nsplwaiters++;
+      sem_post(&dev->d_bfsem);
+      pipecommon_semtake(&dev->d_splsem);
+      pipecommon_semtake(&dev->d_bfsem);
+    }
+}
+
+/****************************************************************************
+ * Name: pipecommon_spliceend
+ *
+ * Description:
+ *   Clear 'flag' and wake up every task waiting in pipecommon_splicewait().
+ *   The caller holds d_bfsem.
+ *
+ ****************************************************************************/
+
+static void pipecommon_spliceend(struct pipe_dev_s *dev, uint8_t flag)
+{
+  dev->d_flags &= ~flag;
+  while (dev->d_nsplwaiters > 0)
+    {
+      dev->d_nsplwaiters--;
+      sem_post(&dev->d_splsem);
+    }
+}
+
+/****************************************************************************
+ * Name: pipecommon_rdspan
+ *
+ * Description:
+ *   Return the number of buffered bytes that are contiguous from the read
+ *   index.  The caller holds d_bfsem.
+ *
+ ****************************************************************************/
+
+static inline size_t pipecommon_rdspan(struct pipe_dev_s *dev)
+{
+  if (dev->d_wrndx >= dev->d_rdndx)
+    {
+      return dev->d_wrndx - dev->d_rdndx;
+    }
+
+  return dev->d_bufsize - dev->d_rdndx;
+}
+
+/****************************************************************************
+ * Name: pipecommon_wrspan
+ *
+ * Description:
+ *   Return the number of free bytes that are contiguous from the write
+ *   index.  One byte is always left free so that a full buffer can be told
+ *   from an empty one.  The caller holds d_bfsem.
+ *
+ ****************************************************************************/
+
+static inline size_t pipecommon_wrspan(struct pipe_dev_s *dev)
+{
+  if (dev->d_rdndx > dev->d_wrndx)
+    {
+      return dev->d_rdndx - dev->d_wrndx - 1;
+    }
+
+  return dev->d_bufsize - dev->d_wrndx - ((dev->d_rdndx == 0) ? 1 : 0);
+}
+
+/****************************************************************************
+ * Name: pipecommon_rdadvance / pipecommon_wradvance
+ *
+ * Description:
+ *   Consume or commit 'n' bytes at the read or write index.  'n' must not
+ *   exceed the current span.  The caller holds d_bfsem.
+ *
+ ****************************************************************************/
+
+static inline void pipecommon_rdadvance(struct pipe_dev_s *dev, size_t n)
+{
+  size_t rdndx = dev->d_rdndx + n;
+
+  dev->d_rdndx = (rdndx >= dev->d_bufsize) ? 0 : (pipe_ndx_t)rdndx;
+}
+
+static inline void pipecommon_wradvance(struct pipe_dev_s *dev, size_t n)
+{
+  size_t wrndx = dev->d_wrndx + n;
+
+  dev->d_wrndx = (wrndx >= dev->d_bufsize) ? 0 : (pipe_ndx_t)wrndx;
+}
+
+/****************************************************************************
+ * Name: pipecommon_copyout
+ *
+ * Description:
+ *   Move up to 'len' bytes from the circular buffer to the user buffer.  The
+ *   buffered data is in at most two contiguous pieces (before and after the
+ *   wrap), so at most two user copies are made.
+ *
+ * Returned Value:
+ *   The number of bytes moved (possibly zero) or -EFAULT.
+ *
+ * Assumptions:
+ *   The caller holds d_bfsem.
+ *
+ ****************************************************************************/
+
+static ssize_t pipecommon_copyout(struct pipe_dev_s *dev, char *buffer,
+                                  size_t len)
+{
+  size_t nread = 0;
+  size_t chunk;
+
+  while (nread < len && dev->d_wrndx != dev->d_rdndx)
+    {
+      /* Take the data up to the write index or the end of the buffer */
+
+      chunk = pipecommon_rdspan(dev);
+      if (chunk > len - nread)
+        {
+          chunk = len - nread;
+        }
+
+      if (LOS_ArchCopyToUser(buffer + nread, dev->d_buffer + dev->d_rdndx, chunk) != 0)
+        {
+          return -EFAULT;
+        }
+
+      pipecommon_rdadvance(dev, chunk);
+      nread += chunk;
+    }
+
+  return nread;
+}
+
+/****************************************************************************
+ * Name: pipecommon_copyin
+ *
+ * Description:
+ *   Move up to 'len' bytes from the user buffer into the free space of the
+ *   circular buffer, in at most two contiguous user copies.  One byte is
+ *   always left free so that a full buffer can be told from an empty one.
+ *
+ * Returned Value:
+ *   The number of bytes moved (possibly zero) or -EFAULT.
+ *
+ * Assumptions:
+ *   The caller holds d_bfsem.
+ *
+ ****************************************************************************/
+
+static ssize_t pipecommon_copyin(struct pipe_dev_s *dev, const char *buffer,
+                                 size_t len)
+{
+  size_t nwritten = 0;
+  size_t chunk;
+
+  while (nwritten < len)
+    {
+      /* Fill up to the byte before the read index or the end of the buffer */
+
+      chunk = pipecommon_wrspan(dev);
+      if (chunk == 0)
+        {
+          break;
+        }
+
+      if (chunk > len - nwritten)
+        {
+          chunk = len - nwritten;
+        }
+
+      if (LOS_ArchCopyFromUser(dev->d_buffer + dev->d_wrndx, buffer + nwritten, chunk) != 0)
+        {
+          return -EFAULT;
+        }
+
+      pipecommon_wradvance(dev, chunk);
+      nwritten += chunk;
+    }
+
+  return nwritten;
+}
+
+/****************************************************************************
+ * Name: pipecommon_resize
+ *
+ * Description:
+ *   Change the capacity of the pipe to 'size' bytes.  The buffered data is
+ *   moved to the start of the new buffer.
+ *
+ * Returned Value:
+ *   The new capacity on success; -EPERM if 'size' exceeds the largest
+ *   capacity, -EBUSY if more than 'size' bytes are buffered or a splice is
+ *   using the buffer, -EINVAL or -ENOMEM on other failures.
+ *
+ * Assumptions:
+ *   The caller holds d_bfsem.
+ *
+ ****************************************************************************/
+
+static int pipecommon_resize(struct pipe_dev_s *dev, size_t size)
+{
+  uint8_t *buffer;
+  size_t nbytes;
+  size_t chunk;
+
+  /* One byte of the buffer always stays free */
+
+  if (size < 1)
+    {
+      return -EINVAL;
+    }
+
+  if (size >= CONFIG_DEV_PIPE_MAXSIZE)
+    {
+      return -EPERM;
+    }
+
+  /* A splice works on the buffer without holding d_bfsem */
+
+  if ((dev->d_flags & (PIPE_FLAG_RDSPLICE | PIPE_FLAG_WRSPLICE)) != 0)
+    {
+      return -EBUSY;
+    }
+
+  /* Until the pipe is opened there is no buffer, only its size */
+
+  if (dev->d_buffer == NULL)
+    {
+      dev->d_bufsize = size + 1;
+      return size;
+    }
+
+  if (dev->d_wrndx >= dev->d_rdndx)
+    {
+      nbytes = dev->d_wrndx - dev->d_rdndx;
+    }
+  else
+    {
+      nbytes = dev->d_bufsize + dev->d_wrndx - dev->d_rdndx;
+    }
+
+  if (nbytes > size)
+    {
+      return -EBUSY;
+    }
+
+  buffer = (uint8_t *)malloc(size + 1);
+  if (buffer == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  /* Copy the data out of the old buffer in at most two pieces */
+
+  if (dev->d_wrndx >= dev->d_rdndx)
+    {
+      (void)memcpy_s(buffer, size + 1, dev->d_buffer + dev->d_rdndx, nbytes);
+    }
+  else
+    {
+      chunk = dev->d_bufsize - dev->d_rdndx;
+      (void)memcpy_s(buffer, size + 1, dev->d_buffer + dev->d_rdndx, chunk);
+      (void)memcpy_s(buffer + chunk, size + 1 - chunk, dev->d_buffer, nbytes - chunk);
+    }
+
+  free(dev->d_buffer);
+  dev->d_buffer  = buffer;
+  dev->d_bufsize = size + 1;
+  dev->d_rdndx   = 0;
+  dev->d_wrndx   = nbytes;
+  return size;
+}
+
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
@@ -119,7 +411,7 @@ struct pipe_dev_s *pipecommon_allocdev(size_t bufsize, const char *name)
   struct pipe_dev_s *dev = NULL;
   int ret;
 
-  if (bufsize > CONFIG_DEV_PIPE_MAXSIZE)
+  if (bufsize < 2 || bufsize > CONFIG_DEV_PIPE_MAXSIZE)
     {
       return NULL;
     }
@@ -141,6 +433,7 @@ struct pipe_dev_s *pipecommon_allocdev(size_t bufsize, const char *name)
       sem_init(&dev->d_bfsem, 0, 1);
       sem_init(&dev->d_rdsem, 0, 0);
       sem_init(&dev->d_wrsem, 0, 0);
+      sem_init(&dev->d_splsem, 0, 0);
       LOS_ListInit(&dev->wq.poll_queue);
      /* The read/write wait semaphores are used for signaling and, hence,
       * should not have priority inheritance enabled.
@@ -161,6 +454,7 @@ void pipecommon_freedev(struct pipe_dev_s *dev)
   sem_destroy(&dev->d_bfsem);
   sem_destroy(&dev->d_rdsem);
   sem_destroy(&dev->d_wrsem);
+  sem_destroy(&dev->d_splsem);
   free(dev);
 }
 
@@ -407,10 +701,18 @@ ssize_t pipecommon_read(struct file *filep, char *buffer, size_t len)
       return ret;
     }
 
-  /* If the pipe is empty, then wait for something to be written to it */
+  /* If the pipe is empty, then wait for something to be written to it.
+   * Data that a splice is draining is not available.
+   */
 
-  while (dev->d_wrndx == dev->d_rdndx)
+  for (; ; )
     {
+      pipecommon_splicewait(dev, PIPE_FLAG_RDSPLICE);
+      if (dev->d_wrndx != dev->d_rdndx)
+        {
+          break;
+        }
+
       /* If O_NONBLOCK was set, then return EGAIN */
 
       if (filep->f_oflags & O_NONBLOCK)
@@ -443,23 +745,17 @@ ssize_t pipecommon_read(struct file *filep, char *buffer, size_t len)
   nread = 0;
   for (; ; )
     {
-      while ((size_t)nread < len && dev->d_wrndx != dev->d_rdndx)
-        {
-          ret = LOS_ArchCopyToUser(buffer, dev->d_buffer + dev->d_rdndx, sizeof(char));
-          if (ret != 0)
-            {
-              sem_post(&dev->d_bfsem);
-              return -EFAULT;
-            }
-          buffer++;
-          if (++dev->d_rdndx >= dev->d_bufsize)
-            {
-              dev->d_rdndx = 0;
-            }
+      /* Drain the circular buffer in at most two contiguous copies */
 
-          nread++;
+      ret = pipecommon_copyout(dev, buffer + nread, len - nread);
+      if (ret < 0)
+        {
+          sem_post(&dev->d_bfsem);
+          return ret;
         }
 
+      nread += ret;
+
       /* Is the read complete? */
       if ((size_t)nread >= len)
         {
@@ -515,6 +811,8 @@ ssize_t pipecommon_read(struct file *filep, char *buffer, size_t len)
         {
           return ret;
         }
+
+      pipecommon_splicewait(dev, PIPE_FLAG_RDSPLICE);
     }
 
   /* Notify all waiting writers that bytes have been removed from the buffer */
@@ -542,7 +840,7 @@ ssize_t pipecommon_write(struct file *filep, const char *buffer,
   struct pipe_dev_s *dev      = (struct pipe_dev_s *)((struct drv_data *)vnode->data)->priv;
   ssize_t                nwritten = 0;
   ssize_t                last;
-  int                    nxtwrndx;
+  ssize_t                nbytes;
   int                    sval;
   int                    ret;
 
@@ -601,54 +899,43 @@ ssize_t pipecommon_write(struct file *filep, const char *buffer,
   last = 0;
   for (; ; )
     {
-      /* Calculate the write index AFTER the next byte is written */
+      /* Fill the free space of the circular buffer in at most two
+       * contiguous copies.  Free space that a splice is filling is not
+       * available.
+       */
+
+      pipecommon_splicewait(dev, PIPE_FLAG_WRSPLICE);
 
-      nxtwrndx = dev->d_wrndx + 1;
-      if (nxtwrndx >= dev->d_bufsize)
+      nbytes = pipecommon_copyin(dev, buffer + nwritten, len - nwritten);
+      if (nbytes < 0)
         {
-          nxtwrndx = 0;
+          sem_post(&dev->d_bfsem);
+          return nbytes;
         }
 
-      /* Would the next write overflow the circular buffer? */
+      /* Is the write complete? */
 
-      if (nxtwrndx != dev->d_rdndx)
+      nwritten += nbytes;
+      if ((size_t)nwritten >= len)
         {
-          /* No... copy the byte */
-
-
-          ret = LOS_ArchCopyFromUser(dev->d_buffer + dev->d_wrndx, buffer, sizeof(char));
-          if (ret != 0)
+          /* Yes.. Notify all of the waiting readers that more data is available */
+          while (sem_getvalue(&dev->d_rdsem, &sval) == 0 && sval == 0)
             {
-              sem_post(&dev->d_bfsem);
-              return -EFAULT;
+              sem_post(&dev->d_rdsem);
             }
-          buffer++;
-          dev->d_wrndx = nxtwrndx;
-
-          /* Is the write complete? */
-
-          nwritten++;
-          if ((size_t)nwritten >= len)
-            {
-              /* Yes.. Notify all of the waiting readers that more data is available */
-              while (sem_getvalue(&dev->d_rdsem, &sval) == 0 && sval == 0)
-                {
-                  sem_post(&dev->d_rdsem);
-                }
 
-              /* Notify all poll/select waiters that they can read from the FIFO */
+          /* Notify all poll/select waiters that they can read from the FIFO */
 
-              pipecommon_pollnotify(dev, POLLIN);
+          pipecommon_pollnotify(dev, POLLIN);
 
-              /* Return the number of bytes written */
+          /* Return the number of bytes written */
 
-              sem_post(&dev->d_bfsem);
-              return len;
-            }
+          sem_post(&dev->d_bfsem);
+          return len;
         }
       else
         {
-          /* There is not enough room for the next byte.  Was anything written in this pass? */
+          /* The buffer is full.  Was anything written in this pass? */
 
           if (last < nwritten)
             {
@@ -693,6 +980,277 @@ ssize_t pipecommon_write(struct file *filep, const char *buffer,
     }
 }
 
+/****************************************************************************
+ * Name: pipecommon_spliceread
+ *
+ * Description:
+ *   Move up to 'len' bytes from the pipe to 'outfilep'.  The data is written
+ *   to 'outfilep' straight out of the circular buffer, in at most two
+ *   pieces, instead of going through an intermediate buffer.  Waits for
+ *   data the way pipecommon_read() does unless 'nonblock' is set.
+ *
+ *   d_bfsem is not held while 'outfilep' is written.  PIPE_FLAG_RDSPLICE
+ *   keeps other readers and pipecommon_resize() away from the span being
+ *   written, and writers never touch buffered data.
+ *
+ * Returned Value:
+ *   The number of bytes moved, 0 at end-of-file, or a negated errno value.
+ *
+ ****************************************************************************/
+
+ssize_t pipecommon_spliceread(struct file *filep, struct file *outfilep,
+                              size_t len, bool nonblock)
+{
+  struct Vnode      *vnode = filep->f_vnode;
+  struct pipe_dev_s *dev   = (struct pipe_dev_s *)((struct drv_data *)vnode->data)->priv;
+  ssize_t                nspliced = 0;
+  ssize_t                nbytes;
+  uint8_t               *data;
+  size_t                 chunk;
+  int                    sval;
+  int                    ret;
+
+  if (dev == NULL)
+    {
+      return -EINVAL;
+    }
+
+  if (len == 0)
+    {
+      return 0;
+    }
+
+  ret = sem_wait(&dev->d_bfsem);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  /* If the pipe is empty, then wait for something to be written to it */
+
+  for (; ; )
+    {
+      pipecommon_splicewait(dev, PIPE_FLAG_RDSPLICE);
+      if (dev->d_wrndx != dev->d_rdndx)
+        {
+          break;
+        }
+
+      if (nonblock || (filep->f_oflags & O_NONBLOCK))
+        {
+          sem_post(&dev->d_bfsem);
+          return -EAGAIN;
+        }
+
+      if (dev->d_nwriters <= 0)
+        {
+          sem_post(&dev->d_bfsem);
+          return 0;
+        }
+
+      sem_post(&dev->d_bfsem);
+      ret = sem_wait(&dev->d_rdsem);
+      if (ret < 0 || (ret = sem_wait(&dev->d_bfsem)) < 0)
+        {
+          return ret;
+        }
+    }
+
+  /* Hand the buffered data to the output file without holding d_bfsem */
+
+  dev->d_flags |= PIPE_FLAG_RDSPLICE;
+  while ((size_t)nspliced < len && dev->d_wrndx != dev->d_rdndx)
+    {
+      chunk = pipecommon_rdspan(dev);
+      if (chunk > len - nspliced)
+        {
+          chunk = len - nspliced;
+        }
+
+      data = dev->d_buffer + dev->d_rdndx;
+      sem_post(&dev->d_bfsem);
+      nbytes = file_write(outfilep, data, chunk);
+      if (nbytes < 0)
+        {
+          nbytes = -get_errno();
+        }
+
+      pipecommon_semtake(&dev->d_bfsem);
+      if (nbytes < 0)
+        {
+          if (nspliced == 0)
+            {
+              nspliced = nbytes;
+            }
+
+          break;
+        }
+
+      pipecommon_rdadvance(dev, nbytes);
+      nspliced += nbytes;
+      if ((size_t)nbytes < chunk)
+        {
+          break;
+        }
+    }
+
+  pipecommon_spliceend(dev, PIPE_FLAG_RDSPLICE);
+
+  /* Notify all waiting writers that bytes have been removed from the buffer */
+
+  if (nspliced > 0)
+    {
+      while (sem_getvalue(&dev->d_wrsem, &sval) == 0 && sval == 0)
+        {
+          sem_post(&dev->d_wrsem);
+        }
+
+      pipecommon_pollnotify(dev, POLLOUT);
+    }
+
+  sem_post(&dev->d_bfsem);
+  return nspliced;
+}
+
+/****************************************************************************
+ * Name: pipecommon_splicewrite
+ *
+ * Description:
+ *   Move up to 'len' bytes from 'infilep' into the pipe.  'infilep' is read
+ *   straight into the free space of the circular buffer, in at most two
+ *   pieces.  Waits for free space the way pipecommon_write() does unless
+ *   'nonblock' is set.
+ *
+ *   d_bfsem is not held while 'infilep' is read.  PIPE_FLAG_WRSPLICE keeps
+ *   other writers and pipecommon_resize() away from the span being filled,
+ *   and readers never touch free space.
+ *
+ * Returned Value:
+ *   The number of bytes moved, 0 at end-of-file of 'infilep', or a negated
+ *   errno value.
+ *
+ ****************************************************************************/
+
+ssize_t pipecommon_splicewrite(struct file *filep, struct file *infilep,
+                               size_t len, bool nonblock)
+{
+  struct Vnode      *vnode = filep->f_vnode;
+  struct pipe_dev_s *dev   = (struct pipe_dev_s *)((struct drv_data *)vnode->data)->priv;
+  ssize_t                nspliced = 0;
+  ssize_t                nbytes;
+  uint8_t               *data;
+  size_t                 chunk;
+  int                    sval;
+  int                    ret;
+
+  if (dev == NULL)
+    {
+      return -EINVAL;
+    }
+
+  if (len == 0)
+    {
+      return 0;
+    }
+
+  if (dev->d_nreaders <= 0)
+    {
+      return -EPIPE;
+    }
+
+  ret = sem_wait(&dev->d_bfsem);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  /* If the pipe is full, then wait for data to be removed from it */
+
+  for (; ; )
+    {
+      pipecommon_splicewait(dev, PIPE_FLAG_WRSPLICE);
+      if (pipecommon_wrspan(dev) != 0)
+        {
+          break;
+        }
+
+      if (nonblock || (filep->f_oflags & O_NONBLOCK))
+        {
+          sem_post(&dev->d_bfsem);
+          return -EAGAIN;
+        }
+
+      while (sem_getvalue(&dev->d_wrsem, &sval) == 0 && sval != 0)
+        {
+          pipecommon_semtake(&dev->d_wrsem);
+        }
+
+      sem_post(&dev->d_bfsem);
+      pipecommon_semtake(&dev->d_wrsem);
+      pipecommon_semtake(&dev->d_bfsem);
+    }
+
+  /* Let the input file fill the free space without holding d_bfsem */
+
+  dev->d_flags |= PIPE_FLAG_WRSPLICE;
+  while ((size_t)nspliced < len)
+    {
+      chunk = pipecommon_wrspan(dev);
+      if (chunk == 0)
+        {
+          break;
+        }
+
+      if (chunk > len - nspliced)
+        {
+          chunk = len - nspliced;
+        }
+
+      data = dev->d_buffer + dev->d_wrndx;
+      sem_post(&dev->d_bfsem);
+      nbytes = file_read(infilep, data, chunk);
+      if (nbytes < 0)
+        {
+          nbytes = -get_errno();
+        }
+
+      pipecommon_semtake(&dev->d_bfsem);
+      if (nbytes < 0)
+        {
+          if (nspliced == 0)
+            {
+              nspliced = nbytes;
+            }
+
+          break;
+        }
+
+      pipecommon_wradvance(dev, nbytes);
+      nspliced += nbytes;
+      if ((size_t)nbytes < chunk)
+        {
+          break;
+        }
+    }
+
+  pipecommon_spliceend(dev, PIPE_FLAG_WRSPLICE);
+
+  /* Notify all of the waiting readers that more data is available */
+
+  if (nspliced > 0)
+    {
+      while (sem_getvalue(&dev->d_rdsem, &sval) == 0 && sval == 0)
+        {
+          sem_post(&dev->d_rdsem);
+        }
+
+      pipecommon_pollnotify(dev, POLLIN);
+    }
+
+  sem_post(&dev->d_bfsem);
+  return nspliced;
+}
+
 /****************************************************************************
  * Name: pipecommon_poll
  ****************************************************************************/
@@ -776,7 +1334,54 @@ int pipecommon_poll(struct file *filep, poll_table *table)
 
 int pipecommon_ioctl(struct file *filep, int cmd, unsigned long arg)
 {
-  return -ENOSYS;
+  struct Vnode      *vnode = filep->f_vnode;
+  struct pipe_dev_s *dev   = (struct pipe_dev_s *)((struct drv_data *)vnode->data)->priv;
+  int                    sval;
+  int                    ret;
+
+  if (dev == NULL)
+    {
+      return -EINVAL;
+    }
+
+  switch (cmd)
+    {
+      /* Return the capacity of the pipe in bytes */
+
+      case F_GETPIPE_SZ:
+        pipecommon_semtake(&dev->d_bfsem);
+        ret = dev->d_bufsize - 1;
+        sem_post(&dev->d_bfsem);
+        break;
+
+      /* Change the capacity of the pipe.  The buffer is reallocated while
+       * d_bfsem is held, so no reader or writer sees it half moved.
+       */
+
+      case F_SETPIPE_SZ:
+        pipecommon_semtake(&dev->d_bfsem);
+        ret = pipecommon_resize(dev, (size_t)arg);
+        if (ret > 0 && dev->d_buffer != NULL)
+          {
+            /* Writers blocked on a full buffer may have room now */
+
+            while (sem_getvalue(&dev->d_wrsem, &sval) == 0 && sval == 0)
+              {
+                sem_post(&dev->d_wrsem);
+              }
+
+            pipecommon_pollnotify(dev, POLLOUT);
+          }
+
+        sem_post(&dev->d_bfsem);
+        break;
+
+      default:
+        ret = -ENOSYS;
+        break;
+    }
+
+  return ret;
 }
 
 /****************************************************************************
@@ -25,6 +25,7 @@
  * Included Files
  ****************************************************************************/
 #include "vnode.h"
+#include "fs/file.h"
 #include <sys/types.h>
 #include <limits.h>
 #include <stdint.h>
@@ -43,8 +44,12 @@
 #  define MAX_READ_WRITE_LEN 0x1000000
 #endif
 
+/* Upper limit of the buffer size, including the size set at run time
+ * with F_SETPIPE_SZ.
+ */
+
 #ifndef CONFIG_DEV_PIPE_MAXSIZE
-#  define CONFIG_DEV_PIPE_MAXSIZE 1024
+#  define CONFIG_DEV_PIPE_MAXSIZE 0x100000
 #endif
 
 #if CONFIG_DEV_PIPE_MAXSIZE <= 0
@@ -69,6 +74,24 @@
 #  define CONFIG_DEV_PIPE_NPOLLWAITERS 2
 #endif
 
+/* Maximum number of pipes that can exist at the same time.  Pipe minor
+ * numbers are allocated from a two-level bitmap, so this must be a
+ * multiple of 32.
+ */
+
+#ifndef CONFIG_DEV_PIPE_MAXPIPES
+#  define CONFIG_DEV_PIPE_MAXPIPES 4096
+#endif
+
+#if (CONFIG_DEV_PIPE_MAXPIPES % 32) != 0
+#  error CONFIG_DEV_PIPE_MAXPIPES must be a multiple of 32
+#endif
+
+/* If CONFIG_DEV_PIPE_ANONYMOUS is defined, pipe() does not register a
+ * /dev/pipeN driver for each pipe.  The pipe is only reachable through the
+ * two file descriptors returned.
+ */
+
 /* Maximum number of open's supported on pipe */
 
 #define CONFIG_DEV_PIPE_MAXUSER 255
@@ -77,6 +100,8 @@
 
 #define PIPE_FLAG_POLICY    (1 << 0) /* Bit 0: Policy=Free buffer when empty */
 #define PIPE_FLAG_UNLINKED  (1 << 1) /* Bit 1: The driver has been unlinked */
+#define PIPE_FLAG_RDSPLICE  (1 << 2) /* Bit 2: A splice is draining the buffer */
+#define PIPE_FLAG_WRSPLICE  (1 << 3) /* Bit 3: A splice is filling the buffer */
 
 #define PIPE_POLICY_0(f)    do { (f) &= ~PIPE_FLAG_POLICY; } while (0)
 #define PIPE_POLICY_1(f)    do { (f) |= PIPE_FLAG_POLICY; } while (0)
@@ -109,16 +134,18 @@ typedef uint8_t pipe_ndx_t;   /*  8-bit index */
 struct pipe_dev_s
 {
   char       name[PATH_MAX + 1];
-  sem_t      d_bfsem;       /* Used to serialize access to d_buffer and indices */
+  sem_t      d_bfsem;       /* Used to serialize access to d_buffer, d_bufsize and indices */
   sem_t      d_rdsem;       /* Empty buffer - Reader waits for data write */
   sem_t      d_wrsem;       /* Full buffer - Writer waits for data read */
+  sem_t      d_splsem;      /* Readers/writers wait for a splice to finish */
   pipe_ndx_t d_wrndx;       /* Index in d_buffer to save next byte written */
   pipe_ndx_t d_rdndx;       /* Index in d_buffer to return the next byte read */
   pipe_ndx_t d_bufsize;     /* allocated size of d_buffer in bytes */
   uint8_t    d_nwriters;    /* Number of reference counts for write access */
   uint8_t    d_nreaders;    /* Number of reference counts for read access */
-  uint8_t    d_pipeno;      /* Pipe minor number */
+  uint32_t   d_pipeno;      /* Pipe minor number */
   uint8_t    d_flags;       /* See PIPE_FLAG_* definitions */
+  uint8_t    d_nsplwaiters; /* Number of tasks waiting on d_splsem */
   uint8_t   *d_buffer;      /* Buffer allocated when device opened */
   wait_queue_head_t wq;     /* It is a list if poll structures of threads waiting for driver events */
 };
@@ -146,6 +173,10 @@ ssize_t pipecommon_read(struct file *, char *, size_t);
 ssize_t pipecommon_write(struct file *, const char *, size_t);
 int     pipecommon_ioctl(struct file *filep, int cmd, unsigned long arg);
 int     pipecommon_poll(struct file *filep, poll_table *fds);
+ssize_t pipecommon_spliceread(struct file *filep, struct file *outfilep,
+                              size_t len, bool nonblock);
+ssize_t pipecommon_splicewrite(struct file *filep, struct file *infilep,
+                               size_t len, bool nonblock);
 #ifndef CONFIG_DISABLE_PSEUDOFS_OPERATIONS
 int     pipecommon_unlink(struct Vnode *vnode);
 #endif
@@ -0,0 +1,56 @@
+/****************************************************************************
+ * fs/nfs/host/include/nfs_host.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/* Host build: the definitions that the kernel build environment provides
+ * to every NFS source.  Included ahead of each source by the Makefile.
+ */
+
+#ifndef __FS_NFS_HOST_INCLUDE_NFS_HOST_H
+#define __FS_NFS_HOST_INCLUDE_NFS_HOST_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define OK              0
+#define VOID            void
+#define UINT32          uint32_t
+#define UINT64          uint64_t
+#define get_errno()     errno
+#define PRINT_ERR       printf
+
+#ifndef CONFIG_NFS_MACHINE_NAME
+#  define CONFIG_NFS_MACHINE_NAME      "nfshost"
+#  define CONFIG_NFS_MACHINE_NAME_SIZE 8
+#endif
+
+#endif /* __FS_NFS_HOST_INCLUDE_NFS_HOST_H */
@@ -0,0 +1,48 @@
+/****************************************************************************
+ * fs/nfs/host/include/securec.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/* Host build: the bounded memory and string functions of libsec. */
+
+#ifndef __FS_NFS_HOST_INCLUDE_SECUREC_H
+#define __FS_NFS_HOST_INCLUDE_SECUREC_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stddef.h>
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define EOK 0
+
+/****************************************************************************
+ * Public Function Prototypes
+ ****************************************************************************/
+
+int memset_s(void *dest, size_t destMax, int c, size_t count);
+int memcpy_s(void *dest, size_t destMax, const void *src, size_t count);
+int strncpy_s(char *dest, size_t destMax, const char *src, size_t count);
+
+#endif /* __FS_NFS_HOST_INCLUDE_SECUREC_H */
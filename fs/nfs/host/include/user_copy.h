@@ -0,0 +1,41 @@
+/****************************************************************************
+ * fs/nfs/host/include/user_copy.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/* Host build: user copies.  The tests run in one address space. */
+
+#ifndef __FS_NFS_HOST_INCLUDE_USER_COPY_H
+#define __FS_NFS_HOST_INCLUDE_USER_COPY_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stddef.h>
+
+/****************************************************************************
+ * Public Function Prototypes
+ ****************************************************************************/
+
+int LOS_CopyFromKernel(void *dest, size_t max, const void *src, size_t count);
+int LOS_CopyToKernel(void *dest, size_t max, const void *src, size_t count);
+
+#endif /* __FS_NFS_HOST_INCLUDE_USER_COPY_H */
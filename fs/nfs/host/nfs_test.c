@@ -0,0 +1,775 @@
+/****************************************************************************
+ * fs/nfs/host/nfs_test.c
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/* Host test of the attribute cache of the NFS client.  nfs_util.c and the
+ * read-ahead and write-behind engines are built unchanged and talk to a
+ * loopback server that keeps a single file in memory.  The server can hold
+ * back its GETATTR replies, so that a file can be written while a GETATTR
+ * is waiting for its reply without nm_mux.  A second test changes the file
+ * on the server while read-ahead holds its old data, and checks that the
+ * attributes of a directory listing do not hide the change from the next
+ * read.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "rpc.h"
+#include "nfs.h"
+#include "nfs_node.h"
+#include "xdr_subs.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define TEST_FHSIZE      8      /* Size of the file handle of the file */
+#define TEST_MAXDATA     8192   /* Size the file may grow to */
+#define TEST_BUFLEN      4096   /* I/O buffer size of the mount */
+#define TEST_WSIZE       1024   /* Max data per WRITE */
+#define TEST_NWBUFS      4      /* Write-behind buffers */
+#define TEST_WRITELEN    3000   /* Bytes appended during the GETATTR */
+#define TEST_NRASLOTS    4      /* Read-ahead window */
+#define TEST_MAXREPLY    512    /* Words in a reply */
+#define NFS3ERR_NOTSUPP  10004
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct sockaddr  g_saddr;
+static struct nfsmount *g_nmp;
+static struct nfsnode   g_node;
+
+/* State of the server, all under g_lock */
+
+static pthread_mutex_t  g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   g_cond = PTHREAD_COND_INITIALIZER;
+static uint8_t          g_data[TEST_MAXDATA];
+static uint64_t         g_size;
+static uint32_t         g_mtime = 1;
+static bool             g_hold;
+static int              g_heldfd = -1;
+static uint32_t         g_held[TEST_MAXREPLY];
+static size_t           g_heldlen;
+static int              g_ngetattr;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: test_readn
+ ****************************************************************************/
+
+static int test_readn(int fd, void *buffer, size_t len)
+{
+  size_t  done = 0;
+  ssize_t nread;
+
+  while (done < len)
+    {
+      nread = read(fd, (char *)buffer + done, len - done);
+      if (nread <= 0)
+        {
+          return -1;
+        }
+
+      done += nread;
+    }
+
+  return 0;
+}
+
+/****************************************************************************
+ * Name: test_fattr
+ *
+ * Description:
+ *   Put the attributes of the file at 'ptr'.  Called with g_lock held.
+ *
+ * Returned Value:
+ *   The number of words used.
+ *
+ ****************************************************************************/
+
+static size_t test_fattr(uint32_t *ptr)
+{
+  struct nfs_fattr *attr = (struct nfs_fattr *)ptr;
+
+  (void)memset(attr, 0, sizeof(struct nfs_fattr));
+  attr->fa_type  = txdr_unsigned(NFREG);
+  attr->fa_mode  = txdr_unsigned(0644);
+  attr->fa_nlink = txdr_unsigned(1);
+  txdr_hyper(g_size, &attr->fa_size);
+  attr->fa_mtime.nfsv3_sec = txdr_unsigned(g_mtime);
+  attr->fa_ctime.nfsv3_sec = txdr_unsigned(g_mtime);
+  return sizeof(struct nfs_fattr) / sizeof(uint32_t);
+}
+
+/****************************************************************************
+ * Name: test_write
+ *
+ * Description:
+ *   Apply the WRITE call with arguments at 'args' and put the WRITE3resok
+ *   reply at 'ptr'.  Called with g_lock held.
+ *
+ * Returned Value:
+ *   The number of words used.
+ *
+ ****************************************************************************/
+
+static size_t test_write(uint32_t *args, uint32_t *ptr)
+{
+  uint32_t *start = ptr;
+  uint64_t  offset;
+  uint32_t  count;
+
+  args  += 1 + uint32_increment(fxdr_unsigned(uint32_t, *args));
+  offset = fxdr_hyper(args);
+  count  = fxdr_unsigned(uint32_t, args[2]);
+  args  += 5;
+
+  if (offset + count > TEST_MAXDATA)
+    {
+      count = (offset < TEST_MAXDATA) ? (uint32_t)(TEST_MAXDATA - offset) : 0;
+    }
+
+  (void)memcpy(&g_data[offset], args, count);
+  if (offset + count > g_size)
+    {
+      g_size = offset + count;
+    }
+
+  g_mtime++;
+
+  *ptr++ = 0;                                 /* No WCC attributes */
+  *ptr++ = txdr_unsigned(1);                  /* Attributes follow */
+  ptr   += test_fattr(ptr);
+  *ptr++ = txdr_unsigned(count);
+  *ptr++ = txdr_unsigned(NFSV3WRITE_FILESYNC);
+  *ptr++ = 0;                                 /* Write verifier */
+  *ptr++ = 0;
+  return ptr - start;
+}
+
+/****************************************************************************
+ * Name: test_read
+ *
+ * Description:
+ *   Put the READ3resok reply to the READ call with arguments at 'args' at
+ *   'ptr'.  Called with g_lock held.
+ *
+ * Returned Value:
+ *   The number of words used.
+ *
+ ****************************************************************************/
+
+static size_t test_read(uint32_t *args, uint32_t *ptr)
+{
+  uint32_t *start = ptr;
+  uint64_t  offset;
+  uint32_t  count;
+
+  args  += 1 + uint32_increment(fxdr_unsigned(uint32_t, *args));
+  offset = fxdr_hyper(args);
+  count  = fxdr_unsigned(uint32_t, args[2]);
+
+  if (offset >= g_size)
+    {
+      count = 0;
+    }
+  else if (offset + count > g_size)
+    {
+      count = (uint32_t)(g_size - offset);
+    }
+
+  *ptr++ = txdr_unsigned(1);                  /* Attributes follow */
+  ptr   += test_fattr(ptr);
+  *ptr++ = txdr_unsigned(count);
+  *ptr++ = (offset + count >= g_size) ? txdr_unsigned(1) : 0;
+  *ptr++ = txdr_unsigned(count);
+  (void)memcpy(ptr, &g_data[offset], count);
+  ptr   += uint32_increment(count);
+  return ptr - start;
+}
+
+/****************************************************************************
+ * Name: test_serve
+ *
+ * Description:
+ *   Answer the calls of one connection in order.  A GETATTR reply carries
+ *   the attributes of when the call arrived; while g_hold is set, it is
+ *   kept back until test_release().
+ *
+ ****************************************************************************/
+
+static void *test_serve(void *arg)
+{
+  int       fd = (int)(intptr_t)arg;
+  uint32_t  mark;
+  uint32_t  body[TEST_MAXDATA / sizeof(uint32_t) + 64];
+  uint32_t  reply[TEST_MAXREPLY];
+  uint32_t *args;
+  uint32_t *ptr;
+  uint32_t  proc;
+  size_t    len;
+  bool      held;
+
+  args = &body[(sizeof(struct rpc_call_header) - sizeof(uint32_t)) / sizeof(uint32_t)];
+
+  for (; ; )
+    {
+      if (test_readn(fd, &mark, sizeof(mark)) != 0)
+        {
+          break;
+        }
+
+      len = ntohl(mark) & 0x7fffffff;
+      if (len > sizeof(body) || test_readn(fd, body, len) != 0)
+        {
+          break;
+        }
+
+      /* The reply header with the xid, then the NFS status */
+
+      (void)memset(reply, 0, sizeof(reply));
+      reply[1] = body[0];
+      reply[2] = htonl(1);
+      ptr      = &reply[sizeof(struct rpc_reply_header) / sizeof(uint32_t)];
+      proc     = ntohl(body[5]);
+      held     = false;
+
+      (void)pthread_mutex_lock(&g_lock);
+      switch (proc)
+        {
+          case NFSPROC_GETATTR:
+            *ptr++ = 0;
+            ptr   += test_fattr(ptr);
+            held   = g_hold;
+            g_ngetattr++;
+            break;
+
+          case NFSPROC_WRITE:
+            *ptr++ = 0;
+            ptr   += test_write(args, ptr);
+            break;
+
+          case NFSPROC_READ:
+            *ptr++ = 0;
+            ptr   += test_read(args, ptr);
+            break;
+
+          default:
+            *ptr++ = txdr_unsigned(NFS3ERR_NOTSUPP);
+            break;
+        }
+
+      len      = (ptr - reply) * sizeof(uint32_t);
+      reply[0] = htonl(0x80000000 | (uint32_t)(len - sizeof(uint32_t)));
+
+      if (held)
+        {
+          (void)memcpy(g_held, reply, len);
+          g_heldlen = len;
+          g_heldfd  = fd;
+          (void)pthread_cond_broadcast(&g_cond);
+        }
+      else if (write(fd, reply, len) != (ssize_t)len)
+        {
+          (void)pthread_mutex_unlock(&g_lock);
+          break;
+        }
+
+      (void)pthread_mutex_unlock(&g_lock);
+    }
+
+  (void)pthread_mutex_lock(&g_lock);
+  if (g_heldfd == fd)
+    {
+      g_heldfd = -1;
+    }
+
+  (void)pthread_mutex_unlock(&g_lock);
+  (void)close(fd);
+  return NULL;
+}
+
+/****************************************************************************
+ * Name: test_server
+ ****************************************************************************/
+
+static void *test_server(void *arg)
+{
+  pthread_t thread;
+  int listener = *(int *)arg;
+  int fd;
+
+  for (; ; )
+    {
+      fd = accept(listener, NULL, NULL);
+      if (fd < 0)
+        {
+          continue;
+        }
+
+      (void)pthread_create(&thread, NULL, test_serve, (void *)(intptr_t)fd);
+      (void)pthread_detach(thread);
+    }
+
+  return NULL;
+}
+
+/****************************************************************************
+ * Name: test_hold
+ *
+ * Description:
+ *   Hold back the GETATTR replies from now on.
+ *
+ * Returned Value:
+ *   The number of GETATTR calls received so far.
+ *
+ ****************************************************************************/
+
+static int test_hold(void)
+{
+  int n;
+
+  (void)pthread_mutex_lock(&g_lock);
+  g_hold = true;
+  n      = g_ngetattr;
+  (void)pthread_mutex_unlock(&g_lock);
+  return n;
+}
+
+/****************************************************************************
+ * Name: test_waitheld
+ *
+ * Description:
+ *   Wait until a GETATTR after the first 'n' has arrived and been held.
+ *
+ ****************************************************************************/
+
+static void test_waitheld(int n)
+{
+  (void)pthread_mutex_lock(&g_lock);
+  while (g_ngetattr <= n || g_heldfd < 0)
+    {
+      (void)pthread_cond_wait(&g_cond, &g_lock);
+    }
+
+  (void)pthread_mutex_unlock(&g_lock);
+}
+
+/****************************************************************************
+ * Name: test_release
+ *
+ * Description:
+ *   Send the GETATTR reply held back and stop holding.
+ *
+ ****************************************************************************/
+
+static void test_release(void)
+{
+  (void)pthread_mutex_lock(&g_lock);
+  if (g_heldfd >= 0)
+    {
+      (void)write(g_heldfd, g_held, g_heldlen);
+      g_heldfd = -1;
+    }
+
+  g_hold = false;
+  (void)pthread_mutex_unlock(&g_lock);
+}
+
+/****************************************************************************
+ * Name: test_mount
+ *
+ * Description:
+ *   Set up a mount and the node of the file, as nfs_bind() and the lookup
+ *   would, and fetch the attributes of the file.
+ *
+ ****************************************************************************/
+
+static int test_mount(void)
+{
+  pthread_mutexattr_t attr;
+  struct rpcclnt     *rpc;
+  struct nfs_fattr    fattr;
+  int                 error;
+
+  g_nmp = calloc(1, SIZEOF_nfsmount(TEST_BUFLEN));
+  rpc   = calloc(1, sizeof(struct rpcclnt));
+  if (g_nmp == NULL || rpc == NULL || rpcclnt_lockinit(rpc) != OK)
+    {
+      return ENOMEM;
+    }
+
+  rpc->rc_name   = &g_saddr;
+  rpc->rc_sotype = SOCK_STREAM;
+  rpc->rc_retry  = 8;
+  rpc->rc_so     = -1;
+
+  (void)pthread_mutexattr_init(&attr);
+  (void)pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  (void)pthread_mutex_init(&g_nmp->nm_mux, &attr);
+
+  g_nmp->nm_rpcclnt     = rpc;
+  g_nmp->nm_buflen      = TEST_BUFLEN;
+  g_nmp->nm_retry       = 8;
+  g_nmp->nm_wsize       = TEST_WSIZE;
+  g_nmp->nm_rsize       = TEST_WSIZE;
+  g_nmp->nm_readahead   = TEST_NRASLOTS;
+  g_nmp->nm_writebehind = TEST_NWBUFS;
+  g_nmp->nm_acregmin    = 1000;
+  g_nmp->nm_acregmax    = 1000;
+  g_nmp->nm_mounted     = true;
+
+  g_node.n_fhsize = TEST_FHSIZE;
+  g_node.n_type   = NFREG;
+  g_nmp->nm_head  = &g_node;
+
+  nfs_mux_take(g_nmp);
+  error = nfs_getattr(g_nmp, &g_node, &fattr);
+  if (error == OK)
+    {
+      nfs_attrupdate(&g_node, &fattr);
+    }
+
+  nfs_mux_release(g_nmp);
+  return error;
+}
+
+/****************************************************************************
+ * Name: test_unmount
+ ****************************************************************************/
+
+static void test_unmount(void)
+{
+  nfs_mux_take(g_nmp);
+  nfs_readahead_free(g_nmp, &g_node);
+  nfs_writebehind_free(g_nmp, &g_node);
+  nfs_mux_release(g_nmp);
+
+  rpcclnt_disconnect(g_nmp->nm_rpcclnt);
+  rpcclnt_lockdestroy(g_nmp->nm_rpcclnt);
+  free(g_nmp->nm_rpcclnt);
+  (void)pthread_mutex_destroy(&g_nmp->nm_mux);
+  free(g_nmp);
+}
+
+/****************************************************************************
+ * Name: test_getattr
+ *
+ * Description:
+ *   Refresh the attributes of the file, as nfs_revalidate() does.
+ *
+ ****************************************************************************/
+
+static void *test_getattr(void *arg)
+{
+  struct nfs_fattr fattr;
+  int error;
+
+  (void)arg;
+
+  nfs_mux_take(g_nmp);
+  error = nfs_getattr(g_nmp, &g_node, &fattr);
+  if (error == OK)
+    {
+      nfs_attrupdate(&g_node, &fattr);
+    }
+
+  nfs_mux_release(g_nmp);
+  return (void *)(intptr_t)error;
+}
+
+/****************************************************************************
+ * Name: test_append
+ *
+ * Description:
+ *   Append to the file through write-behind, as vfs_nfs_write() does.
+ *
+ ****************************************************************************/
+
+static int test_append(const char *buffer, size_t buflen)
+{
+  size_t nwritten = 0;
+  loff_t pos;
+  int    error;
+
+  nfs_mux_take(g_nmp);
+  pos   = (loff_t)g_node.n_size;
+  error = nfs_writebehind_setup(g_nmp, &g_node);
+  if (error == OK)
+    {
+      error = nfs_writebehind_write(g_nmp, &g_node, buffer, buflen, pos,
+                                    false, &nwritten);
+    }
+
+  if (error == OK)
+    {
+      nfs_sizeupdate(&g_node, (uint64_t)pos + nwritten);
+    }
+
+  nfs_mux_release(g_nmp);
+  return error;
+}
+
+/****************************************************************************
+ * Name: test_getattr_race
+ *
+ * Description:
+ *   Append to the file while a GETATTR is waiting for its reply.  The
+ *   reply predates the append and must not take back the size.
+ *
+ ****************************************************************************/
+
+static int test_getattr_race(void)
+{
+  static char buffer[TEST_WRITELEN];
+  pthread_t thread;
+  void *result;
+  int error;
+  int n;
+
+  (void)memset(buffer, 'a', sizeof(buffer));
+
+  n = test_hold();
+  (void)pthread_create(&thread, NULL, test_getattr, NULL);
+  test_waitheld(n);
+
+  error = test_append(buffer, sizeof(buffer));
+  test_release();
+  (void)pthread_join(thread, &result);
+
+  printf("getattr race: append %d, getattr %d, size %llu\n", error,
+         (int)(intptr_t)result, (unsigned long long)g_node.n_size);
+
+  if (error != OK || (intptr_t)result != EAGAIN ||
+      g_node.n_size != TEST_WRITELEN)
+    {
+      return -1;
+    }
+
+  /* A GETATTR after the append has to see it */
+
+  result = test_getattr(NULL);
+  printf("getattr after append: %d, size %llu\n",
+         (int)(intptr_t)result, (unsigned long long)g_node.n_size);
+
+  return ((intptr_t)result != OK || g_node.n_size != TEST_WRITELEN) ? -1 : 0;
+}
+
+/****************************************************************************
+ * Name: test_revalidate
+ *
+ * Description:
+ *   Check the cached attributes of the file before a read, as
+ *   nfs_revalidate() does.  Called with nm_mux held.
+ *
+ ****************************************************************************/
+
+static int test_revalidate(void)
+{
+  struct nfs_fattr fattr;
+  int error;
+
+  if (nfs_attrcache_valid(g_nmp, &g_node))
+    {
+      return OK;
+    }
+
+  error = nfs_getattr(g_nmp, &g_node, &fattr);
+  if (error != OK)
+    {
+      return (error == EAGAIN) ? OK : error;
+    }
+
+  if (nfs_attrchanged(&g_node, &fattr))
+    {
+      nfs_readahead_reset(g_nmp, &g_node);
+    }
+
+  nfs_attrupdate(&g_node, &fattr);
+  return OK;
+}
+
+/****************************************************************************
+ * Name: test_readfile
+ *
+ * Description:
+ *   Read from the file through read-ahead, as vfs_nfs_read() does.
+ *
+ ****************************************************************************/
+
+static int test_readfile(char *buffer, size_t buflen, loff_t pos)
+{
+  size_t nread = 0;
+  int    error;
+
+  nfs_mux_take(g_nmp);
+  error = test_revalidate();
+  if (error == OK)
+    {
+      error = nfs_readahead_setup(g_nmp, &g_node);
+    }
+
+  if (error == OK)
+    {
+      error = nfs_readahead_read(g_nmp, &g_node, buffer, buflen, pos, &nread);
+    }
+
+  nfs_mux_release(g_nmp);
+  return (error == OK && nread != buflen) ? EIO : error;
+}
+
+/****************************************************************************
+ * Name: test_listing
+ *
+ * Description:
+ *   Read the start of the file, so that read-ahead keeps the blocks that
+ *   follow.  Then change the file on the server and list it: the listing
+ *   sees the new attributes, and the next read must return the new data.
+ *
+ ****************************************************************************/
+
+static int test_listing(void)
+{
+  struct nfs_fattr fattr;
+  char buffer[TEST_WSIZE];
+  bool valid;
+  int  error;
+  int  i;
+
+  /* Start reading; read-ahead collects the rest of the file */
+
+  error = test_readfile(buffer, sizeof(buffer), 0);
+  if (error != OK)
+    {
+      printf("listing: read %d\n", error);
+      return -1;
+    }
+
+  nfs_mux_take(g_nmp);
+  nfs_readahead_drain(g_nmp);
+  nfs_mux_release(g_nmp);
+
+  /* Another client rewrites the file; the size stays the same */
+
+  (void)pthread_mutex_lock(&g_lock);
+  (void)memset(g_data, 'b', g_size);
+  g_mtime++;
+  (void)test_fattr((uint32_t *)&fattr);
+  (void)pthread_mutex_unlock(&g_lock);
+
+  /* READDIRPLUS brings the new attributes */
+
+  nfs_mux_take(g_nmp);
+  nfs_attrrefresh(&g_node, &fattr);
+  valid = nfs_attrcache_valid(g_nmp, &g_node);
+  nfs_mux_release(g_nmp);
+
+  /* Read on where the first read stopped */
+
+  error = test_readfile(buffer, sizeof(buffer), sizeof(buffer));
+  for (i = 0; error == OK && i < (int)sizeof(buffer) && buffer[i] == 'b'; i++);
+
+  printf("listing: attributes %s, read %d, new data %d of %d bytes\n",
+         valid ? "valid" : "out of date", error, i, (int)sizeof(buffer));
+
+  return (error != OK || i != (int)sizeof(buffer)) ? -1 : 0;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: main
+ ****************************************************************************/
+
+int main(int argc, char **argv)
+{
+  struct sockaddr_in addr;
+  socklen_t addrlen = sizeof(addr);
+  pthread_t server;
+  int listener;
+  int one = 1;
+  int ret;
+
+  (void)argc;
+  (void)argv;
+
+  listener = socket(AF_INET, SOCK_STREAM, 0);
+  if (listener < 0)
+    {
+      perror("socket");
+      return EXIT_FAILURE;
+    }
+
+  (void)memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  (void)setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(listener, 16) < 0 ||
+      getsockname(listener, (struct sockaddr *)&addr, &addrlen) < 0)
+    {
+      perror("listen");
+      return EXIT_FAILURE;
+    }
+
+  (void)memcpy(&g_saddr, &addr, sizeof(addr));
+  (void)pthread_create(&server, NULL, test_server, &listener);
+
+  rpcclnt_init();
+
+  ret = test_mount();
+  if (ret != OK)
+    {
+      printf("mount: %d\n", ret);
+      ret = -1;
+    }
+  else
+    {
+      ret = test_getattr_race();
+      if (ret == 0)
+        {
+          ret = test_listing();
+        }
+
+      test_unmount();
+    }
+
+  printf("%s\n", (ret == 0) ? "PASS" : "FAIL");
+  return (ret == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,146 @@
+/****************************************************************************
+ * fs/nfs/host/rpc_os.c
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/* Host implementations of the kernel services used by the NFS client */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "securec.h"
+#include "los_sys.h"
+#include "user_copy.h"
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: memset_s
+ ****************************************************************************/
+
+int memset_s(void *dest, size_t destMax, int c, size_t count)
+{
+  if (dest == NULL || count > destMax)
+    {
+      return -1;
+    }
+
+  (void)memset(dest, c, count);
+  return EOK;
+}
+
+/****************************************************************************
+ * Name: memcpy_s
+ ****************************************************************************/
+
+int memcpy_s(void *dest, size_t destMax, const void *src, size_t count)
+{
+  if (dest == NULL || src == NULL || count > destMax)
+    {
+      return -1;
+    }
+
+  (void)memmove(dest, src, count);
+  return EOK;
+}
+
+/****************************************************************************
+ * Name: strncpy_s
+ ****************************************************************************/
+
+int strncpy_s(char *dest, size_t destMax, const char *src, size_t count)
+{
+  size_t len;
+
+  if (dest == NULL || src == NULL || destMax == 0)
+    {
+      return -1;
+    }
+
+  len = strnlen(src, count);
+  if (len >= destMax)
+    {
+      dest[0] = '\0';
+      return -1;
+    }
+
+  (void)memcpy(dest, src, len);
+  dest[len] = '\0';
+  return EOK;
+}
+
+/****************************************************************************
+ * Name: LOS_GetCpuCycle
+ ****************************************************************************/
+
+void LOS_GetCpuCycle(uint32_t *puwCntHi, uint32_t *puwCntLo)
+{
+  struct timespec ts;
+  uint64_t cycles;
+
+  (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+  cycles    = (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+  *puwCntHi = (uint32_t)(cycles >> 32);
+  *puwCntLo = (uint32_t)cycles;
+}
+
+/****************************************************************************
+ * Name: LOS_TickCountGet
+ *
+ * Description:
+ *   One tick is one millisecond
+ *
+ ****************************************************************************/
+
+uint64_t LOS_TickCountGet(void)
+{
+  struct timespec ts;
+
+  (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/****************************************************************************
+ * Name: LOS_CopyFromKernel
+ *
+ * Description:
+ *   The tests run in a single address space
+ *
+ ****************************************************************************/
+
+int LOS_CopyFromKernel(void *dest, size_t max, const void *src, size_t count)
+{
+  return memcpy_s(dest, max, src, count);
+}
+
+/****************************************************************************
+ * Name: LOS_CopyToKernel
+ ****************************************************************************/
+
+int LOS_CopyToKernel(void *dest, size_t max, const void *src, size_t count)
+{
+  return memcpy_s(dest, max, src, count);
+}
@@ -0,0 +1,630 @@
+/****************************************************************************
+ * fs/nfs/host/rpc_test.c
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/* Host test of the multiplexed RPC client.  rpc_clnt.c is built unchanged
+ * and talks to a loopback server that answers the calls of each
+ * connection in random order and drops some of the replies.  Several
+ * threads issue rpcclnt_request() calls while another one pipelines calls
+ * with rpcclnt_sendcall() and rpcclnt_getreply(), as read-ahead does.  The
+ * server echoes a token of each call so that every reply can be checked
+ * against the call it belongs to.  A second test tears the client down
+ * while calls are waiting for replies that never come.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "rpc.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define TEST_PROG        100003
+#define TEST_VERS        3
+#define TEST_NSYNC       6     /* Threads calling rpcclnt_request() */
+#define TEST_NPIPE       8     /* Calls the pipelining thread keeps out */
+#define TEST_MAXQUEUED   256   /* Calls a connection of the server holds */
+#define TEST_NTEARDOWN   4     /* Threads waiting during the teardown */
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct test_call
+{
+  uint32_t xid;
+  uint32_t token;
+};
+
+struct test_conn
+{
+  int              fd;
+  pthread_mutex_t  lock;
+  struct test_call queue[TEST_MAXQUEUED];
+  int              nqueued;
+  bool             closed;
+};
+
+struct test_request
+{
+  struct rpc_call_header ch;
+  uint32_t token;
+};
+
+struct test_response
+{
+  struct rpc_reply_header rh;
+  uint32_t token;
+  uint32_t fill[128];
+};
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct rpcclnt   g_rpc;
+static struct sockaddr  g_saddr;
+static atomic_int       g_droppct = 2;
+static int              g_ncalls  = 300;
+static int              g_nerrors;
+static int              g_nbad;
+static pthread_mutex_t  g_countlock = PTHREAD_MUTEX_INITIALIZER;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: test_count
+ ****************************************************************************/
+
+static void test_count(int *counter)
+{
+  (void)pthread_mutex_lock(&g_countlock);
+  (*counter)++;
+  (void)pthread_mutex_unlock(&g_countlock);
+}
+
+/****************************************************************************
+ * Name: test_readn
+ ****************************************************************************/
+
+static int test_readn(int fd, void *buffer, size_t len)
+{
+  size_t  done = 0;
+  ssize_t nread;
+
+  while (done < len)
+    {
+      nread = read(fd, (char *)buffer + done, len - done);
+      if (nread <= 0)
+        {
+          return -1;
+        }
+
+      done += nread;
+    }
+
+  return 0;
+}
+
+/****************************************************************************
+ * Name: test_replier
+ *
+ * Description:
+ *   Answer the queued calls of a connection in random order, dropping
+ *   g_droppct percent of them.  Replies carry a random amount of padding.
+ *
+ ****************************************************************************/
+
+static void *test_replier(void *arg)
+{
+  struct test_conn *conn = arg;
+  struct test_call  call;
+  unsigned int      seed = (unsigned int)(uintptr_t)conn;
+  uint32_t          buf[80];
+  size_t            len;
+  bool              closed;
+  int               i;
+
+  for (; ; )
+    {
+      usleep(rand_r(&seed) % 2000);
+
+      (void)pthread_mutex_lock(&conn->lock);
+      if (conn->nqueued == 0)
+        {
+          closed = conn->closed;
+          (void)pthread_mutex_unlock(&conn->lock);
+          if (closed)
+            {
+              break;
+            }
+
+          continue;
+        }
+
+      i                  = rand_r(&seed) % conn->nqueued;
+      call               = conn->queue[i];
+      conn->queue[i]     = conn->queue[--conn->nqueued];
+      (void)pthread_mutex_unlock(&conn->lock);
+
+      if ((int)(rand_r(&seed) % 100) < atomic_load(&g_droppct))
+        {
+          continue;
+        }
+
+      /* Record mark, then the reply header with the xid, then the token */
+
+      len = sizeof(struct rpc_reply_header) + sizeof(uint32_t) +
+            (rand_r(&seed) % 50) * sizeof(uint32_t);
+      (void)memset(buf, 0, sizeof(buf));
+      buf[0] = htonl(0x80000000 | (uint32_t)(len - sizeof(uint32_t)));
+      buf[1] = htonl(call.xid);
+      buf[2] = htonl(1);
+      buf[sizeof(struct rpc_reply_header) / sizeof(uint32_t)] = call.token;
+
+      if (write(conn->fd, buf, len) != (ssize_t)len)
+        {
+          break;
+        }
+    }
+
+  (void)close(conn->fd);
+  return NULL;
+}
+
+/****************************************************************************
+ * Name: test_reader
+ *
+ * Description:
+ *   Queue the calls that arrive on a connection for test_replier().
+ *
+ ****************************************************************************/
+
+static void *test_reader(void *arg)
+{
+  struct test_conn *conn = arg;
+  pthread_t replier;
+  uint32_t  mark;
+  uint32_t  body[256];
+  size_t    len;
+
+  (void)pthread_create(&replier, NULL, test_replier, conn);
+
+  for (; ; )
+    {
+      if (test_readn(conn->fd, &mark, sizeof(mark)) != 0)
+        {
+          break;
+        }
+
+      len = ntohl(mark) & 0x7fffffff;
+      if (len > sizeof(body) || test_readn(conn->fd, body, len) != 0)
+        {
+          break;
+        }
+
+      (void)pthread_mutex_lock(&conn->lock);
+      if (conn->nqueued < TEST_MAXQUEUED)
+        {
+          conn->queue[conn->nqueued].xid   = ntohl(body[0]);
+          conn->queue[conn->nqueued].token =
+            body[(sizeof(struct rpc_call_header) - sizeof(uint32_t)) / sizeof(uint32_t)];
+          conn->nqueued++;
+        }
+
+      (void)pthread_mutex_unlock(&conn->lock);
+    }
+
+  (void)pthread_mutex_lock(&conn->lock);
+  conn->closed  = true;
+  conn->nqueued = 0;
+  (void)pthread_mutex_unlock(&conn->lock);
+
+  (void)shutdown(conn->fd, SHUT_RDWR);
+  (void)pthread_join(replier, NULL);
+  (void)pthread_mutex_destroy(&conn->lock);
+  free(conn);
+  return NULL;
+}
+
+/****************************************************************************
+ * Name: test_server
+ ****************************************************************************/
+
+static void *test_server(void *arg)
+{
+  struct test_conn *conn;
+  pthread_t reader;
+  int listener = *(int *)arg;
+  int fd;
+
+  for (; ; )
+    {
+      fd = accept(listener, NULL, NULL);
+      if (fd < 0)
+        {
+          continue;
+        }
+
+      conn = calloc(1, sizeof(struct test_conn));
+      if (conn == NULL)
+        {
+          (void)close(fd);
+          continue;
+        }
+
+      conn->fd = fd;
+      (void)pthread_mutex_init(&conn->lock, NULL);
+      (void)pthread_create(&reader, NULL, test_reader, conn);
+      (void)pthread_detach(reader);
+    }
+
+  return NULL;
+}
+
+/****************************************************************************
+ * Name: test_sync
+ *
+ * Description:
+ *   Issue g_ncalls calls of rpcclnt_request() and check their replies.
+ *
+ ****************************************************************************/
+
+static void *test_sync(void *arg)
+{
+  struct test_request  request;
+  struct test_response response;
+  int id = (int)(intptr_t)arg;
+  int error;
+  int i;
+
+  for (i = 0; i < g_ncalls; i++)
+    {
+      request.token = ((uint32_t)id << 16) | (uint32_t)i;
+      (void)memset(&response, 0xee, sizeof(response));
+
+      error = rpcclnt_request(&g_rpc, 1, TEST_PROG, TEST_VERS,
+                              &request, sizeof(uint32_t),
+                              &response, sizeof(response));
+      if (error != OK)
+        {
+          printf("sync %d: call %d failed: %d\n", id, i, error);
+          test_count(&g_nerrors);
+        }
+      else if (response.token != request.token)
+        {
+          printf("sync %d: reply %08x to call %08x\n", id,
+                 response.token, request.token);
+          test_count(&g_nbad);
+        }
+    }
+
+  return NULL;
+}
+
+/****************************************************************************
+ * Name: test_pipeline
+ *
+ * Description:
+ *   Keep TEST_NPIPE calls outstanding with rpcclnt_sendcall() and collect
+ *   their replies with rpcclnt_getreply(), sending the calls without a
+ *   reply again when nothing arrives in time.
+ *
+ ****************************************************************************/
+
+static void *test_pipeline(void *arg)
+{
+  struct test_request  request[TEST_NPIPE];
+  struct test_response response;
+  uint32_t xid[TEST_NPIPE];
+  bool     done[TEST_NPIPE];
+  uint32_t rxid;
+  int      nrounds = g_ncalls / 2;
+  int      round;
+  int      left;
+  int      retries;
+  int      error;
+  int      i;
+
+  (void)arg;
+
+  for (round = 0; round < nrounds; round++)
+    {
+      for (i = 0; i < TEST_NPIPE; i++)
+        {
+          request[i].token = 0xe0000000 | ((uint32_t)round << 8) | (uint32_t)i;
+          xid[i]           = 0;
+          done[i]          = false;
+
+          error = rpcclnt_sendcall(&g_rpc, 6, TEST_PROG, TEST_VERS,
+                                   &request[i], sizeof(uint32_t), &xid[i]);
+          if (error != OK)
+            {
+              printf("pipeline: sendcall failed: %d\n", error);
+            }
+        }
+
+      for (left = TEST_NPIPE, retries = 0; left > 0; )
+        {
+          error = rpcclnt_getreply(&g_rpc, &response, sizeof(response), &rxid);
+          if (rxid == 0)
+            {
+              if (++retries > 20)
+                {
+                  printf("pipeline: gave up: %d\n", error);
+                  test_count(&g_nerrors);
+                  break;
+                }
+
+              for (i = 0; i < TEST_NPIPE; i++)
+                {
+                  if (!done[i])
+                    {
+                      (void)rpcclnt_sendcall(&g_rpc, 6, TEST_PROG, TEST_VERS,
+                                             &request[i], sizeof(uint32_t),
+                                             &xid[i]);
+                    }
+                }
+
+              continue;
+            }
+
+          for (i = 0; i < TEST_NPIPE && xid[i] != rxid; i++);
+          if (i == TEST_NPIPE || done[i])
+            {
+              /* A duplicate, or the reply to an earlier round */
+
+              continue;
+            }
+
+          if (error != OK)
+            {
+              printf("pipeline: reply failed: %d\n", error);
+              test_count(&g_nerrors);
+            }
+          else if (response.token != request[i].token)
+            {
+              printf("pipeline: reply %08x to call %08x\n",
+                     response.token, request[i].token);
+              test_count(&g_nbad);
+            }
+
+          done[i] = true;
+          left--;
+        }
+    }
+
+  return NULL;
+}
+
+/****************************************************************************
+ * Name: test_waiter
+ *
+ * Description:
+ *   Make one call that gets no reply and return its result.
+ *
+ ****************************************************************************/
+
+static void *test_waiter(void *arg)
+{
+  struct test_request  request;
+  struct test_response response;
+
+  request.token = (uint32_t)(intptr_t)arg;
+  return (void *)(intptr_t)rpcclnt_request(&g_rpc, 1, TEST_PROG, TEST_VERS,
+                                           &request, sizeof(uint32_t),
+                                           &response, sizeof(response));
+}
+
+/****************************************************************************
+ * Name: test_setup
+ ****************************************************************************/
+
+static int test_setup(void)
+{
+  (void)memset(&g_rpc, 0, sizeof(g_rpc));
+  if (rpcclnt_lockinit(&g_rpc) != OK)
+    {
+      return -1;
+    }
+
+  g_rpc.rc_name   = &g_saddr;
+  g_rpc.rc_sotype = SOCK_STREAM;
+  g_rpc.rc_retry  = 8;
+  g_rpc.rc_so     = -1;
+  return 0;
+}
+
+/****************************************************************************
+ * Name: test_mux
+ ****************************************************************************/
+
+static int test_mux(void)
+{
+  pthread_t threads[TEST_NSYNC + 1];
+  int i;
+
+  if (test_setup() != 0)
+    {
+      return -1;
+    }
+
+  for (i = 0; i < TEST_NSYNC; i++)
+    {
+      (void)pthread_create(&threads[i], NULL, test_sync, (void *)(intptr_t)i);
+    }
+
+  (void)pthread_create(&threads[TEST_NSYNC], NULL, test_pipeline, NULL);
+
+  for (i = 0; i <= TEST_NSYNC; i++)
+    {
+      (void)pthread_join(threads[i], NULL);
+    }
+
+  printf("mux: errors %d bad %d reconnects %u stashed %d pending %d\n",
+         g_nerrors, g_nbad, g_rpc.rc_gen, g_rpc.rc_nstash, g_rpc.rc_pending);
+
+  rpcclnt_disconnect(&g_rpc);
+  rpcclnt_lockdestroy(&g_rpc);
+  return (g_nerrors != 0 || g_nbad != 0) ? -1 : 0;
+}
+
+/****************************************************************************
+ * Name: test_teardown
+ *
+ * Description:
+ *   Unmount with calls waiting: rpcclnt_lockdestroy() must make them fail
+ *   with ESHUTDOWN and only return once they have left the client.
+ *
+ ****************************************************************************/
+
+static int test_teardown(void)
+{
+  pthread_t threads[TEST_NTEARDOWN];
+  void *result;
+  int nfailed = 0;
+  int i;
+
+  if (test_setup() != 0)
+    {
+      return -1;
+    }
+
+  atomic_store(&g_droppct, 100);
+
+  for (i = 0; i < TEST_NTEARDOWN; i++)
+    {
+      (void)pthread_create(&threads[i], NULL, test_waiter, (void *)(intptr_t)i);
+    }
+
+  usleep(100 * 1000);
+
+  rpcclnt_disconnect(&g_rpc);
+  rpcclnt_lockdestroy(&g_rpc);
+
+  for (i = 0; i < TEST_NTEARDOWN; i++)
+    {
+      (void)pthread_join(threads[i], &result);
+      if ((intptr_t)result != ESHUTDOWN)
+        {
+          printf("teardown: call %d returned %d\n", i, (int)(intptr_t)result);
+          nfailed++;
+        }
+    }
+
+  printf("teardown: %d of %d calls failed with ESHUTDOWN\n",
+         TEST_NTEARDOWN - nfailed, TEST_NTEARDOWN);
+  return (nfailed != 0) ? -1 : 0;
+}
+
+/****************************************************************************
+ * Name: test_usage
+ ****************************************************************************/
+
+static void test_usage(const char *progname)
+{
+  fprintf(stderr, "Usage: %s [-d droppct] [-n calls]\n", progname);
+  exit(EXIT_FAILURE);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: main
+ ****************************************************************************/
+
+int main(int argc, char **argv)
+{
+  struct sockaddr_in addr;
+  socklen_t addrlen = sizeof(addr);
+  pthread_t server;
+  int listener;
+  int one = 1;
+  int ret;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "d:n:")) != -1)
+    {
+      switch (opt)
+        {
+          case 'd':
+            atomic_store(&g_droppct, atoi(optarg));
+            break;
+
+          case 'n':
+            g_ncalls = atoi(optarg);
+            break;
+
+          default:
+            test_usage(argv[0]);
+        }
+    }
+
+  listener = socket(AF_INET, SOCK_STREAM, 0);
+  if (listener < 0)
+    {
+      perror("socket");
+      return EXIT_FAILURE;
+    }
+
+  (void)memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  (void)setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(listener, 16) < 0 ||
+      getsockname(listener, (struct sockaddr *)&addr, &addrlen) < 0)
+    {
+      perror("listen");
+      return EXIT_FAILURE;
+    }
+
+  (void)memcpy(&g_saddr, &addr, sizeof(addr));
+  (void)pthread_create(&server, NULL, test_server, &listener);
+
+  rpcclnt_init();
+
+  ret = test_mux();
+  if (ret == 0)
+    {
+      ret = test_teardown();
+    }
+
+  printf("%s\n", (ret == 0) ? "PASS" : "FAIL");
+  return (ret == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
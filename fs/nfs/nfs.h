@@ -87,6 +87,14 @@ extern "C" {
 #define NFS_WSIZE          (8192 * 4)     /* Def. write data size <= 8192 */
 #define NFS_RSIZE          (8192 * 4)     /* Def. read data size <= 8192 */
 #define NFS_READDIRSIZE    1024           /* Def. readdir size */
+#define NFS_ACREGMIN       3              /* Def. min. attribute cache timeouts in seconds */
+#define NFS_ACREGMAX       60             /* Def. max. attribute cache timeouts in seconds */
+#define NFS_ACDIRMIN       30
+#define NFS_ACDIRMAX       60
+#define NFS_READAHEAD      4              /* Def. read-ahead window (READs in flight) */
+#define NFS_MAXREADAHEAD   16             /* Max. read-ahead window */
+#define NFS_WRITEBEHIND    8              /* Def. write-behind window (WRITE buffers) */
+#define NFS_MAXWRITEBEHIND 16             /* Max. write-behind window */
 #define NFS_NPROCS         23
 
 /* Ideally, NFS_DIRBLKSIZ should be bigger, but I've seen servers with
@@ -148,8 +156,29 @@ extern int  nfs_findnode(struct nfsmount *nmp, const char *relpath,
 extern int nfs_finddir(struct nfsmount *nmp, const char *relpath,
               struct file_handle *fhandle,
               struct nfs_fattr *attributes, char *filename);
+extern int  nfs_getattr(struct nfsmount *nmp, struct nfsnode *np,
+              struct nfs_fattr *attributes);
 extern void nfs_attrupdate(struct nfsnode *np,
               struct nfs_fattr *attributes);
+extern bool nfs_attrchanged(struct nfsnode *np,
+              struct nfs_fattr *attributes);
+extern void nfs_attrrefresh(struct nfsnode *np,
+              struct nfs_fattr *attributes);
+extern void nfs_sizeupdate(struct nfsnode *np, uint64_t size);
+extern bool nfs_attrcache_valid(struct nfsmount *nmp, struct nfsnode *np);
+extern int  nfs_readahead_setup(struct nfsmount *nmp, struct nfsnode *np);
+extern int  nfs_readahead_read(struct nfsmount *nmp, struct nfsnode *np,
+              char *buffer, size_t buflen, loff_t pos, size_t *nread);
+extern void nfs_readahead_drain(struct nfsmount *nmp);
+extern void nfs_readahead_reset(struct nfsmount *nmp, struct nfsnode *np);
+extern void nfs_readahead_free(struct nfsmount *nmp, struct nfsnode *np);
+extern int  nfs_writebehind_setup(struct nfsmount *nmp, struct nfsnode *np);
+extern int  nfs_writebehind_write(struct nfsmount *nmp, struct nfsnode *np,
+              const char *buffer, size_t buflen, loff_t pos, bool user,
+              size_t *nwritten);
+extern void nfs_writebehind_drain(struct nfsmount *nmp);
+extern int  nfs_writebehind_flush(struct nfsmount *nmp, struct nfsnode *np);
+extern void nfs_writebehind_free(struct nfsmount *nmp, struct nfsnode *np);
 extern int nfs_mount(const char *server_ip_and_path, const char *mount_path,
               unsigned int uid, unsigned int gid);
 
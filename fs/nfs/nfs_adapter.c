@@ -70,6 +70,7 @@
 #include "vnode.h"
 #include "los_vm_filemap.h"
 #include "user_copy.h"
+#include "los_sys.h"
 
 /****************************************************************************
  * Pre-processor Definitions
@@ -118,6 +119,23 @@ struct nfsstats nfsstats;
     }                              \
   while (0)
 
+/* Fail the directory read with EPROTO, going to 'label', unless 'len' more
+ * bytes of the reply in nm_iobuffer are available at 'ptr'.
+ */
+
+#define NFS_DIR_REPLY_CHECK(nmp, ptr, len, label)                             \
+  do                                                                          \
+    {                                                                         \
+      if ((size_t)(len) > (size_t)((uint8_t *)(nmp)->nm_iobuffer +            \
+                                   (nmp)->nm_buflen - (uint8_t *)(ptr)))      \
+        {                                                                     \
+          nfs_debug_error("READDIR reply truncated\n");                       \
+          error = EPROTO;                                                     \
+          goto label;                                                         \
+        }                                                                     \
+    }                                                                         \
+  while (0)
+
 #define FILENAME_MAX_LEN 50
 struct MountOps nfs_mount_operations;
 struct VnodeOps nfs_vops;
@@ -226,6 +244,93 @@ static int nfs_fileupdate(struct nfsmount *nmp, char *filename,
   return OK;
 }
 
+/****************************************************************************
+ * Name: nfs_revalidate
+ *
+ * Description:
+ *   Make sure that the cached attributes of a node can be used.  The server
+ *   is asked with a GETATTR only when the attribute cache has expired, or
+ *   always if 'force' is set (on open, for close-to-open consistency).  If
+ *   the file changed on the server, its cached pages are dropped.  A stale
+ *   file handle is looked up again by name.
+ *
+ * Returned Value:
+ *   0 on success; a positive errno value on failure.
+ *
+ ****************************************************************************/
+
+static int nfs_revalidate(struct nfsmount *nmp, struct Vnode *node, bool force)
+{
+  struct nfsnode           *np = (struct nfsnode *)node->data;
+  struct nfs_fattr          fattr;
+  struct file_handle        parent_fhandle;
+  uint32_t                  mintimeo;
+  uint32_t                  maxtimeo;
+  uint32_t                  timeo;
+  int                       error;
+
+  if (!force && nfs_attrcache_valid(nmp, np))
+    {
+      return OK;
+    }
+
+  error = nfs_getattr(nmp, np, &fattr);
+  if (error == EAGAIN)
+    {
+      /* Written here while the call was out: what is cached is newer */
+
+      return OK;
+    }
+
+  if (error == NFSERR_STALE && np->n_name != NULL)
+    {
+      /* The file was replaced on the server, find it again by name */
+
+      OsFileCacheRemove(&(node->mapping));
+      nfs_readahead_reset(nmp, np);
+      parent_fhandle.length = np->n_pfhsize;
+      (void)memcpy_s(&(parent_fhandle.handle), NFSX_V3FHMAX, &(np->n_pfhandle), np->n_pfhsize);
+      np->n_attrtimeo = 0;
+      return nfs_fileupdate(nmp, np->n_name, &parent_fhandle, np);
+    }
+
+  if (error != OK)
+    {
+      return error;
+    }
+
+  if (np->n_type == NFDIR)
+    {
+      mintimeo = nmp->nm_acdirmin;
+      maxtimeo = nmp->nm_acdirmax;
+    }
+  else
+    {
+      mintimeo = nmp->nm_acregmin;
+      maxtimeo = nmp->nm_acregmax;
+    }
+
+  if (nfs_attrchanged(np, &fattr))
+    {
+      /* Changed on the server: drop the cached pages and check again soon */
+
+      OsFileCacheRemove(&(node->mapping));
+      nfs_readahead_reset(nmp, np);
+      np->n_attrtimeo = mintimeo;
+    }
+  else
+    {
+      /* Unchanged: trust the attributes for longer next time */
+
+      timeo = np->n_attrtimeo << 1;
+      np->n_attrtimeo = (timeo < mintimeo) ? mintimeo :
+                        (timeo > maxtimeo) ? maxtimeo : timeo;
+    }
+
+  nfs_attrupdate(np, &fattr);
+  return OK;
+}
+
 int vfs_nfs_reclaim(struct Vnode *node)
 {
   struct nfsnode  *prev = NULL;
@@ -285,6 +390,8 @@ int vfs_nfs_reclaim(struct Vnode *node)
 
               /* Then deallocate the file structure and return success */
 
+              nfs_readahead_free(nmp, np);
+              nfs_writebehind_free(nmp, np);
               free(np->n_name);
               free(np);
               ret = OK;
@@ -467,6 +574,56 @@ static void nfs_decode_args(struct nfs_mount_parameters *nprmt,
     {
       nprmt->readdirsize = maxio;
     }
+
+  /* Get the attribute cache timeouts.  A max below the min lowers the min
+   * with it, so that acregmax=0 turns attribute caching off.
+   */
+
+  if ((argp->flags & NFSMNT_ACREGMIN) != 0)
+    {
+      nprmt->acregmin = (uint32_t)argp->acregmin * LOSCFG_BASE_CORE_TICK_PER_SECOND;
+    }
+
+  if ((argp->flags & NFSMNT_ACREGMAX) != 0)
+    {
+      nprmt->acregmax = (uint32_t)argp->acregmax * LOSCFG_BASE_CORE_TICK_PER_SECOND;
+    }
+
+  if ((argp->flags & NFSMNT_ACDIRMIN) != 0)
+    {
+      nprmt->acdirmin = (uint32_t)argp->acdirmin * LOSCFG_BASE_CORE_TICK_PER_SECOND;
+    }
+
+  if ((argp->flags & NFSMNT_ACDIRMAX) != 0)
+    {
+      nprmt->acdirmax = (uint32_t)argp->acdirmax * LOSCFG_BASE_CORE_TICK_PER_SECOND;
+    }
+
+  if (nprmt->acregmin > nprmt->acregmax)
+    {
+      nprmt->acregmin = nprmt->acregmax;
+    }
+
+  if (nprmt->acdirmin > nprmt->acdirmax)
+    {
+      nprmt->acdirmin = nprmt->acdirmax;
+    }
+
+  /* Get the read-ahead window */
+
+  if ((argp->flags & NFSMNT_READAHEAD) != 0)
+    {
+      nprmt->readahead = (argp->readahead > NFS_MAXREADAHEAD) ?
+                         NFS_MAXREADAHEAD : argp->readahead;
+    }
+
+  /* Get the write-behind window */
+
+  if ((argp->flags & NFSMNT_WRITEBEHIND) != 0)
+    {
+      nprmt->writebehind = (argp->writebehind > NFS_MAXWRITEBEHIND) ?
+                           NFS_MAXWRITEBEHIND : argp->writebehind;
+    }
 }
 
 /****************************************************************************
@@ -509,6 +666,12 @@ int nfs_bind(struct Vnode *blkdriver, const void *data,
   nprmt.wsize       = NFS_WSIZE;
   nprmt.rsize       = NFS_RSIZE;
   nprmt.readdirsize = NFS_READDIRSIZE;
+  nprmt.acregmin    = NFS_ACREGMIN * LOSCFG_BASE_CORE_TICK_PER_SECOND;
+  nprmt.acregmax    = NFS_ACREGMAX * LOSCFG_BASE_CORE_TICK_PER_SECOND;
+  nprmt.acdirmin    = NFS_ACDIRMIN * LOSCFG_BASE_CORE_TICK_PER_SECOND;
+  nprmt.acdirmax    = NFS_ACDIRMAX * LOSCFG_BASE_CORE_TICK_PER_SECOND;
+  nprmt.readahead   = NFS_READAHEAD;
+  nprmt.writebehind = NFS_WRITEBEHIND;
 
   nfs_decode_args(&nprmt, argp);
 
@@ -582,6 +745,12 @@ int nfs_bind(struct Vnode *blkdriver, const void *data,
   nmp->nm_wsize       = nprmt.wsize;
   nmp->nm_rsize       = nprmt.rsize;
   nmp->nm_readdirsize = nprmt.readdirsize;
+  nmp->nm_acregmin    = nprmt.acregmin;
+  nmp->nm_acregmax    = nprmt.acregmax;
+  nmp->nm_acdirmin    = nprmt.acdirmin;
+  nmp->nm_acdirmax    = nprmt.acdirmax;
+  nmp->nm_readahead   = nprmt.readahead;
+  nmp->nm_writebehind = nprmt.writebehind;
   nmp->nm_fhsize      = NFSX_V3FHMAX;
 
   (void)strncpy_s(nmp->nm_path, sizeof(nmp->nm_path), argp->path, pathlen);
@@ -607,6 +776,13 @@ int nfs_bind(struct Vnode *blkdriver, const void *data,
 
       (void)memset_s(rpc, sizeof(struct rpcclnt), 0, sizeof(struct rpcclnt));
 
+      error = rpcclnt_lockinit(rpc);
+      if (error != OK)
+        {
+          free(rpc);
+          goto bad;
+        }
+
       nfs_debug_info("Connecting\n");
 
       /* Translate nfsmnt flags -> rpcclnt flags */
@@ -628,6 +804,7 @@ int nfs_bind(struct Vnode *blkdriver, const void *data,
     }
 
   nmp->nm_mounted        = true;
+  nmp->nm_readdirplus    = true;
   nmp->nm_so             = nmp->nm_rpcclnt->rc_so;
   nmp->nm_head           = NULL;
   nmp->nm_dir            = NULL;
@@ -668,6 +845,7 @@ bad:
       if (nmp->nm_rpcclnt)
         {
           rpcclnt_disconnect(nmp->nm_rpcclnt);
+          rpcclnt_lockdestroy(nmp->nm_rpcclnt);
           free(nmp->nm_rpcclnt);
           nmp->nm_rpcclnt = NULL;
         }
@@ -906,6 +1084,13 @@ int vfs_nfs_stat(struct Vnode *node, struct stat *buf)
   struct nfsmount *nmp = (struct nfsmount *)(node->originMount->data);
   nfs_mux_take(nmp);
   nfs_node = (struct nfsnode *)node->data;
+
+  /* Refresh expired attributes.  If the server cannot be reached, the
+   * last known attributes are returned.
+   */
+
+  (void)nfs_revalidate(nmp, node, false);
+
   buf->st_mode = node->mode;
   buf->st_gid = node->gid;
   buf->st_uid = node->uid;
@@ -964,6 +1149,104 @@ errout_with_mutex:
   return ret;
 }
 
+/****************************************************************************
+ * Name: nfs_readdir_request
+ *
+ * Description:
+ *   Send a READDIR, or a READDIRPLUS if 'plus' is set, for the next block
+ *   of entries of an open directory.  The reply is left in nm_iobuffer.
+ *
+ * Returned Value:
+ *   0 on success; a positive errno value on failure.
+ *
+ ****************************************************************************/
+
+static int nfs_readdir_request(struct nfsmount *nmp, struct nfsdir_s *nfs_dir,
+                               uint32_t *cookies, bool plus)
+{
+  uint32_t *ptr;
+  uint32_t maxcount;
+  int reqlen;
+  int procnum;
+
+  ptr     = (uint32_t *)&nmp->nm_msgbuffer.readdir.readdir;
+  reqlen  = 0;
+
+  /* Copy the variable length, directory file handle */
+
+  *ptr++  = txdr_unsigned((uint32_t)nfs_dir->nfs_fhsize);
+  reqlen += sizeof(uint32_t);
+
+  (void)memcpy_s(ptr, nfs_dir->nfs_fhsize, nfs_dir->nfs_fhandle, nfs_dir->nfs_fhsize);
+  reqlen += (int)nfs_dir->nfs_fhsize;
+  ptr    += uint32_increment((int)nfs_dir->nfs_fhsize);
+
+  /* Cookie and cookie verifier */
+
+  ptr[0] = cookies[0];
+  ptr[1] = cookies[1];
+  ptr    += 2;
+  reqlen += 2 * sizeof(uint32_t);
+
+  (void)memcpy_s(ptr, DIRENT_NFS_VERFLEN, nfs_dir->nfs_verifier, DIRENT_NFS_VERFLEN);
+  ptr    += uint32_increment(DIRENT_NFS_VERFLEN);
+  reqlen += DIRENT_NFS_VERFLEN;
+
+  /* Size of the directory information to return */
+
+  *ptr++  = txdr_unsigned((uint32_t)nmp->nm_readdirsize);
+  reqlen += sizeof(uint32_t);
+
+  if (plus)
+    {
+      /* The whole READDIRPLUS reply, with the attributes and handles, must
+       * fit into the I/O buffer.
+       */
+
+      maxcount = nmp->nm_buflen - SIZEOF_rpc_reply_readdir(0);
+      *ptr    = txdr_unsigned(maxcount);
+      reqlen += sizeof(uint32_t);
+      procnum = NFSPROC_READDIRPLUS;
+    }
+  else
+    {
+      procnum = NFSPROC_READDIR;
+    }
+
+  /* And read the directory */
+
+  nfs_statistics(procnum);
+  return nfs_request(nmp, procnum,
+                     (void *)&nmp->nm_msgbuffer.readdir, reqlen,
+                     (void *)nmp->nm_iobuffer, nmp->nm_buflen);
+}
+
+/****************************************************************************
+ * Name: nfs_readdirplus_attrupdate
+ *
+ * Description:
+ *   Refresh the cached attributes of an already known node from the
+ *   attributes that READDIRPLUS returned with its handle.  A file that
+ *   changed on the server only gets its attributes marked out of date, so
+ *   that the next nfs_revalidate() still drops its cached data.
+ *
+ ****************************************************************************/
+
+static void nfs_readdirplus_attrupdate(struct nfsmount *nmp, const void *fhandle,
+                                       uint32_t fhsize, struct nfs_fattr *attributes)
+{
+  struct nfsnode *np;
+
+  for (np = nmp->nm_head; np != NULL; np = np->n_next)
+    {
+      if (np->n_fhsize == fhsize && memcmp(&np->n_fhandle, fhandle, fhsize) == 0)
+        {
+          nfs_attrrefresh(np, attributes);
+          break;
+        }
+    }
+}
+
 int vfs_nfs_readdir(struct Vnode *node, struct fs_dirent_s *dir)
 {
   struct nfsmount *nmp;
@@ -972,14 +1255,18 @@ int vfs_nfs_readdir(struct Vnode *node, struct fs_dirent_s *dir)
   struct nfsdir_s *nfs_dir = NULL;
   struct entry3   *entry = NULL;
   struct entry3   *entry_pos = NULL;
+  struct nfs_fattr *attributes = NULL;
 
   /* Use 2 cookies */
 
   uint32_t cookies[2];
   uint32_t tmp;
+  uint32_t fhsize;
+  uint32_t type;
   uint32_t *ptr = NULL;
+  uint32_t *fhandle_ptr = NULL;
   size_t d_name_size;
-  int reqlen;
+  bool plus;
   int error = 0;
   int i = 0;
 
@@ -1020,40 +1307,21 @@ int vfs_nfs_readdir(struct Vnode *node, struct fs_dirent_s *dir)
           entry_pos = nfs_dir->nfs_entries;
           do
             {
-              ptr     = (uint32_t *)&nmp->nm_msgbuffer.readdir.readdir;
-              reqlen  = 0;
-
-              /* Copy the variable length, directory file handle */
-
-              *ptr++  = txdr_unsigned((uint32_t)nfs_dir->nfs_fhsize);
-              reqlen += sizeof(uint32_t);
-
-              (void)memcpy_s(ptr, nfs_dir->nfs_fhsize, nfs_dir->nfs_fhandle, nfs_dir->nfs_fhsize);
-              reqlen += (int)nfs_dir->nfs_fhsize;
-              ptr    += uint32_increment((int)nfs_dir->nfs_fhsize);
-
-              /* Cookie and cookie verifier */
-
-              ptr[0] = cookies[0];
-              ptr[1] = cookies[1];
-              ptr    += 2;
-              reqlen += 2 * sizeof(uint32_t);
-
-              (void)memcpy_s(ptr, DIRENT_NFS_VERFLEN, nfs_dir->nfs_verifier, DIRENT_NFS_VERFLEN);
-              ptr    += uint32_increment(DIRENT_NFS_VERFLEN);
-              reqlen += DIRENT_NFS_VERFLEN;
-
-              /* Number of directory entries (We currently only process one entry at a time) */
-
-              *ptr    = txdr_unsigned((uint32_t)nmp->nm_readdirsize);
-              reqlen += sizeof(uint32_t);
+              /* Prefer READDIRPLUS, which also returns the handles and
+               * attributes of the entries.
+               */
 
-              /* And read the directory */
+              plus  = nmp->nm_readdirplus;
+              error = nfs_readdir_request(nmp, nfs_dir, cookies, plus);
+              if (plus && (error == NFSERR_NOTSUPP || error == EOPNOTSUPP))
+                {
+                  /* The server does not support it; use READDIR from now on */
 
-              nfs_statistics(NFSPROC_READDIR);
-              error = nfs_request(nmp, NFSPROC_READDIR,
-                                  (void *)&nmp->nm_msgbuffer.readdir, reqlen,
-                                  (void *)nmp->nm_iobuffer, nmp->nm_buflen);
+                  nfs_debug_info("READDIRPLUS not supported, using READDIR\n");
+                  nmp->nm_readdirplus = false;
+                  plus  = false;
+                  error = nfs_readdir_request(nmp, nfs_dir, cookies, false);
+                }
 
               if (error != OK)
                 {
@@ -1075,16 +1343,20 @@ int vfs_nfs_readdir(struct Vnode *node, struct fs_dirent_s *dir)
 
               /* Check if attributes follow, if 0 so Skip over the attributes */
 
+              NFS_DIR_REPLY_CHECK(nmp, ptr, sizeof(uint32_t), errout_with_memory);
               tmp = *ptr++;
               if (tmp != 0)
                 {
-                  /* Attributes are not currently used */
+                  /* Refresh the cached attributes of the directory */
 
+                  NFS_DIR_REPLY_CHECK(nmp, ptr, sizeof(struct nfs_fattr), errout_with_memory);
+                  nfs_attrupdate((struct nfsnode *)node->data, (struct nfs_fattr *)ptr);
                   ptr += uint32_increment(sizeof(struct nfs_fattr));
                 }
 
               /* Save the verification cookie */
 
+              NFS_DIR_REPLY_CHECK(nmp, ptr, DIRENT_NFS_VERFLEN + sizeof(uint32_t), errout_with_memory);
               (void)memcpy_s(nfs_dir->nfs_verifier, DIRENT_NFS_VERFLEN, ptr, DIRENT_NFS_VERFLEN);
               ptr += uint32_increment(DIRENT_NFS_VERFLEN);
 
@@ -1099,6 +1371,7 @@ int vfs_nfs_readdir(struct Vnode *node, struct fs_dirent_s *dir)
                    * end-of-directory indication.
                    */
 
+                  NFS_DIR_REPLY_CHECK(nmp, ptr, sizeof(uint32_t), errout_with_memory);
                   tmp = *ptr++;
                   if (tmp != 0)
                     {
@@ -1123,7 +1396,11 @@ int vfs_nfs_readdir(struct Vnode *node, struct fs_dirent_s *dir)
                *    Name length (4 bytes)
                *    Name string (varaiable size but in multiples of 4 bytes)
                *    Cookie (8 bytes)
+               *    Attributes and handle (READDIRPLUS only, see nfs_proto.h)
                *    next entry (4 bytes)
+               *
+               * Every field is checked against the end of the I/O buffer before
+               * it is read, so a short or malformed reply cannot walk off it.
                */
 
                do
@@ -1132,13 +1409,19 @@ int vfs_nfs_readdir(struct Vnode *node, struct fs_dirent_s *dir)
 
                   /* There is an entry. Skip over the file ID and point to the length */
 
+                  NFS_DIR_REPLY_CHECK(nmp, ptr, 3 * sizeof(uint32_t), errout_with_entry);
                   entry->file_id[0] = *ptr++;
                   entry->file_id[1] = *ptr++; /*lint !e662 !e661*/
 
-                  /* Get the length and point to the name */
+                  /* Get the length and point to the name.  The name, its padding
+                   * and the cookie must all be in the reply.
+                   */
 
                   tmp    = *ptr++; /*lint !e662 !e661*/
                   entry->name_len = fxdr_unsigned(uint32_t, tmp);
+                  NFS_DIR_REPLY_CHECK(nmp, ptr, entry->name_len, errout_with_entry);
+                  NFS_DIR_REPLY_CHECK(nmp, ptr, (sizeof(uint32_t) * uint32_increment(entry->name_len)) +
+                                      (2 * sizeof(uint32_t)), errout_with_entry);
                   entry->contents = (uint8_t *)malloc(entry->name_len + 1);
                   if (!entry->contents)
                     {
@@ -1169,9 +1452,61 @@ int vfs_nfs_readdir(struct Vnode *node, struct fs_dirent_s *dir)
                   entry->cookie[0] = *ptr++;
                   entry->cookie[1] = *ptr++;
 
-                  /* Get the file attributes associated with this name and return
-                   * the file type.
-                   */
+                  if (plus)
+                    {
+                      /* The attributes and the handle are both optional */
+
+                      attributes  = NULL;
+                      fhandle_ptr = NULL;
+                      fhsize      = 0;
+
+                      NFS_DIR_REPLY_CHECK(nmp, ptr, sizeof(uint32_t), errout_with_entry);
+                      tmp = *ptr++;
+                      if (tmp != 0)
+                        {
+                          NFS_DIR_REPLY_CHECK(nmp, ptr, sizeof(struct nfs_fattr), errout_with_entry);
+                          attributes = (struct nfs_fattr *)ptr;
+                          ptr += uint32_increment(sizeof(struct nfs_fattr));
+                        }
+
+                      NFS_DIR_REPLY_CHECK(nmp, ptr, sizeof(uint32_t), errout_with_entry);
+                      tmp = *ptr++;
+                      if (tmp != 0)
+                        {
+                          NFS_DIR_REPLY_CHECK(nmp, ptr, sizeof(uint32_t), errout_with_entry);
+                          fhsize = fxdr_unsigned(uint32_t, *ptr++);
+                          if (fhsize > NFSX_V3FHMAX)
+                            {
+                              nfs_debug_error("READDIRPLUS handle too large: %u\n", fhsize);
+                              error = EPROTO;
+                              goto errout_with_entry;
+                            }
+
+                          NFS_DIR_REPLY_CHECK(nmp, ptr, sizeof(uint32_t) * uint32_increment(fhsize),
+                                              errout_with_entry);
+                          fhandle_ptr = ptr;
+                          ptr += uint32_increment(fhsize);
+                        }
+
+                      /* Keep the file type for the dirent and refresh the
+                       * attribute cache of the node if it is in use.
+                       */
+
+                      if (attributes != NULL)
+                        {
+                          entry->type = fxdr_unsigned(uint32_t, attributes->fa_type);
+                          if (fhandle_ptr != NULL)
+                            {
+                              nfs_readdirplus_attrupdate(nmp, fhandle_ptr, fhsize, attributes);
+                            }
+                        }
+                    }
+
+                  /* The next entry indication follows */
+
+                  NFS_DIR_REPLY_CHECK(nmp, ptr, sizeof(uint32_t), errout_with_entry);
+
+                  /* Skip the entries for the directory itself and its parent */
 
                   if (strcmp((char *)entry->contents, ".") == 0 || strcmp((char *)entry->contents, "..") == 0)
                     {
@@ -1191,6 +1526,10 @@ int vfs_nfs_readdir(struct Vnode *node, struct fs_dirent_s *dir)
                     }
                 }
               while (*ptr++);
+
+              /* Then the end-of-directory indication */
+
+              NFS_DIR_REPLY_CHECK(nmp, ptr, sizeof(uint32_t), errout_with_memory);
               if (entry_pos)
                 {
                   cookies[0] = entry_pos->cookie[0];
@@ -1243,23 +1582,32 @@ int vfs_nfs_readdir(struct Vnode *node, struct fs_dirent_s *dir)
           dir->fd_dir[i].d_name[entry_pos->name_len] = '\0';
         }
 
+      type = entry_pos->type;
       nfs_dir->nfs_entries = entry_pos->next;
       NFS_DIR_ENTRY_FREE(entry_pos);
 
-      fhandle.length = (uint32_t)nfs_dir->nfs_fhsize;
-      (void)memcpy_s(&fhandle.handle, DIRENT_NFS_MAXHANDLE, nfs_dir->nfs_fhandle, DIRENT_NFS_MAXHANDLE);
+      /* READDIR does not return the file type, nor does READDIRPLUS when the
+       * server leaves out the attributes.  Ask for it then.
+       */
 
-      error = nfs_lookup(nmp, dir->fd_dir[i].d_name, &fhandle, &obj_attributes, NULL);
-      if (error != OK)
-      {
-        nfs_debug_error("nfs_lookup failed: %d\n", error);
-        goto errout_with_memory;
-      }
+      if (type == NFNON)
+        {
+          fhandle.length = (uint32_t)nfs_dir->nfs_fhsize;
+          (void)memcpy_s(&fhandle.handle, DIRENT_NFS_MAXHANDLE, nfs_dir->nfs_fhandle, DIRENT_NFS_MAXHANDLE);
+
+          error = nfs_lookup(nmp, dir->fd_dir[i].d_name, &fhandle, &obj_attributes, NULL);
+          if (error != OK)
+          {
+            nfs_debug_error("nfs_lookup failed: %d\n", error);
+            goto errout_with_memory;
+          }
+
+          type = fxdr_unsigned(uint32_t, obj_attributes.fa_type);
+        }
 
       /* Set the dirent file type */
 
-      tmp = fxdr_unsigned(uint32_t, obj_attributes.fa_type);
-      switch (tmp)
+      switch (type)
         {
         default:
         case NFNON:        /* Unknown type */
@@ -1292,6 +1640,8 @@ int vfs_nfs_readdir(struct Vnode *node, struct fs_dirent_s *dir)
   nfs_mux_release(nmp);
   return i;
 
+errout_with_entry:
+  NFS_DIR_ENTRY_FREE(entry);
 errout_with_memory:
   for (entry_pos = nfs_dir->nfs_entries; entry_pos != NULL; entry_pos = nfs_dir->nfs_entries)
     {
@@ -1563,10 +1913,9 @@ int vfs_nfs_write(struct file *filep, const char *buffer, size_t buflen)
   size_t                reqlen;
   uint32_t              *ptr = NULL;
   uint32_t              tmp;
-  int                   committed = NFSV3WRITE_UNSTABLE;
+  int                   committed = NFSV3WRITE_FILESYNC;
   int                   error;
   char                  *temp_buffer = NULL;
-  struct file_handle    parent_fhandle;
 
   struct Vnode *node = filep->f_vnode;
   nmp = (struct nfsmount *)(node->originMount->data);
@@ -1583,14 +1932,13 @@ int vfs_nfs_write(struct file *filep, const char *buffer, size_t buflen)
       goto errout_with_mutex;
     }
 
-  parent_fhandle.length = ((struct nfsnode *)node->data)->n_pfhsize;
-  (void)memcpy_s(&(parent_fhandle.handle), NFSX_V3FHMAX,
-      &(((struct nfsnode *)node->data)->n_pfhandle),
-      ((struct nfsnode *)node->data)->n_pfhsize);
+  /* Data staged by read-ahead would not show this write */
+
+  nfs_readahead_reset(nmp, np);
 
   if (filep->f_oflags & O_APPEND)
     {
-      if (nfs_fileupdate(nmp, np->n_name, &parent_fhandle, np) == OK)
+      if (nfs_revalidate(nmp, node, false) == OK)
         {
           f_pos = np->n_size;
         }
@@ -1613,6 +1961,27 @@ int vfs_nfs_write(struct file *filep, const char *buffer, size_t buflen)
       goto errout_with_mutex;
     }
 
+  /* Write behind, unless it is disabled on the mount.  The synchronous
+   * writes below make each chunk stable on the server before returning.
+   */
+
+  if (buflen > 0 && nfs_writebehind_setup(nmp, np) == OK)
+    {
+      error = nfs_writebehind_write(nmp, np, buffer, buflen, f_pos, true, &byteswritten);
+      if (error != OK)
+        {
+          goto errout_with_mutex;
+        }
+
+      f_pos += byteswritten;
+      filep->f_pos = f_pos;
+      np->n_fpos = f_pos;
+      nfs_sizeupdate(np, (f_pos > (loff_t)np->n_size) ? (uint64_t)f_pos : np->n_size);
+
+      nfs_mux_release(nmp);
+      return byteswritten;
+    }
+
   /* Allocate memory for data */
 
   bufsize = (buflen < nmp->nm_wsize) ? buflen : nmp->nm_wsize;
@@ -1734,6 +2103,12 @@ int vfs_nfs_write(struct file *filep, const char *buffer, size_t buflen)
           nfs_attrupdate(np, (struct nfs_fattr *)ptr);
           ptr += uint32_increment(sizeof(struct nfs_fattr));
         }
+      else
+        {
+          /* No.. the write made the cached attributes out of date */
+
+          np->n_flags &= ~NFSNODE_ATTRVALID;
+        }
 
       /* Get the count of bytes actually written */
 
@@ -1753,10 +2128,7 @@ int vfs_nfs_write(struct file *filep, const char *buffer, size_t buflen)
 
       /* Update the read state data */
 
-      if (filep->f_pos > (loff_t)np->n_size)
-        {
-          np->n_size = f_pos;
-        }
+      nfs_sizeupdate(np, (f_pos > (loff_t)np->n_size) ? (uint64_t)f_pos : np->n_size);
       byteswritten += writesize;
       buffer       += writesize;
   }
@@ -1782,10 +2154,9 @@ ssize_t vfs_nfs_writepage(struct Vnode *node, char *buffer, off_t pos, size_t bu
   size_t                reqlen;
   uint32_t              *ptr = NULL;
   uint32_t              tmp;
-  int                   committed = NFSV3WRITE_UNSTABLE;
+  int                   committed = NFSV3WRITE_FILESYNC;
   int                   error;
   char                  *temp_buffer = NULL;
-  struct file_handle    parent_fhandle;
 
   nmp = (struct nfsmount *)(node->originMount->data);
   DEBUGASSERT(nmp != NULL);
@@ -1801,10 +2172,9 @@ ssize_t vfs_nfs_writepage(struct Vnode *node, char *buffer, off_t pos, size_t bu
       goto errout_with_mutex;
     }
 
-  parent_fhandle.length = ((struct nfsnode *)node->data)->n_pfhsize;
-  (void)memcpy_s(&(parent_fhandle.handle), NFSX_V3FHMAX,
-      &(((struct nfsnode *)node->data)->n_pfhandle),
-      ((struct nfsnode *)node->data)->n_pfhsize);
+  /* Data staged by read-ahead would not show this write */
+
+  nfs_readahead_reset(nmp, np);
 
   /* Check if the file size would exceed the range of off_t */
 
@@ -1824,6 +2194,19 @@ ssize_t vfs_nfs_writepage(struct Vnode *node, char *buffer, off_t pos, size_t bu
 
   buflen = min(buflen, np->n_size - f_pos);
 
+  if (buflen > 0 && nfs_writebehind_setup(nmp, np) == OK)
+    {
+      error = nfs_writebehind_write(nmp, np, buffer, buflen, f_pos, false, &byteswritten);
+      if (error != OK)
+        {
+          goto errout_with_mutex;
+        }
+
+      np->n_fpos = f_pos + byteswritten;
+      nfs_mux_release(nmp);
+      return byteswritten;
+    }
+
   /* Allocate memory for data */
 
   bufsize = (buflen < nmp->nm_wsize) ? buflen : nmp->nm_wsize;
@@ -1945,6 +2328,12 @@ ssize_t vfs_nfs_writepage(struct Vnode *node, char *buffer, off_t pos, size_t bu
           nfs_attrupdate(np, (struct nfs_fattr *)ptr);
           ptr += uint32_increment(sizeof(struct nfs_fattr));
         }
+      else
+        {
+          /* No.. the write made the cached attributes out of date */
+
+          np->n_flags &= ~NFSNODE_ATTRVALID;
+        }
 
       /* Get the count of bytes actually written */
 
@@ -2035,7 +2424,7 @@ off_t vfs_nfs_seek(struct file *filep, off_t offset, int whence)
   filep->f_pos = np->n_fpos;
   if (position > (off_t)np->n_size)
   {
-      np->n_size = (loff_t)position;
+      nfs_sizeupdate(np, (uint64_t)position);
   }
   nfs_mux_release(nmp);
   return (off_t)filep->f_pos;
@@ -2048,14 +2437,15 @@ errout_with_mutex:
 ssize_t vfs_nfs_readpage(struct Vnode *node, char *buffer, off_t pos)
 {
   struct nfsnode            *np;
+  struct rpc_call_read       read_call;
   struct rpc_reply_read     *read_response = NULL;
+  char                      *iobuffer = NULL;
   size_t                     readsize;
   size_t                     tmp;
   size_t                     bytesread;
   size_t                     reqlen;
   uint32_t                  *ptr = NULL;
   int                        error = 0;
-  struct file_handle         parent_fhandle;
   int                        buflen = PAGE_SIZE;
   struct nfsmount *nmp = (struct nfsmount *)(node->originMount->data);
 
@@ -2073,14 +2463,14 @@ ssize_t vfs_nfs_readpage(struct Vnode *node, char *buffer, off_t pos)
     }
 
 
-  parent_fhandle.length = ((struct nfsnode *)node->data)->n_pfhsize;
-  (void)memcpy_s(&(parent_fhandle.handle), NFSX_V3FHMAX,
-      &(((struct nfsnode *)node->data)->n_pfhandle),
-      ((struct nfsnode *)node->data)->n_pfhsize);
-  error = nfs_fileupdate(nmp, np->n_name, &parent_fhandle, np);
+  /* The size only needs to come from the server once the cached
+   * attributes have expired.
+   */
+
+  error = nfs_revalidate(nmp, node, false);
   if (error != OK)
     {
-      nfs_debug_info("nfs_fileupdate failed: %d\n", error);
+      nfs_debug_info("nfs_revalidate failed: %d\n", error);
       goto errout_with_mutex;
     }
 
@@ -2100,6 +2490,18 @@ ssize_t vfs_nfs_readpage(struct Vnode *node, char *buffer, off_t pos)
       buflen = tmp;
     }
 
+  /* The READs go through buffers of their own rather than the ones in the
+   * mount structure, so that other threads can use the mount while the
+   * server is asked.
+   */
+
+  iobuffer = malloc(nmp->nm_buflen);
+  if (iobuffer == NULL)
+    {
+      error = ENOMEM;
+      goto errout_with_mutex;
+    }
+
   /* Now loop until we fill the user buffer (or hit the end of the file) */
 
   for (bytesread = 0; bytesread < buflen; )
@@ -2122,7 +2524,7 @@ ssize_t vfs_nfs_readpage(struct Vnode *node, char *buffer, off_t pos)
 
       /* Initialize the request */
 
-      ptr     = (uint32_t *)&nmp->nm_msgbuffer.read.read;
+      ptr     = (uint32_t *)&read_call.read;
       reqlen  = 0;
 
       /* Copy the variable length, file handle */
@@ -2149,8 +2551,8 @@ ssize_t vfs_nfs_readpage(struct Vnode *node, char *buffer, off_t pos)
 
       nfs_statistics(NFSPROC_READ);
       error = nfs_request(nmp, NFSPROC_READ,
-          (void *)&nmp->nm_msgbuffer.read, reqlen,
-          (void *)nmp->nm_iobuffer, nmp->nm_buflen);
+          (void *)&read_call, reqlen,
+          (void *)iobuffer, nmp->nm_buflen);
       if (error)
         {
           nfs_debug_error("nfs_request failed: %d\n", error);
@@ -2161,7 +2563,7 @@ ssize_t vfs_nfs_readpage(struct Vnode *node, char *buffer, off_t pos)
        * response data.
        */
 
-      read_response = (struct rpc_reply_read *)nmp->nm_iobuffer;
+      read_response = (struct rpc_reply_read *)iobuffer;
       readsize = fxdr_unsigned(uint32_t, read_response->read.hdr.count);
 
       /* Copy the read data into the user buffer */
@@ -2187,10 +2589,12 @@ ssize_t vfs_nfs_readpage(struct Vnode *node, char *buffer, off_t pos)
         }
     }
 
+  free(iobuffer);
   nfs_mux_release(nmp);
   return bytesread;
 
 errout_with_mutex:
+  free(iobuffer);
   nfs_mux_release(nmp);
   return -error;
 }
@@ -2198,14 +2602,15 @@ errout_with_mutex:
 ssize_t vfs_nfs_read(struct file *filep, char *buffer, size_t buflen)
 {
   struct nfsnode            *np;
+  struct rpc_call_read       read_call;
   struct rpc_reply_read     *read_response = NULL;
+  char                      *iobuffer = NULL;
   size_t                     readsize;
   size_t                     tmp;
   size_t                     bytesread;
   size_t                     reqlen;
   uint32_t                  *ptr = NULL;
   int                        error = 0;
-  struct file_handle         parent_fhandle;
 
   struct Vnode *node = filep->f_vnode;
   struct nfsmount *nmp = (struct nfsmount *)(node->originMount->data);
@@ -2224,14 +2629,14 @@ ssize_t vfs_nfs_read(struct file *filep, char *buffer, size_t buflen)
     }
 
 
-  parent_fhandle.length = ((struct nfsnode *)node->data)->n_pfhsize;
-  (void)memcpy_s(&(parent_fhandle.handle), NFSX_V3FHMAX,
-      &(((struct nfsnode *)node->data)->n_pfhandle),
-      ((struct nfsnode *)node->data)->n_pfhsize);
-  error = nfs_fileupdate(nmp, np->n_name, &parent_fhandle, np);
+  /* The size only needs to come from the server once the cached
+   * attributes have expired.
+   */
+
+  error = nfs_revalidate(nmp, node, false);
   if (error != OK)
     {
-      nfs_debug_info("nfs_fileupdate failed: %d\n", error);
+      nfs_debug_info("nfs_revalidate failed: %d\n", error);
       goto errout_with_mutex;
     }
 
@@ -2245,6 +2650,37 @@ ssize_t vfs_nfs_read(struct file *filep, char *buffer, size_t buflen)
       buflen = tmp;
     }
 
+  /* A read that continues the previous one is likely followed by more.
+   * Serve it through the read-ahead window, which keeps several READs in
+   * flight instead of one at a time.
+   */
+
+  if (buflen > 0 && filep->f_pos == np->n_rapos &&
+      nfs_readahead_setup(nmp, np) == OK)
+    {
+      error = nfs_readahead_read(nmp, np, buffer, buflen, filep->f_pos, &bytesread);
+      if (error != OK)
+        {
+          goto errout_with_mutex;
+        }
+
+      filep->f_pos += bytesread;
+      np->n_fpos   += bytesread;
+      goto out;
+    }
+
+  /* The READs go through buffers of their own rather than the ones in the
+   * mount structure, so that other threads can use the mount while the
+   * server is asked.
+   */
+
+  iobuffer = malloc(nmp->nm_buflen);
+  if (iobuffer == NULL)
+    {
+      error = ENOMEM;
+      goto errout_with_mutex;
+    }
+
   /* Now loop until we fill the user buffer (or hit the end of the file) */
 
   for (bytesread = 0; bytesread < buflen; )
@@ -2267,7 +2703,7 @@ ssize_t vfs_nfs_read(struct file *filep, char *buffer, size_t buflen)
 
       /* Initialize the request */
 
-      ptr     = (uint32_t *)&nmp->nm_msgbuffer.read.read;
+      ptr     = (uint32_t *)&read_call.read;
       reqlen  = 0;
 
       /* Copy the variable length, file handle */
@@ -2294,8 +2730,8 @@ ssize_t vfs_nfs_read(struct file *filep, char *buffer, size_t buflen)
 
       nfs_statistics(NFSPROC_READ);
       error = nfs_request(nmp, NFSPROC_READ,
-          (void *)&nmp->nm_msgbuffer.read, reqlen,
-          (void *)nmp->nm_iobuffer, nmp->nm_buflen);
+          (void *)&read_call, reqlen,
+          (void *)iobuffer, nmp->nm_buflen);
       if (error)
         {
           nfs_debug_error("nfs_request failed: %d\n", error);
@@ -2306,7 +2742,7 @@ ssize_t vfs_nfs_read(struct file *filep, char *buffer, size_t buflen)
        * response data.
        */
 
-      read_response = (struct rpc_reply_read *)nmp->nm_iobuffer;
+      read_response = (struct rpc_reply_read *)iobuffer;
       readsize = fxdr_unsigned(uint32_t, read_response->read.hdr.count);
 
       /* Copy the read data into the user buffer */
@@ -2332,10 +2768,14 @@ ssize_t vfs_nfs_read(struct file *filep, char *buffer, size_t buflen)
         }
     }
 
+out:
+  np->n_rapos = filep->f_pos;
+  free(iobuffer);
   nfs_mux_release(nmp);
   return bytesread;
 
 errout_with_mutex:
+  free(iobuffer);
   nfs_mux_release(nmp);
   return -error;
 }
@@ -2664,6 +3104,7 @@ int vfs_nfs_close(struct Vnode *node)
 {
   struct nfsmount *nmp = (struct nfsmount *)(node->originMount->data);
   struct nfsnode  *np = NULL;
+  int error;
   nfs_mux_take(nmp);
   np = (struct nfsnode*)(node->data);
   /* Decrement the reference count.  If the reference count would not
@@ -2674,8 +3115,21 @@ int vfs_nfs_close(struct Vnode *node)
     {
       np->n_crefs--;
     }
+
+  /* Release the read-ahead buffers, they are not needed until the next
+   * sequential read.
+   */
+
+  nfs_readahead_free(nmp, np);
+
+  /* Commit the data written behind, so that the next open on any client
+   * finds it, and report what could not be written.
+   */
+
+  error = nfs_writebehind_flush(nmp, np);
+  nfs_writebehind_free(nmp, np);
   nfs_mux_release(nmp);
-  return OK;
+  return -error;
 }
 
 int vfs_nfs_close_file(struct file *filep)
@@ -2684,6 +3138,20 @@ int vfs_nfs_close_file(struct file *filep)
   return vfs_nfs_close(node);
 }
 
+int vfs_nfs_fsync(struct file *filep)
+{
+  struct Vnode *node = (struct Vnode *)filep->f_vnode;
+  struct nfsmount *nmp = (struct nfsmount *)(node->originMount->data);
+  struct nfsnode  *np = NULL;
+  int error;
+
+  nfs_mux_take(nmp);
+  np = (struct nfsnode *)(node->data);
+  error = nfs_writebehind_flush(nmp, np);
+  nfs_mux_release(nmp);
+  return -error;
+}
+
 int vfs_nfs_closedir(struct Vnode *node, struct fs_dirent_s *dir)
 {
   struct nfsmount *nmp = (struct nfsmount *)(node->originMount->data);
@@ -2960,6 +3428,15 @@ int vfs_nfs_truncate(struct Vnode *node, off_t length)
   nfs_mux_take(nmp);
   np = (struct nfsnode*)(node->data);
 
+  /* Data written behind must not be written again past the new end */
+
+  error = nfs_writebehind_flush(nmp, np);
+  if (error != OK)
+    {
+      nfs_mux_release(nmp);
+      return -error;
+    }
+
   /* Create the SETATTR RPC call arguments */
 
   ptr    = (uint32_t *)&nmp->nm_msgbuffer.setattr.setattr;
@@ -3000,9 +3477,13 @@ int vfs_nfs_truncate(struct Vnode *node, off_t length)
       return -error;
     }
 
-  /* Indicate that the file now has zero length */
+  /* Indicate that the file now has zero length.  The times changed as
+   * well, so fetch the attributes again when they are needed.
+   */
 
-  np->n_size = length;
+  nfs_sizeupdate(np, length);
+  np->n_flags &= ~NFSNODE_ATTRVALID;
+  nfs_readahead_reset(nmp, np);
   nfs_mux_release(nmp);
   return OK;
 }
@@ -3044,6 +3525,16 @@ static int vfs_nfs_unmount(struct Mount *mnt, struct Vnode **blkDriver)
       goto errout_with_mutex;
     }
 
+  /* Threads whose requests are waiting for a reply without nm_mux take it
+   * again once they have the reply, so the mount structure must stay.
+   */
+
+  if (nmp->nm_nrpcs != 0)
+    {
+      error = EBUSY;
+      goto errout_with_mutex;
+    }
+
   /* No open file... Umount the file system. */
 
   error = rpcclnt_umount(nmp->nm_rpcclnt);
@@ -3057,10 +3548,13 @@ static int vfs_nfs_unmount(struct Mount *mnt, struct Vnode **blkDriver)
 
   rpcclnt_disconnect(nmp->nm_rpcclnt);
 
-  /* And free any allocated resources */
+  /* And free any allocated resources.  rpcclnt_lockdestroy() waits for any
+   * thread still inside the RPC client.
+   */
 
   nfs_mux_release(nmp);
   (void)pthread_mutex_destroy(&nmp->nm_mux);
+  rpcclnt_lockdestroy(nmp->nm_rpcclnt);
   free(nmp->nm_rpcclnt);
   nmp->nm_rpcclnt = NULL;
   free(nmp);
@@ -3073,59 +3567,19 @@ errout_with_mutex:
   return -error;
 }
 
-static int nfs_check_timestamp(struct timespec *origin, struct timespec *new)
-{
-  return (origin->tv_sec == new->tv_sec) && (origin->tv_nsec == new->tv_nsec);
-}
-
 static int vfs_nfs_open(struct file *filep)
 {
   int ret;
-  struct timespec ts;
-  struct rpc_call_fs attr_call;
-  struct rpc_reply_getattr attr_reply;
   struct Vnode *node = filep->f_vnode;
-  struct nfsnode *nfs_node = NULL;
   struct nfsmount *nmp = (struct nfsmount *)(node->originMount->data);
-  struct file_handle parent_fhandle = {0};
 
-  nfs_mux_take(nmp);
-  nfs_node = (struct nfsnode *)node->data;
-  attr_call.fs.fsroot.length = txdr_unsigned(nfs_node->n_fhsize);
-  memcpy_s(&(attr_call.fs.fsroot.handle), sizeof(nfsfh_t), &(nfs_node->n_fhandle), sizeof(nfsfh_t));
-
-  ret = nfs_request(nmp, NFSPROC_GETATTR, &attr_call,
-      sizeof(struct file_handle), &attr_reply,
-      sizeof(struct rpc_reply_getattr));
-  if (ret != OK)
-    {
-      if (ret == NFSERR_STALE)
-      {
-        /* If the file handle is stale, update it */
-        OsFileCacheRemove(&(node->mapping));
-        parent_fhandle.length = ((struct nfsnode *)node->parent->data)->n_fhsize;
-        memcpy_s(&(parent_fhandle.handle), parent_fhandle.length,
-            &(((struct nfsnode *)node->parent->data)->n_fhandle),
-            ((struct nfsnode *)node->parent->data)->n_fhsize);
-        ret = nfs_fileupdate(nmp, nfs_node->n_name, &parent_fhandle, nfs_node);
-      }
-      nfs_mux_release(nmp);
-      return ret;
-    }
-
-  /* Extract time values as timestamp */
-
-  fxdr_nfsv3time(&attr_reply.attr.fa_mtime, &ts);
-  if (!nfs_check_timestamp(&(nfs_node->n_timestamp), &ts))
-    {
-      OsFileCacheRemove(&(node->mapping));
-      nfs_node->n_timestamp.tv_sec = ts.tv_sec;
-      nfs_node->n_timestamp.tv_nsec = ts.tv_nsec;
-    }
+  /* Close-to-open consistency: always check with the server on open */
 
+  nfs_mux_take(nmp);
+  ret = nfs_revalidate(nmp, node, true);
   nfs_mux_release(nmp);
 
-  return OK;
+  return -ret;
 }
 
 struct MountOps nfs_mount_operations =
@@ -3163,6 +3617,7 @@ struct file_operations_vfs nfs_fops =
   .read = vfs_nfs_read,
   .mmap = OsVfsFileMmap,
   .close = vfs_nfs_close_file,
+  .fsync = vfs_nfs_fsync,
 };
 FSMAP_ENTRY(nfs_fsmap, "nfs", nfs_mount_operations, FALSE, FALSE);
 #endif
@@ -73,6 +73,12 @@ extern "C" {
 #define NFSMNT_TIMEO             (1 << 3)      /* Set initial timeout */
 #define NFSMNT_RETRANS           (1 << 4)      /* Set number of request retries */
 #define NFSMNT_READDIRSIZE       (1 << 5)      /* Set readdir size */
+#define NFSMNT_ACREGMIN          (1 << 6)      /* Set min attribute cache timeout for files */
+#define NFSMNT_ACREGMAX          (1 << 7)      /* Set max attribute cache timeout for files */
+#define NFSMNT_ACDIRMIN          (1 << 8)      /* Set min attribute cache timeout for directories */
+#define NFSMNT_ACDIRMAX          (1 << 9)      /* Set max attribute cache timeout for directories */
+#define NFSMNT_READAHEAD         (1 << 10)     /* Set read-ahead window */
+#define NFSMNT_WRITEBEHIND       (1 << 11)     /* Set write-behind window */
 
 /****************************************************************************
  * Public Types
@@ -87,6 +93,8 @@ struct nfsmount
   struct nfsnode  *nm_head;                   /* A list of all files opened on this mountpoint */
   struct nfsdir_s *nm_dir;                    /* A list of all directories opened on this mountpoint */
   pthread_mutex_t  nm_mux;                    /* Used to assure thread-safe access */
+  uint16_t         nm_muxdepth;               /* Times the holder of nm_mux has taken it */
+  uint16_t         nm_nrpcs;                  /* Requests waiting for a reply without nm_mux */
   nfsfh_t          nm_fh;                     /* File handle of root dir */
   char             nm_path[NFS_MOUNT_PATH_MAX_SIZE];  /* server's path of the directory being mounted */
   struct nfs_fattr nm_fattr;                  /* nfs file attribute cache */
@@ -94,6 +102,7 @@ struct nfsmount
   int32_t          nm_so;                     /* RPC socket */
   struct sockaddr  nm_nam;                    /* Addr of server */
   bool             nm_mounted;                /* true: The file system is ready */
+  bool             nm_readdirplus;            /* true: The server supports READDIRPLUS */
   uint8_t          nm_fhsize;                 /* Size of root file handle (host order) */
   uint8_t          nm_sotype;                 /* Type of socket */
   uint8_t          nm_retry;                  /* Max retries */
@@ -102,6 +111,14 @@ struct nfsmount
   uint16_t         nm_wsize;                  /* Max size of write RPC */
   uint16_t         nm_readdirsize;            /* Size of a readdir RPC */
   uint16_t         nm_buflen;                 /* Size of I/O buffer */
+  uint32_t         nm_acregmin;               /* Min attribute cache timeout for files (ticks) */
+  uint32_t         nm_acregmax;               /* Max attribute cache timeout for files (ticks) */
+  uint32_t         nm_acdirmin;               /* Min attribute cache timeout for directories (ticks) */
+  uint32_t         nm_acdirmax;               /* Max attribute cache timeout for directories (ticks) */
+  uint8_t          nm_readahead;              /* READs kept in flight per file (0: no read-ahead) */
+  struct nfsnode  *nm_rahead;                 /* File whose read-ahead READs are in flight */
+  uint8_t          nm_writebehind;            /* WRITE buffers per file (0: synchronous writes) */
+  struct nfsnode  *nm_wbhead;                 /* File whose WRITEs or COMMIT are in flight */
   mode_t           nm_permission;
   uint             nm_gid;
   uint             nm_uid;
@@ -123,6 +140,7 @@ struct nfsmount
     struct rpc_call_mkdir   mkdir;
     struct rpc_call_rmdir   rmdir;
     struct rpc_call_readdir readdir;
+    struct rpc_call_readdirplus readdirplus;
     struct rpc_call_fs      fsstat;
     struct rpc_call_setattr setattr;
     struct rpc_call_fs      fs;
@@ -157,18 +175,32 @@ struct nfs_mount_parameters
   uint16_t         rsize;                  /* Max size of read RPC */
   uint16_t         wsize;                  /* Max size of write RPC */
   uint16_t         readdirsize;            /* Size of a readdir RPC */
+  uint32_t         acregmin;               /* Attribute cache timeouts (in ticks) */
+  uint32_t         acregmax;
+  uint32_t         acdirmin;
+  uint32_t         acdirmax;
+  uint8_t          readahead;              /* Read-ahead window (READs in flight) */
+  uint8_t          writebehind;            /* Write-behind window (WRITE buffers) */
 };
 
 struct nfs_args
 {
   uint8_t         addrlen;               /* Length of address */
   uint8_t         sotype;                /* Socket type */
-  uint8_t         flags;                 /* Flags, determines if following are valid: */
+  uint16_t        flags;                 /* Flags, determines if following are valid: */
   uint8_t         timeo;                 /* Time value in deciseconds (with NFSMNT_TIMEO) */
   uint8_t         retrans;               /* Times to retry send (with NFSMNT_RETRANS) */
   uint16_t        wsize;                 /* Write size in bytes (with NFSMNT_WSIZE) */
   uint16_t        rsize;                 /* Read size in bytes (with NFSMNT_RSIZE) */
   uint16_t        readdirsize;           /* readdir size in bytes (with NFSMNT_READDIRSIZE) */
+  uint16_t        acregmin;              /* Attribute cache timeouts in seconds (with */
+  uint16_t        acregmax;              /* NFSMNT_ACREGMIN, ACREGMAX, ACDIRMIN and */
+  uint16_t        acdirmin;              /* ACDIRMAX).  acregmax=0 disables caching of */
+  uint16_t        acdirmax;              /* file attributes */
+  uint8_t         readahead;             /* READs in flight for sequential reads (with */
+                                         /* NFSMNT_READAHEAD).  0 disables read-ahead */
+  uint8_t         writebehind;           /* Uncommitted WRITEs per file (with */
+                                         /* NFSMNT_WRITEBEHIND).  0: synchronous writes */
   char            *path;                 /* Server's path of the directory being mount */
   struct sockaddr addr;                  /* File server address (requires 32-bit alignment) */
 };
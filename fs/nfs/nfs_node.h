@@ -65,11 +65,96 @@ extern "C" {
 
 #define NFSNODE_OPEN           (1 << 0) /* File is still open */
 #define NFSNODE_MODIFIED       (1 << 1) /* Might have a modified buffer */
+#define NFSNODE_ATTRVALID      (1 << 2) /* Cached attributes may be used */
+
+/* States of a read-ahead slot */
+
+#define NFSRA_EMPTY            0        /* Not in the window */
+#define NFSRA_PENDING          1        /* READ sent, waiting for the reply */
+#define NFSRA_READY            2        /* Reply received */
+
+/* States of a write-behind buffer */
+
+#define NFSWB_FREE             0        /* Holds no data */
+#define NFSWB_PENDING          1        /* WRITE sent, waiting for the reply */
+#define NFSWB_UNSTABLE         2        /* Written, but not committed yet */
+#define NFSWB_COMMITTING       3        /* Covered by the COMMIT in flight */
 
 /****************************************************************************
  * Public Types
  ****************************************************************************/
 
+/* A read-ahead slot stages the reply to one READ of the window */
+
+struct nfs_raslot_s
+{
+  uint8_t            rs_state;      /* See NFSRA_* */
+  bool               rs_eof;        /* The server reported the end of file */
+  uint32_t           rs_xid;        /* xid of the READ call */
+  int                rs_error;      /* NFS error of the reply, if any */
+  uint32_t           rs_count;      /* Number of bytes received */
+  uint64_t           rs_offset;     /* File offset of the data */
+  void              *rs_reply;      /* struct rpc_reply_read, ra_buflen bytes */
+};
+
+/* The read-ahead window of a file being read sequentially.  The slots form
+ * a ring; ra_count slots from ra_head hold consecutive blocks of ra_bsize
+ * bytes, starting with the block that contains ra_next.
+ */
+
+struct nfs_readahead_s
+{
+  uint64_t           ra_next;       /* Offset where the next read continues */
+  uint64_t           ra_end;        /* Offset after the last block requested */
+  uint32_t           ra_bsize;      /* Bytes requested by each READ */
+  uint32_t           ra_buflen;     /* Size of a reply buffer */
+  uint8_t            ra_nslots;     /* Window size */
+  uint8_t            ra_head;       /* Slot holding the block at ra_next */
+  uint8_t            ra_count;      /* Slots in the window */
+  void              *ra_spare;      /* Buffer that receives the next reply */
+  struct nfs_raslot_s ra_slots[1];  /* Actual size is ra_nslots */
+};
+
+#define SIZEOF_nfs_readahead_s(n) \
+  (sizeof(struct nfs_readahead_s) + ((n) - 1) * sizeof(struct nfs_raslot_s))
+
+/* A write-behind buffer holds the WRITE call for one range of the file.
+ * The data stays there until a COMMIT made it stable on the server, so that
+ * it can be sent again if the server restarts before.
+ */
+
+struct nfs_wbbuf_s
+{
+  uint8_t            wb_state;      /* See NFSWB_* */
+  uint32_t           wb_xid;        /* xid of the WRITE call */
+  uint32_t           wb_count;      /* Number of bytes */
+  uint64_t           wb_offset;     /* File offset of the data */
+  size_t             wb_reqlen;     /* Length of the call after the RPC header */
+  void              *wb_call;       /* struct rpc_call_write, wb_buflen bytes */
+};
+
+/* The write-behind state of a file.  The buffers that are not free are the
+ * dirty ranges of the file; all uncommitted ones were written with the
+ * write verifier in wb_verf.
+ */
+
+struct nfs_writebehind_s
+{
+  uint32_t           wb_bsize;      /* Max bytes of data per WRITE */
+  uint32_t           wb_buflen;     /* Size of a call buffer */
+  uint32_t           wb_commitxid;  /* xid of the COMMIT in flight, 0 if none */
+  int                wb_error;      /* Error to report with the next write,
+                                     * fsync or close */
+  bool               wb_verfvalid;  /* wb_verf was returned by the server */
+  uint8_t            wb_verf[NFSX_V3WRITEVERF];
+  uint8_t            wb_nbufs;      /* Number of buffers */
+  void              *wb_reply;      /* Receives WRITE and COMMIT replies */
+  struct nfs_wbbuf_s wb_bufs[1];    /* Actual size is wb_nbufs */
+};
+
+#define SIZEOF_nfs_writebehind_s(n) \
+  (sizeof(struct nfs_writebehind_s) + ((n) - 1) * sizeof(struct nfs_wbbuf_s))
+
 /* There is a unique nfsnode allocated for each active file.  An nfsnode is
  * 'named' by its file handle.
  */
@@ -89,8 +174,14 @@ struct nfsnode
   nfsfh_t            n_fhandle;     /* NFS File Handle */
   nfsfh_t            n_pfhandle;    /* NFS File Handle of parent */
   uint64_t           n_size;        /* Current size of file */
+  uint64_t           n_attrstamp;   /* Tick count when the attributes were fetched */
+  uint32_t           n_attrtimeo;   /* Attribute cache timeout in ticks */
+  uint32_t           n_attrgen;     /* Bumped on each change of the cached attributes */
   int                n_oflags;      /* Flags provided when file was opened */
   loff_t             n_fpos;        /* NFS File position */
+  loff_t             n_rapos;       /* Where a sequential read would continue */
+  struct nfs_readahead_s *n_ra;     /* Read-ahead window, if any */
+  struct nfs_writebehind_s *n_wb;   /* Write-behind buffers, if any */
   struct file       *n_filep;       /* File pointer from VFS */
   char              *n_name;
 };
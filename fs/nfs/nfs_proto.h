@@ -355,6 +355,7 @@ struct entry3
   uint32_t        name_len;
   uint8_t         *contents;
   uint32_t        cookie[2];
+  uint32_t        type;           /* File type from READDIRPLUS (NFNON: unknown) */
   struct entry3   *next;
 };
 
@@ -540,6 +541,19 @@ struct WRITE3resok
   uint8_t            verf[NFSX_V3WRITEVERF];
 };
 
+struct COMMIT3args
+{
+  struct file_handle fhandle;            /* Variable length */
+  nfsuint64          offset;
+  uint32_t           count;              /* 0: to the end of the file */
+};
+
+struct COMMIT3resok
+{
+  struct wcc_data    file_wcc;
+  uint8_t            verf[NFSX_V3WRITEVERF];
+};
+
 struct REMOVE3args
 {
   struct diropargs3  object;
@@ -624,6 +638,24 @@ struct READDIR3resok
    (sizeof(uint32_t) + sizeof(struct nfs_fattr) + \
     NFSX_V3COOKIEVERF + sizeof(uint32_t) + (n))
 
+/* READDIRPLUS takes a second count for the size of the whole reply.  The
+ * reply has the READDIR3resok layout, but each entry is followed by:
+ *
+ *  Attributes follow indication (4 bytes)
+ *  File attributes (sizeof(struct nfs_fattr), if they follow)
+ *  Handle follows indication (4 bytes)
+ *  Handle length (4 bytes) and handle (multiple of 4 bytes, if it follows)
+ */
+
+struct READDIRPLUS3args
+{
+  struct file_handle dir;                           /* Variable length */
+  nfsuint64          cookie;
+  uint8_t            cookieverf[NFSX_V3COOKIEVERF];
+  uint32_t           dircount;
+  uint32_t           maxcount;
+};
+
 struct FS3args
 {
   struct file_handle fsroot;
@@ -0,0 +1,590 @@
+/****************************************************************************
+ * fs/nfs/nfs_readahead.c
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <sys/types.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include "vfs_config.h"
+#include "dirent.h"
+#include "rpc.h"
+#include "nfs.h"
+#include "nfs_node.h"
+#include "xdr_subs.h"
+#include "user_copy.h"
+#undef  OK
+#define OK 0
+
+/* A file that is read sequentially keeps up to nm_readahead READ calls in
+ * flight, one per slot of its window, instead of waiting for each reply
+ * before sending the next call.  The replies are matched to their slots by
+ * xid and stay staged there until the file is read on.
+ *
+ * Only one file of a mount has calls in flight at a time (nm_rahead), as
+ * whatever rpcclnt_getreply() returns is taken for a reply to it.  Other
+ * threads may wait for their own RPCs meanwhile; their replies are handed
+ * to them by xid.  nfs_request() collects the outstanding replies first with
+ * nfs_readahead_drain().
+ */
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: nfs_readahead_empty
+ *
+ * Description:
+ *   Drop all slots of the window.  The caller makes sure that no reply to
+ *   them can be mistaken for the reply to another call.
+ *
+ ****************************************************************************/
+
+static void nfs_readahead_empty(struct nfs_readahead_s *ra)
+{
+  int i;
+
+  for (i = 0; i < ra->ra_nslots; i++)
+    {
+      ra->ra_slots[i].rs_state = NFSRA_EMPTY;
+    }
+
+  ra->ra_head  = 0;
+  ra->ra_count = 0;
+}
+
+/****************************************************************************
+ * Name: nfs_readahead_send
+ *
+ * Description:
+ *   Send the READ call of a slot, or send it again with the same xid.  The
+ *   call is built on the stack: nm_msgbuffer may hold the call of the
+ *   request that waits for nfs_readahead_drain().
+ *
+ * Returned Value:
+ *   0 on success; a positive errno value on failure.
+ *
+ ****************************************************************************/
+
+static int nfs_readahead_send(struct nfsmount *nmp, struct nfsnode *np,
+                              struct nfs_raslot_s *slot, uint32_t bsize)
+{
+  struct rpc_call_read call;
+  uint32_t *ptr;
+  size_t    reqlen;
+
+  ptr     = (uint32_t *)&call.read;
+  reqlen  = 0;
+
+  /* Copy the variable length, file handle */
+
+  *ptr++  = txdr_unsigned((uint32_t)np->n_fhsize);
+  reqlen += sizeof(uint32_t);
+
+  (void)memcpy_s(ptr, np->n_fhsize, &np->n_fhandle, np->n_fhsize);
+  reqlen += (int)np->n_fhsize;
+  ptr    += uint32_increment((int)np->n_fhsize);
+
+  /* Copy the file offset and the read size */
+
+  txdr_hyper(slot->rs_offset, ptr);
+  ptr    += 2;
+  reqlen += 2 * sizeof(uint32_t);
+
+  *ptr    = txdr_unsigned(bsize);
+  reqlen += sizeof(uint32_t);
+
+  nfs_statistics(NFSPROC_READ);
+  return rpcclnt_sendcall(nmp->nm_rpcclnt, NFSPROC_READ, NFS_PROG, NFS_VER3,
+                          (void *)&call, reqlen, &slot->rs_xid);
+}
+
+/****************************************************************************
+ * Name: nfs_readahead_receive
+ *
+ * Description:
+ *   Receive one reply and stage it in the slot of its READ.  Replies that
+ *   match no pending slot (late duplicates) are dropped.  For UDP, the
+ *   pending READs are sent again when no reply arrives in time.
+ *
+ * Returned Value:
+ *   0 on success; a positive errno value if the connection failed.  Errors
+ *   of a single READ are left in its slot.
+ *
+ ****************************************************************************/
+
+static int nfs_readahead_receive(struct nfsmount *nmp, struct nfsnode *np,
+                                 int *retries)
+{
+  struct nfs_readahead_s *ra = np->n_ra;
+  struct nfs_raslot_s    *slot = NULL;
+  struct rpc_reply_read  *reply;
+  void                   *tmp;
+  uint32_t                xid = 0;
+  int                     error;
+  int                     i;
+
+  if (nmp->nm_rpcclnt->rc_so == -1)
+    {
+      /* The connection was closed, no more replies will come */
+
+      return ENOTCONN;
+    }
+
+  error = rpcclnt_getreply(nmp->nm_rpcclnt, ra->ra_spare, ra->ra_buflen, &xid);
+
+#if (NFS_PROTO_TYPE == NFS_IPPROTO_UDP)
+  if (error == EAGAIN)
+    {
+      /* The calls or their replies may have been lost */
+
+      if (++(*retries) > nmp->nm_retry)
+        {
+          return error;
+        }
+
+      for (i = 0; i < ra->ra_nslots; i++)
+        {
+          if (ra->ra_slots[i].rs_state == NFSRA_PENDING)
+            {
+              error = nfs_readahead_send(nmp, np, &ra->ra_slots[i], ra->ra_bsize);
+              if (error != OK)
+                {
+                  return error;
+                }
+            }
+        }
+
+      return OK;
+    }
+#endif
+
+  if (xid == 0)
+    {
+      /* Nothing was received */
+
+      return error;
+    }
+
+  for (i = 0; i < ra->ra_nslots; i++)
+    {
+      if (ra->ra_slots[i].rs_state == NFSRA_PENDING && ra->ra_slots[i].rs_xid == xid)
+        {
+          slot = &ra->ra_slots[i];
+          break;
+        }
+    }
+
+  if (slot == NULL)
+    {
+      return OK;
+    }
+
+  /* Take over the buffer, the old one of the slot receives the next reply */
+
+  tmp            = slot->rs_reply;
+  slot->rs_reply = ra->ra_spare;
+  ra->ra_spare   = tmp;
+
+  reply = (struct rpc_reply_read *)slot->rs_reply;
+  if (error == OK && reply->status != 0)
+    {
+      error = fxdr_unsigned(uint32_t, reply->status);
+    }
+
+  if (error == OK)
+    {
+      slot->rs_count = fxdr_unsigned(uint32_t, reply->read.hdr.count);
+      slot->rs_eof   = (reply->read.hdr.eof != 0);
+      if (slot->rs_count > ra->ra_bsize)
+        {
+          error = EIO;
+        }
+    }
+
+  slot->rs_error = error;
+  slot->rs_state = NFSRA_READY;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: nfs_readahead_wait
+ *
+ * Description:
+ *   Receive replies until the one for 'slot' is in.
+ *
+ ****************************************************************************/
+
+static int nfs_readahead_wait(struct nfsmount *nmp, struct nfsnode *np,
+                              struct nfs_raslot_s *slot)
+{
+  int retries = 0;
+  int error = OK;
+
+  while (slot->rs_state == NFSRA_PENDING && error == OK)
+    {
+      error = nfs_readahead_receive(nmp, np, &retries);
+    }
+
+  return error;
+}
+
+/****************************************************************************
+ * Name: nfs_readahead_fill
+ *
+ * Description:
+ *   Send READs for the free slots of the window, up to the end of the file.
+ *
+ ****************************************************************************/
+
+static int nfs_readahead_fill(struct nfsmount *nmp, struct nfsnode *np)
+{
+  struct nfs_readahead_s *ra = np->n_ra;
+  struct nfs_raslot_s    *slot;
+  int                     error;
+
+  while (ra->ra_count < ra->ra_nslots && ra->ra_end < np->n_size)
+    {
+      slot = &ra->ra_slots[(ra->ra_head + ra->ra_count) % ra->ra_nslots];
+      if (slot->rs_reply == NULL)
+        {
+          /* The reply buffers are allocated as the window grows, so small
+           * files never pay for the whole window.
+           */
+
+          slot->rs_reply = malloc(ra->ra_buflen);
+          if (slot->rs_reply == NULL)
+            {
+              break;
+            }
+        }
+
+      slot->rs_offset = ra->ra_end;
+      slot->rs_xid    = 0;
+      slot->rs_error  = OK;
+      slot->rs_count  = 0;
+      slot->rs_eof    = false;
+
+      error = nfs_readahead_send(nmp, np, slot, ra->ra_bsize);
+      if (error != OK)
+        {
+          return error;
+        }
+
+      slot->rs_state  = NFSRA_PENDING;
+      nmp->nm_rahead  = np;
+      ra->ra_end     += ra->ra_bsize;
+      ra->ra_count++;
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: nfs_readahead_setup
+ *
+ * Description:
+ *   Give a file a read-ahead window, unless it has one already.
+ *
+ * Returned Value:
+ *   0 on success; ENOSYS if read-ahead is disabled on the mount, ENOMEM if
+ *   the window could not be allocated.
+ *
+ ****************************************************************************/
+
+int nfs_readahead_setup(struct nfsmount *nmp, struct nfsnode *np)
+{
+  struct nfs_readahead_s *ra;
+  uint32_t bsize;
+  size_t   size;
+  size_t   tmp;
+
+  if (np->n_ra != NULL)
+    {
+      return OK;
+    }
+
+  if (nmp->nm_readahead == 0)
+    {
+      return ENOSYS;
+    }
+
+  /* Make sure that a reply fits into the same size of buffer that the
+   * synchronous reads use.
+   */
+
+  bsize = nmp->nm_rsize;
+  tmp   = SIZEOF_rpc_reply_read(bsize);
+  if (tmp > nmp->nm_buflen)
+    {
+      bsize -= (tmp - nmp->nm_buflen);
+    }
+
+  size = SIZEOF_nfs_readahead_s(nmp->nm_readahead);
+  ra   = (struct nfs_readahead_s *)malloc(size);
+  if (ra == NULL)
+    {
+      return ENOMEM;
+    }
+
+  (void)memset_s(ra, size, 0, size);
+  ra->ra_bsize  = bsize;
+  ra->ra_buflen = SIZEOF_rpc_reply_read(bsize);
+  ra->ra_nslots = nmp->nm_readahead;
+  ra->ra_spare  = malloc(ra->ra_buflen);
+  if (ra->ra_spare == NULL)
+    {
+      free(ra);
+      return ENOMEM;
+    }
+
+  np->n_ra = ra;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: nfs_readahead_read
+ *
+ * Description:
+ *   Read 'buflen' bytes at 'pos' through the read-ahead window of the file,
+ *   which must have been set up with nfs_readahead_setup().  A read that
+ *   does not continue where the last one stopped starts a new window.
+ *   Before returning, READs are sent for the blocks that follow, so that
+ *   they arrive while the caller processes the data.
+ *
+ * Returned Value:
+ *   0 on success, with the number of bytes read in 'nread' (short at the
+ *   end of the file); a positive errno value on failure.
+ *
+ ****************************************************************************/
+
+int nfs_readahead_read(struct nfsmount *nmp, struct nfsnode *np,
+                       char *buffer, size_t buflen, loff_t pos, size_t *nread)
+{
+  struct nfs_readahead_s *ra = np->n_ra;
+  struct nfs_raslot_s    *slot;
+  struct rpc_reply_read  *reply;
+  size_t                  copied = 0;
+  size_t                  offset;
+  size_t                  nbytes;
+  int                     error = OK;
+
+  /* Only one file of the mount may have calls in flight */
+
+  nfs_writebehind_drain(nmp);
+  if (nmp->nm_rahead != NULL && nmp->nm_rahead != np)
+    {
+      nfs_readahead_drain(nmp);
+    }
+
+  if (ra->ra_count == 0 || (uint64_t)pos != ra->ra_next)
+    {
+      nfs_readahead_reset(nmp, np);
+      ra->ra_next = (uint64_t)pos;
+      ra->ra_end  = (uint64_t)pos;
+    }
+
+  while (copied < buflen)
+    {
+      error = nfs_readahead_fill(nmp, np);
+      if (error != OK)
+        {
+          break;
+        }
+
+      if (ra->ra_count == 0)
+        {
+          error = ENOMEM;
+          break;
+        }
+
+      slot  = &ra->ra_slots[ra->ra_head];
+      error = nfs_readahead_wait(nmp, np, slot);
+      if (error == OK)
+        {
+          error = slot->rs_error;
+        }
+
+      if (error != OK)
+        {
+          break;
+        }
+
+      offset = ra->ra_next - slot->rs_offset;
+      if (offset >= slot->rs_count)
+        {
+          /* The file ended before the block did */
+
+          nfs_readahead_reset(nmp, np);
+          break;
+        }
+
+      nbytes = slot->rs_count - offset;
+      if (nbytes > buflen - copied)
+        {
+          nbytes = buflen - copied;
+        }
+
+      reply = (struct rpc_reply_read *)slot->rs_reply;
+      if (LOS_CopyFromKernel(buffer + copied, buflen - copied,
+                             (const void *)(reply->read.data + offset), nbytes) != 0)
+        {
+          error = EFAULT;
+          break;
+        }
+
+      copied      += nbytes;
+      ra->ra_next += nbytes;
+
+      if (offset + nbytes == slot->rs_count)
+        {
+          if (slot->rs_eof || slot->rs_count < ra->ra_bsize)
+            {
+              /* A short block: the blocks behind it do not continue it */
+
+              nfs_readahead_reset(nmp, np);
+              break;
+            }
+
+          /* The block is used up, its slot can take the next READ */
+
+          slot->rs_state = NFSRA_EMPTY;
+          ra->ra_head    = (ra->ra_head + 1) % ra->ra_nslots;
+          ra->ra_count--;
+        }
+    }
+
+  if (error != OK)
+    {
+      nfs_debug_error("nfs_readahead_read failed: %d\n", error);
+      nfs_readahead_reset(nmp, np);
+      if (copied == 0)
+        {
+          return error;
+        }
+    }
+  else if (nfs_readahead_fill(nmp, np) != OK)
+    {
+      nfs_readahead_reset(nmp, np);
+    }
+
+  *nread = copied;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: nfs_readahead_drain
+ *
+ * Description:
+ *   Collect the replies to all READs still in flight on the mount.  The
+ *   data stays staged in the window.  Called before any other RPC of the
+ *   mount, so that the window of another file can be filled later.
+ *
+ ****************************************************************************/
+
+void nfs_readahead_drain(struct nfsmount *nmp)
+{
+  struct nfsnode *np = nmp->nm_rahead;
+  struct nfs_readahead_s *ra;
+  int error = OK;
+  int i;
+
+  if (np == NULL)
+    {
+      return;
+    }
+
+  ra = np->n_ra;
+  for (i = 0; i < ra->ra_nslots && error == OK; i++)
+    {
+      error = nfs_readahead_wait(nmp, np, &ra->ra_slots[i]);
+    }
+
+  /* Without the connection, the replies that are missing will not come */
+
+  if (error != OK)
+    {
+      nfs_readahead_empty(ra);
+    }
+
+  nmp->nm_rahead = NULL;
+}
+
+/****************************************************************************
+ * Name: nfs_readahead_reset
+ *
+ * Description:
+ *   Drop the data staged for a file, after it changed or when its reader
+ *   moved elsewhere.
+ *
+ ****************************************************************************/
+
+void nfs_readahead_reset(struct nfsmount *nmp, struct nfsnode *np)
+{
+  if (nmp->nm_rahead == np)
+    {
+      nfs_readahead_drain(nmp);
+    }
+
+  if (np->n_ra != NULL)
+    {
+      nfs_readahead_empty(np->n_ra);
+    }
+}
+
+/****************************************************************************
+ * Name: nfs_readahead_free
+ *
+ * Description:
+ *   Release the read-ahead window of a file.
+ *
+ ****************************************************************************/
+
+void nfs_readahead_free(struct nfsmount *nmp, struct nfsnode *np)
+{
+  struct nfs_readahead_s *ra = np->n_ra;
+  int i;
+
+  if (ra == NULL)
+    {
+      return;
+    }
+
+  nfs_readahead_reset(nmp, np);
+  for (i = 0; i < ra->ra_nslots; i++)
+    {
+      free(ra->ra_slots[i].rs_reply);
+    }
+
+  free(ra->ra_spare);
+  free(ra);
+  np->n_ra = NULL;
+}
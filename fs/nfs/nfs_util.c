@@ -37,6 +37,7 @@
 #include "nfs_node.h"
 #include "xdr_subs.h"
 #include "nfs.h"
+#include "los_sys.h"
 #undef  OK
 #define OK 0
 
@@ -107,6 +108,7 @@ static inline int nfs_pathsegment(const char **path, char *buffer,
 void nfs_mux_take(struct nfsmount *nmp)
 {
   (void)pthread_mutex_lock(&nmp->nm_mux);
+  nmp->nm_muxdepth++;
 }
 
 /****************************************************************************
@@ -115,6 +117,7 @@ void nfs_mux_take(struct nfsmount *nmp)
 
 void nfs_mux_release(struct nfsmount *nmp)
 {
+  nmp->nm_muxdepth--;
   (void)pthread_mutex_unlock(&nmp->nm_mux);
 }
 
@@ -151,6 +154,64 @@ int nfs_checkmount(struct nfsmount *nmp)
   return 0;
 }
 
+/****************************************************************************
+ * Name: nfs_private
+ *
+ * Description:
+ *   Tell whether 'buf' lies outside the mount structure, so that other
+ *   threads do not use it.
+ *
+ ****************************************************************************/
+
+static bool nfs_private(struct nfsmount *nmp, const void *buf)
+{
+  const char *start = (const char *)nmp;
+
+  return (const char *)buf < start ||
+         (const char *)buf >= start + SIZEOF_nfsmount(nmp->nm_buflen);
+}
+
+/****************************************************************************
+ * Name: nfs_rpcrequest
+ *
+ * Description:
+ *   Perform the RPC of nfs_request().  A request whose call and reply are
+ *   not kept in the mount structure does not need nm_mux while it waits for
+ *   the reply, so other threads may send their requests meanwhile.  That is
+ *   only done when nm_mux is not taken more than once, so that no caller
+ *   further up loses it unexpectedly.  Such requests are counted in
+ *   nm_nrpcs, as their threads take nm_mux again afterwards and the mount
+ *   must not go away meanwhile.
+ *
+ ****************************************************************************/
+
+static int nfs_rpcrequest(struct nfsmount *nmp, int procnum,
+                          void *request, size_t reqlen,
+                          void *response, size_t resplen)
+{
+  bool unlock;
+  int  error;
+
+  unlock = nmp->nm_muxdepth == 1 && nfs_private(nmp, request) &&
+           nfs_private(nmp, response);
+  if (unlock)
+    {
+      nmp->nm_nrpcs++;
+      nfs_mux_release(nmp);
+    }
+
+  error = rpcclnt_request(nmp->nm_rpcclnt, procnum, NFS_PROG, NFS_VER3,
+                          request, reqlen, response, resplen);
+
+  if (unlock)
+    {
+      nfs_mux_take(nmp);
+      nmp->nm_nrpcs--;
+    }
+
+  return error;
+}
+
 /****************************************************************************
  * Name: nfs_request
  *
@@ -167,13 +228,20 @@ int nfs_request(struct nfsmount *nmp, int procnum,
                 void *request, size_t reqlen,
                 void *response, size_t resplen)
 {
-  struct rpcclnt *clnt = nmp->nm_rpcclnt;
   struct nfs_reply_header replyh;
   int error;
 
+  /* The read-ahead and write-behind engines of a file take whatever
+   * rpcclnt_getreply() returns as theirs, and the server should have all
+   * data written before it is asked anything else; collect their replies
+   * first.
+   */
+
+  nfs_readahead_drain(nmp);
+  nfs_writebehind_drain(nmp);
+
 tryagain:
-  error = rpcclnt_request(clnt, procnum, NFS_PROG, NFS_VER3,
-                          request, reqlen, response, resplen);
+  error = nfs_rpcrequest(nmp, procnum, request, reqlen, response, resplen);
   if (error != 0)
     {
       nfs_error("rpcclnt_request failed: %d\n", error);
@@ -194,8 +262,7 @@ tryagain:
 
       /* Send the request again */
 
-      error = rpcclnt_request(clnt, procnum, NFS_PROG, NFS_VER3,
-                              request, reqlen, response, resplen);
+      error = nfs_rpcrequest(nmp, procnum, request, reqlen, response, resplen);
       
       if (error != 0)
         {
@@ -250,6 +317,8 @@ int nfs_lookup(struct nfsmount *nmp, const char *filename,
                struct nfs_fattr *obj_attributes,
                struct nfs_fattr *dir_attributes)
 {
+  struct rpc_call_lookup  request;
+  struct rpc_reply_lookup response;
   uint32_t *ptr = NULL;
   uint32_t value;
   int reqlen;
@@ -267,9 +336,11 @@ int nfs_lookup(struct nfsmount *nmp, const char *filename,
       return E2BIG;
     }
 
-  /* Initialize the request */
+  /* Initialize the request.  The call and the reply are kept on the stack,
+   * so that other threads can use the mount while the server is asked.
+   */
 
-  ptr     = (uint32_t *)&nmp->nm_msgbuffer.lookup.lookup;
+  ptr     = (uint32_t *)&request.lookup;
   reqlen  = 0;
 
   /* Copy the variable length, directory file handle */
@@ -293,8 +364,8 @@ int nfs_lookup(struct nfsmount *nmp, const char *filename,
 
   nfs_statistics(NFSPROC_LOOKUP);
   error = nfs_request(nmp, NFSPROC_LOOKUP,
-                      (void *)&nmp->nm_msgbuffer.lookup, reqlen,
-                      (void *)nmp->nm_iobuffer, nmp->nm_buflen);
+                      (void *)&request, reqlen,
+                      (void *)&response, sizeof(struct rpc_reply_lookup));
 
   if (error)
     {
@@ -307,7 +378,7 @@ int nfs_lookup(struct nfsmount *nmp, const char *filename,
    * may differ in size whereas struct rpc_reply_lookup uses a fixed size.
    */
 
-  ptr = (uint32_t *)&((struct rpc_reply_lookup *)nmp->nm_iobuffer)->lookup;
+  ptr = (uint32_t *)&response.lookup;
 
   /* Get the length of the file handle */
 
@@ -556,7 +627,9 @@ int nfs_finddir(struct nfsmount *nmp, const char *relpath,
  * Name: nfs_attrupdate
  *
  * Description:
- *   Update file attributes on write or after the file is modified.
+ *   Update file attributes on write or after the file is modified.  The
+ *   attributes were just received from the server, so they also restart
+ *   the attribute cache timeout.
  *
  * Returned Value:
  *   None.
@@ -567,6 +640,10 @@ void nfs_attrupdate(struct nfsnode *np, struct nfs_fattr *attributes)
 {
   struct timespec ts;
 
+  np->n_attrstamp = LOS_TickCountGet();
+  np->n_flags    |= NFSNODE_ATTRVALID;
+  np->n_attrgen++;
+
   /* Save a few of the files attribute values in file structure (host order) */
 
   np->n_type   = fxdr_unsigned(uint8_t, attributes->fa_type);
@@ -580,3 +657,174 @@ void nfs_attrupdate(struct nfsnode *np, struct nfs_fattr *attributes)
   fxdr_nfsv3time(&attributes->fa_ctime, &ts);
   np->n_ctime  = ts.tv_sec;
 }
+
+/****************************************************************************
+ * Name: nfs_attrchanged
+ *
+ * Description:
+ *   Tell whether attributes just received from the server show that the
+ *   file was changed there since its attributes were cached, so that its
+ *   cached data is out of date.
+ *
+ * Returned Value:
+ *   true if the modification time or the size differ.
+ *
+ ****************************************************************************/
+
+bool nfs_attrchanged(struct nfsnode *np, struct nfs_fattr *attributes)
+{
+  struct timespec ts;
+
+  fxdr_nfsv3time(&attributes->fa_mtime, &ts);
+  return ts.tv_sec != np->n_timestamp.tv_sec ||
+         ts.tv_nsec != np->n_timestamp.tv_nsec ||
+         fxdr_hyper(&attributes->fa_size) != np->n_size;
+}
+
+/****************************************************************************
+ * Name: nfs_attrrefresh
+ *
+ * Description:
+ *   Take the attributes of a file that came with the reply to another
+ *   call, such as READDIRPLUS.  If the file changed on the server, its
+ *   cached data has to be dropped, which only nfs_revalidate() does; it
+ *   finds the change by n_timestamp.  In that case the cached attributes
+ *   are therefore just marked out of date and left alone.
+ *
+ * Returned Value:
+ *   None.
+ *
+ ****************************************************************************/
+
+void nfs_attrrefresh(struct nfsnode *np, struct nfs_fattr *attributes)
+{
+  if (nfs_attrchanged(np, attributes))
+    {
+      np->n_flags &= ~NFSNODE_ATTRVALID;
+    }
+  else
+    {
+      nfs_attrupdate(np, attributes);
+    }
+}
+
+/****************************************************************************
+ * Name: nfs_sizeupdate
+ *
+ * Description:
+ *   Set the cached size of a file that was changed here, by a write or a
+ *   truncate.  Attributes that a GETATTR in flight brings back predate the
+ *   change and are dropped by nfs_getattr().
+ *
+ * Returned Value:
+ *   None.
+ *
+ ****************************************************************************/
+
+void nfs_sizeupdate(struct nfsnode *np, uint64_t size)
+{
+  np->n_size = size;
+  np->n_attrgen++;
+}
+
+/****************************************************************************
+ * Name: nfs_getattr
+ *
+ * Description:
+ *   Ask the server for the attributes of a file.  nm_mux is released while
+ *   the call waits for its reply, so the file may be written or truncated
+ *   meanwhile; the reply then does not show that change and must not
+ *   replace the cached attributes.  That is found by n_attrgen.
+ *
+ * Returned Value:
+ *   0 on success; EAGAIN if the cached attributes changed during the call,
+ *   in which case 'attributes' is not set; another positive errno value on
+ *   failure.
+ *
+ ****************************************************************************/
+
+int nfs_getattr(struct nfsmount *nmp, struct nfsnode *np,
+                struct nfs_fattr *attributes)
+{
+  struct rpc_call_fs       attr_call;
+  struct rpc_reply_getattr attr_reply;
+  uint32_t                 gen;
+  int                      error;
+
+  /* The replies that nfs_request() collects first may change the
+   * attributes too; that is not what is looked for.
+   */
+
+  nfs_readahead_drain(nmp);
+  nfs_writebehind_drain(nmp);
+  gen = np->n_attrgen;
+
+  attr_call.fs.fsroot.length = txdr_unsigned(np->n_fhsize);
+  (void)memcpy_s(&(attr_call.fs.fsroot.handle), sizeof(nfsfh_t), &(np->n_fhandle), np->n_fhsize);
+
+  nfs_statistics(NFSPROC_GETATTR);
+  error = nfs_request(nmp, NFSPROC_GETATTR, &attr_call,
+                      sizeof(uint32_t) + np->n_fhsize, &attr_reply,
+                      sizeof(struct rpc_reply_getattr));
+  if (error != OK)
+    {
+      return error;
+    }
+
+  if (np->n_attrgen != gen)
+    {
+      return EAGAIN;
+    }
+
+  (void)memcpy_s(attributes, sizeof(struct nfs_fattr), &attr_reply.attr, sizeof(struct nfs_fattr));
+  return OK;
+}
+
+/****************************************************************************
+ * Name: nfs_attrcache_valid
+ *
+ * Description:
+ *   Check whether the cached attributes of 'np' may still be used instead
+ *   of asking the server.  The timeout of a node lies between the min and
+ *   max values of the mount for its type; it grows while the file stays
+ *   unchanged (see n_attrtimeo).
+ *
+ * Returned Value:
+ *   true if the cached attributes are still fresh.
+ *
+ ****************************************************************************/
+
+bool nfs_attrcache_valid(struct nfsmount *nmp, struct nfsnode *np)
+{
+  uint32_t timeo = np->n_attrtimeo;
+  uint32_t mintimeo;
+  uint32_t maxtimeo;
+
+  if ((np->n_flags & NFSNODE_ATTRVALID) == 0)
+    {
+      return false;
+    }
+
+  if (np->n_type == NFDIR)
+    {
+      mintimeo = nmp->nm_acdirmin;
+      maxtimeo = nmp->nm_acdirmax;
+    }
+  else
+    {
+      mintimeo = nmp->nm_acregmin;
+      maxtimeo = nmp->nm_acregmax;
+    }
+
+  if (timeo < mintimeo)
+    {
+      timeo = mintimeo;
+    }
+
+  if (timeo > maxtimeo)
+    {
+      timeo = maxtimeo;
+    }
+
+  return (LOS_TickCountGet() - np->n_attrstamp) < timeo;
+}
@@ -0,0 +1,1041 @@
+/****************************************************************************
+ * fs/nfs/nfs_writebehind.c
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <sys/types.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include "vfs_config.h"
+#include "dirent.h"
+#include "rpc.h"
+#include "nfs.h"
+#include "nfs_node.h"
+#include "xdr_subs.h"
+#include "user_copy.h"
+#undef  OK
+#define OK 0
+
+/* A file that is written sends its data in UNSTABLE WRITE calls from up to
+ * nm_writebehind buffers of its own, and does not wait for the replies
+ * before write() returns.  The server may keep UNSTABLE data in memory
+ * only, so each buffer holds on to its data until a COMMIT covered it.
+ *
+ * Every WRITE and COMMIT reply carries the write verifier of the server,
+ * which changes when the server restarts and may have lost the data that
+ * was not committed.  When the verifier changes, the uncommitted buffers
+ * are written again.
+ *
+ * A COMMIT is sent in the background once half of the buffers wait for
+ * one, and finally by nfs_writebehind_flush() on fsync() and close().
+ * Errors of the WRITEs in the background are reported by the next write,
+ * fsync or close of the file.
+ *
+ * As with read-ahead, only one file of a mount has calls in flight at a
+ * time (nm_wbhead), and nfs_request() collects the outstanding replies
+ * first with nfs_writebehind_drain(), so that the server has all data
+ * before it is asked anything else.
+ */
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Size of the buffer that receives the replies */
+
+#define NFS_WBREPLYSIZE \
+  ((sizeof(struct rpc_reply_write) > sizeof(struct rpc_reply_commit)) ? \
+    sizeof(struct rpc_reply_write) : sizeof(struct rpc_reply_commit))
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: nfs_writebehind_seterror
+ *
+ * Description:
+ *   Remember the first error of the calls in the background.
+ *
+ ****************************************************************************/
+
+static void nfs_writebehind_seterror(struct nfs_writebehind_s *wb, int error)
+{
+  if (wb->wb_error == OK)
+    {
+      wb->wb_error = error;
+    }
+}
+
+/****************************************************************************
+ * Name: nfs_writebehind_count
+ *
+ * Description:
+ *   Return the number of buffers in the given state.
+ *
+ ****************************************************************************/
+
+static int nfs_writebehind_count(struct nfs_writebehind_s *wb, uint8_t state)
+{
+  int count = 0;
+  int i;
+
+  for (i = 0; i < wb->wb_nbufs; i++)
+    {
+      if (wb->wb_bufs[i].wb_state == state)
+        {
+          count++;
+        }
+    }
+
+  return count;
+}
+
+/****************************************************************************
+ * Name: nfs_writebehind_inflight
+ *
+ * Description:
+ *   Return true if replies to WRITE or COMMIT calls are outstanding.
+ *
+ ****************************************************************************/
+
+static bool nfs_writebehind_inflight(struct nfs_writebehind_s *wb)
+{
+  return wb->wb_commitxid != 0 ||
+         nfs_writebehind_count(wb, NFSWB_PENDING) > 0;
+}
+
+/****************************************************************************
+ * Name: nfs_writebehind_fail
+ *
+ * Description:
+ *   Give up on all buffers after the connection to the server failed.
+ *
+ ****************************************************************************/
+
+static void nfs_writebehind_fail(struct nfs_writebehind_s *wb, int error)
+{
+  int i;
+
+  for (i = 0; i < wb->wb_nbufs; i++)
+    {
+      wb->wb_bufs[i].wb_state = NFSWB_FREE;
+    }
+
+  wb->wb_commitxid  = 0;
+  wb->wb_verfvalid  = false;
+  nfs_writebehind_seterror(wb, error);
+}
+
+/****************************************************************************
+ * Name: nfs_writebehind_build
+ *
+ * Description:
+ *   Build the WRITE call in a buffer for 'count' bytes at 'offset'.
+ *
+ * Returned Value:
+ *   A pointer to where the data belongs in the call.
+ *
+ ****************************************************************************/
+
+static uint8_t *nfs_writebehind_build(struct nfsnode *np,
+                                      struct nfs_wbbuf_s *buf,
+                                      uint64_t offset, uint32_t count)
+{
+  uint32_t *ptr;
+  size_t    reqlen;
+
+  ptr     = (uint32_t *)&((struct rpc_call_write *)buf->wb_call)->write;
+  reqlen  = 0;
+
+  /* Copy the variable length, file handle */
+
+  *ptr++  = txdr_unsigned((uint32_t)np->n_fhsize);
+  reqlen += sizeof(uint32_t);
+
+  (void)memcpy_s(ptr, np->n_fhsize, &np->n_fhandle, np->n_fhsize);
+  reqlen += (int)np->n_fhsize;
+  ptr    += uint32_increment((int)np->n_fhsize);
+
+  /* Copy the file offset */
+
+  txdr_hyper(offset, ptr);
+  ptr    += 2;
+  reqlen += 2 * sizeof(uint32_t);
+
+  /* Copy the count and stable values, then the length of the data */
+
+  *ptr++  = txdr_unsigned(count);
+  *ptr++  = txdr_unsigned(NFSV3WRITE_UNSTABLE);
+  *ptr++  = txdr_unsigned(count);
+  reqlen += 3 * sizeof(uint32_t);
+
+  buf->wb_offset = offset;
+  buf->wb_count  = count;
+  buf->wb_reqlen = reqlen + uint32_alignup(count);
+  return (uint8_t *)ptr;
+}
+
+/****************************************************************************
+ * Name: nfs_writebehind_setstable
+ *
+ * Description:
+ *   Change the stable value of the WRITE call in a buffer.
+ *
+ ****************************************************************************/
+
+static void nfs_writebehind_setstable(struct nfs_wbbuf_s *buf, uint32_t stable)
+{
+  uint32_t *ptr;
+  uint32_t  fhsize;
+
+  ptr    = (uint32_t *)&((struct rpc_call_write *)buf->wb_call)->write;
+  fhsize = fxdr_unsigned(uint32_t, *ptr);
+
+  /* Skip the file handle, the offset and the count */
+
+  ptr   += 1 + uint32_increment(fhsize) + 2 + 1;
+  *ptr   = txdr_unsigned(stable);
+}
+
+/****************************************************************************
+ * Name: nfs_writebehind_send
+ *
+ * Description:
+ *   Send the WRITE call of a buffer.  A zero wb_xid gives the call a new
+ *   xid; otherwise it is a retransmission.
+ *
+ *   A call that could not be sent is treated as a call whose reply got
+ *   lost: it is sent again when no reply comes.
+ *
+ ****************************************************************************/
+
+static void nfs_writebehind_send(struct nfsmount *nmp, struct nfsnode *np,
+                                 struct nfs_wbbuf_s *buf)
+{
+  nfs_statistics(NFSPROC_WRITE);
+  (void)rpcclnt_sendcall(nmp->nm_rpcclnt, NFSPROC_WRITE, NFS_PROG, NFS_VER3,
+                         buf->wb_call, buf->wb_reqlen, &buf->wb_xid);
+
+  buf->wb_state  = NFSWB_PENDING;
+  nmp->nm_wbhead = np;
+}
+
+/****************************************************************************
+ * Name: nfs_writebehind_rewrite
+ *
+ * Description:
+ *   Write all buffers in the given state again, with new xids.  A reply
+ *   cached by the server for the old xid would not tell whether the data
+ *   is there now.
+ *
+ ****************************************************************************/
+
+static void nfs_writebehind_rewrite(struct nfsmount *nmp, struct nfsnode *np,
+                                    uint8_t state)
+{
+  struct nfs_writebehind_s *wb = np->n_wb;
+  int i;
+
+  for (i = 0; i < wb->wb_nbufs; i++)
+    {
+      if (wb->wb_bufs[i].wb_state == state)
+        {
+          wb->wb_bufs[i].wb_xid = 0;
+          nfs_writebehind_send(nmp, np, &wb->wb_bufs[i]);
+        }
+    }
+}
+
+/****************************************************************************
+ * Name: nfs_writebehind_sendcommit
+ *
+ * Description:
+ *   Send the COMMIT for the range covered by the committing buffers.  The
+ *   call is built on the stack: nm_msgbuffer may hold the call of the
+ *   request that waits for nfs_writebehind_drain().
+ *
+ ****************************************************************************/
+
+static void nfs_writebehind_sendcommit(struct nfsmount *nmp,
+                                       struct nfsnode *np)
+{
+  struct nfs_writebehind_s *wb = np->n_wb;
+  struct nfs_wbbuf_s       *buf;
+  struct rpc_call_commit    call;
+  uint64_t                  start = UINT64_MAX;
+  uint64_t                  end = 0;
+  uint32_t                 *ptr;
+  size_t                    reqlen;
+  int                       i;
+
+  for (i = 0; i < wb->wb_nbufs; i++)
+    {
+      buf = &wb->wb_bufs[i];
+      if (buf->wb_state == NFSWB_COMMITTING)
+        {
+          if (buf->wb_offset < start)
+            {
+              start = buf->wb_offset;
+            }
+
+          if (buf->wb_offset + buf->wb_count > end)
+            {
+              end = buf->wb_offset + buf->wb_count;
+            }
+        }
+    }
+
+  ptr     = (uint32_t *)&call.commit;
+  reqlen  = 0;
+
+  /* Copy the variable length, file handle */
+
+  *ptr++  = txdr_unsigned((uint32_t)np->n_fhsize);
+  reqlen += sizeof(uint32_t);
+
+  (void)memcpy_s(ptr, np->n_fhsize, &np->n_fhandle, np->n_fhsize);
+  reqlen += (int)np->n_fhsize;
+  ptr    += uint32_increment((int)np->n_fhsize);
+
+  /* Copy the offset and the count of the range.  A count of zero commits
+   * everything up to the end of the file.
+   */
+
+  txdr_hyper(start, ptr);
+  ptr    += 2;
+  reqlen += 2 * sizeof(uint32_t);
+
+  *ptr    = txdr_unsigned((end - start > UINT32_MAX) ? 0 : (uint32_t)(end - start));
+  reqlen += sizeof(uint32_t);
+
+  nfs_statistics(NFSPROC_COMMIT);
+  (void)rpcclnt_sendcall(nmp->nm_rpcclnt, NFSPROC_COMMIT, NFS_PROG, NFS_VER3,
+                         (void *)&call, reqlen, &wb->wb_commitxid);
+  nmp->nm_wbhead = np;
+}
+
+/****************************************************************************
+ * Name: nfs_writebehind_commit
+ *
+ * Description:
+ *   Start a COMMIT for all buffers that are written but not committed.
+ *
+ ****************************************************************************/
+
+static void nfs_writebehind_commit(struct nfsmount *nmp, struct nfsnode *np)
+{
+  struct nfs_writebehind_s *wb = np->n_wb;
+  int i;
+
+  for (i = 0; i < wb->wb_nbufs; i++)
+    {
+      if (wb->wb_bufs[i].wb_state == NFSWB_UNSTABLE)
+        {
+          wb->wb_bufs[i].wb_state = NFSWB_COMMITTING;
+        }
+    }
+
+  wb->wb_commitxid = 0;
+  nfs_writebehind_sendcommit(nmp, np);
+}
+
+/****************************************************************************
+ * Name: nfs_writebehind_checkverf
+ *
+ * Description:
+ *   Compare the write verifier of a reply with the one that the buffers
+ *   were written with.  If the server restarted in between, all data that
+ *   is not committed yet is written again.
+ *
+ ****************************************************************************/
+
+static void nfs_writebehind_checkverf(struct nfsmount *nmp, struct nfsnode *np,
+                                      const uint8_t *verf)
+{
+  struct nfs_writebehind_s *wb = np->n_wb;
+
+  if (wb->wb_verfvalid && memcmp(wb->wb_verf, verf, NFSX_V3WRITEVERF) == 0)
+    {
+      return;
+    }
+
+  if (wb->wb_verfvalid)
+    {
+      nfs_debug_info("write verifier changed, writing again\n");
+      nfs_writebehind_rewrite(nmp, np, NFSWB_UNSTABLE);
+      nfs_writebehind_rewrite(nmp, np, NFSWB_COMMITTING);
+    }
+
+  (void)memcpy_s(wb->wb_verf, NFSX_V3WRITEVERF, verf, NFSX_V3WRITEVERF);
+  wb->wb_verfvalid = true;
+}
+
+/****************************************************************************
+ * Name: nfs_writebehind_attrupdate
+ *
+ * Description:
+ *   Take the file attributes of a reply.  While other WRITEs are in
+ *   flight, the size reported by the server may still lack their data, so
+ *   the cached attributes are only marked out of date.
+ *
+ ****************************************************************************/
+
+static void nfs_writebehind_attrupdate(struct nfsnode *np,
+                                       struct nfs_fattr *attributes)
+{
+  if (attributes != NULL && nfs_writebehind_count(np->n_wb, NFSWB_PENDING) == 0)
+    {
+      nfs_attrupdate(np, attributes);
+    }
+  else
+    {
+      np->n_flags &= ~NFSNODE_ATTRVALID;
+    }
+}
+
+/****************************************************************************
+ * Name: nfs_writebehind_written
+ *
+ * Description:
+ *   Handle the reply to the WRITE call of a buffer.
+ *
+ ****************************************************************************/
+
+static void nfs_writebehind_written(struct nfsmount *nmp, struct nfsnode *np,
+                                    struct nfs_wbbuf_s *buf, int error)
+{
+  struct nfs_writebehind_s *wb = np->n_wb;
+  struct rpc_reply_write   *reply = (struct rpc_reply_write *)wb->wb_reply;
+  struct nfs_fattr         *attributes = NULL;
+  uint32_t                 *ptr;
+  uint32_t                  count;
+  uint32_t                  committed;
+
+  if (error == OK && reply->status != 0)
+    {
+      error = fxdr_unsigned(uint32_t, reply->status);
+    }
+
+  if (error != OK)
+    {
+      nfs_debug_error("WRITE failed: %d\n", error);
+      nfs_writebehind_seterror(wb, error);
+      buf->wb_state = NFSWB_FREE;
+      nfs_writebehind_attrupdate(np, NULL);
+      return;
+    }
+
+  /* Parse file_wcc.  Skip the WCC attributes, if any. */
+
+  ptr = (uint32_t *)&reply->write;
+  if (*ptr++ != 0)
+    {
+      ptr += uint32_increment(sizeof(struct wcc_attr));
+    }
+
+  /* Check if normal file attributes follow */
+
+  if (*ptr++ != 0)
+    {
+      attributes = (struct nfs_fattr *)ptr;
+      ptr += uint32_increment(sizeof(struct nfs_fattr));
+    }
+
+  count     = fxdr_unsigned(uint32_t, *ptr++);
+  committed = fxdr_unsigned(uint32_t, *ptr++);
+
+  if (count < 1 || count > buf->wb_count)
+    {
+      nfs_writebehind_seterror(wb, EIO);
+      buf->wb_state = NFSWB_FREE;
+    }
+  else if (count < buf->wb_count)
+    {
+      /* Only a part was written.  Write the whole buffer again and make it
+       * stable, so that the part already written needs no COMMIT.
+       */
+
+      nfs_writebehind_setstable(buf, NFSV3WRITE_FILESYNC);
+      buf->wb_xid = 0;
+      nfs_writebehind_send(nmp, np, buf);
+    }
+  else if (committed != NFSV3WRITE_UNSTABLE)
+    {
+      /* The server made the data stable already */
+
+      buf->wb_state = NFSWB_FREE;
+    }
+  else
+    {
+      nfs_writebehind_checkverf(nmp, np, (const uint8_t *)ptr);
+      buf->wb_state = NFSWB_UNSTABLE;
+    }
+
+  nfs_writebehind_attrupdate(np, attributes);
+}
+
+/****************************************************************************
+ * Name: nfs_writebehind_committed
+ *
+ * Description:
+ *   Handle the reply to the COMMIT call.
+ *
+ ****************************************************************************/
+
+static void nfs_writebehind_committed(struct nfsmount *nmp, struct nfsnode *np,
+                                      int error)
+{
+  struct nfs_writebehind_s *wb = np->n_wb;
+  struct rpc_reply_commit  *reply = (struct rpc_reply_commit *)wb->wb_reply;
+  struct nfs_fattr         *attributes = NULL;
+  uint32_t                 *ptr;
+  int                       i;
+
+  wb->wb_commitxid = 0;
+
+  if (error == OK && reply->status != 0)
+    {
+      error = fxdr_unsigned(uint32_t, reply->status);
+    }
+
+  if (error != OK)
+    {
+      /* It is unknown what the server kept of the data */
+
+      nfs_debug_error("COMMIT failed: %d\n", error);
+      nfs_writebehind_seterror(wb, error);
+      for (i = 0; i < wb->wb_nbufs; i++)
+        {
+          if (wb->wb_bufs[i].wb_state == NFSWB_COMMITTING)
+            {
+              wb->wb_bufs[i].wb_state = NFSWB_FREE;
+            }
+        }
+
+      return;
+    }
+
+  /* Parse file_wcc.  Skip the WCC attributes, if any. */
+
+  ptr = (uint32_t *)&reply->commit;
+  if (*ptr++ != 0)
+    {
+      ptr += uint32_increment(sizeof(struct wcc_attr));
+    }
+
+  if (*ptr++ != 0)
+    {
+      attributes = (struct nfs_fattr *)ptr;
+      ptr += uint32_increment(sizeof(struct nfs_fattr));
+    }
+
+  nfs_writebehind_checkverf(nmp, np, (const uint8_t *)ptr);
+
+  /* Whatever is still committing is stable now */
+
+  for (i = 0; i < wb->wb_nbufs; i++)
+    {
+      if (wb->wb_bufs[i].wb_state == NFSWB_COMMITTING)
+        {
+          wb->wb_bufs[i].wb_state = NFSWB_FREE;
+        }
+    }
+
+  nfs_writebehind_attrupdate(np, attributes);
+}
+
+/****************************************************************************
+ * Name: nfs_writebehind_receive
+ *
+ * Description:
+ *   Receive one reply and hand it to its WRITE or COMMIT.  Replies that
+ *   match no call in flight (late duplicates) are dropped.  When no reply
+ *   arrives in time or the connection failed, the calls in flight are sent
+ *   again, up to nm_retry times in a row.
+ *
+ * Returned Value:
+ *   0 on success; a positive errno value if the server could not be
+ *   reached.  All buffers are dropped in that case.
+ *
+ ****************************************************************************/
+
+static int nfs_writebehind_receive(struct nfsmount *nmp, struct nfsnode *np,
+                                   int *retries)
+{
+  struct nfs_writebehind_s *wb = np->n_wb;
+  uint32_t xid = 0;
+  int      error;
+  int      i;
+
+  if (nmp->nm_rpcclnt->rc_so == -1)
+    {
+      error = ENOTCONN;
+    }
+  else
+    {
+      error = rpcclnt_getreply(nmp->nm_rpcclnt, wb->wb_reply, NFS_WBREPLYSIZE, &xid);
+    }
+
+  if (xid == 0)
+    {
+      /* Nothing was received; the calls or their replies may have been
+       * lost.
+       */
+
+      if (++(*retries) > nmp->nm_retry)
+        {
+          nfs_debug_error("server not responding: %d\n", error);
+          nfs_writebehind_fail(wb, error);
+          return error;
+        }
+
+      for (i = 0; i < wb->wb_nbufs; i++)
+        {
+          if (wb->wb_bufs[i].wb_state == NFSWB_PENDING)
+            {
+              nfs_writebehind_send(nmp, np, &wb->wb_bufs[i]);
+            }
+        }
+
+      if (wb->wb_commitxid != 0)
+        {
+          nfs_writebehind_sendcommit(nmp, np);
+        }
+
+      return OK;
+    }
+
+  *retries = 0;
+
+  if (xid == wb->wb_commitxid)
+    {
+      nfs_writebehind_committed(nmp, np, error);
+      return OK;
+    }
+
+  for (i = 0; i < wb->wb_nbufs; i++)
+    {
+      if (wb->wb_bufs[i].wb_state == NFSWB_PENDING && wb->wb_bufs[i].wb_xid == xid)
+        {
+          nfs_writebehind_written(nmp, np, &wb->wb_bufs[i], error);
+          break;
+        }
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: nfs_writebehind_getbuf
+ *
+ * Description:
+ *   Return a free buffer, after waiting for replies if there is none.
+ *
+ ****************************************************************************/
+
+static struct nfs_wbbuf_s *nfs_writebehind_getbuf(struct nfsmount *nmp,
+                                                  struct nfsnode *np,
+                                                  int *error)
+{
+  struct nfs_writebehind_s *wb = np->n_wb;
+  struct nfs_wbbuf_s       *buf;
+  int retries = 0;
+  int i;
+
+  for (; ; )
+    {
+      if (wb->wb_error != OK)
+        {
+          *error = wb->wb_error;
+          return NULL;
+        }
+
+      /* Commit in the background once half of the buffers wait for it */
+
+      if (wb->wb_commitxid == 0 &&
+          nfs_writebehind_count(wb, NFSWB_UNSTABLE) >= (wb->wb_nbufs + 1) / 2)
+        {
+          nfs_writebehind_commit(nmp, np);
+        }
+
+      for (i = 0; i < wb->wb_nbufs; i++)
+        {
+          buf = &wb->wb_bufs[i];
+          if (buf->wb_state != NFSWB_FREE)
+            {
+              continue;
+            }
+
+          if (buf->wb_call == NULL)
+            {
+              /* The buffers are allocated as they are needed, so small
+               * files never pay for the whole window.
+               */
+
+              buf->wb_call = malloc(wb->wb_buflen);
+              if (buf->wb_call == NULL)
+                {
+                  continue;
+                }
+            }
+
+          return buf;
+        }
+
+      if (!nfs_writebehind_inflight(wb))
+        {
+          *error = ENOMEM;
+          return NULL;
+        }
+
+      *error = nfs_writebehind_receive(nmp, np, &retries);
+      if (*error != OK)
+        {
+          return NULL;
+        }
+    }
+}
+
+/****************************************************************************
+ * Name: nfs_writebehind_overlaps
+ *
+ * Description:
+ *   Return true if the range overlaps data that is not committed yet.
+ *   Written again after a server restart, the older data could land after
+ *   the newer one.
+ *
+ ****************************************************************************/
+
+static bool nfs_writebehind_overlaps(struct nfs_writebehind_s *wb,
+                                     uint64_t offset, size_t len)
+{
+  struct nfs_wbbuf_s *buf;
+  int i;
+
+  for (i = 0; i < wb->wb_nbufs; i++)
+    {
+      buf = &wb->wb_bufs[i];
+      if (buf->wb_state != NFSWB_FREE &&
+          offset < buf->wb_offset + buf->wb_count &&
+          buf->wb_offset < offset + len)
+        {
+          return true;
+        }
+    }
+
+  return false;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: nfs_writebehind_setup
+ *
+ * Description:
+ *   Give a file write-behind buffers, unless it has them already.
+ *
+ * Returned Value:
+ *   0 on success; ENOSYS if write-behind is disabled on the mount, ENOMEM
+ *   if the buffers could not be allocated.
+ *
+ ****************************************************************************/
+
+int nfs_writebehind_setup(struct nfsmount *nmp, struct nfsnode *np)
+{
+  struct nfs_writebehind_s *wb;
+  uint32_t bsize;
+  size_t   size;
+  size_t   tmp;
+
+  if (np->n_wb != NULL)
+    {
+      return OK;
+    }
+
+  if (nmp->nm_writebehind == 0)
+    {
+      return ENOSYS;
+    }
+
+  /* Make sure that a call fits into the same size of buffer that the
+   * synchronous writes use.
+   */
+
+  bsize = nmp->nm_wsize;
+  tmp   = SIZEOF_rpc_call_write(bsize);
+  if (tmp > nmp->nm_buflen)
+    {
+      bsize -= (tmp - nmp->nm_buflen);
+    }
+
+  size = SIZEOF_nfs_writebehind_s(nmp->nm_writebehind);
+  wb   = (struct nfs_writebehind_s *)malloc(size);
+  if (wb == NULL)
+    {
+      return ENOMEM;
+    }
+
+  (void)memset_s(wb, size, 0, size);
+  wb->wb_bsize  = bsize;
+  wb->wb_buflen = uint32_alignup(SIZEOF_rpc_call_write(bsize));
+  wb->wb_nbufs  = nmp->nm_writebehind;
+  wb->wb_reply  = malloc(NFS_WBREPLYSIZE);
+  if (wb->wb_reply == NULL)
+    {
+      free(wb);
+      return ENOMEM;
+    }
+
+  np->n_wb = wb;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: nfs_writebehind_write
+ *
+ * Description:
+ *   Write 'buflen' bytes at 'pos' through the write-behind buffers of the
+ *   file, which must have been set up with nfs_writebehind_setup().  The
+ *   data is copied into the buffers and sent; the function returns while
+ *   the replies are still outstanding.  'user' tells whether 'buffer' is
+ *   in user space.
+ *
+ * Returned Value:
+ *   0 on success, with the number of bytes taken in 'nwritten'; a positive
+ *   errno value on failure, which may be the error of an earlier WRITE.
+ *
+ ****************************************************************************/
+
+int nfs_writebehind_write(struct nfsmount *nmp, struct nfsnode *np,
+                          const char *buffer, size_t buflen, loff_t pos,
+                          bool user, size_t *nwritten)
+{
+  struct nfs_writebehind_s *wb = np->n_wb;
+  struct nfs_wbbuf_s       *buf;
+  uint8_t                  *data;
+  size_t                    written = 0;
+  size_t                    count;
+  int                       error = OK;
+
+  /* Only one file of the mount may have calls in flight */
+
+  nfs_readahead_drain(nmp);
+  if (nmp->nm_wbhead != NULL && nmp->nm_wbhead != np)
+    {
+      nfs_writebehind_drain(nmp);
+    }
+
+  if (wb->wb_error != OK)
+    {
+      error = wb->wb_error;
+      wb->wb_error = OK;
+      return error;
+    }
+
+  if (nfs_writebehind_overlaps(wb, (uint64_t)pos, buflen))
+    {
+      error = nfs_writebehind_flush(nmp, np);
+      if (error != OK)
+        {
+          return error;
+        }
+    }
+
+  while (written < buflen)
+    {
+      buf = nfs_writebehind_getbuf(nmp, np, &error);
+      if (buf == NULL)
+        {
+          break;
+        }
+
+      count = buflen - written;
+      if (count > wb->wb_bsize)
+        {
+          count = wb->wb_bsize;
+        }
+
+      data = nfs_writebehind_build(np, buf, (uint64_t)pos, count);
+      if (user)
+        {
+          if (LOS_CopyToKernel(data, count, buffer + written, count) != 0)
+            {
+              error = EFAULT;
+              break;
+            }
+        }
+      else
+        {
+          (void)memcpy_s(data, count, buffer + written, count);
+        }
+
+      buf->wb_xid = 0;
+      nfs_writebehind_send(nmp, np, buf);
+
+      written += count;
+      pos     += count;
+    }
+
+  if (error != OK)
+    {
+      nfs_debug_error("nfs_writebehind_write failed: %d\n", error);
+      if (written == 0)
+        {
+          if (error == wb->wb_error)
+            {
+              wb->wb_error = OK;
+            }
+
+          return error;
+        }
+    }
+
+  *nwritten = written;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: nfs_writebehind_drain
+ *
+ * Description:
+ *   Collect the replies to all WRITE and COMMIT calls still in flight on
+ *   the mount.  Uncommitted data stays in the buffers.  Called before any
+ *   other RPC of the mount, which should see the data written.
+ *
+ ****************************************************************************/
+
+void nfs_writebehind_drain(struct nfsmount *nmp)
+{
+  struct nfsnode *np = nmp->nm_wbhead;
+  int retries = 0;
+
+  if (np == NULL)
+    {
+      return;
+    }
+
+  while (nfs_writebehind_inflight(np->n_wb) &&
+         nfs_writebehind_receive(nmp, np, &retries) == OK)
+    {
+    }
+
+  nmp->nm_wbhead = NULL;
+}
+
+/****************************************************************************
+ * Name: nfs_writebehind_flush
+ *
+ * Description:
+ *   Wait for all WRITEs of the file and COMMIT the data, writing it again
+ *   as long as the server restarts in between.
+ *
+ * Returned Value:
+ *   0 on success; a positive errno value if data written since the last
+ *   flush may have been lost.
+ *
+ ****************************************************************************/
+
+int nfs_writebehind_flush(struct nfsmount *nmp, struct nfsnode *np)
+{
+  struct nfs_writebehind_s *wb = np->n_wb;
+  int retries = 0;
+  int error;
+
+  if (wb == NULL)
+    {
+      return OK;
+    }
+
+  nfs_readahead_drain(nmp);
+  if (nmp->nm_wbhead != NULL && nmp->nm_wbhead != np)
+    {
+      nfs_writebehind_drain(nmp);
+    }
+
+  for (; ; )
+    {
+      if (nfs_writebehind_inflight(wb))
+        {
+          if (nfs_writebehind_receive(nmp, np, &retries) != OK)
+            {
+              break;
+            }
+        }
+      else if (nfs_writebehind_count(wb, NFSWB_UNSTABLE) > 0)
+        {
+          nfs_writebehind_commit(nmp, np);
+        }
+      else
+        {
+          break;
+        }
+    }
+
+  if (nmp->nm_wbhead == np)
+    {
+      nmp->nm_wbhead = NULL;
+    }
+
+  /* The next data is checked against the verifier of its own replies */
+
+  wb->wb_verfvalid = false;
+
+  error = wb->wb_error;
+  wb->wb_error = OK;
+  return error;
+}
+
+/****************************************************************************
+ * Name: nfs_writebehind_free
+ *
+ * Description:
+ *   Flush the data of a file and release its write-behind buffers.
+ *
+ ****************************************************************************/
+
+void nfs_writebehind_free(struct nfsmount *nmp, struct nfsnode *np)
+{
+  struct nfs_writebehind_s *wb = np->n_wb;
+  int i;
+
+  if (wb == NULL)
+    {
+      return;
+    }
+
+  (void)nfs_writebehind_flush(nmp, np);
+  for (i = 0; i < wb->wb_nbufs; i++)
+    {
+      free(wb->wb_bufs[i].wb_call);
+    }
+
+  free(wb->wb_reply);
+  free(wb);
+  np->n_wb = NULL;
+}
@@ -78,6 +78,7 @@
  ****************************************************************************/
 
 #include <sys/types.h>
+#include <pthread.h>
 #include <securec.h>
 #include <netinet/in.h>
 #include "nfs_proto.h"
@@ -347,6 +348,12 @@ struct rpc_call_write
 };
 #define SIZEOF_rpc_call_write(n) (sizeof(struct rpc_call_header) + SIZEOF_WRITE3args(n))
 
+struct rpc_call_commit
+{
+  struct rpc_call_header ch;
+  struct COMMIT3args commit;
+};
+
 struct rpc_call_remove
 {
   struct rpc_call_header ch;
@@ -377,6 +384,12 @@ struct rpc_call_readdir
   struct READDIR3args readdir;
 };
 
+struct rpc_call_readdirplus
+{
+  struct rpc_call_header ch;
+  struct READDIRPLUS3args readdirplus;
+};
+
 struct rpc_call_setattr
 {
   struct rpc_call_header ch;
@@ -454,6 +467,13 @@ struct rpc_reply_write
   struct WRITE3resok write;      /* Variable length */
 };
 
+struct rpc_reply_commit
+{
+  struct rpc_reply_header rh;
+  uint32_t status;
+  struct COMMIT3resok commit;
+};
+
 struct rpc_reply_read
 {
   struct rpc_reply_header rh;
@@ -532,16 +552,35 @@ struct rpc_reply_setattr
   struct SETATTR3resok setattr;
 };
 
+/* Several threads may use one RPC client at the same time.  Their calls are
+ * sent one after the other under rc_lock.  Whichever thread finds nobody
+ * reading the socket receives the replies and hands each one to the waiter
+ * with the same xid, until its own reply is in.
+ */
+
+struct rpc_waiter;
+struct rpc_stash;
+
 struct  rpcclnt
 {
   nfsfh_t  rc_fh;             /* File handle of the root directory */
   unsigned int  rc_fhsize;    /* File size of the root directory */
   char    *rc_path;           /* Server's path of the mounted directory */
-  uint32_t         xid;
   struct  sockaddr *rc_name;
   int              rc_so;             /* RPC socket */
 
-  bool     rc_timeout;        /* Receipt of reply timed out */
+  pthread_mutex_t    rc_lock;     /* Serializes sending and the fields below */
+  pthread_cond_t     rc_cond;     /* Signalled when replies were dispatched */
+  struct rpc_waiter *rc_waiters;  /* Calls of rpcclnt_request() without a reply */
+  struct rpc_waiter *rc_target;   /* Waiter whose reply is being received */
+  struct rpc_stash  *rc_stash;    /* Replies for rpcclnt_getreply() not yet collected */
+  uint32_t rc_gen;            /* Incremented whenever the connection is closed */
+  int      rc_recvso;         /* Socket that the receiving thread reads */
+  bool     rc_receiving;      /* A thread is reading from the socket */
+  bool     rc_recvclose;      /* The receiving thread closes rc_recvso */
+  bool     rc_shutdown;       /* rpcclnt_lockdestroy() was called */
+  uint8_t  rc_nstash;         /* Number of stashed replies */
+  uint8_t  rc_pending;        /* Calls sent by rpcclnt_sendcall() without a reply yet */
   uint8_t  rc_sotype;         /* Type of socket */
   uint8_t  rc_retry;          /* Max retries */
 };
@@ -551,6 +590,8 @@ struct  rpcclnt
  ****************************************************************************/
 
 void rpcclnt_init(void);
+int  rpcclnt_lockinit(struct rpcclnt *rpc);
+void rpcclnt_lockdestroy(struct rpcclnt *rpc);
 int  rpcclnt_connect(struct rpcclnt *rpc);
 void rpcclnt_disconnect(struct rpcclnt *rpc);
 int  rpcclnt_umount(struct rpcclnt *rpc);
@@ -558,6 +599,10 @@ void rpcclnt_safedisconnect(struct rpcclnt *rpc);
 int  rpcclnt_request(struct rpcclnt *rpc, int procnum, int prog, int version,
                      void *request, size_t reqlen,
                      void *response, size_t resplen);
+int  rpcclnt_sendcall(struct rpcclnt *rpc, int procnum, int prog, int version,
+                      void *request, size_t reqlen, uint32_t *xid);
+int  rpcclnt_getreply(struct rpcclnt *rpc, void *response, size_t resplen,
+                      uint32_t *xid);
 void rpcclnt_setuidgid(uint32_t uid, uint32_t gid);
 
 #ifdef __cplusplus
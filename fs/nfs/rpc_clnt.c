@@ -81,6 +81,7 @@
 
 #include <sys/time.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 #include "lwip/opt.h"
 #include "lwip/sockets.h"
@@ -107,6 +108,33 @@
 #define RPCCLNT_FH_LEN                  4
 #define RPCCLNT_RECV_BUF_MAX_LEN        64
 #define RPCCLNT_CONNECT_MAX_RETRY_TIMES 1024
+#define RPCCLNT_STASH_MAX               32
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* A caller of rpcclnt_request() waiting for the reply to its call */
+
+struct rpc_waiter
+{
+  struct rpc_waiter *rw_next;
+  uint32_t           rw_xid;        /* xid of the call */
+  uint32_t           rw_gen;        /* rc_gen when the call was last sent */
+  void              *rw_response;   /* Where the reply goes */
+  size_t             rw_resplen;
+  int                rw_error;      /* Error receiving the reply */
+  bool               rw_done;       /* The reply is in */
+};
+
+/* A reply to a call of rpcclnt_sendcall() that another thread received */
+
+struct rpc_stash
+{
+  struct rpc_stash  *rs_next;
+  size_t             rs_len;
+  uint32_t           rs_reply[];    /* The whole reply, rs_len bytes */
+};
 
 /****************************************************************************
  * Private Data
@@ -139,14 +167,15 @@ static struct rpcstats rpcstats;
 
 static int rpcclnt_send(struct rpcclnt *rpc, int procid, int prog,
                         void *call, int reqlen);
-static int rpcclnt_receive(struct rpcclnt *rpc, struct sockaddr *aname,
-                           int proc, int program, void *reply, size_t resplen);
-static int rpcclnt_reply(struct rpcclnt *rpc, int procid, int prog,
-                         void *reply, size_t resplen);
+static int rpcclnt_receive(struct rpcclnt *rpc, void *response,
+                           size_t resplen, uint32_t *xid);
+static int rpcclnt_checkreply(struct rpc_reply_header *replymsg);
 static uint32_t rpcclnt_newxid(void);
 static void rpcclnt_fmtheader(struct rpc_call_header *ch,
                               uint32_t xid, int procid, int prog, int vers, size_t reqlen);
+static void rpcclnt_close(struct rpcclnt *rpc);
 static int rpcclnt_reconnect(struct rpcclnt *rpc, struct sockaddr *saddr);
+static int rpcclnt_connectport(struct rpcclnt *rpc, uint16_t port);
 
 /****************************************************************************
  * Private Functions
@@ -188,213 +217,500 @@ static int rpcclnt_send(struct rpcclnt *rpc, int procid, int prog,
   return ret;
 }
 
+#ifndef CONFIG_NFS_RECV_TIMEOUT
 #if (NFS_PROTO_TYPE == NFS_IPPROTO_UDP)
 #define CONFIG_NFS_RECV_TIMEOUT 200 /* udp-nfs recv timeout in milli seconds */
+#elif (NFS_PROTO_TYPE == NFS_IPPROTO_TCP)
+#define CONFIG_NFS_RECV_TIMEOUT 5000 /* tcp-nfs recv timeout in milli seconds */
+#endif
+#endif
 
 /****************************************************************************
- * Name: rpcclnt_receive
+ * Name: rpcclnt_select
  *
  * Description:
- *   Receive a Sun RPC Request/Reply. Only for SOCK_DGRAM
+ *   Wait until the socket has data to read.
+ *
+ * Returned Value:
+ *   Zero if data is ready, EAGAIN if none arrived within
+ *   CONFIG_NFS_RECV_TIMEOUT, or another (positive) errno value on failure.
  *
  ****************************************************************************/
 
-static int rpcclnt_receive(struct rpcclnt *rpc, struct sockaddr *aname,
-                           int proc, int program, void *reply,
-                           size_t resplen)
+static int rpcclnt_select(int so)
 {
-  ssize_t nbytes;
-  int error = 0;
-  int ret;
   fd_set fdreadset;
   struct timeval timeval = {0};
-  socklen_t fromlen = sizeof(struct sockaddr);
-  uint32_t xid;
-retry:
+  int error;
+  int ret;
+
   FD_ZERO(&fdreadset);
-  FD_SET((uint32_t)(rpc->rc_so), &fdreadset);
+  FD_SET((uint32_t)so, &fdreadset);
 
   timeval.tv_sec = (CONFIG_NFS_RECV_TIMEOUT / 1000);
   timeval.tv_usec = (CONFIG_NFS_RECV_TIMEOUT % 1000) * 1000;
 
-  ret = select(rpc->rc_so + 1, &fdreadset, 0, 0, &timeval);
+  ret = select(so + 1, &fdreadset, 0, 0, &timeval);
   if (ret == 0)
     {
-      nfs_debug_error("rpcclnt_receive select nothing\n");
+      nfs_debug_info("rpcclnt_select nothing\n");
       return EAGAIN;
     }
   else if (ret < 0)
     {
       error = get_errno();
-      nfs_debug_error("rpcclnt_receive select error %d\n", error);
+      nfs_debug_error("rpcclnt_select error %d\n", error);
       return error;
     }
 
-  nbytes = recvfrom(rpc->rc_so, reply, resplen, 0, aname, &fromlen);
-  if (nbytes <= (ssize_t)sizeof(xid))
+  return OK;
+}
+
+#if (NFS_PROTO_TYPE == NFS_IPPROTO_UDP)
+
+/****************************************************************************
+ * Name: rpcclnt_recvhead
+ *
+ * Description:
+ *   Wait for the next reply and peek at its xid, which is returned in
+ *   'head'.  Only for SOCK_DGRAM: the length of a datagram is not known in
+ *   advance, so '*reclen' is set to zero.
+ *
+ ****************************************************************************/
+
+static int rpcclnt_recvhead(int so, uint32_t *head, size_t *reclen)
+{
+  char    discard[RPCCLNT_RECV_BUF_MAX_LEN];
+  ssize_t nbytes;
+  int     error;
+
+  error = rpcclnt_select(so);
+  if (error != OK)
     {
-      error = get_errno();
-      nfs_debug_error("psock_recvfrom failed: %d\n", error);
-      goto retry;
+      return error;
     }
 
-  error = memcpy_s((void *)&xid, sizeof(xid), ((char *)reply + RPC_RMSIZE), sizeof(xid));
-  if (error != EOK)
+  nbytes = recv(so, head, sizeof(uint32_t), MSG_PEEK);
+  if (nbytes < (ssize_t)sizeof(uint32_t))
+    {
+      /* Drop what cannot be a reply */
+
+      nfs_debug_error("rpcclnt_recvhead bad datagram: %d\n", get_errno());
+      (void)recv(so, discard, sizeof(discard), 0);
+      return EAGAIN;
+    }
+
+  *reclen = 0;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: rpcclnt_recvbody
+ *
+ * Description:
+ *   Receive the datagram whose head rpcclnt_recvhead() peeked at into
+ *   'dest', or drop it if 'dest' is NULL.  Only for SOCK_DGRAM
+ *
+ ****************************************************************************/
+
+static int rpcclnt_recvbody(int so, uint32_t *head, size_t reclen,
+                            void *dest, size_t destlen)
+{
+  char    discard[RPCCLNT_RECV_BUF_MAX_LEN];
+  ssize_t nbytes;
+
+  if (dest == NULL)
     {
-      return ENOBUFS;
+      dest    = discard;
+      destlen = sizeof(discard);
     }
 
-  if (fxdr_unsigned(uint32_t, xid) != rpc->xid)
+  nbytes = recv(so, dest, destlen, 0);
+  if (nbytes < 0)
     {
-      nfs_debug_error("psock_recvfrom a wrong packet\n");
-      goto retry;
+      return get_errno();
     }
 
-  return error;
+  return OK;
 }
 
 #elif (NFS_PROTO_TYPE == NFS_IPPROTO_TCP)
-#define CONFIG_NFS_RECV_TIMEOUT 5000 /* tcp-nfs recv timeout in milli seconds */
 
 /****************************************************************************
- * Name: rpcclnt_receive
+ * Name: rpcclnt_recvbytes
  *
  * Description:
- *   Receive a Sun RPC Request/Reply. Only for SOCK_STREAM
+ *   Read exactly 'len' bytes from the stream.  If 'buffer' is NULL, they
+ *   are dropped.  Only for SOCK_STREAM
  *
  ****************************************************************************/
 
-static int rpcclnt_receive(struct rpcclnt *rpc, struct sockaddr *aname,
-                           int proc, int program, void *reply,
-                           size_t resplen)
+static int rpcclnt_recvbytes(int so, void *buffer, size_t len)
 {
-  ssize_t   nbytes;
-  size_t    offset = 0;
-  size_t    hdrlen = 0;
-  uint32_t  total = 0;
-  int       error;
-  int       ret;
-  fd_set    fdreadset;
-  struct    timeval timeval = {0};
-  socklen_t fromlen = sizeof(struct sockaddr);
+  char    discard[RPCCLNT_RECV_BUF_MAX_LEN];
+  ssize_t nbytes;
+  size_t  nrecv;
+  int     error;
 
-  do
+  while (len > 0)
     {
-      FD_ZERO(&fdreadset);
-      FD_SET((uint32_t)(rpc->rc_so), &fdreadset);
-
-      timeval.tv_sec = (CONFIG_NFS_RECV_TIMEOUT / 1000);
-      timeval.tv_usec = (CONFIG_NFS_RECV_TIMEOUT % 1000) * 1000;
+      error = rpcclnt_select(so);
+      if (error != OK)
+        {
+          return error;
+        }
 
-      ret = select(rpc->rc_so + 1, &fdreadset, 0, 0, &timeval);
-      if (ret == 0) /* no reply */
+      if (buffer != NULL)
         {
-          nfs_debug_error("rpcclnt_receive select nothing\n");
-          return EAGAIN;
+          nbytes = recv(so, buffer, len, 0);
         }
-      else if (ret < 0) /* select error */
+      else
         {
-          error = get_errno();
-          nfs_debug_error("rpcclnt_receive select error %d\n", error);
-          return error;
+          nrecv  = (len < sizeof(discard)) ? len : sizeof(discard);
+          nbytes = recv(so, discard, nrecv, 0);
         }
 
-      nbytes = recvfrom(rpc->rc_so, (char *)reply + offset, resplen - offset, 0, aname, &fromlen);
       if (nbytes < 0)
         {
           error = get_errno();
-          nfs_debug_error("rpcclnt_receive recvfrom error %d\n", error);
+          nfs_debug_error("rpcclnt_recvbytes recv error %d\n", error);
           return error;
         }
       else if (nbytes == 0)
         {
-          /* connection closed by peer side */
-
-          nfs_debug_error("rpcclnt_receive connection closed by peer\n");
+          nfs_debug_error("rpcclnt_recvbytes connection closed by peer\n");
           return EIO;
         }
-      else
+
+      if (buffer != NULL)
         {
-          offset += nbytes;
+          buffer = (char *)buffer + nbytes;
+        }
 
-          /* parse fragment header */
+      len -= nbytes;
+    }
 
-          if (offset == 0 || hdrlen < sizeof(struct rpc_reply_header))
-            {
-              hdrlen += nbytes;
+  return OK;
+}
 
-              /* unlikely */
+/****************************************************************************
+ * Name: rpcclnt_recvhead
+ *
+ * Description:
+ *   Wait for the next record and read its record mark and xid into 'head'.
+ *   The length of the whole record, record mark included, is returned in
+ *   '*reclen'.  Only for SOCK_STREAM
+ *
+ ****************************************************************************/
 
-              if (hdrlen < sizeof(struct rpc_reply_header))
-                {
-                  continue;
-                }
+static int rpcclnt_recvhead(int so, uint32_t *head, size_t *reclen)
+{
+  uint32_t total;
+  int      error;
 
-              error = memcpy_s(&total, RPC_RMSIZE, reply, RPC_RMSIZE);
-              if (error != EOK)
-                {
-                  return ENOBUFS;
-                }
-              total = (fxdr_unsigned(uint32_t, total) & RPC_RM_FLAGMENT_LEN_MASK) + RPC_RMSIZE;
-            }
+  error = rpcclnt_select(so);
+  if (error != OK)
+    {
+      return error;
+    }
+
+  /* Once part of a record is read, the stream is out of step if the rest
+   * does not follow.
+   */
+
+  error = rpcclnt_recvbytes(so, head, RPC_RMSIZE + sizeof(uint32_t));
+  if (error != OK)
+    {
+      return (error == EAGAIN) ? EIO : error;
+    }
+
+  total = (fxdr_unsigned(uint32_t, head[0]) & RPC_RM_FLAGMENT_LEN_MASK) + RPC_RMSIZE;
+  if (total < RPC_RMSIZE + sizeof(uint32_t))
+    {
+      nfs_debug_error("rpcclnt_recvhead bad record length %u\n", total);
+      return EIO;
+    }
+
+  *reclen = total;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: rpcclnt_recvbody
+ *
+ * Description:
+ *   Read the rest of the record whose head rpcclnt_recvhead() read.  The
+ *   whole record is returned in 'dest', as far as it fits; the rest is
+ *   dropped, as is all of it if 'dest' is NULL.  Only for SOCK_STREAM
+ *
+ ****************************************************************************/
+
+static int rpcclnt_recvbody(int so, uint32_t *head, size_t reclen,
+                            void *dest, size_t destlen)
+{
+  size_t hdrlen = RPC_RMSIZE + sizeof(uint32_t);
+  size_t nrecv = 0;
+  int    error;
+
+  if (dest != NULL && destlen >= hdrlen)
+    {
+      (void)memcpy_s(dest, destlen, head, hdrlen);
+      nrecv = ((reclen < destlen) ? reclen : destlen) - hdrlen;
+      error = rpcclnt_recvbytes(so, (char *)dest + hdrlen, nrecv);
+      if (error != OK)
+        {
+          return (error == EAGAIN) ? EIO : error;
         }
     }
-  while (offset < total);
 
-  return 0;
+  error = rpcclnt_recvbytes(so, NULL, reclen - hdrlen - nrecv);
+  return (error == EAGAIN) ? EIO : error;
 }
+
 #endif
 
 /****************************************************************************
- * Name: rpcclnt_reply
+ * Name: rpcclnt_dispatch
  *
  * Description:
- *   Received the RPC reply on the socket.
+ *   Receive one reply and hand it to the caller of rpcclnt_request() that
+ *   waits for it.  Any other reply is returned in 'response' if that is
+ *   given, which is how rpcclnt_getreply() collects the replies to calls of
+ *   rpcclnt_sendcall().  Otherwise such a reply is stashed for
+ *   rpcclnt_getreply() while those calls are pending, or dropped.
+ *
+ *   Only the thread that set rc_receiving calls this, without rc_lock held.
+ *
+ * Returned Value:
+ *   Zero on success or a (positive) errno value on failure.  EAGAIN means
+ *   that nothing arrived in time.  If the reply went to 'response', its xid
+ *   is returned in '*xid', which is zero otherwise.
  *
  ****************************************************************************/
 
-static int rpcclnt_reply(struct rpcclnt *rpc, int procid, int prog,
-                         void *reply, size_t resplen)
+static int rpcclnt_dispatch(struct rpcclnt *rpc, int so, void *response,
+                            size_t resplen, uint32_t *xid)
 {
-  int error;
+  struct rpc_waiter *waiter;
+  struct rpc_stash  *stash = NULL;
+  struct rpc_stash **tail;
+  uint32_t head[2];
+  uint32_t rxid;
+  size_t   reclen = 0;
+  size_t   destlen = 0;
+  void    *dest = NULL;
+  int      error;
+
+  *xid = 0;
+
+  error = rpcclnt_recvhead(so, head, &reclen);
+  if (error != OK)
+    {
+      return error;
+    }
 
-  /* Get the next RPC reply from the socket */
+  rxid = fxdr_unsigned(uint32_t, head[RPC_RMSIZE / sizeof(uint32_t)]);
 
-  error = rpcclnt_receive(rpc, rpc->rc_name, procid, prog, reply, resplen);
-  if (error != 0)
+  (void)pthread_mutex_lock(&rpc->rc_lock);
+  for (waiter = rpc->rc_waiters; waiter != NULL; waiter = waiter->rw_next)
+    {
+      if (waiter->rw_xid == rxid && !waiter->rw_done)
+        {
+          break;
+        }
+    }
+
+  if (waiter != NULL)
+    {
+      rpc->rc_target = waiter;
+      dest           = waiter->rw_response;
+      destlen        = waiter->rw_resplen;
+    }
+  else if (response != NULL)
+    {
+      dest    = response;
+      destlen = resplen;
+    }
+#if (NFS_PROTO_TYPE == NFS_IPPROTO_TCP)
+  else if (rpc->rc_pending > 0 && rpc->rc_nstash < RPCCLNT_STASH_MAX)
+    {
+      stash = malloc(sizeof(struct rpc_stash) + reclen);
+      if (stash != NULL)
+        {
+          stash->rs_next = NULL;
+          stash->rs_len  = reclen;
+          dest           = stash->rs_reply;
+          destlen        = reclen;
+        }
+    }
+#endif
+
+  (void)pthread_mutex_unlock(&rpc->rc_lock);
+
+  if (dest == NULL)
     {
-      nfs_debug_error("rpcclnt_receive returned: %d\n", error);
+      nfs_debug_info("rpcclnt_dispatch drops a reply to another call\n");
+    }
 
-      /* For UDP, If we failed because of a timeout, then try sending the CALL
-       * message again. While for TCP, just return errno.
-       */
+  error = rpcclnt_recvbody(so, head, reclen, dest, destlen);
 
-#if (NFS_PROTO_TYPE == NFS_IPPROTO_UDP)
-      if (error == EAGAIN || error == ETIMEDOUT)
+  (void)pthread_mutex_lock(&rpc->rc_lock);
+  if (waiter != NULL)
+    {
+      rpc->rc_target = NULL;
+      if (error == OK)
+        {
+          waiter->rw_error = (reclen > destlen) ? ENOBUFS : OK;
+          waiter->rw_done  = true;
+        }
+    }
+  else if (stash != NULL)
+    {
+      if (error == OK)
         {
-          rpc->rc_timeout = true;
+          for (tail = &rpc->rc_stash; *tail != NULL; tail = &(*tail)->rs_next);
+          *tail = stash;
+          rpc->rc_nstash++;
         }
+      else
+        {
+          free(stash);
+        }
+    }
+  else if (dest != NULL && error == OK)
+    {
+      *xid  = rxid;
+      error = (reclen > destlen) ? ENOBUFS : OK;
+    }
+
+  (void)pthread_mutex_unlock(&rpc->rc_lock);
+  return error;
+}
+
+/****************************************************************************
+ * Name: rpcclnt_receive
+ *
+ * Description:
+ *   Take the part of the receiver and dispatch one reply.  Called with
+ *   rc_lock held while no other thread receives; the lock is dropped while
+ *   reading the socket.  If the transport fails, the connection is closed
+ *   so that the calls on it get sent again on a new one.
+ *
+ ****************************************************************************/
+
+static int rpcclnt_receive(struct rpcclnt *rpc, void *response,
+                           size_t resplen, uint32_t *xid)
+{
+#if (NFS_PROTO_TYPE == NFS_IPPROTO_TCP)
+  uint32_t gen = rpc->rc_gen;
 #endif
+  int      so = rpc->rc_so;
+  int      error;
+
+  *xid = 0;
+  if (so == -1)
+    {
+      return ENOTCONN;
     }
 
-  /* Get the xid and check that it is an RPC replysvr */
+  rpc->rc_recvso    = so;
+  rpc->rc_receiving = true;
+  (void)pthread_mutex_unlock(&rpc->rc_lock);
 
-  else
+  error = rpcclnt_dispatch(rpc, so, response, resplen, xid);
+
+  (void)pthread_mutex_lock(&rpc->rc_lock);
+  rpc->rc_receiving = false;
+
+  if (rpc->rc_recvclose)
     {
-      struct rpc_reply_header *replyheader =
-        (struct rpc_reply_header *)reply;
+      (void)lwip_close(so);
+      rpc->rc_recvclose = false;
+    }
 
-      if (replyheader->rp_direction != rpc_reply)
+  if (error != OK && error != EAGAIN && *xid == 0)
+    {
+      nfs_debug_error("rpcclnt_receive failed: %d\n", error);
+#if (NFS_PROTO_TYPE == NFS_IPPROTO_TCP)
+      if (gen == rpc->rc_gen)
         {
-          nfs_debug_error("Different RPC REPLY returned\n");
-          rpc_statistics(rpcinvalid);
-          error = EPROTO;
+          rpcclnt_close(rpc);
         }
+#endif
     }
 
+  /* Let the waiters see whether their replies are in, and one of them take
+   * over receiving.
+   */
+
+  (void)pthread_cond_broadcast(&rpc->rc_cond);
   return error;
 }
 
+/****************************************************************************
+ * Name: rpcclnt_checkreply
+ *
+ * Description:
+ *   Check the RPC level status of a reply.
+ *
+ * Returned Value:
+ *   Zero if the call was accepted, a (positive) errno value otherwise.
+ *
+ ****************************************************************************/
+
+static int rpcclnt_checkreply(struct rpc_reply_header *replymsg)
+{
+  uint32_t tmp;
+
+  tmp = fxdr_unsigned(uint32_t, replymsg->type);
+  if (tmp == RPC_MSGDENIED)
+    {
+      tmp = fxdr_unsigned(uint32_t, replymsg->status);
+      switch (tmp)
+        {
+        case RPC_MISMATCH:
+          nfs_debug_error("RPC_MSGDENIED: RPC_MISMATCH error\n");
+          return EOPNOTSUPP;
+
+        case RPC_AUTHERR:
+          nfs_debug_error("RPC_MSGDENIED: RPC_AUTHERR error\n");
+          return EACCES;
+
+        default:
+          return EOPNOTSUPP;
+        }
+    }
+  else if (tmp != RPC_MSGACCEPTED)
+    {
+      return EOPNOTSUPP;
+    }
+
+  tmp = fxdr_unsigned(uint32_t, replymsg->status);
+  if (tmp == RPC_SUCCESS)
+    {
+      nfs_debug_info("RPC_SUCCESS\n");
+    }
+  else if (tmp == RPC_PROGMISMATCH)
+    {
+      nfs_debug_error("RPC_MSGACCEPTED: RPC_PROGMISMATCH error\n");
+      return EOPNOTSUPP;
+    }
+  else if (tmp == RPC_PROCUNAVAIL)
+    {
+      /* No NFS reply follows, e.g. for a procedure the server lacks */
+
+      nfs_debug_error("RPC_MSGACCEPTED: RPC_PROCUNAVAIL error\n");
+      return EOPNOTSUPP;
+    }
+  else if (tmp > 5)
+    {
+      nfs_debug_error("Unsupported RPC type: %d\n", tmp);
+      return EOPNOTSUPP;
+    }
+
+  return OK;
+}
+
 /****************************************************************************
  * Name: rpcclnt_newxid
  *
@@ -548,6 +864,61 @@ static void rpcclnt_fmtheader(struct rpc_call_header *ch,
   ch->rpc_verf.authlen   = 0;
 }
 
+/****************************************************************************
+ * Name: rpcclnt_close
+ *
+ * Description:
+ *   Close the connection to the server.  Called with rc_lock held.
+ *
+ ****************************************************************************/
+
+static void rpcclnt_close(struct rpcclnt *rpc)
+{
+  if (rpc->rc_so != -1)
+    {
+      /* A socket that another thread is reading from is only shut down
+       * here.  That thread closes it, so that a new socket does not get its
+       * number while it is still in use.
+       */
+
+      if (rpc->rc_receiving && rpc->rc_recvso == rpc->rc_so)
+        {
+          (void)shutdown(rpc->rc_so, SHUT_RDWR);
+          rpc->rc_recvclose = true;
+        }
+      else
+        {
+          (void)lwip_close(rpc->rc_so);
+        }
+
+      rpc->rc_so = -1;
+    }
+
+  /* No replies to pipelined calls can arrive any more, and calls waiting
+   * for a reply must be sent again.
+   */
+
+  while (rpc->rc_stash != NULL)
+    {
+      struct rpc_stash *stash = rpc->rc_stash;
+
+      rpc->rc_stash = stash->rs_next;
+      free(stash);
+    }
+
+  rpc->rc_nstash  = 0;
+  rpc->rc_pending = 0;
+  rpc->rc_gen++;
+}
+
+/****************************************************************************
+ * Name: rpcclnt_reconnect
+ *
+ * Description:
+ *   Connect again to 'saddr'.  Called with rc_lock held.
+ *
+ ****************************************************************************/
+
 static int rpcclnt_reconnect(struct rpcclnt *rpc, struct sockaddr *saddr)
 {
   int errval;
@@ -559,7 +930,7 @@ static int rpcclnt_reconnect(struct rpcclnt *rpc, struct sockaddr *saddr)
   unsigned short trycount = 0;
   struct sockaddr_in sock_in;
 
-  rpcclnt_disconnect(rpc);
+  rpcclnt_close(rpc);
 
   error = socket(rpc->rc_name->sa_family, rpc->rc_sotype, IPPROTO_TCP);
   if (error < 0)
@@ -597,15 +968,152 @@ static int rpcclnt_reconnect(struct rpcclnt *rpc, struct sockaddr *saddr)
   error = connect(rpc->rc_so, saddr, sizeof(*saddr));
   if (error < 0)
     {
-      errval = get_errno();
-      nfs_debug_error("psock_connect failed [port=%d]: %d\n",
-           ntohs(((struct sockaddr_in *)saddr)->sin_port), errval);
-      goto bad;
+      errval = get_errno();
+      nfs_debug_error("psock_connect failed [port=%d]: %d\n",
+           ntohs(((struct sockaddr_in *)saddr)->sin_port), errval);
+      goto bad;
+    }
+  return error;
+bad:
+  rpcclnt_close(rpc);
+  return errval;
+}
+
+/****************************************************************************
+ * Name: rpcclnt_connectport
+ *
+ * Description:
+ *   Connect to another port of the server, given in network byte order.
+ *   Later reconnections of rpcclnt_xmit() go to the same port.
+ *
+ ****************************************************************************/
+
+static int rpcclnt_connectport(struct rpcclnt *rpc, uint16_t port)
+{
+  int error;
+
+  (void)pthread_mutex_lock(&rpc->rc_lock);
+  ((struct sockaddr_in *)rpc->rc_name)->sin_port = port;
+  error = rpcclnt_reconnect(rpc, rpc->rc_name);
+  (void)pthread_mutex_unlock(&rpc->rc_lock);
+
+  return error;
+}
+
+/****************************************************************************
+ * Name: rpcclnt_idle
+ *
+ * Description:
+ *   Tell whether no replies can be on their way to the client.
+ *
+ ****************************************************************************/
+
+static bool rpcclnt_idle(struct rpcclnt *rpc)
+{
+  return !rpc->rc_receiving && rpc->rc_waiters == NULL &&
+         rpc->rc_pending == 0 && rpc->rc_stash == NULL;
+}
+
+/****************************************************************************
+ * Name: rpcclnt_xmit
+ *
+ * Description:
+ *   Send a formatted call, connecting again first if the connection was
+ *   closed.  Called with rc_lock held, which keeps the calls of several
+ *   threads from interleaving on the socket.
+ *
+ ****************************************************************************/
+
+static int rpcclnt_xmit(struct rpcclnt *rpc, int procnum, int prog,
+                        void *request, size_t reqlen)
+{
+  int error;
+
+  if (rpc->rc_shutdown)
+    {
+      return ESHUTDOWN;
+    }
+
+#if (NFS_PROTO_TYPE == NFS_IPPROTO_TCP)
+
+  /* check tcp connection alive or not as server would close connection if
+   * long time no data transfer.  While replies are on their way the socket
+   * is not idle, and the alive check would consume them.
+   */
+
+  if (rpc->rc_so != -1 && rpcclnt_idle(rpc))
+    {
+      error = rpcclnt_alivecheck(rpc);
+      if (error != OK)
+        {
+          nfs_debug_error("rpc_alivecheck failed: %d\n", error);
+          return error;
+        }
+    }
+
+  /* reconnect due to previous connection down */
+
+  if (rpc->rc_so == -1)
+    {
+      error = rpcclnt_reconnect(rpc, rpc->rc_name);
+      if (error != OK)
+        {
+          nfs_debug_error("rpcclnt_reconnect failed: %d\n", error);
+          return error;
+        }
+    }
+#endif
+
+  rpc_statistics(rpcrequests);
+
+  error = rpcclnt_send(rpc, procnum, prog, request, reqlen);
+  if (error != OK)
+    {
+#if (NFS_PROTO_TYPE == NFS_IPPROTO_TCP)
+      rpcclnt_close(rpc);
+#endif
+      nfs_debug_error("rpcclnt_send failed: %d\n", error);
     }
+
   return error;
-bad:
-  rpcclnt_disconnect(rpc);
-  return errval;
+}
+
+/****************************************************************************
+ * Name: rpcclnt_deadline
+ *
+ * Description:
+ *   Set 'ts' to the time by which a reply to a call sent now is due.
+ *
+ ****************************************************************************/
+
+static void rpcclnt_deadline(struct timespec *ts)
+{
+  (void)clock_gettime(CLOCK_REALTIME, ts);
+
+  ts->tv_sec  += CONFIG_NFS_RECV_TIMEOUT / 1000;
+  ts->tv_nsec += (CONFIG_NFS_RECV_TIMEOUT % 1000) * 1000000;
+  if (ts->tv_nsec >= 1000000000)
+    {
+      ts->tv_sec++;
+      ts->tv_nsec -= 1000000000;
+    }
+}
+
+/****************************************************************************
+ * Name: rpcclnt_expired
+ *
+ * Description:
+ *   Tell whether the time in 'ts' has passed.
+ *
+ ****************************************************************************/
+
+static bool rpcclnt_expired(const struct timespec *ts)
+{
+  struct timespec now;
+
+  (void)clock_gettime(CLOCK_REALTIME, &now);
+  return now.tv_sec > ts->tv_sec ||
+         (now.tv_sec == ts->tv_sec && now.tv_nsec >= ts->tv_nsec);
 }
 
 /****************************************************************************
@@ -637,6 +1145,66 @@ void rpcclnt_init(void)
   nfs_debug_info("RPC initialized\n");
 }
 
+/****************************************************************************
+ * Name: rpcclnt_lockinit
+ *
+ * Description:
+ *   Initialize the lock that lets several threads share the RPC client.
+ *
+ * Returned Value:
+ *   Returns zero on success or a (positive) errno value on failure.
+ *
+ ****************************************************************************/
+
+int rpcclnt_lockinit(struct rpcclnt *rpc)
+{
+  int error;
+
+  error = pthread_mutex_init(&rpc->rc_lock, NULL);
+  if (error != OK)
+    {
+      return error;
+    }
+
+  error = pthread_cond_init(&rpc->rc_cond, NULL);
+  if (error != OK)
+    {
+      (void)pthread_mutex_destroy(&rpc->rc_lock);
+    }
+
+  return error;
+}
+
+/****************************************************************************
+ * Name: rpcclnt_lockdestroy
+ *
+ * Description:
+ *   Release what rpcclnt_lockinit() set up.  Calls of rpcclnt_request()
+ *   still in progress fail with ESHUTDOWN, and this waits until they and
+ *   the thread reading the socket have left.  No new calls may be made.
+ *   Calls of rpcclnt_getreply() belong to open files and cannot be in
+ *   progress here.
+ *
+ ****************************************************************************/
+
+void rpcclnt_lockdestroy(struct rpcclnt *rpc)
+{
+  (void)pthread_mutex_lock(&rpc->rc_lock);
+  rpc->rc_shutdown = true;
+  rpcclnt_close(rpc);
+  (void)pthread_cond_broadcast(&rpc->rc_cond);
+
+  while (rpc->rc_waiters != NULL || rpc->rc_receiving)
+    {
+      (void)pthread_cond_wait(&rpc->rc_cond, &rpc->rc_lock);
+    }
+
+  (void)pthread_mutex_unlock(&rpc->rc_lock);
+
+  (void)pthread_cond_destroy(&rpc->rc_cond);
+  (void)pthread_mutex_destroy(&rpc->rc_lock);
+}
+
 /****************************************************************************
  * Name: rpcclnt_connect
  *
@@ -652,7 +1220,6 @@ int rpcclnt_connect(struct rpcclnt *rpc)
   int error;
   struct sockaddr *saddr;
   struct sockaddr_in sin;
-  struct sockaddr_in *sa;
 
   union
   {
@@ -676,12 +1243,17 @@ int rpcclnt_connect(struct rpcclnt *rpc)
 
   saddr = rpc->rc_name;
 
-  /* Create an instance of the socket state structure */
+  /* Create an instance of the socket state structure.  Threads with calls
+   * in progress may see the new socket, so it is set up under rc_lock.
+   */
+
+  (void)pthread_mutex_lock(&rpc->rc_lock);
 
   error = socket(saddr->sa_family, rpc->rc_sotype, NFS_PROTOTYPE);
   if (error < 0)
     {
       nfs_debug_error("psock_socket failed: %d", get_errno());
+      (void)pthread_mutex_unlock(&rpc->rc_lock);
       return -error;
     }
 
@@ -709,7 +1281,7 @@ int rpcclnt_connect(struct rpcclnt *rpc)
   if (error)
     {
       nfs_debug_error("psock_bind failed: %d, port = %d\n", errval, tport);
-      goto bad;
+      goto errout_with_lock;
     }
 
   /* Protocols that do not require connections could be optionally left
@@ -722,9 +1294,11 @@ int rpcclnt_connect(struct rpcclnt *rpc)
     {
       error = get_errno();
       nfs_debug_error("psock_connect to PMAP port failed: %d", error);
-      goto bad;
+      goto errout_with_lock;
     }
 
+  (void)pthread_mutex_unlock(&rpc->rc_lock);
+
   /* Do the RPC to get a dynamic bounding with the server using ppmap.
    * Get port number for MOUNTD.
    */
@@ -743,10 +1317,7 @@ int rpcclnt_connect(struct rpcclnt *rpc)
       goto bad;
     }
 
-  sa = (struct sockaddr_in *)saddr;
-  sa->sin_port = htons(fxdr_unsigned(uint32_t, response.rdata.pmap.port));
-
-  error = rpcclnt_reconnect(rpc, saddr);
+  error = rpcclnt_connectport(rpc, htons(fxdr_unsigned(uint32_t, response.rdata.pmap.port)));
   if (error != 0)
     {
       nfs_error("rpcclnt_reconnect failed: %d\n", error);
@@ -795,9 +1366,7 @@ int rpcclnt_connect(struct rpcclnt *rpc)
    * NFS port in the socket.
    */
 
-  sa->sin_port = htons(PMAPPORT);
-
-  error = rpcclnt_reconnect(rpc, saddr);
+  error = rpcclnt_connectport(rpc, htons(PMAPPORT));
   if (error != 0)
     {
       nfs_error("rpcclnt_reconnect failed: %d\n", error);
@@ -820,9 +1389,7 @@ int rpcclnt_connect(struct rpcclnt *rpc)
       goto bad;
     }
 
-  sa->sin_port = htons(fxdr_unsigned(uint32_t, response.rdata.pmap.port));
-
-  error = rpcclnt_reconnect(rpc, saddr);
+  error = rpcclnt_connectport(rpc, htons(fxdr_unsigned(uint32_t, response.rdata.pmap.port)));
   if (error != 0)
     {
       nfs_error("rpcclnt_reconnect failed: %d\n", error);
@@ -831,6 +1398,11 @@ int rpcclnt_connect(struct rpcclnt *rpc)
 
   return OK;
 
+errout_with_lock:
+  rpcclnt_close(rpc);
+  (void)pthread_mutex_unlock(&rpc->rc_lock);
+  return error;
+
 bad:
   rpcclnt_disconnect(rpc);
   return error;
@@ -840,17 +1412,16 @@ bad:
  * Name: rpcclnt_disconnect
  *
  * Description:
- *   Disconnect from the NFS server.
+ *   Disconnect from the NFS server.  Takes rc_lock, so it must not be called
+ *   from within the RPC client.
  *
  ****************************************************************************/
 
 void rpcclnt_disconnect(struct rpcclnt *rpc)
 {
-  if (rpc->rc_so != -1)
-    {
-      (void)lwip_close(rpc->rc_so);
-      rpc->rc_so = -1;
-    }
+  (void)pthread_mutex_lock(&rpc->rc_lock);
+  rpcclnt_close(rpc);
+  (void)pthread_mutex_unlock(&rpc->rc_lock);
 }
 
 /****************************************************************************
@@ -863,9 +1434,6 @@ void rpcclnt_disconnect(struct rpcclnt *rpc)
 
 int rpcclnt_umount(struct rpcclnt *rpc)
 {
-  struct sockaddr *saddr;
-  struct sockaddr_in *sa;
-
   union
   {
     struct rpc_call_pmap   sdata;
@@ -880,16 +1448,11 @@ int rpcclnt_umount(struct rpcclnt *rpc)
 
   int error;
 
-  saddr = rpc->rc_name;
-  sa = (struct sockaddr_in *)saddr;
-
   /* Do the RPC to get a dynamic bounding with the server using ppmap.
    * Get port number for MOUNTD.
    */
 
-  sa->sin_port = htons(PMAPPORT);
-
-  error = rpcclnt_reconnect(rpc, saddr);
+  error = rpcclnt_connectport(rpc, htons(PMAPPORT));
   if (error != 0)
     {
       nfs_error("rpcclnt_reconnect failed: %d\n", error);
@@ -912,9 +1475,7 @@ int rpcclnt_umount(struct rpcclnt *rpc)
       goto bad;
     }
 
-  sa->sin_port = htons(fxdr_unsigned(uint32_t, response.rdata.pmap.port));
-
-  error = rpcclnt_reconnect(rpc, saddr);
+  error = rpcclnt_connectport(rpc, htons(fxdr_unsigned(uint32_t, response.rdata.pmap.port)));
   if (error != 0)
     {
       nfs_error("rpcclnt_reconnect failed: %d\n", error);
@@ -953,9 +1514,13 @@ bad:
  *
  * Description:
  *   Perform the RPC request.  Logic formats the RPC CALL message and calls
- *   rpcclnt_send to send the RPC CALL message.  It then calls rpcclnt_reply()
- *   to get the response.  It may attempt to re-send the CALL message on
- *   certain errors.
+ *   rpcclnt_send to send the RPC CALL message.  It then waits for the
+ *   response, which either this thread receives or another thread that
+ *   reads the socket at the time hands over.  A call that gets no response
+ *   in time, or whose connection is closed meanwhile, is sent again a
+ *   limited number of times; for TCP, on a new connection.
+ *
+ *   Several threads may have requests outstanding on the same client.
  *
  *   On successful receipt, it verifies the RPC level of the returned values.
  *   (There may still be be NFS layer errors that will be deted by calling
@@ -967,16 +1532,16 @@ int rpcclnt_request(struct rpcclnt *rpc, int procnum, int prog,
                     int version, void *request, size_t reqlen,
                     void *response, size_t resplen)
 {
-  struct rpc_reply_header *replymsg;
-  uint32_t tmp;
-#if (NFS_PROTO_TYPE == NFS_IPPROTO_UDP)
-  int retries;
-#endif
-  int error = 0;
+  struct rpc_waiter   waiter;
+  struct rpc_waiter **prev;
+  struct timespec     deadline;
+  uint32_t            xid;
+  int                 retries = 0;
+  int                 error;
 
-  /* Get a new (non-zero) xid */
-
-  rpc->xid = rpcclnt_newxid();
+  (void)memset_s(&waiter, sizeof(waiter), 0, sizeof(waiter));
+  waiter.rw_response = response;
+  waiter.rw_resplen  = resplen;
 
   /* Get the full size of the message (the size of variable data plus the size of
    * the messages header).
@@ -984,148 +1549,280 @@ int rpcclnt_request(struct rpcclnt *rpc, int procnum, int prog,
 
   reqlen += sizeof(struct rpc_call_header);
 
-  /* Initialize the RPC header fields */
-
-  rpcclnt_fmtheader((struct rpc_call_header *)request,
-                    rpc->xid, prog, version, procnum, reqlen);
+  (void)pthread_mutex_lock(&rpc->rc_lock);
 
-  /* Send the RPC call messsages and receive the RPC response. For UDP-RPC, A limited
-   * number of re-tries will be attempted, but only for the case of response
-   * timeouts. While for TCP-RPC, no retry attempted.
-   */
+  /* Get a new (non-zero) xid and initialize the RPC header fields */
 
-#if (NFS_PROTO_TYPE == NFS_IPPROTO_UDP)
-  retries = 0;
   do
     {
-      /* Do the client side RPC. */
+      waiter.rw_xid = rpcclnt_newxid();
+    }
+  while (waiter.rw_xid == 0);
 
-      rpc_statistics(rpcrequests);
-      rpc->rc_timeout = false;
+  rpcclnt_fmtheader((struct rpc_call_header *)request,
+                    waiter.rw_xid, prog, version, procnum, reqlen);
+
+  /* Send the RPC CALL message */
 
-      /* Send the RPC CALL message */
+  error = rpcclnt_xmit(rpc, procnum, prog, request, reqlen);
+  waiter.rw_gen   = rpc->rc_gen;
+  waiter.rw_next  = rpc->rc_waiters;
+  rpc->rc_waiters = &waiter;
+  rpcclnt_deadline(&deadline);
 
-      error = rpcclnt_send(rpc, procnum, prog, request, reqlen);
-      if (error != OK)
+  /* Wait for the reply from our send */
+
+  while (!waiter.rw_done)
+    {
+      if (rpc->rc_shutdown)
         {
-          nfs_debug_info("ERROR rpcclnt_send failed: %d\n", error);
+          error = ESHUTDOWN;
+          break;
         }
 
-      /* Wait for the reply from our send */
-
-      else
+      if (rpcclnt_expired(&deadline))
         {
-          error = rpcclnt_reply(rpc, procnum, prog, response, resplen);
-          if (error != OK)
+          if (rpc->rc_target == &waiter)
             {
-              nfs_debug_info("ERROR rpcclnt_reply failed: %d\n", error);
+              /* The reply is being received right now */
+
+              rpcclnt_deadline(&deadline);
             }
-        }
+          else if (error == OK)
+            {
+#if (NFS_PROTO_TYPE == NFS_IPPROTO_TCP)
 
-      retries++;
-    }
-  while (rpc->rc_timeout && retries <= rpc->rc_retry);
+              /* Replies over TCP do not get lost; the connection is stuck */
 
-  if (error != OK)
-    {
-      nfs_debug_error("RPC failed: %d\n", error);
-      return error;
-    }
+              if (waiter.rw_gen == rpc->rc_gen)
+                {
+                  rpcclnt_close(rpc);
+                }
+#endif
+              error = EAGAIN;
+            }
+        }
 
-#else
+      /* Only the failures of this call count against its retries, not the
+       * connection being closed because of another one.
+       */
 
-  /* check tcp connection alive or not as server would close connection if long time no data transfer */
+      if (error != OK && ++retries > rpc->rc_retry)
+        {
+          break;
+        }
 
-  if (rpc->rc_so != -1)
-    {
-      error = rpcclnt_alivecheck(rpc);
-      if (error != OK)
+      if (error != OK || waiter.rw_gen != rpc->rc_gen)
         {
-          nfs_debug_error("rpc_alivecheck failed: %d\n", error);
-          return error;
+          nfs_debug_info("rpcclnt_request resends call %u: %d\n",
+                         waiter.rw_xid, error);
+          error = rpcclnt_xmit(rpc, procnum, prog, request, reqlen);
+          waiter.rw_gen = rpc->rc_gen;
+          rpcclnt_deadline(&deadline);
+          continue;
+        }
+
+      if (!rpc->rc_receiving)
+        {
+          (void)rpcclnt_receive(rpc, NULL, 0, &xid);
+        }
+      else
+        {
+          (void)pthread_cond_timedwait(&rpc->rc_cond, &rpc->rc_lock, &deadline);
         }
     }
 
-  /* reconnect due to previous connection down */
+  /* Another thread may still be receiving into 'response' */
 
-  if (rpc->rc_so == -1)
+  while (rpc->rc_target == &waiter)
     {
-      error = rpcclnt_reconnect(rpc, rpc->rc_name);
-      if (error != OK)
-        {
-          nfs_debug_error("rpcclnt_send failed: %d\n", error);
-          return error;
-        }
+      (void)pthread_cond_wait(&rpc->rc_cond, &rpc->rc_lock);
     }
 
-  rpc_statistics(rpcrequests);
+  for (prev = &rpc->rc_waiters; *prev != &waiter; prev = &(*prev)->rw_next);
+  *prev = waiter.rw_next;
 
-  /* Send the RPC CALL message */
+  if (rpc->rc_shutdown)
+    {
+      /* rpcclnt_lockdestroy() waits for the last waiter to leave */
 
-  error = rpcclnt_send(rpc, procnum, prog, request, reqlen);
-  if (error != OK)
+      (void)pthread_cond_broadcast(&rpc->rc_cond);
+    }
+
+  if (waiter.rw_done)
     {
-      rpcclnt_disconnect(rpc);
-      nfs_debug_error("rpcclnt_send failed: %d\n", error);
-      return error;
+      error = waiter.rw_error;
     }
 
-  /* Wait for the reply from our send */
+  (void)pthread_mutex_unlock(&rpc->rc_lock);
 
-  error = rpcclnt_reply(rpc, procnum, prog, response, resplen);
   if (error != OK)
     {
-      rpcclnt_disconnect(rpc);
-      nfs_debug_error("rpcclnt_reply failed: %d\n", error);
+      nfs_debug_error("RPC failed: %d\n", error);
       return error;
     }
 
-#endif
+  if (((struct rpc_reply_header *)response)->rp_direction != rpc_reply)
+    {
+      nfs_debug_error("Different RPC REPLY returned\n");
+      rpc_statistics(rpcinvalid);
+      return EPROTO;
+    }
 
   /* Break down the RPC header and check if it is OK */
 
-  replymsg = (struct rpc_reply_header *)response;
+  return rpcclnt_checkreply((struct rpc_reply_header *)response);
+}
 
-  tmp = fxdr_unsigned(uint32_t, replymsg->type);
-  if (tmp == RPC_MSGDENIED)
+/****************************************************************************
+ * Name: rpcclnt_sendcall
+ *
+ * Description:
+ *   Send an RPC CALL message without waiting for its reply, so that several
+ *   calls can be outstanding at the same time.  The reply is collected
+ *   later with rpcclnt_getreply().
+ *
+ *   If '*xid' is zero, a new xid is assigned and returned in '*xid'.
+ *   Otherwise the call is a retransmission and keeps its xid.
+ *
+ * Returned Value:
+ *   Returns zero on success or a (positive) errno value on failure.
+ *
+ ****************************************************************************/
+
+int rpcclnt_sendcall(struct rpcclnt *rpc, int procnum, int prog,
+                     int version, void *request, size_t reqlen,
+                     uint32_t *xid)
+{
+  int error;
+
+  (void)pthread_mutex_lock(&rpc->rc_lock);
+
+  if (*xid == 0)
     {
-      tmp = fxdr_unsigned(uint32_t, replymsg->status);
-      switch (tmp)
+      do
         {
-        case RPC_MISMATCH:
-          nfs_debug_error("RPC_MSGDENIED: RPC_MISMATCH error\n");
-          return EOPNOTSUPP;
+          *xid = rpcclnt_newxid();
+        }
+      while (*xid == 0);
+    }
 
-        case RPC_AUTHERR:
-          nfs_debug_error("RPC_MSGDENIED: RPC_AUTHERR error\n");
-          return EACCES;
+  reqlen += sizeof(struct rpc_call_header);
+  rpcclnt_fmtheader((struct rpc_call_header *)request,
+                    *xid, prog, version, procnum, reqlen);
 
-        default:
-          return EOPNOTSUPP;
-        }
+  error = rpcclnt_xmit(rpc, procnum, prog, request, reqlen);
+  if (error == OK)
+    {
+      rpc->rc_pending++;
     }
-  else if (tmp != RPC_MSGACCEPTED)
+
+  (void)pthread_mutex_unlock(&rpc->rc_lock);
+  return error;
+}
+
+/****************************************************************************
+ * Name: rpcclnt_getreply
+ *
+ * Description:
+ *   Receive the next reply to any of the calls sent with rpcclnt_sendcall().
+ *   Its xid is returned in '*xid' so that the caller can match it to the
+ *   call.  EAGAIN is returned when nothing arrived in time; it is up to the
+ *   caller to send the calls again.  For TCP, the connection is closed
+ *   first, as the replies to the calls on it will not come any more.
+ *
+ *   Replies to calls of rpcclnt_request() that come in meanwhile are handed
+ *   to their waiters; replies that other threads receive for these calls
+ *   are kept for this function (TCP only).
+ *
+ * Returned Value:
+ *   Returns zero on success or a (positive) errno value on failure.
+ *
+ ****************************************************************************/
+
+int rpcclnt_getreply(struct rpcclnt *rpc, void *response, size_t resplen,
+                     uint32_t *xid)
+{
+  struct rpc_reply_header *replyheader = (struct rpc_reply_header *)response;
+  struct rpc_stash *stash;
+  struct timespec   deadline;
+#if (NFS_PROTO_TYPE == NFS_IPPROTO_TCP)
+  uint32_t          gen;
+#endif
+  int               error = OK;
+
+  *xid = 0;
+
+  (void)pthread_mutex_lock(&rpc->rc_lock);
+
+#if (NFS_PROTO_TYPE == NFS_IPPROTO_TCP)
+  gen = rpc->rc_gen;
+#endif
+  rpcclnt_deadline(&deadline);
+
+  while (*xid == 0)
     {
-      return EOPNOTSUPP;
+      stash = rpc->rc_stash;
+      if (stash != NULL)
+        {
+          rpc->rc_stash = stash->rs_next;
+          rpc->rc_nstash--;
+
+          (void)memcpy_s(response, resplen, stash->rs_reply,
+                         (stash->rs_len < resplen) ? stash->rs_len : resplen);
+          error = (stash->rs_len > resplen) ? ENOBUFS : OK;
+          *xid  = fxdr_unsigned(uint32_t, replyheader->rp_xid);
+          free(stash);
+        }
+      else if (rpcclnt_expired(&deadline))
+        {
+          error = EAGAIN;
+          break;
+        }
+      else if (!rpc->rc_receiving)
+        {
+          error = rpcclnt_receive(rpc, response, resplen, xid);
+          if (error != OK && error != EAGAIN && *xid == 0)
+            {
+              break;
+            }
+        }
+      else
+        {
+          (void)pthread_cond_timedwait(&rpc->rc_cond, &rpc->rc_lock, &deadline);
+        }
     }
 
-  tmp = fxdr_unsigned(uint32_t, replymsg->status);
-  if (tmp == RPC_SUCCESS)
+  if (*xid != 0)
     {
-      nfs_debug_info("RPC_SUCCESS\n");
+      if (rpc->rc_pending > 0)
+        {
+          rpc->rc_pending--;
+        }
     }
-  else if (tmp == RPC_PROGMISMATCH)
+#if (NFS_PROTO_TYPE == NFS_IPPROTO_TCP)
+  else if (gen == rpc->rc_gen)
     {
-      nfs_debug_error("RPC_MSGACCEPTED: RPC_PROGMISMATCH error\n");
-      return EOPNOTSUPP;
+      rpcclnt_close(rpc);
     }
-  else if (tmp > 5)
+#endif
+
+  (void)pthread_mutex_unlock(&rpc->rc_lock);
+
+  if (error == OK && replyheader->rp_direction != rpc_reply)
     {
-      nfs_debug_error("Unsupported RPC type: %d\n", tmp);
-      return EOPNOTSUPP;
+      nfs_debug_error("Different RPC REPLY returned\n");
+      rpc_statistics(rpcinvalid);
+      error = EPROTO;
     }
 
-  return OK;
+  if (error != OK)
+    {
+      nfs_debug_error("rpcclnt_getreply failed: %d\n", error);
+      return error;
+    }
+
+  return rpcclnt_checkreply(replyheader);
 }
 
 void rpcclnt_setuidgid(uint32_t uid, uint32_t gid)
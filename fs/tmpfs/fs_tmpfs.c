@@ -23,6 +23,7 @@
 /****************************************************************************
  * Included Files
  ****************************************************************************/
+#include <stdlib.h>
 #include <string.h>
 #include <fcntl.h>
 #include <errno.h>
@@ -34,13 +35,19 @@
 #include <linux/spinlock.h>
 #include <sys/statfs.h>
 #include "fs/dirent_fs.h"
+#include "fs/driver.h"
 #include "fs/mount.h"
 #include "fs/file.h"
 #include "fs/fs.h"
 #include "los_tables.h"
+#include "los_task.h"
 #include "fs_tmpfs.h"
 #include "los_vm_filemap.h"
+#include "los_vm_map.h"
+#include "los_vm_page.h"
+#include "los_vm_phys.h"
 #include "user_copy.h"
+#include "capability_api.h"
 
 #ifdef LOSCFG_FS_RAMFS
 
@@ -56,6 +63,34 @@
 #  warning CONFIG_FS_TMPFS_FILE_FREEGUARD needs to be > ALLOCGUARD
 #endif
 */
+/* Directories with more entries than this get a hashed name index */
+
+#ifndef CONFIG_FS_TMPFS_DIRHASH_THRESHOLD
+#  define CONFIG_FS_TMPFS_DIRHASH_THRESHOLD 32
+#endif
+
+/* Initial number of buckets, must be a power of two */
+
+#define TMPFS_DIRHASH_MINBUCKETS 64
+
+#ifndef SEEK_DATA
+#  define SEEK_DATA 3
+#endif
+
+#ifndef SEEK_HOLE
+#  define SEEK_HOLE 4
+#endif
+
+#ifndef FALLOC_FL_KEEP_SIZE
+#  define FALLOC_FL_KEEP_SIZE 0x01
+#endif
+
+/* Re-entrant locks are held by a task rather than a process, so that the
+ * threads of one process exclude each other.
+ */
+
+#define tmpfs_self() ((pid_t)LOS_CurTaskIDGet())
+
 #define tmpfs_lock_file(tfo) \
            (tmpfs_lock_object((struct tmpfs_object_s *)tfo))
 #define tmpfs_lock_directory(tdo) \
@@ -77,8 +112,38 @@ static void tmpfs_unlock_reentrant(struct tmpfs_sem_s *sem);
 static void tmpfs_unlock(struct tmpfs_s *fs);
 static void tmpfs_lock_object(struct tmpfs_object_s *to);
 static void tmpfs_unlock_object(struct tmpfs_object_s *to);
+static bool tmpfs_charge(size_t *used, size_t limit, size_t n);
+static void tmpfs_uncharge(size_t *used, size_t n);
+static void tmpfs_pool_init(struct tmpfs_s *fs);
+static void *tmpfs_pool_alloc(enum tmpfs_pool_e pool);
+static void tmpfs_pool_free(enum tmpfs_pool_e pool, void *obj);
+static void tmpfs_pool_drain(struct tmpfs_s *fs);
+static char *tmpfs_alloc_page(void);
+static void tmpfs_free_pages(struct tmpfs_file_s *tfo, size_t first);
+static int  tmpfs_grow_pagetab(struct tmpfs_file_s *tfo, size_t npages);
+static int  tmpfs_alloc_range(struct tmpfs_file_s *tfo, loff_t start,
+              loff_t end);
+static void tmpfs_trim_pages(struct tmpfs_file_s *tfo, size_t size);
+static int  tmpfs_copyout(struct tmpfs_file_s *tfo, char *buffer,
+              loff_t pos, size_t len);
+static off_t tmpfs_seek_data(struct tmpfs_file_s *tfo, off_t offset,
+              bool hole);
+static int  tmpfs_copyin(struct tmpfs_file_s *tfo, const char *buffer,
+              loff_t pos, size_t len);
 static void tmpfs_release_lockedobject(struct tmpfs_object_s *to);
 static void tmpfs_release_lockedfile(struct tmpfs_file_s *tfo);
+static uint32_t tmpfs_hash_name(const char *name);
+static void tmpfs_dirhash_insert(struct tmpfs_directory_s *tdo,
+              struct tmpfs_dirent_s *tde);
+static void tmpfs_dirhash_remove(struct tmpfs_directory_s *tdo,
+              struct tmpfs_dirent_s *tde);
+static int  tmpfs_dirhash_resize(struct tmpfs_directory_s *tdo,
+              uint32_t nbuckets);
+static void tmpfs_dirhash_free(struct tmpfs_directory_s *tdo);
+static int  tmpfs_dirent_setname(struct tmpfs_dirent_s *tde,
+              const char *name);
+static void tmpfs_dirent_putname(struct tmpfs_dirent_s *tde);
+static void tmpfs_free_dirent(struct tmpfs_dirent_s *tde);
 static struct tmpfs_dirent_s *tmpfs_find_dirent(struct tmpfs_directory_s *tdo,
               const char *name);
 static int  tmpfs_remove_dirent(struct tmpfs_directory_s *tdo,
@@ -86,35 +151,40 @@ static int  tmpfs_remove_dirent(struct tmpfs_directory_s *tdo,
 static int  tmpfs_add_dirent(struct tmpfs_directory_s **tdo,
               struct tmpfs_object_s *to, const char *name);
 static struct tmpfs_file_s *tmpfs_alloc_file(void);
+static void tmpfs_free_file(struct tmpfs_file_s *tfo);
 static int tmpfs_create_file(struct tmpfs_s *fs,
                              const char *relpath,
                              struct tmpfs_directory_s *parent_input,
                              struct tmpfs_file_s **tfo);
 
 static struct tmpfs_directory_s *tmpfs_alloc_directory(void);
+static void tmpfs_free_directory(struct tmpfs_directory_s *tdo);
 static int tmpfs_create_directory(struct tmpfs_s *fs,
                                   const char *relpath,
                                   struct tmpfs_directory_s *parent,
                                   struct tmpfs_directory_s **tdo);
 
-static int  tmpfs_find_object(struct tmpfs_s *fs,
-              const char *relpath, struct tmpfs_object_s **object,
-              struct tmpfs_directory_s **parent);
-static int  tmpfs_find_file(struct tmpfs_s *fs,
-              const char *relpath,
-              struct tmpfs_file_s **tfo,
-              struct tmpfs_directory_s **parent);
-static int  tmpfs_find_directory(struct tmpfs_s *fs,
-              const char *relpath,
-              struct tmpfs_directory_s **tdo,
-              struct tmpfs_directory_s **parent);
+static struct tmpfs_directory_s *tmpfs_vnode_directory(struct tmpfs_s *fs,
+              struct Vnode *vp);
+static bool tmpfs_vnode_isancestor(struct Vnode *ancestor,
+              struct Vnode *vp);
 
 /* File system operations */
 
 int tmpfs_close(struct file *filep);
 off_t tmpfs_seek(struct file *filep, off_t offset, int whence);
 int tmpfs_ioctl(struct file *filep, int cmd, unsigned long arg);
+static int tmpfs_export_ioctl(unsigned long arg);
+static int tmpfs_export_access(const char *blkdev);
+static int tmpfs_readdirplus(struct tmpfs_directory_s *tdo,
+              unsigned long arg);
+static int tmpfs_fallocate_common(struct file *filep, int mode,
+              loff_t offset, loff_t len);
+int tmpfs_fallocate(struct file *filep, int mode, off_t offset, off_t len);
+int tmpfs_fallocate64(struct file *filep, int mode, off64_t offset,
+              off64_t len);
 int tmpfs_sync(struct file *filep);
+int tmpfs_mmap(struct file *filep, LosVmMapRegion *region);
 int tmpfs_closedir(struct Vnode *node, struct fs_dirent_s *dir);
 int tmpfs_rewinddir(struct Vnode *vp, struct fs_dirent_s *dir);
 int tmpfs_truncate(struct Vnode *vp, off_t len);
@@ -140,6 +210,15 @@ int tmpfs_statfs(struct Mount *mp, struct statfs *sbp);
 
 static void tmpfs_stat_common(struct tmpfs_object_s *to,
                               struct stat *buf);
+static int  tmpfs_vm_fault(LosVmMapRegion *region, LosVmPgFault *vmf);
+static void tmpfs_vm_remove(LosVmMapRegion *region, LosArchMmu *archMmu,
+              VM_OFFSET_T pgoff);
+static int  tmpfs_parse_size(const char *str, unsigned long long *size);
+static size_t tmpfs_clamp_growth(struct tmpfs_s *fs,
+                                unsigned long long value);
+static int  tmpfs_parse_options(struct tmpfs_s *fs, const char *data,
+                                unsigned long long *growth, char **restore);
+static int  tmpfs_import(struct tmpfs_s *fs, const char *blkdev);
 
 /****************************************************************************
  * Public Data
@@ -174,13 +253,33 @@ struct file_operations_vfs tmpfs_fops = {
     .write = tmpfs_write,
     .read = tmpfs_read,
     .ioctl = tmpfs_ioctl,
-    .mmap = OsVfsFileMmap,
+    .mmap = tmpfs_mmap,
     .close = tmpfs_close,
+    .fallocate = tmpfs_fallocate,
+    .fallocate64 = tmpfs_fallocate64,
     .fsync = tmpfs_sync,
 };
 
 static struct tmpfs_s tmpfs_superblock = {0};
 
+/* Protects g_tmpfs_alloc_unit and tfs_growth, which los_set_ramfs_unit()
+ * may change at any time.  tfs_statlock cannot be used as it is only
+ * initialized at mount.
+ */
+
+static DEFINE_SPINLOCK(g_tmpfs_growthlock);
+
+/* Shared mappings use the file pages themselves instead of page cache
+ * copies.
+ */
+
+static struct VmFileOps tmpfs_vm_ops = {
+    .open = NULL,
+    .close = NULL,
+    .fault = tmpfs_vm_fault,
+    .remove = tmpfs_vm_remove,
+};
+
 /****************************************************************************
  * Name: tmpfs_timestamp
  ****************************************************************************/
@@ -204,7 +303,7 @@ static void tmpfs_lock_reentrant(struct tmpfs_sem_s *sem)
 
   /* Do we already hold the semaphore? */
 
-  me = getpid();
+  me = tmpfs_self();
   if (me == sem->ts_holder)
     {
       /* Yes... just increment the count */
@@ -257,7 +356,7 @@ static void tmpfs_lock_object(struct tmpfs_object_s *to)
 
 static void tmpfs_unlock_reentrant(struct tmpfs_sem_s *sem)
 {
-  DEBUGASSERT(sem->ts_holder == getpid());
+  DEBUGASSERT(sem->ts_holder == tmpfs_self());
 
   /* Is this our last count on the semaphore? */
 
@@ -297,1371 +396,3332 @@ static void tmpfs_unlock_object(struct tmpfs_object_s *to)
 }
 
 /****************************************************************************
- * Name: tmpfs_release_lockedobject
+ * Name: tmpfs_charge
+ *
+ * Description:
+ *   Account for 'n' more units against one of the superblock counters.
+ *   Fails, leaving the counter unchanged, if that would exceed a non-zero
+ *   'limit'.  tmpfs_mount only allows one instance, so the counters always
+ *   live in tmpfs_superblock.
+ *
  ****************************************************************************/
 
-static void tmpfs_release_lockedobject(struct tmpfs_object_s *to)
+static bool tmpfs_charge(size_t *used, size_t limit, size_t n)
 {
-  DEBUGASSERT(to && to->to_refs > 0);
-
-  /* Is this a file object? */
+  struct tmpfs_s *fs = &tmpfs_superblock;
+  bool ok = true;
 
-  if (to->to_type == TMPFS_REGULAR)
+  spin_lock(&fs->tfs_statlock);
+  if (limit != 0 && (*used > limit || n > limit - *used))
     {
-      tmpfs_release_lockedfile((struct tmpfs_file_s *)to);
+      ok = false;
     }
   else
     {
-      if(to->to_refs > 0)
-        {
-          to->to_refs--;
-        }
-      tmpfs_unlock_object(to);
+      *used += n;
     }
+
+  spin_unlock(&fs->tfs_statlock);
+  return ok;
 }
 
 /****************************************************************************
- * Name: tmpfs_release_lockedfile
+ * Name: tmpfs_uncharge
  ****************************************************************************/
 
-static void tmpfs_release_lockedfile(struct tmpfs_file_s *tfo)
+static void tmpfs_uncharge(size_t *used, size_t n)
 {
-  DEBUGASSERT(tfo && tfo->tfo_refs > 0);
+  struct tmpfs_s *fs = &tmpfs_superblock;
 
-  /* If there are no longer any references to the file and the file has been
-   * unlinked from its parent directory, then free the file object now.
-   */
+  spin_lock(&fs->tfs_statlock);
+  DEBUGASSERT(*used >= n);
+  *used -= n;
+  spin_unlock(&fs->tfs_statlock);
+}
 
-  if (tfo->tfo_refs == 1 && (tfo->tfo_flags & TFO_FLAG_UNLINKED) != 0)
-    {
-      sem_destroy(&tfo->tfo_exclsem.ts_sem);
-      kmm_free(tfo->tfo_data);
-      kmm_free(tfo);
-    }
+/****************************************************************************
+ * Name: tmpfs_pool_init
+ *
+ * Description:
+ *   Set up the empty object caches of a new mount.
+ *
+ ****************************************************************************/
 
-  /* Otherwise, just decrement the reference count on the file object */
+static void tmpfs_pool_init(struct tmpfs_s *fs)
+{
+  static const size_t objsize[TMPFS_NPOOLS] =
+  {
+    sizeof(struct tmpfs_file_s),
+    sizeof(struct tmpfs_directory_s),
+    sizeof(struct tmpfs_dirent_s)
+  };
+  int i;
 
-  else
+  (VOID)memset_s(fs->tfs_pools, sizeof(fs->tfs_pools), 0,
+                 sizeof(fs->tfs_pools));
+  for (i = 0; i < TMPFS_NPOOLS; i++)
     {
-      if(tfo->tfo_refs > 0)
-        {
-          tfo->tfo_refs--;
-        }
-      tmpfs_unlock_file(tfo);
+      fs->tfs_pools[i].tp_info.tpi_objsize = objsize[i];
     }
 }
 
 /****************************************************************************
- * Name: tmpfs_find_dirent
+ * Name: tmpfs_pool_alloc
+ *
+ * Description:
+ *   Allocate one object, reusing a cached one when there is any.  Returns
+ *   NULL if the heap is exhausted.
+ *
  ****************************************************************************/
 
-static struct tmpfs_dirent_s *tmpfs_find_dirent(struct tmpfs_directory_s *tdo,
-                                                const char *name)
+static void *tmpfs_pool_alloc(enum tmpfs_pool_e pool)
 {
-  LOS_DL_LIST *node;
-  struct tmpfs_dirent_s *tde;
+  struct tmpfs_s *fs = &tmpfs_superblock;
+  struct tmpfs_pool_s *tp = &fs->tfs_pools[pool];
+  struct tmpfs_poolobj_s *obj;
+  size_t objsize;
 
-  /* Search the list of directory entries for a match */
+  spin_lock(&fs->tfs_statlock);
+  obj = tp->tp_free;
+  if (obj != NULL)
+    {
+      tp->tp_free = obj->tpo_next;
+      tp->tp_info.tpi_free--;
+      tp->tp_info.tpi_hits++;
+    }
+  else
+    {
+      tp->tp_info.tpi_misses++;
+    }
 
-  for (node = tdo->tdo_entry.pstNext; node != &tdo->tdo_entry; node = node->pstNext)
+  if (++tp->tp_info.tpi_inuse > tp->tp_info.tpi_peak)
     {
-      tde = (struct tmpfs_dirent_s *)node;
-      if (tde->tde_inuse == true && strcmp(tde->tde_name, name) == 0)
+      tp->tp_info.tpi_peak = tp->tp_info.tpi_inuse;
+    }
+
+  objsize = tp->tp_info.tpi_objsize;
+  spin_unlock(&fs->tfs_statlock);
+
+  if (obj == NULL)
+    {
+      obj = (struct tmpfs_poolobj_s *)kmm_malloc(objsize);
+      if (obj == NULL)
         {
-          return tde;
+          spin_lock(&fs->tfs_statlock);
+          tp->tp_info.tpi_inuse--;
+          spin_unlock(&fs->tfs_statlock);
         }
     }
 
-  /* Return NULL if not found */
-
-  return NULL;
+  return obj;
 }
 
 /****************************************************************************
- * Name: tmpfs_remove_dirent
+ * Name: tmpfs_pool_free
+ *
+ * Description:
+ *   Return an object to its cache, or to the heap if the cache is full.
+ *
  ****************************************************************************/
 
-static int tmpfs_remove_dirent(struct tmpfs_directory_s *tdo,
-                               struct tmpfs_object_s *to)
+static void tmpfs_pool_free(enum tmpfs_pool_e pool, void *obj)
 {
-  struct tmpfs_dirent_s *tde;
-
-  /* Search the list of directory entries for a match */
+  struct tmpfs_s *fs = &tmpfs_superblock;
+  struct tmpfs_pool_s *tp = &fs->tfs_pools[pool];
+  struct tmpfs_poolobj_s *tpo = (struct tmpfs_poolobj_s *)obj;
 
-  tde = to->to_dirent;
-  if (tde == NULL)
+  spin_lock(&fs->tfs_statlock);
+  DEBUGASSERT(tp->tp_info.tpi_inuse > 0);
+  tp->tp_info.tpi_inuse--;
+  if (tp->tp_info.tpi_free < CONFIG_FS_TMPFS_POOL_MAX)
     {
-      return -ENONET;
+      tpo->tpo_next = tp->tp_free;
+      tp->tp_free   = tpo;
+      tp->tp_info.tpi_free++;
+      tpo = NULL;
     }
 
-  /* Free the object name */
+  spin_unlock(&fs->tfs_statlock);
 
-  if (tde->tde_name != NULL)
+  if (tpo != NULL)
     {
-      kmm_free(tde->tde_name);
-      tde->tde_name = NULL;
+      kmm_free(tpo);
     }
+}
 
-  if (tdo->tdo_count == 0)
-    {
-      LOS_ListDelete(&tde->tde_node);
-      kmm_free(tde);
-    }
-  else
-    {
-      tde->tde_inuse = false;
-      tde->tde_object = NULL;
-    }
-  if(tdo->tdo_nentries > 0)
+/****************************************************************************
+ * Name: tmpfs_pool_drain
+ *
+ * Description:
+ *   Give all cached objects back to the heap.  Called on unmount.
+ *
+ ****************************************************************************/
+
+static void tmpfs_pool_drain(struct tmpfs_s *fs)
+{
+  struct tmpfs_poolobj_s *obj;
+  int i;
+
+  for (i = 0; i < TMPFS_NPOOLS; i++)
     {
-      tdo->tdo_nentries--;
+      while ((obj = fs->tfs_pools[i].tp_free) != NULL)
+        {
+          fs->tfs_pools[i].tp_free = obj->tpo_next;
+          kmm_free(obj);
+        }
+
+      fs->tfs_pools[i].tp_info.tpi_free = 0;
     }
-  return OK;
 }
 
 /****************************************************************************
- * Name: tmpfs_add_dirent
+ * Name: tmpfs_alloc_page
+ *
+ * Description:
+ *   Allocate one zero-filled page of file data.  Pages come from the
+ *   physical page allocator so that large files do not fragment the heap.
+ *   Returns NULL if the page would exceed the size= limit of the mount.
+ *
+ *   The file holds one reference on the page and every shared mapping of
+ *   it holds another, so a page that is still mapped outlives truncation
+ *   or deletion of the file.
+ *
  ****************************************************************************/
 
-static int tmpfs_add_dirent(struct tmpfs_directory_s **tdo,
-                            struct tmpfs_object_s *to,
-                            const char *name)
+static char *tmpfs_alloc_page(void)
 {
-  struct tmpfs_directory_s *parent;
-  struct tmpfs_dirent_s *tde;
-  char *newname;
-
-  /* Copy the name string so that it will persist as long as the
-   * directory entry.
-   */
+  struct tmpfs_s *fs = &tmpfs_superblock;
+  LosVmPage *vmpage;
+  char *page;
 
-  newname = strdup(name);
-  if (newname == NULL)
+  if (!tmpfs_charge(&fs->tfs_npages, fs->tfs_maxpages, 1))
     {
-      return -ENOSPC;
+      return NULL;
     }
 
-  tde = (struct tmpfs_dirent_s *)malloc(sizeof(struct tmpfs_dirent_s));
-  if (tde == NULL)
+  vmpage = LOS_PhysPageAlloc();
+  if (vmpage == NULL)
     {
-      free(newname);
-      return -ENOSPC;
+      tmpfs_uncharge(&fs->tfs_npages, 1);
+      return NULL;
     }
 
-  tde->tde_object = to;
-  tde->tde_name   = newname;
-  tde->tde_inuse  = true;
-  to->to_dirent   = tde;
-
-  /* Save the new object info in the new directory entry */
-
-  parent = *tdo;
-  LOS_ListTailInsert(&parent->tdo_entry, &tde->tde_node);
-  parent->tdo_nentries++;
-
-  /* Update directory times */
-
-  parent->tdo_ctime = parent->tdo_mtime = tmpfs_timestamp();
-
-  return OK;
+  LOS_AtomicSet(&vmpage->refCounts, 1);
+  page = (char *)OsVmPageToVaddr(vmpage);
+  (void)memset_s(page, TMPFS_PAGE_SIZE, 0, TMPFS_PAGE_SIZE);
+  return page;
 }
 
 /****************************************************************************
- * Name: tmpfs_alloc_file
+ * Name: tmpfs_free_pages
+ *
+ * Description:
+ *   Free the data pages from page index 'first' onwards.  Freeing from
+ *   index zero releases the page table as well.
+ *
  ****************************************************************************/
 
-static struct tmpfs_file_s *tmpfs_alloc_file(void)
+static void tmpfs_free_pages(struct tmpfs_file_s *tfo, size_t first)
 {
-  struct tmpfs_file_s *tfo;
-  size_t allocsize;
+  size_t nfreed = 0;
+  size_t i;
 
-  /* Create a new zero length file object */
-
-  allocsize = sizeof(struct tmpfs_file_s);
-  tfo = (struct tmpfs_file_s *)kmm_malloc(allocsize);
-  if (tfo == NULL)
+  for (i = first; i < tfo->tfo_npages; i++)
     {
-      return NULL;
+      if (tfo->tfo_pages[i] != NULL)
+        {
+          LOS_PhysPageFree(OsVmVaddrToPage(tfo->tfo_pages[i]));
+          tfo->tfo_pages[i] = NULL;
+          nfreed++;
+        }
     }
 
-  /* Initialize the new file object.  NOTE that the initial state is
-   * locked with one reference count.
-   */
-
-  tfo->tfo_atime = tmpfs_timestamp();
-  tfo->tfo_mtime = tfo->tfo_atime;
-  tfo->tfo_ctime = tfo->tfo_atime;
-  tfo->tfo_type  = TMPFS_REGULAR;
-  tfo->tfo_refs  = 1;
-  tfo->tfo_flags = 0;
-  tfo->tfo_size  = 0;
-  tfo->tfo_data  = NULL;
-
-  tfo->tfo_exclsem.ts_holder = getpid();
-  tfo->tfo_exclsem.ts_count  = 1;
-  if (sem_init(&tfo->tfo_exclsem.ts_sem, 0, 0) != 0)
+  if (nfreed > 0)
     {
-      PRINT_ERR("%s %d, sem_init failed!\n", __FUNCTION__, __LINE__);
-      kmm_free(tfo);
-      return NULL;
+      tfo->tfo_nalloc -= nfreed;
+      tmpfs_uncharge(&tmpfs_superblock.tfs_npages, nfreed);
     }
 
-  return tfo;
+  if (first == 0 && tfo->tfo_pages != NULL)
+    {
+      kmm_free(tfo->tfo_pages);
+      tfo->tfo_pages  = NULL;
+      tfo->tfo_npages = 0;
+    }
 }
 
 /****************************************************************************
- * Name: tmpfs_create_file
+ * Name: tmpfs_grow_pagetab
+ *
+ * Description:
+ *   Make room for at least 'npages' entries in the page table.  The table
+ *   doubles in size so that only the pointers are ever copied, and that
+ *   rarely.
+ *
  ****************************************************************************/
 
-static int tmpfs_create_file(struct tmpfs_s *fs,
-                             const char *relpath,
-                             struct tmpfs_directory_s *parent_input,
-                             struct tmpfs_file_s **tfo)
+static int tmpfs_grow_pagetab(struct tmpfs_file_s *tfo, size_t npages)
 {
-  struct tmpfs_directory_s *parent;
-  struct tmpfs_file_s *newtfo;
-  struct tmpfs_dirent_s *tde;
-  char *copy;
-  int ret;
-
-  /* Duplicate the path variable so that we can modify it */
+  char **pages;
+  size_t nentries;
 
-  copy = strdup(relpath);
-  if (copy == NULL)
+  if (npages <= tfo->tfo_npages)
     {
-      return -ENOSPC;
+      return OK;
     }
 
-  /* Separate the path into the file name and the path to the parent
-   * directory.
-   */
-  if (parent_input == NULL)
+  if (npages > (SIZE_MAX / sizeof(char *)) / 2)
     {
-      /* No subdirectories... use the root directory */
-      parent = (struct tmpfs_directory_s *)fs->tfs_root.tde_object;
+      return -EFBIG;
     }
-  else
+
+  nentries = (tfo->tfo_npages > 0) ? tfo->tfo_npages : 8;
+  while (nentries < npages)
     {
-      parent = parent_input;
+      nentries <<= 1;
     }
-  if (parent == NULL)
+
+  pages = (char **)kmm_malloc(nentries * sizeof(char *));
+  if (pages == NULL)
     {
-      ret = -EEXIST;
-      goto errout_with_copy;
+      return -ENOSPC;
     }
-  tmpfs_lock_directory(parent);
-  parent->tdo_refs++;
 
-  /* Verify that no object of this name already exists in the directory */
-  tde = tmpfs_find_dirent(parent, copy);
-  if (tde != NULL)
+  (void)memset_s(pages, nentries * sizeof(char *), 0, nentries * sizeof(char *));
+  if (tfo->tfo_npages > 0)
     {
-      /* Something with this name already exists in the directory.
-       * OR perhaps some fatal error occurred.
-       */
-
-      ret = -EEXIST;
-      goto errout_with_parent;
+      (void)memcpy_s(pages, nentries * sizeof(char *), tfo->tfo_pages,
+                     tfo->tfo_npages * sizeof(char *));
+      kmm_free(tfo->tfo_pages);
     }
 
-  /* Allocate an empty file.  The initial state of the file is locked with one
-   * reference count.
-   */
+  tfo->tfo_pages  = pages;
+  tfo->tfo_npages = nentries;
+  return OK;
+}
 
-  newtfo = tmpfs_alloc_file();
-  if (newtfo == NULL)
+/****************************************************************************
+ * Name: tmpfs_alloc_range
+ *
+ * Description:
+ *   Make sure that every page overlapping the byte range [start, end) is
+ *   present.  Only ranges that are about to be written are allocated;
+ *   everything else stays a hole.
+ *
+ *   The missing pages are all allocated before any of them is put into the
+ *   page table, chained through their first bytes meanwhile.  If the mount
+ *   runs out of space part way, they are freed again and the file is left
+ *   as it was.
+ *
+ ****************************************************************************/
+
+static int tmpfs_alloc_range(struct tmpfs_file_s *tfo, loff_t start,
+                             loff_t end)
+{
+  char *chain = NULL;
+  char *page;
+  size_t nalloc = 0;
+  loff_t first;
+  loff_t last;
+  loff_t i;
+  int ret;
+
+  if (start < 0 || (unsigned long long)end > SIZE_MAX)
     {
-      ret = -ENOSPC;
-      goto errout_with_parent;
+      return -EFBIG;
     }
 
-  /* Then add the new, empty file to the directory */
+  first = start >> TMPFS_PAGE_SHIFT;
+  last  = (end + TMPFS_PAGE_MASK) >> TMPFS_PAGE_SHIFT;
 
-  ret = tmpfs_add_dirent(&parent, (struct tmpfs_object_s *)newtfo, copy);
+  ret = tmpfs_grow_pagetab(tfo, (size_t)last);
   if (ret < 0)
     {
-      goto errout_with_file;
+      return ret;
     }
 
-  /* Release the reference and lock on the parent directory */
-  if (parent->tdo_refs > 0)
+  for (i = first; i < last; i++)
     {
-      parent->tdo_refs--;
-    }
-  tmpfs_unlock_directory(parent);
+      if (tfo->tfo_pages[i] != NULL)
+        {
+          continue;
+        }
 
-  /* Free the copy of the relpath and return success */
+      page = tmpfs_alloc_page();
+      if (page == NULL)
+        {
+          while ((page = chain) != NULL)
+            {
+              chain = *(char **)page;
+              LOS_PhysPageFree(OsVmVaddrToPage(page));
+            }
 
-  kmm_free(copy);
-  *tfo = newtfo;
-  return OK;
-
-  /* Error exits */
+          tmpfs_uncharge(&tmpfs_superblock.tfs_npages, nalloc);
+          return -ENOSPC;
+        }
 
-errout_with_file:
-  sem_destroy(&newtfo->tfo_exclsem.ts_sem);
-  kmm_free(newtfo);
+      *(char **)page = chain;
+      chain = page;
+      nalloc++;
+    }
 
-errout_with_parent:
-  if (parent->tdo_refs > 0)
-  {
-    parent->tdo_refs--;
-  }
-  tmpfs_unlock_directory(parent);
+  for (i = last - 1; chain != NULL; i--)
+    {
+      if (tfo->tfo_pages[i] == NULL)
+        {
+          page  = chain;
+          chain = *(char **)page;
+          *(char **)page = NULL;
+          tfo->tfo_pages[i] = page;
+        }
+    }
 
-errout_with_copy:
-  kmm_free(copy);
-  return ret;
+  tfo->tfo_nalloc += nalloc;
+  return OK;
 }
 
 /****************************************************************************
- * Name: tmpfs_alloc_directory
+ * Name: tmpfs_trim_pages
+ *
+ * Description:
+ *   Drop the pages that lie wholly beyond 'size' and clear the tail of the
+ *   last partial page, so that a later extension reads back zeros.
+ *
  ****************************************************************************/
 
-static struct tmpfs_directory_s *tmpfs_alloc_directory(void)
+static void tmpfs_trim_pages(struct tmpfs_file_s *tfo, size_t size)
 {
-  struct tmpfs_directory_s *tdo;
-  size_t allocsize;
+  size_t pgndx = size >> TMPFS_PAGE_SHIFT;
+  size_t pgoff = size & TMPFS_PAGE_MASK;
 
-  allocsize = sizeof(struct tmpfs_directory_s);
-  tdo = (struct tmpfs_directory_s *)kmm_malloc(allocsize);
-  if (tdo == NULL)
+  if (pgoff != 0)
     {
-      return NULL;
-    }
-
-  /* Initialize the new directory object */
-
-  tdo->tdo_atime    = tmpfs_timestamp();
-  tdo->tdo_mtime    = tdo->tdo_mtime;
-  tdo->tdo_ctime    =  tdo->tdo_mtime;
-  tdo->tdo_type     = TMPFS_DIRECTORY;
-  tdo->tdo_refs     = 0;
-  tdo->tdo_nentries = 0;
-  tdo->tdo_count    = 0;
-  LOS_ListInit(&tdo->tdo_entry);
+      if (pgndx < tfo->tfo_npages && tfo->tfo_pages[pgndx] != NULL)
+        {
+          (void)memset_s(tfo->tfo_pages[pgndx] + pgoff, TMPFS_PAGE_SIZE - pgoff,
+                         0, TMPFS_PAGE_SIZE - pgoff);
+        }
 
-  tdo->tdo_exclsem.ts_holder = TMPFS_NO_HOLDER;
-  tdo->tdo_exclsem.ts_count  = 0;
-  if (sem_init(&tdo->tdo_exclsem.ts_sem, 0, 1) != 0)
-    {
-      PRINT_ERR("%s %d, sem_init failed!\n", __FUNCTION__, __LINE__);
-      kmm_free(tdo);
-      return NULL;
+      pgndx++;
     }
-  return tdo;
+
+  tmpfs_free_pages(tfo, pgndx);
 }
 
 /****************************************************************************
- * Name: tmpfs_create_directory
+ * Name: tmpfs_copyout
+ *
+ * Description:
+ *   Copy 'len' bytes of file data starting at 'pos' to a kernel or user
+ *   buffer, one page-sized run at a time.  Holes read back as zeros.
+ *
  ****************************************************************************/
 
-static int tmpfs_create_directory(struct tmpfs_s *fs,
-                                  const char *relpath,
-                                  struct tmpfs_directory_s *parent_input,
-                                  struct tmpfs_directory_s **tdo)
+static int tmpfs_copyout(struct tmpfs_file_s *tfo, char *buffer,
+                         loff_t pos, size_t len)
 {
-  struct tmpfs_directory_s *parent;
-  struct tmpfs_directory_s *newtdo;
-  struct tmpfs_dirent_s *tde;
-  char *copy;
+  size_t pgndx;
+  size_t pgoff;
+  size_t nbytes;
+  char *page;
   int ret;
 
-  /* Duplicate the path variable so that we can modify it */
-
-  copy = strdup(relpath);
-  if (copy == NULL)
-    {
-      return -ENOSPC;
-    }
-
-  /* Separate the path into the file name and the path to the parent
-   * directory.
-   */
-  if (parent_input == NULL)
-    {
-      /* No subdirectories... use the root directory */
-
-      parent = (struct tmpfs_directory_s *)fs->tfs_root.tde_object;
-    }
-  else
+  while (len > 0)
     {
-      parent = parent_input;
-    }
+      pgndx  = pos >> TMPFS_PAGE_SHIFT;
+      pgoff  = pos & TMPFS_PAGE_MASK;
+      page   = (pgndx < tfo->tfo_npages) ? tfo->tfo_pages[pgndx] : NULL;
+      nbytes = TMPFS_PAGE_SIZE - pgoff;
+      if (nbytes > len)
+        {
+          nbytes = len;
+        }
 
-  /* Verify that no object of this name already exists in the directory */
-  if (parent == NULL)
-    {
-      ret = -EEXIST;
-      goto errout_with_copy;
-    }
-  tmpfs_lock_directory(parent);
-  parent->tdo_refs++;
-  tde = tmpfs_find_dirent(parent, copy);
-  if (tde != NULL)
-    {
-      /* Something with this name already exists in the directory.
-       * OR perhaps some fatal error occurred.
-       */
+      if (page == NULL)
+        {
+          ret = LOS_UserMemClear((unsigned char *)buffer, nbytes);
+        }
+      else
+        {
+          ret = LOS_CopyFromKernel(buffer, nbytes, page + pgoff, nbytes);
+        }
 
-      ret = -EEXIST;
+      if (ret != 0)
+        {
+          return -EFAULT;
+        }
 
-      goto errout_with_parent;
+      buffer += nbytes;
+      pos    += nbytes;
+      len    -= nbytes;
     }
 
-  /* Allocate an empty directory object.  NOTE that there is no reference on
-   * the new directory and the object is not locked.
-   */
-
-  newtdo = tmpfs_alloc_directory();
-  if (newtdo == NULL)
-    {
-      ret = -ENOSPC;
-      goto errout_with_parent;
-    }
+  return OK;
+}
 
-  /* Then add the new, empty file to the directory */
+/****************************************************************************
+ * Name: tmpfs_copyin
+ *
+ * Description:
+ *   Copy 'len' bytes from a kernel or user buffer into the file at 'pos'.
+ *   The pages covering the range must already be present.
+ *
+ ****************************************************************************/
 
-  ret = tmpfs_add_dirent(&parent, (struct tmpfs_object_s *)newtdo, copy);
-  if (ret < 0)
-    {
-      goto errout_with_directory;
-    }
+static int tmpfs_copyin(struct tmpfs_file_s *tfo, const char *buffer,
+                        loff_t pos, size_t len)
+{
+  size_t pgoff;
+  size_t nbytes;
+  char *page;
 
-  /* Free the copy of the relpath, release our reference to the parent directory,
-   * and return success
-   */
-  if (parent->tdo_refs > 0)
+  while (len > 0)
     {
-      parent->tdo_refs--;
-    }
-  tmpfs_unlock_directory(parent);
-  kmm_free(copy);
+      page   = tfo->tfo_pages[pos >> TMPFS_PAGE_SHIFT];
+      pgoff  = pos & TMPFS_PAGE_MASK;
+      nbytes = TMPFS_PAGE_SIZE - pgoff;
+      if (nbytes > len)
+        {
+          nbytes = len;
+        }
 
-  /* Return the (unlocked, unreferenced) directory object to the caller */
+      DEBUGASSERT(page != NULL);
+      if (LOS_CopyToKernel(page + pgoff, nbytes, buffer, nbytes) != 0)
+        {
+          return -EFAULT;
+        }
 
-  if (tdo != NULL)
-    {
-      *tdo = newtdo;
+      buffer += nbytes;
+      pos    += nbytes;
+      len    -= nbytes;
     }
 
   return OK;
-
-  /* Error exits */
-
-errout_with_directory:
-  sem_destroy(&newtdo->tdo_exclsem.ts_sem);
-  kmm_free(newtdo);
-
-errout_with_parent:
-  if (parent->tdo_refs > 0)
-    {
-      parent->tdo_refs--;
-    }
-  tmpfs_unlock_directory(parent);
-
-errout_with_copy:
-  kmm_free(copy);
-  return ret;
 }
 
 /****************************************************************************
- * Name: tmpfs_find_object
+ * Name: tmpfs_seek_data
+ *
+ * Description:
+ *   Return the first offset at or after 'offset' that lies in data, or in
+ *   a hole if 'hole' is true.  The end of the file counts as a hole.
+ *   Returns -ENXIO if 'offset' is at or beyond the end of the file.
+ *
  ****************************************************************************/
 
-static int tmpfs_find_object(struct tmpfs_s *fs,
-                             const char *relpath,
-                             struct tmpfs_object_s **object,
-                             struct tmpfs_directory_s **parent)
+static off_t tmpfs_seek_data(struct tmpfs_file_s *tfo, off_t offset,
+                             bool hole)
 {
-  struct tmpfs_object_s *to = NULL;
-  struct tmpfs_dirent_s *tde;
-  struct tmpfs_directory_s *tdo = NULL;
-  struct tmpfs_directory_s *next_tdo;
-  char *segment;
-  char *next_segment;
-  char *tkptr;
-  char *copy;
+  size_t pgndx;
+  size_t lastpg;
+  bool   isdata;
 
-  /* Make a copy of the path (so that we can modify it via strtok) */
-
-  copy = strdup(relpath);
-  if (copy == NULL)
+  if (offset < 0 || offset >= tfo->tfo_size)
     {
-      return -ENOSPC;
+      return -ENXIO;
     }
 
-  /* Traverse the file system for any object with the matching name */
-
-  to       = fs->tfs_root.tde_object;
-  next_tdo = (struct tmpfs_directory_s *)fs->tfs_root.tde_object;
-  tdo      = next_tdo;
-  for (segment =  strtok_r(copy, "/", &tkptr);
-       segment != NULL;
-       segment = next_segment)
+  lastpg = (tfo->tfo_size + TMPFS_PAGE_MASK) >> TMPFS_PAGE_SHIFT;
+  for (pgndx = offset >> TMPFS_PAGE_SHIFT; pgndx < lastpg; pgndx++)
     {
-      /* Get the next segment after the one we are currently working on.
-       * This will be NULL is we are working on the final segment of the
-       * relpath.
-       */
-
-      next_segment = strtok_r(NULL, "/", &tkptr);
-
-      /* Search the next directory. */
-
-      tdo = next_tdo;
-
-      /* Find the TMPFS object with the next segment name in the current
-       * directory.
-       */
-
-      tde = tmpfs_find_dirent(tdo, segment);
-      if (tde == NULL)
-        {
-          /* No object with this name exists in the directory. */
-
-          kmm_free(copy);
-          return -ENOENT;
-        }
-
-      to = tde->tde_object;
-
-      /* Is this object another directory? */
-
-      if (to->to_type != TMPFS_DIRECTORY)
+      isdata = pgndx < tfo->tfo_npages && tfo->tfo_pages[pgndx] != NULL;
+      if (isdata != hole)
         {
-          /* No.  Was this the final segment in the path? */
-
-          if (next_segment == NULL)
+          if (((off_t)pgndx << TMPFS_PAGE_SHIFT) > offset)
             {
-              /* Then we can break out of the loop now */
-
-               break;
+              offset = (off_t)pgndx << TMPFS_PAGE_SHIFT;
             }
 
-          /* No, this was not the final segement of the relpath.
-           * We cannot continue the search if any of the intermediate
-           * segments do no correspond to directories.
-           */
-
-          kmm_free(copy);
-          return -ENOTDIR;
+          return offset;
         }
-
-      /* Search this directory for the next segement.  If we
-       * exit the loop, tdo will still refer to the parent
-       * directory of to.
-       */
-
-      next_tdo = (struct tmpfs_directory_s *)to;
     }
 
-  /* When we exit this loop (successfully), to will point to the TMPFS
-   * object associated with the terminal segment of the relpath.
-   * Increment the reference count on the located object.
-   */
-
-  /* Free the dup'ed string */
+  /* Ran off the end of the file: that is a hole but never data */
 
-  kmm_free(copy);
+  return hole ? (off_t)tfo->tfo_size : -ENXIO;
+}
 
-  /* Return what we found */
+/****************************************************************************
+ * Name: tmpfs_release_lockedobject
+ ****************************************************************************/
 
-  if (parent)
-    {
-      if (tdo != NULL)
-        {
-          /* Get exclusive access to the parent and increment the reference
-           * count on the object.
-           */
+static void tmpfs_release_lockedobject(struct tmpfs_object_s *to)
+{
+  DEBUGASSERT(to && to->to_refs > 0);
 
-          tmpfs_lock_directory(tdo);
-          tdo->tdo_refs++;
-        }
+  /* Is this a file object? */
 
-      *parent = tdo;
+  if (to->to_type == TMPFS_REGULAR)
+    {
+      tmpfs_release_lockedfile((struct tmpfs_file_s *)to);
     }
-
-  if (object)
+  else
     {
-      if (to != NULL)
+      if(to->to_refs > 0)
         {
-          /* Get exclusive access to the object and increment the reference
-           * count on the object.
-           */
-
-          tmpfs_lock_object(to);
-          to->to_refs++;
+          to->to_refs--;
         }
-
-      *object = to;
+      tmpfs_unlock_object(to);
     }
-
-  return OK;
 }
 
 /****************************************************************************
- * Name: tmpfs_find_file
+ * Name: tmpfs_release_lockedfile
  ****************************************************************************/
 
-static int tmpfs_find_file(struct tmpfs_s *fs,
-                           const char *relpath,
-                           struct tmpfs_file_s **tfo,
-                           struct tmpfs_directory_s **parent)
+static void tmpfs_release_lockedfile(struct tmpfs_file_s *tfo)
 {
-  struct tmpfs_object_s *to;
-  int ret;
+  DEBUGASSERT(tfo && tfo->tfo_refs > 0);
 
-  /* Find the object at this path.  If successful, tmpfs_find_object() will
-   * lock both the object and the parent directory and will increment the
-   * reference count on both.
+  /* If there are no longer any references to the file and the file has been
+   * unlinked from its parent directory, then free the file object now.
    */
 
-  ret = tmpfs_find_object(fs, relpath, &to, parent);
-  if (ret >= 0)
+  if (tfo->tfo_refs == 1 && (tfo->tfo_flags & TFO_FLAG_UNLINKED) != 0)
     {
-      /* We found it... but is it a regular file? */
+      tmpfs_free_file(tfo);
+    }
+
+  /* Otherwise, just decrement the reference count on the file object */
 
-      if (to->to_type != TMPFS_REGULAR)
+  else
+    {
+      if(tfo->tfo_refs > 0)
         {
-          /* No... unlock the object and its parent and return an error */
+          tfo->tfo_refs--;
+        }
+      tmpfs_unlock_file(tfo);
+    }
+}
 
-          tmpfs_release_lockedobject(to);
+/****************************************************************************
+ * Name: tmpfs_hash_name
+ *
+ * Description:
+ *   32-bit FNV-1a hash of a directory entry name.
+ *
+ ****************************************************************************/
 
-          if (parent)
-            {
-              struct tmpfs_directory_s *tdo = *parent;
+static uint32_t tmpfs_hash_name(const char *name)
+{
+  uint32_t hash = 2166136261u;
 
-              tdo->tdo_refs--;
-              tmpfs_unlock_directory(tdo);
-            }
+  while (*name != '\0')
+    {
+      hash ^= (uint8_t)*name++;
+      hash *= 16777619u;
+    }
 
-          ret = -EISDIR;
-        }
+  return hash;
+}
 
-      /* Return the verified file object */
+/****************************************************************************
+ * Name: tmpfs_dirhash_insert
+ ****************************************************************************/
 
-      *tfo = (struct tmpfs_file_s *)to;
-    }
+static void tmpfs_dirhash_insert(struct tmpfs_directory_s *tdo,
+                                 struct tmpfs_dirent_s *tde)
+{
+  uint32_t bucket = tde->tde_hash & (tdo->tdo_nbuckets - 1);
 
-  return ret;
+  tde->tde_hnext        = tdo->tdo_hash[bucket];
+  tdo->tdo_hash[bucket] = tde;
 }
 
 /****************************************************************************
- * Name: tmpfs_find_directory
+ * Name: tmpfs_dirhash_remove
  ****************************************************************************/
 
-static int tmpfs_find_directory(struct tmpfs_s *fs,
-                           const char *relpath,
-                           struct tmpfs_directory_s **tdo,
-                           struct tmpfs_directory_s **parent)
+static void tmpfs_dirhash_remove(struct tmpfs_directory_s *tdo,
+                                 struct tmpfs_dirent_s *tde)
 {
-  struct tmpfs_object_s *to;
-  int ret;
+  struct tmpfs_dirent_s **prev;
 
-  /* Find the object at this path */
-
-  ret = tmpfs_find_object(fs, relpath, &to, parent);
-  if (ret >= 0)
+  prev = &tdo->tdo_hash[tde->tde_hash & (tdo->tdo_nbuckets - 1)];
+  while (*prev != NULL)
     {
-      /* We found it... but is it a regular file? */
-
-      if (to->to_type != TMPFS_DIRECTORY)
+      if (*prev == tde)
         {
-          /* No... unlock the object and its parent and return an error */
+          *prev = tde->tde_hnext;
+          break;
+        }
 
-          tmpfs_release_lockedobject(to);
+      prev = &(*prev)->tde_hnext;
+    }
 
-          if (parent)
-            {
-              struct tmpfs_directory_s *tmptdo = *parent;
+  tde->tde_hnext = NULL;
+}
 
-              tmptdo->tdo_refs--;
-              tmpfs_unlock_directory(tmptdo);
-            }
+/****************************************************************************
+ * Name: tmpfs_dirhash_resize
+ *
+ * Description:
+ *   (Re)build the name index of a directory with 'nbuckets' buckets from
+ *   its entry list.  On failure the old index, if any, is kept; lookups
+ *   still work, only slower.
+ *
+ ****************************************************************************/
 
-          ret = -ENOTDIR;
-        }
+static int tmpfs_dirhash_resize(struct tmpfs_directory_s *tdo,
+                                uint32_t nbuckets)
+{
+  struct tmpfs_dirent_s **hash;
+  struct tmpfs_dirent_s *tde;
+  LOS_DL_LIST *node;
+
+  hash = (struct tmpfs_dirent_s **)kmm_malloc(nbuckets * sizeof(*hash));
+  if (hash == NULL)
+    {
+      return -ENOMEM;
+    }
 
-      /* Return the verified file object */
+  (void)memset_s(hash, nbuckets * sizeof(*hash), 0, nbuckets * sizeof(*hash));
+  kmm_free(tdo->tdo_hash);
+  tdo->tdo_hash     = hash;
+  tdo->tdo_nbuckets = nbuckets;
 
-      *tdo = (struct tmpfs_directory_s *)to;
+  for (node = tdo->tdo_entry.pstNext; node != &tdo->tdo_entry; node = node->pstNext)
+    {
+      tde = (struct tmpfs_dirent_s *)node;
+      if (tde->tde_inuse == true)
+        {
+          tmpfs_dirhash_insert(tdo, tde);
+        }
     }
 
-  return ret;
+  return OK;
 }
 
 /****************************************************************************
- * Name: tmpfs_close
+ * Name: tmpfs_dirhash_free
  ****************************************************************************/
 
-int tmpfs_close(struct file *filep)
+static void tmpfs_dirhash_free(struct tmpfs_directory_s *tdo)
 {
-  struct tmpfs_file_s *tfo;
-
-  DEBUGASSERT(filep != NULL);
-
-  /* Recover our private data from the struct file instance */
-  tfo = (struct tmpfs_file_s *)(filep->f_vnode->data);
-  if (tfo == NULL)
+  if (tdo->tdo_hash != NULL)
     {
-      return -EINVAL;
+      kmm_free(tdo->tdo_hash);
+      tdo->tdo_hash     = NULL;
+      tdo->tdo_nbuckets = 0;
     }
-  /* Get exclusive access to the file */
+}
 
-  tmpfs_lock_file(tfo);
+/****************************************************************************
+ * Name: tmpfs_find_dirent
+ ****************************************************************************/
 
-  /* Decrement the reference count on the file */
+static struct tmpfs_dirent_s *tmpfs_find_dirent(struct tmpfs_directory_s *tdo,
+                                                const char *name)
+{
+  LOS_DL_LIST *node;
+  struct tmpfs_dirent_s *tde;
+  uint32_t hash;
 
-  if (tfo->tfo_refs > 0)
+  hash = tmpfs_hash_name(name);
+
+  /* Use the name index if the directory has one */
+
+  if (tdo->tdo_hash != NULL)
     {
-      tfo->tfo_refs--;
+      for (tde = tdo->tdo_hash[hash & (tdo->tdo_nbuckets - 1)];
+           tde != NULL;
+           tde = tde->tde_hnext)
+        {
+          if (tde->tde_hash == hash && strcmp(tde->tde_name, name) == 0)
+            {
+              return tde;
+            }
+        }
+
+      return NULL;
     }
 
-  /* If the reference count decremented to zero and the file has been
-   * unlinked, then free the file allocation now.
-   */
+  /* Search the list of directory entries for a match */
 
-  if (tfo->tfo_refs == 0 && (tfo->tfo_flags & TFO_FLAG_UNLINKED) != 0)
+  for (node = tdo->tdo_entry.pstNext; node != &tdo->tdo_entry; node = node->pstNext)
     {
-      /* Free the file object while we hold the lock?  Weird but this
-       * should be safe because the object is unlinked and could not
-       * have any other references.
-       */
-
-      (void)sem_destroy(&tfo->tfo_exclsem.ts_sem);
-      kmm_free(tfo->tfo_data);
-      kmm_free(tfo);
-      return OK;
+      tde = (struct tmpfs_dirent_s *)node;
+      if (tde->tde_inuse == true && tde->tde_hash == hash &&
+          strcmp(tde->tde_name, name) == 0)
+        {
+          return tde;
+        }
     }
 
-  /* Release the lock on the file */
+  /* Return NULL if not found */
 
-  tmpfs_unlock_file(tfo);
-  return OK;
+  return NULL;
 }
 
 /****************************************************************************
- * Name: tmpfs_read
+ * Name: tmpfs_dirent_setname
+ *
+ * Description:
+ *   Give a directory entry its name.  Short names are stored in the entry
+ *   itself, only long ones need a separate allocation.
+ *
  ****************************************************************************/
 
-ssize_t tmpfs_read(struct file *filep, char *buffer, size_t buflen)
+static int tmpfs_dirent_setname(struct tmpfs_dirent_s *tde,
+                                const char *name)
 {
-  struct tmpfs_file_s *tfo;
-  ssize_t nread;
-  loff_t startpos;
-  loff_t endpos;
-
-  DEBUGASSERT(filep->f_vnode != NULL);
-
-  /* Recover our private data from the struct file instance */
+  size_t len = strlen(name) + 1;
 
-  tfo = (struct tmpfs_file_s *)(filep->f_vnode->data);
-  if (tfo == NULL)
+  if (len <= sizeof(tde->tde_iname))
     {
-      return -EINVAL;
+      tde->tde_name = tde->tde_iname;
     }
-  if (filep->f_pos >= tfo->tfo_size || buflen == 0)
+  else
     {
-      return 0;
+      tde->tde_name = (char *)kmm_malloc(len);
+      if (tde->tde_name == NULL)
+        {
+          return -ENOSPC;
+        }
     }
 
-  /* Get exclusive access to the file */
+  (VOID)memcpy_s(tde->tde_name, len, name, len);
+  return OK;
+}
 
-  tmpfs_lock_file(tfo);
+/****************************************************************************
+ * Name: tmpfs_dirent_putname
+ ****************************************************************************/
 
-  /* Handle attempts to read beyond the end of the file. */
+static void tmpfs_dirent_putname(struct tmpfs_dirent_s *tde)
+{
+  if (tde->tde_name != NULL && tde->tde_name != tde->tde_iname)
+    {
+      kmm_free(tde->tde_name);
+    }
 
-  startpos = filep->f_pos;
-  nread    = buflen;
-  endpos   = startpos + buflen;
+  tde->tde_name = NULL;
+}
 
-  if (endpos > tfo->tfo_size)
+/****************************************************************************
+ * Name: tmpfs_free_dirent
+ ****************************************************************************/
+
+static void tmpfs_free_dirent(struct tmpfs_dirent_s *tde)
+{
+  tmpfs_dirent_putname(tde);
+  tmpfs_pool_free(TMPFS_POOL_DIRENT, tde);
+}
+
+/****************************************************************************
+ * Name: tmpfs_remove_dirent
+ ****************************************************************************/
+
+static int tmpfs_remove_dirent(struct tmpfs_directory_s *tdo,
+                               struct tmpfs_object_s *to)
+{
+  struct tmpfs_dirent_s *tde;
+
+  /* Search the list of directory entries for a match */
+
+  tde = to->to_dirent;
+  if (tde == NULL)
     {
-      endpos = tfo->tfo_size;
-      nread  = endpos - startpos;
+      return -ENONET;
     }
 
-  /* Copy data from the memory object to the user buffer */
+  /* Take the entry out of the name index */
 
-  if (LOS_CopyFromKernel(buffer, buflen, &tfo->tfo_data[startpos], nread) != 0)
+  if (tdo->tdo_hash != NULL && tde->tde_inuse == true)
     {
-      tmpfs_unlock_file(tfo);
-      return -EINVAL;
+      tmpfs_dirhash_remove(tdo, tde);
     }
-  filep->f_pos += nread;
 
-  /* Update the node's access time */
+  /* Free the object name */
 
-  tfo->tfo_atime = tmpfs_timestamp();
+  tmpfs_dirent_putname(tde);
 
-  /* Release the lock on the file */
+  if (tdo->tdo_count == 0)
+    {
+      LOS_ListDelete(&tde->tde_node);
+      tmpfs_free_dirent(tde);
+    }
+  else
+    {
+      tde->tde_inuse = false;
+      tde->tde_object = NULL;
+    }
+  if(tdo->tdo_nentries > 0)
+    {
+      tdo->tdo_nentries--;
+    }
 
-  tmpfs_unlock_file(tfo);
-  return nread;
+  /* An empty directory does not need its index any more */
+
+  if (tdo->tdo_nentries == 0)
+    {
+      tmpfs_dirhash_free(tdo);
+    }
+
+  return OK;
 }
 
 /****************************************************************************
- * Name: tmpfs_readpage
+ * Name: tmpfs_add_dirent
  ****************************************************************************/
 
-ssize_t tmpfs_readpage(struct Vnode *vnode, char *buffer, off_t off)
+static int tmpfs_add_dirent(struct tmpfs_directory_s **tdo,
+                            struct tmpfs_object_s *to,
+                            const char *name)
 {
-  struct tmpfs_file_s *tfo;
-  ssize_t nread;
-  loff_t startpos;
-  loff_t endpos;
-
-  DEBUGASSERT(vnode->data != NULL);
-
-  /* Recover our private data from the vnode */
+  struct tmpfs_directory_s *parent;
+  struct tmpfs_dirent_s *tde;
 
-  tfo = (struct tmpfs_file_s *)(vnode->data);
-  if (tfo == NULL)
+  tde = (struct tmpfs_dirent_s *)tmpfs_pool_alloc(TMPFS_POOL_DIRENT);
+  if (tde == NULL)
     {
-      return -EINVAL;
+      return -ENOSPC;
     }
-  if (off >= tfo->tfo_size)
+
+  /* Copy the name string so that it will persist as long as the
+   * directory entry.
+   */
+
+  if (tmpfs_dirent_setname(tde, name) < 0)
     {
-      return 0;
+      tmpfs_pool_free(TMPFS_POOL_DIRENT, tde);
+      return -ENOSPC;
     }
 
-  /* Get exclusive access to the file */
+  tde->tde_object = to;
+  tde->tde_hash   = tmpfs_hash_name(tde->tde_name);
+  tde->tde_hnext  = NULL;
+  tde->tde_inuse  = true;
+  to->to_dirent   = tde;
 
-  tmpfs_lock_file(tfo);
+  /* Save the new object info in the new directory entry */
 
-  /* Handle attempts to read beyond the end of the file. */
+  parent = *tdo;
+  LOS_ListTailInsert(&parent->tdo_entry, &tde->tde_node);
+  parent->tdo_nentries++;
 
-  startpos = off;
-  nread    = PAGE_SIZE;
-  endpos   = startpos + PAGE_SIZE;
+  /* Keep the name index in step.  It is built once the directory passes
+   * the threshold and doubled whenever the chains would average more than
+   * one entry.
+   */
 
-  if (endpos > tfo->tfo_size)
+  if (parent->tdo_hash != NULL)
     {
-      endpos = tfo->tfo_size;
-      nread  = endpos - startpos;
+      tmpfs_dirhash_insert(parent, tde);
     }
 
-  /* Copy data from the memory object to the user buffer */
-
-  if (LOS_CopyFromKernel(buffer, PAGE_SIZE, &tfo->tfo_data[startpos], nread) != 0)
+  if (parent->tdo_nentries > CONFIG_FS_TMPFS_DIRHASH_THRESHOLD &&
+      parent->tdo_nentries > parent->tdo_nbuckets)
     {
-      tmpfs_unlock_file(tfo);
-      return -EINVAL;
+      (void)tmpfs_dirhash_resize(parent, (parent->tdo_nbuckets > 0) ?
+                                 parent->tdo_nbuckets << 1 :
+                                 TMPFS_DIRHASH_MINBUCKETS);
     }
 
-  /* Update the node's access time */
-
-  tfo->tfo_atime = tmpfs_timestamp();
+  /* Update directory times */
 
-  /* Release the lock on the file */
+  parent->tdo_ctime = parent->tdo_mtime = tmpfs_timestamp();
 
-  tmpfs_unlock_file(tfo);
-  return nread;
+  return OK;
 }
 
-
 /****************************************************************************
- * Name: tmpfs_create
+ * Name: tmpfs_alloc_file
  ****************************************************************************/
 
-int tmpfs_create(struct Vnode *dvp, const char *path, int mode, struct Vnode **vpp)
+static struct tmpfs_file_s *tmpfs_alloc_file(void)
 {
-    struct Vnode *vp = NULL;
-    struct tmpfs_file_s *tfo;
-    struct tmpfs_s *fs;
-    int ret = 0;
-    struct tmpfs_directory_s *parent_tdo = NULL;
+  struct tmpfs_s *fs = &tmpfs_superblock;
+  struct tmpfs_file_s *tfo;
 
-    if (dvp == NULL)
-      {
-        return -ENOENT;
-      }
+  if (!tmpfs_charge(&fs->tfs_nnodes, fs->tfs_maxnodes, 1))
+    {
+      return NULL;
+    }
 
-    fs = dvp->originMount->data;
-    if (fs == NULL)
-      {
-        return -ENOENT;
-      }
+  /* Create a new zero length file object */
 
-    tmpfs_lock(fs);
+  tfo = (struct tmpfs_file_s *)tmpfs_pool_alloc(TMPFS_POOL_FILE);
+  if (tfo == NULL)
+    {
+      tmpfs_uncharge(&fs->tfs_nnodes, 1);
+      return NULL;
+    }
 
-    if (dvp->data != NULL)
-      {
-        parent_tdo = (struct tmpfs_directory_s *)(dvp->data);
-      }
+  /* Initialize the new file object.  NOTE that the initial state is
+   * locked with one reference count.
+   */
 
-    ret = tmpfs_create_file(fs, path, parent_tdo, &tfo);
-    if (ret < 0)
+  tfo->tfo_atime = tmpfs_timestamp();
+  tfo->tfo_mtime = tfo->tfo_atime;
+  tfo->tfo_ctime = tfo->tfo_atime;
+  tfo->tfo_type  = TMPFS_REGULAR;
+  tfo->tfo_refs  = 1;
+  tfo->tfo_flags = 0;
+  tfo->tfo_size  = 0;
+  tfo->tfo_pages = NULL;
+  tfo->tfo_npages = 0;
+  tfo->tfo_nalloc = 0;
+  spin_lock(&g_tmpfs_growthlock);
+  tfo->tfo_growth = fs->tfs_growth;
+  spin_unlock(&g_tmpfs_growthlock);
+
+  tfo->tfo_exclsem.ts_holder = tmpfs_self();
+  tfo->tfo_exclsem.ts_count  = 1;
+  if (sem_init(&tfo->tfo_exclsem.ts_sem, 0, 0) != 0)
+    {
+      PRINT_ERR("%s %d, sem_init failed!\n", __FUNCTION__, __LINE__);
+      tmpfs_pool_free(TMPFS_POOL_FILE, tfo);
+      tmpfs_uncharge(&fs->tfs_nnodes, 1);
+      return NULL;
+    }
+
+  return tfo;
+}
+
+/****************************************************************************
+ * Name: tmpfs_free_file
+ *
+ * Description:
+ *   Free a file object together with its data and return its inode to the
+ *   mount.
+ *
+ ****************************************************************************/
+
+static void tmpfs_free_file(struct tmpfs_file_s *tfo)
+{
+  (void)sem_destroy(&tfo->tfo_exclsem.ts_sem);
+  tmpfs_free_pages(tfo, 0);
+  tmpfs_pool_free(TMPFS_POOL_FILE, tfo);
+  tmpfs_uncharge(&tmpfs_superblock.tfs_nnodes, 1);
+}
+
+/****************************************************************************
+ * Name: tmpfs_create_file
+ ****************************************************************************/
+
+static int tmpfs_create_file(struct tmpfs_s *fs,
+                             const char *relpath,
+                             struct tmpfs_directory_s *parent_input,
+                             struct tmpfs_file_s **tfo)
+{
+  struct tmpfs_directory_s *parent;
+  struct tmpfs_file_s *newtfo;
+  struct tmpfs_dirent_s *tde;
+  int ret;
+
+  /* Separate the path into the file name and the path to the parent
+   * directory.
+   */
+  if (parent_input == NULL)
+    {
+      /* No subdirectories... use the root directory */
+      parent = (struct tmpfs_directory_s *)fs->tfs_root.tde_object;
+    }
+  else
+    {
+      parent = parent_input;
+    }
+  if (parent == NULL)
+    {
+      return -EEXIST;
+    }
+  tmpfs_lock_directory(parent);
+  parent->tdo_refs++;
+
+  /* Verify that no object of this name already exists in the directory */
+  tde = tmpfs_find_dirent(parent, relpath);
+  if (tde != NULL)
+    {
+      /* Something with this name already exists in the directory.
+       * OR perhaps some fatal error occurred.
+       */
+
+      ret = -EEXIST;
+      goto errout_with_parent;
+    }
+
+  /* Allocate an empty file.  The initial state of the file is locked with one
+   * reference count.
+   */
+
+  newtfo = tmpfs_alloc_file();
+  if (newtfo == NULL)
+    {
+      ret = -ENOSPC;
+      goto errout_with_parent;
+    }
+
+  /* Then add the new, empty file to the directory */
+
+  ret = tmpfs_add_dirent(&parent, (struct tmpfs_object_s *)newtfo, relpath);
+  if (ret < 0)
+    {
+      goto errout_with_file;
+    }
+
+  /* Release the reference and lock on the parent directory */
+  if (parent->tdo_refs > 0)
+    {
+      parent->tdo_refs--;
+    }
+  tmpfs_unlock_directory(parent);
+
+  *tfo = newtfo;
+  return OK;
+
+  /* Error exits */
+
+errout_with_file:
+  tmpfs_free_file(newtfo);
+
+errout_with_parent:
+  if (parent->tdo_refs > 0)
+  {
+    parent->tdo_refs--;
+  }
+  tmpfs_unlock_directory(parent);
+  return ret;
+}
+
+/****************************************************************************
+ * Name: tmpfs_alloc_directory
+ ****************************************************************************/
+
+static struct tmpfs_directory_s *tmpfs_alloc_directory(void)
+{
+  struct tmpfs_s *fs = &tmpfs_superblock;
+  struct tmpfs_directory_s *tdo;
+
+  if (!tmpfs_charge(&fs->tfs_nnodes, fs->tfs_maxnodes, 1))
+    {
+      return NULL;
+    }
+
+  tdo = (struct tmpfs_directory_s *)tmpfs_pool_alloc(TMPFS_POOL_DIRECTORY);
+  if (tdo == NULL)
+    {
+      tmpfs_uncharge(&fs->tfs_nnodes, 1);
+      return NULL;
+    }
+
+  /* Initialize the new directory object */
+
+  tdo->tdo_atime    = tmpfs_timestamp();
+  tdo->tdo_mtime    = tdo->tdo_atime;
+  tdo->tdo_ctime    =  tdo->tdo_mtime;
+  tdo->tdo_type     = TMPFS_DIRECTORY;
+  tdo->tdo_refs     = 0;
+  tdo->tdo_nentries = 0;
+  tdo->tdo_count    = 0;
+  tdo->tdo_hash     = NULL;
+  tdo->tdo_nbuckets = 0;
+  LOS_ListInit(&tdo->tdo_entry);
+
+  tdo->tdo_exclsem.ts_holder = TMPFS_NO_HOLDER;
+  tdo->tdo_exclsem.ts_count  = 0;
+  if (sem_init(&tdo->tdo_exclsem.ts_sem, 0, 1) != 0)
+    {
+      PRINT_ERR("%s %d, sem_init failed!\n", __FUNCTION__, __LINE__);
+      tmpfs_pool_free(TMPFS_POOL_DIRECTORY, tdo);
+      tmpfs_uncharge(&fs->tfs_nnodes, 1);
+      return NULL;
+    }
+  return tdo;
+}
+
+/****************************************************************************
+ * Name: tmpfs_free_directory
+ ****************************************************************************/
+
+static void tmpfs_free_directory(struct tmpfs_directory_s *tdo)
+{
+  (void)sem_destroy(&tdo->tdo_exclsem.ts_sem);
+  tmpfs_dirhash_free(tdo);
+  tmpfs_pool_free(TMPFS_POOL_DIRECTORY, tdo);
+  tmpfs_uncharge(&tmpfs_superblock.tfs_nnodes, 1);
+}
+
+/****************************************************************************
+ * Name: tmpfs_create_directory
+ ****************************************************************************/
+
+static int tmpfs_create_directory(struct tmpfs_s *fs,
+                                  const char *relpath,
+                                  struct tmpfs_directory_s *parent_input,
+                                  struct tmpfs_directory_s **tdo)
+{
+  struct tmpfs_directory_s *parent;
+  struct tmpfs_directory_s *newtdo;
+  struct tmpfs_dirent_s *tde;
+  int ret;
+
+  /* Separate the path into the file name and the path to the parent
+   * directory.
+   */
+  if (parent_input == NULL)
+    {
+      /* No subdirectories... use the root directory */
+
+      parent = (struct tmpfs_directory_s *)fs->tfs_root.tde_object;
+    }
+  else
+    {
+      parent = parent_input;
+    }
+
+  /* Verify that no object of this name already exists in the directory */
+  if (parent == NULL)
+    {
+      return -EEXIST;
+    }
+  tmpfs_lock_directory(parent);
+  parent->tdo_refs++;
+  tde = tmpfs_find_dirent(parent, relpath);
+  if (tde != NULL)
+    {
+      /* Something with this name already exists in the directory.
+       * OR perhaps some fatal error occurred.
+       */
+
+      ret = -EEXIST;
+
+      goto errout_with_parent;
+    }
+
+  /* Allocate an empty directory object.  NOTE that there is no reference on
+   * the new directory and the object is not locked.
+   */
+
+  newtdo = tmpfs_alloc_directory();
+  if (newtdo == NULL)
+    {
+      ret = -ENOSPC;
+      goto errout_with_parent;
+    }
+
+  /* Then add the new, empty file to the directory */
+
+  ret = tmpfs_add_dirent(&parent, (struct tmpfs_object_s *)newtdo, relpath);
+  if (ret < 0)
+    {
+      goto errout_with_directory;
+    }
+
+  /* Release our reference to the parent directory and return success */
+
+  if (parent->tdo_refs > 0)
+    {
+      parent->tdo_refs--;
+    }
+  tmpfs_unlock_directory(parent);
+
+  /* Return the (unlocked, unreferenced) directory object to the caller */
+
+  if (tdo != NULL)
+    {
+      *tdo = newtdo;
+    }
+
+  return OK;
+
+  /* Error exits */
+
+errout_with_directory:
+  tmpfs_free_directory(newtdo);
+
+errout_with_parent:
+  if (parent->tdo_refs > 0)
+    {
+      parent->tdo_refs--;
+    }
+  tmpfs_unlock_directory(parent);
+  return ret;
+}
+
+/****************************************************************************
+ * Name: tmpfs_vnode_directory
+ *
+ * Description:
+ *   Return the directory object behind a directory vnode.  The root vnode
+ *   carries no private data and stands for the root directory.
+ *
+ ****************************************************************************/
+
+static struct tmpfs_directory_s *tmpfs_vnode_directory(struct tmpfs_s *fs,
+                                                       struct Vnode *vp)
+{
+  if (vp->data != NULL)
+    {
+      return (struct tmpfs_directory_s *)vp->data;
+    }
+
+  return (struct tmpfs_directory_s *)fs->tfs_root.tde_object;
+}
+
+/****************************************************************************
+ * Name: tmpfs_vnode_isancestor
+ *
+ * Description:
+ *   Return true if 'ancestor' is 'vp' or one of its parents.
+ *
+ ****************************************************************************/
+
+static bool tmpfs_vnode_isancestor(struct Vnode *ancestor, struct Vnode *vp)
+{
+  for (; vp != NULL; vp = vp->parent)
+    {
+      if (vp == ancestor)
+        {
+          return true;
+        }
+
+      if (vp->originMount != ancestor->originMount)
+        {
+          break;
+        }
+    }
+
+  return false;
+}
+
+/****************************************************************************
+ * Name: tmpfs_close
+ ****************************************************************************/
+
+int tmpfs_close(struct file *filep)
+{
+  struct tmpfs_file_s *tfo;
+
+  DEBUGASSERT(filep != NULL);
+
+  /* Recover our private data from the struct file instance */
+  tfo = (struct tmpfs_file_s *)(filep->f_vnode->data);
+  if (tfo == NULL)
+    {
+      return -EINVAL;
+    }
+  /* Get exclusive access to the file */
+
+  tmpfs_lock_file(tfo);
+
+  /* Decrement the reference count on the file */
+
+  if (tfo->tfo_refs > 0)
+    {
+      tfo->tfo_refs--;
+    }
+
+  /* If the reference count decremented to zero and the file has been
+   * unlinked, then free the file allocation now.
+   */
+
+  if (tfo->tfo_refs == 0 && (tfo->tfo_flags & TFO_FLAG_UNLINKED) != 0)
+    {
+      /* Free the file object while we hold the lock?  Weird but this
+       * should be safe because the object is unlinked and could not
+       * have any other references.
+       */
+
+      tmpfs_free_file(tfo);
+      return OK;
+    }
+
+  /* Release the lock on the file */
+
+  tmpfs_unlock_file(tfo);
+  return OK;
+}
+
+/****************************************************************************
+ * Name: tmpfs_read
+ ****************************************************************************/
+
+ssize_t tmpfs_read(struct file *filep, char *buffer, size_t buflen)
+{
+  struct tmpfs_file_s *tfo;
+  ssize_t nread;
+  loff_t startpos;
+  loff_t endpos;
+  int ret;
+
+  DEBUGASSERT(filep->f_vnode != NULL);
+
+  /* Recover our private data from the struct file instance */
+
+  tfo = (struct tmpfs_file_s *)(filep->f_vnode->data);
+  if (tfo == NULL)
+    {
+      return -EINVAL;
+    }
+  if (filep->f_pos >= tfo->tfo_size || buflen == 0)
+    {
+      return 0;
+    }
+
+  /* Get exclusive access to the file */
+
+  tmpfs_lock_file(tfo);
+
+  /* Handle attempts to read beyond the end of the file. */
+
+  startpos = filep->f_pos;
+  nread    = buflen;
+  endpos   = startpos + buflen;
+
+  if (endpos > tfo->tfo_size)
+    {
+      endpos = tfo->tfo_size;
+      nread  = endpos - startpos;
+    }
+
+  /* Copy data from the memory object to the user buffer */
+
+  ret = tmpfs_copyout(tfo, buffer, startpos, nread);
+  if (ret != OK)
+    {
+      tmpfs_unlock_file(tfo);
+      return ret;
+    }
+  filep->f_pos += nread;
+
+  /* Update the node's access time */
+
+  tfo->tfo_atime = tmpfs_timestamp();
+
+  /* Release the lock on the file */
+
+  tmpfs_unlock_file(tfo);
+  return nread;
+}
+
+/****************************************************************************
+ * Name: tmpfs_readpage
+ ****************************************************************************/
+
+ssize_t tmpfs_readpage(struct Vnode *vnode, char *buffer, off_t off)
+{
+  struct tmpfs_file_s *tfo;
+  ssize_t nread;
+  loff_t startpos;
+  loff_t endpos;
+  int ret;
+
+  DEBUGASSERT(vnode->data != NULL);
+
+  /* Recover our private data from the vnode */
+
+  tfo = (struct tmpfs_file_s *)(vnode->data);
+  if (tfo == NULL)
+    {
+      return -EINVAL;
+    }
+  if (off >= tfo->tfo_size)
+    {
+      return 0;
+    }
+
+  /* Get exclusive access to the file */
+
+  tmpfs_lock_file(tfo);
+
+  /* Handle attempts to read beyond the end of the file. */
+
+  startpos = off;
+  nread    = PAGE_SIZE;
+  endpos   = startpos + PAGE_SIZE;
+
+  if (endpos > tfo->tfo_size)
+    {
+      endpos = tfo->tfo_size;
+      nread  = endpos - startpos;
+    }
+
+  /* Copy data from the memory object to the user buffer */
+
+  ret = tmpfs_copyout(tfo, buffer, startpos, nread);
+  if (ret != OK)
+    {
+      tmpfs_unlock_file(tfo);
+      return ret;
+    }
+
+  /* Update the node's access time */
+
+  tfo->tfo_atime = tmpfs_timestamp();
+
+  /* Release the lock on the file */
+
+  tmpfs_unlock_file(tfo);
+  return nread;
+}
+
+
+/****************************************************************************
+ * Name: tmpfs_create
+ ****************************************************************************/
+
+int tmpfs_create(struct Vnode *dvp, const char *path, int mode, struct Vnode **vpp)
+{
+    struct Vnode *vp = NULL;
+    struct tmpfs_file_s *tfo;
+    struct tmpfs_s *fs;
+    int ret = 0;
+    struct tmpfs_directory_s *parent_tdo = NULL;
+
+    if (dvp == NULL)
+      {
+        return -ENOENT;
+      }
+
+    fs = dvp->originMount->data;
+    if (fs == NULL)
+      {
+        return -ENOENT;
+      }
+
+    /* tmpfs_create_file() locks the parent directory while it checks for
+     * and adds the new entry.
+     */
+
+    if (dvp->data != NULL)
       {
-        goto errout_with_fslock;
+        parent_tdo = (struct tmpfs_directory_s *)(dvp->data);
+      }
+
+    ret = tmpfs_create_file(fs, path, parent_tdo, &tfo);
+    if (ret < 0)
+      {
+        return ret;
+      }
+
+    ret = VnodeAlloc(&tmpfs_vops, &vp);
+    if (ret != 0)
+      {
+        tmpfs_unlock_file(tfo);
+        return ret;
       }
+    vp->parent = dvp;
+    vp->vop = dvp->vop;
+    vp->fop = dvp->fop;
+    vp->data = tfo;
+    vp->originMount = dvp->originMount;
+    vp->type = VNODE_TYPE_REG;
+    tfo->mode = mode;
+    vp->mode = tfo->mode;
+    vp->gid = tfo->gid;
+    vp->uid = tfo->uid;
+
+    ret = VfsHashInsert(vp, (uint32_t)tfo);
+
+    *vpp = vp;
+    tmpfs_unlock_file(tfo);
+    return 0;
+}
+
+
+/****************************************************************************
+ * Name: tmpfs_clamp_growth
+ *
+ * Description:
+ *   Limit a growth reserve to CONFIG_FS_TMPFS_MAX_GROWTH and, on a mount
+ *   with a size= limit, to the size of the mount.
+ *
+ ****************************************************************************/
+
+static size_t tmpfs_clamp_growth(struct tmpfs_s *fs, unsigned long long value)
+{
+  if (value > CONFIG_FS_TMPFS_MAX_GROWTH)
+    {
+      value = CONFIG_FS_TMPFS_MAX_GROWTH;
+    }
+
+  if (fs->tfs_maxpages != 0 && (value >> TMPFS_PAGE_SHIFT) >= fs->tfs_maxpages)
+    {
+      value = (unsigned long long)fs->tfs_maxpages << TMPFS_PAGE_SHIFT;
+    }
+
+  return (size_t)value;
+}
+
+/****************************************************************************
+ * Name: los_set_ramfs_unit
+ ****************************************************************************/
+
+unsigned int g_tmpfs_alloc_unit = 0;
+
+void los_set_ramfs_unit(off_t size)
+{
+  if (size >= 0)
+    {
+      /* The value becomes the default of later mounts and of files created
+       * in the current one.  Writes only look at the per-file copy.
+       */
+
+      spin_lock(&g_tmpfs_growthlock);
+      g_tmpfs_alloc_unit = tmpfs_clamp_growth(&tmpfs_superblock, size);
+      tmpfs_superblock.tfs_growth = g_tmpfs_alloc_unit;
+      spin_unlock(&g_tmpfs_growthlock);
+    }
+}
+
+/****************************************************************************
+ * Name: tmpfs_get_poolinfo
+ ****************************************************************************/
+
+void tmpfs_get_poolinfo(struct tmpfs_poolinfo_s info[TMPFS_NPOOLS])
+{
+  struct tmpfs_s *fs = &tmpfs_superblock;
+  int i;
+
+  spin_lock(&fs->tfs_statlock);
+  for (i = 0; i < TMPFS_NPOOLS; i++)
+    {
+      info[i] = fs->tfs_pools[i].tp_info;
+    }
+
+  spin_unlock(&fs->tfs_statlock);
+}
+
+/****************************************************************************
+ * Name: tmpfs_write
+ ****************************************************************************/
+
+ssize_t tmpfs_write(struct file *filep, const char *buffer, size_t buflen)
+{
+  struct tmpfs_file_s *tfo;
+  ssize_t nwritten;
+  loff_t startpos;
+  loff_t endpos;
+  loff_t last;
+  int ret;
+
+  DEBUGASSERT(filep->f_vnode != NULL);
+
+  if (buflen == 0)
+    {
+      return 0;
+    }
+
+  /* Recover our private data from the struct file instance */
+  tfo = (struct tmpfs_file_s *)(filep->f_vnode->data);
+  if (tfo == NULL)
+    {
+      return -EINVAL;
+    }
+  /* Get exclusive access to the file */
+
+  tmpfs_lock_file(tfo);
+
+  /* Handle attempts to write beyond the end of the file */
+
+  startpos = filep->f_pos;
+  nwritten = buflen;
+  endpos   = startpos + buflen;
+
+  if (startpos < 0)
+    {
+      ret = -EPERM;
+      goto errout_with_lock;
+    }
+
+  /* Back the written range with pages.  A gap left between the old end
+   * of file and startpos remains a hole and reads back as zeros.
+   */
+
+  ret = tmpfs_alloc_range(tfo, startpos, endpos);
+  if (ret < 0)
+    {
+      goto errout_with_lock;
+    }
+
+  /* Copy data from the user buffer to the memory object.  If the buffer
+   * faults, the pages that were added past the end of file are released
+   * again and the file is left as it was.
+   */
+
+  ret = tmpfs_copyin(tfo, buffer, startpos, nwritten);
+  if (ret != OK)
+    {
+      if (endpos > tfo->tfo_size)
+        {
+          tmpfs_trim_pages(tfo, tfo->tfo_size);
+        }
+
+      goto errout_with_lock;
+    }
+
+  /* Extending the file moves the end of file to the end of the write.
+   * If the file has a growth reserve, make sure that much capacity is
+   * allocated past the new end so that a run of appends does not allocate
+   * on every write.  The reserve is best effort and never shows up in the
+   * file size.
+   */
+
+  if (endpos > tfo->tfo_size)
+    {
+      /* tfo_growth is bounded by CONFIG_FS_TMPFS_MAX_GROWTH, but the end
+       * of the reserve must still fit in loff_t.
+       */
+
+      if (tfo->tfo_growth > 0 &&
+          (loff_t)tfo->tfo_growth <= LLONG_MAX - endpos)
+        {
+          last = (endpos + tfo->tfo_growth - 1) >> TMPFS_PAGE_SHIFT;
+          if (last >= tfo->tfo_npages || tfo->tfo_pages[last] == NULL)
+            {
+              (void)tmpfs_alloc_range(tfo, endpos, endpos + tfo->tfo_growth);
+            }
+        }
+
+      tfo->tfo_size = endpos;
+    }
+
+  filep->f_pos += nwritten;
+
+  /* Update the modified and access times of the node */
+
+  tfo->tfo_ctime = tfo->tfo_mtime = tmpfs_timestamp();
+
+  /* Release the lock on the file */
+
+  tmpfs_unlock_file(tfo);
+  return nwritten;
+
+errout_with_lock:
+  tmpfs_unlock_file(tfo);
+  return (ssize_t)ret;
+}
+
+/****************************************************************************
+ * Name: tmpfs_seek
+ ****************************************************************************/
+
+off_t tmpfs_seek(struct file *filep, off_t offset, int whence)
+{
+  struct tmpfs_file_s *tfo;
+  off_t position;
+
+  DEBUGASSERT(filep->f_vnode != NULL);
+
+  /* Recover our private data from the struct file instance */
+
+  tfo = (struct tmpfs_file_s *)(filep->f_vnode->data);
+  if (tfo == NULL)
+    {
+      return -EINVAL;
+    }
+  /* Map the offset according to the whence option */
+
+  switch (whence)
+    {
+      case SEEK_SET: /* The offset is set to offset bytes. */
+          position = offset;
+          break;
+
+      case SEEK_CUR: /* The offset is set to its current location plus
+                      * offset bytes. */
+          position = offset + filep->f_pos;
+          break;
+
+      case SEEK_END: /* The offset is set to the size of the file plus
+                      * offset bytes. */
+          position = offset + tfo->tfo_size;
+          break;
+
+      case SEEK_DATA: /* The offset is set to the next data at or after
+                       * offset. */
+      case SEEK_HOLE: /* The offset is set to the next hole at or after
+                       * offset. */
+          tmpfs_lock_file(tfo);
+          position = tmpfs_seek_data(tfo, offset, whence == SEEK_HOLE);
+          tmpfs_unlock_file(tfo);
+          if (position < 0)
+            {
+              return position;
+            }
+          break;
+
+      default:
+          return -EINVAL;
+    }
+
+  /* Attempts to set the position beyond the end of file will
+   * work if the file is open for write access.
+   *
+   * REVISIT: This simple implementation has no per-open storage that
+   * would be needed to retain the open flags.
+   */
+    if (position < 0)
+    {
+      return -EINVAL;
+    }
+
+  /* Save the new file position */
+
+  filep->f_pos = position;
+  return position;
+}
+
+/****************************************************************************
+ * Name: tmpfs_ioctl
+ ****************************************************************************/
+
+int tmpfs_ioctl(struct file *filep, int cmd, unsigned long arg)
+{
+  struct tmpfs_directory_s *tdo;
+  struct tmpfs_file_s *tfo;
+  struct Vnode *vp = filep->f_vnode;
+  size_t growth;
+  int ret = OK;
+
+  if (cmd == TMPFSIOC_READDIRPLUS)
+    {
+      tdo = tmpfs_vnode_directory(vp->originMount->data, vp);
+      if (tdo == NULL || tdo->tdo_type != TMPFS_DIRECTORY)
+        {
+          return -ENOTDIR;
+        }
+
+      return tmpfs_readdirplus(tdo, arg);
+    }
+
+  if (cmd == TMPFSIOC_EXPORT)
+    {
+      return tmpfs_export_ioctl(arg);
+    }
+
+  tfo = (struct tmpfs_file_s *)(vp->data);
+  if (tfo == NULL || tfo->tfo_type != TMPFS_REGULAR)
+    {
+      return -EINVAL;
+    }
+
+  switch (cmd)
+    {
+      case TMPFSIOC_GETGROWTH:
+        tmpfs_lock_file(tfo);
+        growth = tfo->tfo_growth;
+        tmpfs_unlock_file(tfo);
+
+        if (LOS_CopyFromKernel((void *)arg, sizeof(size_t), &growth,
+                               sizeof(size_t)) != 0)
+          {
+            ret = -EFAULT;
+          }
+        break;
+
+      case TMPFSIOC_SETGROWTH:
+        if (arg > CONFIG_FS_TMPFS_MAX_GROWTH)
+          {
+            ret = -EINVAL;
+            break;
+          }
+
+        tmpfs_lock_file(tfo);
+        tfo->tfo_growth = tmpfs_clamp_growth(&tmpfs_superblock, arg);
+        tmpfs_unlock_file(tfo);
+        break;
+
+      default:
+        ret = -EINVAL;
+        break;
+    }
+
+  return ret;
+}
+
+/****************************************************************************
+ * Name: tmpfs_export_access
+ *
+ * Description:
+ *   The export overwrites the whole device, so an ioctl caller needs the
+ *   right to format devices as well as write access to this one.
+ *
+ ****************************************************************************/
+
+static int tmpfs_export_access(const char *blkdev)
+{
+  struct Vnode *vp = NULL;
+  int ret;
+
+  if (!IsCapPermit(CAP_FS_FORMAT))
+    {
+      return -EPERM;
+    }
+
+  VnodeHold();
+  ret = VnodeLookup(blkdev, &vp, 0);
+  if (ret == OK)
+    {
+      if (vp->type != VNODE_TYPE_BLK)
+        {
+          ret = -ENOTBLK;
+        }
+      else if (VfsVnodePermissionCheck(vp, WRITE_OP))
+        {
+          ret = -EACCES;
+        }
+    }
+
+  VnodeDrop();
+  return ret;
+}
+
+/****************************************************************************
+ * Name: tmpfs_export_ioctl
+ *
+ * Description:
+ *   Handle TMPFSIOC_EXPORT: fetch the device path from the caller, check
+ *   that the caller may overwrite that device and export the mount to it.
+ *
+ ****************************************************************************/
+
+static int tmpfs_export_ioctl(unsigned long arg)
+{
+  char *blkdev;
+  int ret;
+
+  blkdev = (char *)kmm_malloc(PATH_MAX);
+  if (blkdev == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  ret = LOS_StrncpyFromUser(blkdev, (const char *)arg, PATH_MAX);
+  if (ret < 0)
+    {
+      ret = -EFAULT;
+    }
+  else if (ret == 0 || ret >= PATH_MAX)
+    {
+      ret = (ret == 0) ? -EINVAL : -ENAMETOOLONG;
+    }
+  else
+    {
+      ret = tmpfs_export_access(blkdev);
+      if (ret == OK)
+        {
+          ret = tmpfs_export(blkdev);
+        }
+    }
+
+  kmm_free(blkdev);
+  return ret;
+}
+
+/****************************************************************************
+ * Name: tmpfs_readdirplus
+ *
+ * Description:
+ *   Handle TMPFSIOC_READDIRPLUS: return a batch of directory entries
+ *   together with their attributes, so that a long listing does not need
+ *   a stat() per entry.
+ *
+ ****************************************************************************/
+
+static int tmpfs_readdirplus(struct tmpfs_directory_s *tdo,
+                             unsigned long arg)
+{
+  struct tmpfs_readdirplus_s req;
+  struct tmpfs_direntplus_s ent;
+  struct tmpfs_dirent_s *tde;
+  struct tmpfs_object_s *to;
+  LOS_DL_LIST *node;
+  off_t skip;
+  size_t count = 0;
+  int ret = OK;
+
+  if (LOS_CopyToKernel(&req, sizeof(req), (const void *)arg,
+                       sizeof(req)) != 0)
+    {
+      return -EFAULT;
+    }
+
+  if (req.trp_offset < 0 || (req.trp_nentries > 0 && req.trp_entries == NULL))
+    {
+      return -EINVAL;
+    }
+
+  tmpfs_lock_directory(tdo);
+
+  skip = req.trp_offset;
+  for (node = tdo->tdo_entry.pstNext;
+       node != &tdo->tdo_entry && count < req.trp_nentries;
+       node = node->pstNext)
+    {
+      tde = (struct tmpfs_dirent_s *)node;
+      if (tde->tde_inuse == false)
+        {
+          continue;
+        }
+
+      if (skip > 0)
+        {
+          skip--;
+          continue;
+        }
+
+      to = tde->tde_object;
+      (VOID)memset_s(&ent.tdp_dirent, sizeof(struct dirent), 0,
+                     sizeof(struct dirent));
+      ent.tdp_dirent.d_type   = (to->to_type == TMPFS_DIRECTORY) ? DT_DIR : DT_REG;
+      ent.tdp_dirent.d_off    = req.trp_offset + count + 1;
+      ent.tdp_dirent.d_reclen = (uint16_t)sizeof(struct dirent);
+      (void)strncpy_s(ent.tdp_dirent.d_name, NAME_MAX + 1, tde->tde_name, NAME_MAX);
+
+      /* The entry is a child of the locked directory */
+
+      tmpfs_lock_object(to);
+      to->to_refs++;
+      tmpfs_stat_common(to, &ent.tdp_stat);
+      tmpfs_release_lockedobject(to);
+
+      if (LOS_CopyFromKernel(&req.trp_entries[count], sizeof(ent), &ent,
+                             sizeof(ent)) != 0)
+        {
+          ret = -EFAULT;
+          break;
+        }
+
+      count++;
+    }
+
+  tmpfs_unlock_directory(tdo);
+
+  if (ret == OK)
+    {
+      req.trp_offset  += count;
+      req.trp_nentries = count;
+      if (LOS_CopyFromKernel((void *)arg, sizeof(req), &req,
+                             sizeof(req)) != 0)
+        {
+          ret = -EFAULT;
+        }
+    }
+
+  return ret;
+}
+
+/****************************************************************************
+ * Name: tmpfs_fallocate_common
+ *
+ * Description:
+ *   Allocate the pages behind [offset, offset + len).  Unless mode has
+ *   FALLOC_FL_KEEP_SIZE, the file is extended to cover the range.  On
+ *   -ENOSPC part of the range may have been allocated.
+ *
+ ****************************************************************************/
+
+static int tmpfs_fallocate_common(struct file *filep, int mode,
+                                  loff_t offset, loff_t len)
+{
+  struct tmpfs_file_s *tfo;
+  loff_t end;
+  int ret;
+
+  tfo = (struct tmpfs_file_s *)(filep->f_vnode->data);
+  if (tfo == NULL || tfo->tfo_type != TMPFS_REGULAR)
+    {
+      return -ENODEV;
+    }
+
+  if ((mode & ~FALLOC_FL_KEEP_SIZE) != 0)
+    {
+      return -EOPNOTSUPP;
+    }
+
+  if (offset < 0 || len <= 0)
+    {
+      return -EINVAL;
+    }
+
+  if ((unsigned long long)offset > SIZE_MAX ||
+      (unsigned long long)len > SIZE_MAX - (unsigned long long)offset)
+    {
+      return -EFBIG;
+    }
+
+  end = offset + len;
+
+  tmpfs_lock_file(tfo);
+
+  ret = tmpfs_alloc_range(tfo, offset, end);
+  if (ret == OK && (mode & FALLOC_FL_KEEP_SIZE) == 0 && end > tfo->tfo_size)
+    {
+      tfo->tfo_size  = end;
+      tfo->tfo_ctime = tfo->tfo_mtime = tmpfs_timestamp();
+    }
+
+  tmpfs_unlock_file(tfo);
+  return ret;
+}
+
+/****************************************************************************
+ * Name: tmpfs_fallocate
+ ****************************************************************************/
+
+int tmpfs_fallocate(struct file *filep, int mode, off_t offset, off_t len)
+{
+  return tmpfs_fallocate_common(filep, mode, offset, len);
+}
+
+/****************************************************************************
+ * Name: tmpfs_fallocate64
+ ****************************************************************************/
+
+int tmpfs_fallocate64(struct file *filep, int mode, off64_t offset,
+                      off64_t len)
+{
+  return tmpfs_fallocate_common(filep, mode, offset, len);
+}
+
+/****************************************************************************
+ * Name: tmpfs_sync
+ ****************************************************************************/
+
+int tmpfs_sync(struct file *filep)
+{
+  return 0;
+}
+
+/****************************************************************************
+ * Name: tmpfs_vm_fault
+ *
+ * Description:
+ *   Resolve a fault in a shared mapping to the file page itself, filling
+ *   in a hole first so that every mapper sees the same page.
+ *
+ ****************************************************************************/
+
+static int tmpfs_vm_fault(LosVmMapRegion *region, LosVmPgFault *vmf)
+{
+  struct tmpfs_file_s *tfo;
+  loff_t pos;
+  char *page;
+  int ret;
+
+  tfo = (struct tmpfs_file_s *)region->unTypeData.rf.vnode->data;
+  if (tfo == NULL)
+    {
+      return LOS_ERRNO_VM_INVALID_ARGS;
+    }
+
+  tmpfs_lock_file(tfo);
+
+  /* Faults past the end of file are not backed */
+
+  pos = (loff_t)vmf->pgoff << TMPFS_PAGE_SHIFT;
+  if (pos >= tfo->tfo_size)
+    {
+      tmpfs_unlock_file(tfo);
+      return LOS_ERRNO_VM_INVALID_ARGS;
+    }
+
+  ret = tmpfs_alloc_range(tfo, pos, pos + 1);
+  if (ret < 0)
+    {
+      tmpfs_unlock_file(tfo);
+      return LOS_ERRNO_VM_NO_MEMORY;
+    }
+
+  /* The generic fault path takes the mapping's reference on the page once
+   * it is returned here, and tmpfs_vm_remove drops it again.
+   */
+
+  page = tfo->tfo_pages[vmf->pgoff];
+  vmf->pageKVaddr = (VADDR_T *)page;
+
+  if ((vmf->flags & VM_MAP_PF_FLAG_WRITE) != 0)
+    {
+      tfo->tfo_ctime = tfo->tfo_mtime = tmpfs_timestamp();
+    }
+  else
+    {
+      tfo->tfo_atime = tmpfs_timestamp();
+    }
+
+  tmpfs_unlock_file(tfo);
+  return LOS_OK;
+}
+
+/****************************************************************************
+ * Name: tmpfs_vm_remove
+ *
+ * Description:
+ *   Unmap one page of a shared mapping and drop the reference that the
+ *   fault path took on it.
+ *
+ ****************************************************************************/
+
+static void tmpfs_vm_remove(LosVmMapRegion *region, LosArchMmu *archMmu,
+                            VM_OFFSET_T pgoff)
+{
+  LosVmPage *vmpage;
+  PADDR_T paddr;
+  VADDR_T vaddr;
+
+  vaddr = region->range.base + ((UINT32)(pgoff - region->pgOff) << PAGE_SHIFT);
+  if (LOS_ArchMmuQuery(archMmu, vaddr, &paddr, NULL) != LOS_OK)
+    {
+      return;
+    }
+
+  (void)LOS_ArchMmuUnmap(archMmu, vaddr, 1);
+
+  vmpage = LOS_VmPageGet(paddr);
+  if (vmpage != NULL)
+    {
+      LOS_PhysPageFree(vmpage);
+    }
+}
+
+/****************************************************************************
+ * Name: tmpfs_mmap
+ *
+ * Description:
+ *   Shared mappings map the file pages directly, so stores through the
+ *   mapping are file writes and no page cache copy is made.  Private
+ *   mappings keep using the page cache, which provides copy-on-write.
+ *
+ ****************************************************************************/
+
+int tmpfs_mmap(struct file *filep, LosVmMapRegion *region)
+{
+  if ((region->regionFlags & VM_MAP_REGION_FLAG_SHARED) == 0)
+    {
+      return OsVfsFileMmap(filep, region);
+    }
+
+  region->unTypeData.rf.vmFOps = &tmpfs_vm_ops;
+  region->unTypeData.rf.vnode = filep->f_vnode;
+  region->unTypeData.rf.f_oflags = filep->f_oflags;
+  return ENOERR;
+}
+
+/****************************************************************************
+ * Name: tmpfs_opendir
+ ****************************************************************************/
+
+int tmpfs_opendir(struct Vnode *vp, struct fs_dirent_s *dir)
+{
+  struct tmpfs_s *fs;
+  struct tmpfs_directory_s *tdo;
+  int ret = 0;
+  struct fs_tmpfsdir_s *tmp;
+
+  DEBUGASSERT(vp != NULL && dir != NULL);
+
+  /* Get the mountpoint private data from the inode structure */
+
+  fs = vp->originMount->data;
+  DEBUGASSERT(fs != NULL);
+
+  tmp = (struct fs_tmpfsdir_s *)malloc(sizeof(struct fs_tmpfsdir_s));
+  if (!tmp)
+    {
+      return -ENOSPC;
+    }
+
+  /* Only the directory itself needs to be locked while the reference is
+   * taken.
+   */
+
+  tdo = tmpfs_vnode_directory(fs, vp);
+  if (tdo == NULL)
+    {
+      free(tmp);
+      return -EINTR;
+    }
+  tmpfs_lock_directory(tdo);
+  tmp->tf_tdo   = tdo;
+  tmp->tf_index = 0;
+  tmp->tf_last  = NULL;
+  dir->u.fs_dir = (fs_dir_s)tmp;
+  tdo->tdo_count++;
+  tdo->tdo_refs++;
+  tmpfs_unlock_directory(tdo);
+  return ret;
+}
+
+/****************************************************************************
+ * Name: tmpfs_closedir
+ ****************************************************************************/
+
+int tmpfs_closedir(struct Vnode *vp, struct fs_dirent_s *dir)
+{
+  struct tmpfs_directory_s *tdo;
+  struct fs_tmpfsdir_s *tmp;
+
+  DEBUGASSERT(vp != NULL && dir != NULL);
+
+  /* Get the directory structure from the dir argument */
+
+  tmp = (struct fs_tmpfsdir_s *)dir->u.fs_dir;
+  if (tmp == NULL)
+    {
+      return -ENOENT;
+    }
+  tdo = tmp->tf_tdo;
+  DEBUGASSERT(tdo != NULL);
+
+  /* Decrement the reference count on the directory object */
+
+  tmpfs_lock_directory(tdo);
+  if (tdo->tdo_count == 1)
+    {
+      LOS_DL_LIST *node = tdo->tdo_entry.pstNext;
+      struct tmpfs_dirent_s *tde;
+      while (node != &tdo->tdo_entry)
+        {
+          tde = (struct tmpfs_dirent_s *)node;
+          node = node->pstNext;
+          if (tde->tde_inuse == false)
+            {
+              LOS_ListDelete(&tde->tde_node);
+              tmpfs_free_dirent(tde);
+            }
+        }
+    }
+  if (tdo->tdo_refs > 0)
+    {
+      tdo->tdo_refs--;
+    }
+  if (tdo->tdo_count > 0)
+    {
+      tdo->tdo_count--;
+    }
+  tmpfs_unlock_directory(tdo);
+
+  free(tmp);
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: tmpfs_readdir
+ *
+ * Description:
+ *   Return the next entries of an open directory, up to dir->read_cnt of
+ *   them, in fd_dir[].  Returns the number of entries, or -ENOENT at the
+ *   end of the directory.
+ *
+ ****************************************************************************/
+
+int tmpfs_readdir(struct Vnode *vp, struct fs_dirent_s *dir)
+{
+  struct tmpfs_directory_s *tdo;
+  struct fs_tmpfsdir_s *tmp;
+  struct tmpfs_dirent_s *tde;
+  struct tmpfs_object_s *to;
+  LOS_DL_LIST *node;
+  int count;
+  int ret;
+
+  DEBUGASSERT(vp != NULL && dir != NULL);
+
+  /* Get the directory structure from the dir argument and lock it */
+
+  tmp = (struct fs_tmpfsdir_s *)dir->u.fs_dir;
+  if (tmp == NULL)
+    {
+      return -ENOENT;
+    }
+
+  tdo = tmp->tf_tdo;
+  if (tdo == NULL)
+    {
+      return -ENOENT;
+    }
+
+  tmpfs_lock_directory(tdo);
+
+  /* Continue after the last entry visited.  Entries are only marked unused
+   * while the directory is open, never freed, so the cursor stays valid.
+   */
+
+  if (tmp->tf_last != NULL)
+    {
+      node = tmp->tf_last->tde_node.pstNext;
+    }
+  else
+    {
+      node = tdo->tdo_entry.pstNext;
+    }
+
+  /* Fill in as many entries as the caller has room for */
+
+  count = 0;
+  while (node != &tdo->tdo_entry && (count == 0 || count < dir->read_cnt))
+    {
+      tde  = (struct tmpfs_dirent_s *)node;
+      node = node->pstNext;
+
+      tmp->tf_index++;
+      tmp->tf_last = tde;
+      if (tde->tde_inuse == false)
+        {
+          continue;
+        }
+
+      /* Does this entry refer to a file or a directory object? */
+
+      to = tde->tde_object;
+      DEBUGASSERT(to != NULL);
+
+      if (to->to_type == TMPFS_DIRECTORY)
+        {
+          /* A directory */
+
+          dir->fd_dir[count].d_type = DT_DIR;
+        }
+      else /* to->to_type == TMPFS_REGULAR) */
+        {
+          /* A regular file */
+
+          dir->fd_dir[count].d_type = DT_REG;
+        }
+
+      /* Copy the entry name */
+
+      (void)strncpy_s(dir->fd_dir[count].d_name, NAME_MAX + 1, tde->tde_name, NAME_MAX);
+
+      dir->fd_position++;
+      dir->fd_dir[count].d_off = dir->fd_position;
+      dir->fd_dir[count].d_reclen = (uint16_t)sizeof(struct dirent);
+      count++;
+    }
+
+  if (count == 0)
+    {
+      /* We signal the end of the directory by returning the special error:
+       * -ENOENT
+       */
+
+      PRINT_INFO("End of directory\n");
+      ret = -ENOENT;
+    }
+  else
+    {
+      ret = count;
+    }
+
+  tmpfs_unlock_directory(tdo);
+  return ret;
+}
+
+/****************************************************************************
+ * Name: tmpfs_rewinddir
+ ****************************************************************************/
+
+int tmpfs_rewinddir(struct Vnode *vp, struct fs_dirent_s *dir)
+{
+  struct fs_tmpfsdir_s *tmp;
+  PRINT_DEBUG("vp: %p dir: %p\n",  vp, dir);
+  DEBUGASSERT(vp != NULL && dir != NULL);
+  tmp = (struct fs_tmpfsdir_s *)dir->u.fs_dir;
+
+  /* Set the readdir index to zero */
+
+  tmp->tf_index = 0;
+  tmp->tf_last  = NULL;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: tmpfs_truncate
+ ****************************************************************************/
+
+int tmpfs_truncate(struct Vnode *vp, off_t len)
+{
+  struct tmpfs_file_s *tfo = NULL;
+  int ret = OK;
+
+  tfo = vp->data;
+  if (tfo == NULL || len < 0)
+    {
+      return -EINVAL;
+    }
+
+  tmpfs_lock_file(tfo);
+
+  /* Shrinking frees the pages past the new end of file.  Growing only
+   * moves the end of file; the new range is a hole.
+   */
 
-    ret = VnodeAlloc(&tmpfs_vops, &vp);
-    if (ret != 0)
-      {
-        tmpfs_unlock_file(tfo);
-        goto errout_with_fslock;
-      }
-    vp->parent = dvp;
-    vp->vop = dvp->vop;
-    vp->fop = dvp->fop;
-    vp->data = tfo;
-    vp->originMount = dvp->originMount;
-    vp->type = VNODE_TYPE_REG;
-    tfo->mode = mode;
-    vp->mode = tfo->mode;
-    vp->gid = tfo->gid;
-    vp->uid = tfo->uid;
+  if ((unsigned long long)len > SIZE_MAX)
+    {
+      ret = -EFBIG;
+    }
+  else
+    {
+      if (len < tfo->tfo_size)
+        {
+          tmpfs_trim_pages(tfo, len);
+        }
 
-    ret = VfsHashInsert(vp, (uint32_t)tfo);
+      tfo->tfo_size  = len;
+      tfo->tfo_ctime = tfo->tfo_mtime = tmpfs_timestamp();
+    }
 
-    *vpp = vp;
-    tmpfs_unlock_file(tfo);
-errout_with_fslock:
-    tmpfs_unlock(fs);
-    return 0;
+  tmpfs_unlock_file(tfo);
+  return ret;
 }
 
 
+#ifdef LOSCFG_FS_VFS_BLOCK_DEVICE
+
 /****************************************************************************
- * Name: los_set_ramfs_unit
+ * Name: tmpfs_image_checksum
+ *
+ * Description:
+ *   Fold 'len' bytes into the running 32-bit FNV-1a checksum of an image.
+ *
  ****************************************************************************/
 
-static spinlock_t tmpfs_alloc_unit_lock;
-bool is_tmpfs_lock_init = false;
-unsigned int g_tmpfs_alloc_unit = 0;
-
-void los_set_ramfs_unit(off_t size)
+static uint32_t tmpfs_image_checksum(uint32_t sum, const void *buf,
+                                     size_t len)
 {
-  if (is_tmpfs_lock_init && size >= 0)
+  const uint8_t *ptr = (const uint8_t *)buf;
+
+  while (len-- > 0)
     {
-      spin_lock(&tmpfs_alloc_unit_lock);
-      g_tmpfs_alloc_unit = size;
-      spin_unlock(&tmpfs_alloc_unit_lock);
+      sum ^= *ptr++;
+      sum *= 16777619u;
     }
+
+  return sum;
 }
 
 /****************************************************************************
- * Name: tmpfs_write
+ * Name: tmpfs_image_put
+ *
+ * Description:
+ *   Append 'len' bytes to the image being exported.
+ *
  ****************************************************************************/
 
-ssize_t tmpfs_write(struct file *filep, const char *buffer, size_t buflen)
+static int tmpfs_image_put(struct tmpfs_image_s *img, const void *buf,
+                           size_t len)
 {
-  struct tmpfs_file_s *tfo;
   ssize_t nwritten;
-  loff_t startpos;
-  loff_t endpos;
-  int ret;
-  int alloc;
-  char *data;
 
-  DEBUGASSERT(filep->f_vnode != NULL);
+  nwritten = bchlib_write(img->ti_bch, (const char *)buf, img->ti_offset, len);
+  if (nwritten < 0)
+    {
+      return (int)nwritten;
+    }
 
-  if (buflen == 0)
+  /* bchlib reports the end of the device as a short write */
+
+  if ((size_t)nwritten != len)
     {
-      return 0;
+      return -ENOSPC;
     }
 
-  /* Recover our private data from the struct file instance */
-  tfo = (struct tmpfs_file_s *)(filep->f_vnode->data);
-  if (tfo == NULL)
+  img->ti_checksum = tmpfs_image_checksum(img->ti_checksum, buf, len);
+  img->ti_offset  += len;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: tmpfs_image_get
+ *
+ * Description:
+ *   Read the next 'len' bytes of the image being imported.  Reading past
+ *   the length recorded in the header means the image is corrupt.
+ *
+ ****************************************************************************/
+
+static int tmpfs_image_get(struct tmpfs_image_s *img, void *buf, size_t len)
+{
+  ssize_t nread;
+
+  if ((unsigned long long)len > (unsigned long long)(img->ti_end - img->ti_offset))
     {
       return -EINVAL;
     }
-  /* Get exclusive access to the file */
 
-  tmpfs_lock_file(tfo);
+  nread = bchlib_read(img->ti_bch, (char *)buf, img->ti_offset, len);
+  if (nread < 0)
+    {
+      return (int)nread;
+    }
 
-  /* Handle attempts to write beyond the end of the file */
+  if ((size_t)nread != len)
+    {
+      return -EIO;
+    }
 
-  startpos = filep->f_pos;
-  nwritten = buflen;
-  endpos   = startpos + buflen;
+  img->ti_checksum = tmpfs_image_checksum(img->ti_checksum, buf, len);
+  img->ti_offset  += len;
+  return OK;
+}
 
-  if (startpos < 0)
+/****************************************************************************
+ * Name: tmpfs_image_extent
+ *
+ * Description:
+ *   Find the next run of allocated pages at or after page '*pgndx' and
+ *   below 'npages'.  On return '*pgndx' is the page following the run.
+ *   Returns false when no pages are left.
+ *
+ ****************************************************************************/
+
+static bool tmpfs_image_extent(struct tmpfs_file_s *tfo, size_t npages,
+                               size_t *pgndx, struct tmpfs_imgext_s *ext)
+{
+  size_t i = *pgndx;
+
+  while (i < npages && tfo->tfo_pages[i] == NULL)
     {
-      ret = -EPERM;
-      goto errout_with_lock;
+      i++;
     }
 
-  if (endpos > tfo->tfo_size)
+  if (i >= npages)
+    {
+      *pgndx = i;
+      return false;
+    }
+
+  ext->tie_first = (uint32_t)i;
+  while (i < npages && tfo->tfo_pages[i] != NULL)
+    {
+      i++;
+    }
+
+  ext->tie_npages = (uint32_t)(i - ext->tie_first);
+  *pgndx = i;
+  return true;
+}
+
+/****************************************************************************
+ * Name: tmpfs_export_file
+ *
+ * Description:
+ *   Write the record of a locked regular file, followed by its name and
+ *   its data extents.  Pages held past the end of the file as growth
+ *   reserve are not part of the image.
+ *
+ ****************************************************************************/
+
+static int tmpfs_export_file(struct tmpfs_image_s *img,
+                             struct tmpfs_file_s *tfo,
+                             struct tmpfs_imgrec_s *rec)
+{
+  struct tmpfs_imgext_s ext;
+  size_t npages;
+  size_t pgndx;
+  size_t nbytes;
+  size_t i;
+  int ret;
+
+  npages = (tfo->tfo_size >> TMPFS_PAGE_SHIFT) +
+           ((tfo->tfo_size & TMPFS_PAGE_MASK) != 0);
+  if (npages > tfo->tfo_npages)
+    {
+      npages = tfo->tfo_npages;
+    }
+
+  rec->tir_size     = tfo->tfo_size;
+  rec->tir_nextents = 0;
+  for (pgndx = 0; tmpfs_image_extent(tfo, npages, &pgndx, &ext); )
+    {
+      rec->tir_nextents++;
+    }
+
+  ret = tmpfs_image_put(img, rec, sizeof(struct tmpfs_imgrec_s));
+  if (ret == OK)
+    {
+      ret = tmpfs_image_put(img, img->ti_name, rec->tir_namelen);
+    }
+
+  for (pgndx = 0; ret == OK && tmpfs_image_extent(tfo, npages, &pgndx, &ext); )
+    {
+      ret = tmpfs_image_put(img, &ext, sizeof(struct tmpfs_imgext_s));
+      for (i = ext.tie_first; ret == OK && i < pgndx; i++)
+        {
+          nbytes = tfo->tfo_size - (i << TMPFS_PAGE_SHIFT);
+          if (nbytes > TMPFS_PAGE_SIZE)
+            {
+              nbytes = TMPFS_PAGE_SIZE;
+            }
+
+          ret = tmpfs_image_put(img, tfo->tfo_pages[i], nbytes);
+        }
+    }
+
+  return ret;
+}
+
+/****************************************************************************
+ * Name: tmpfs_export_directory
+ *
+ * Description:
+ *   Write the records of every entry of the locked directory 'tdo',
+ *   descending into subdirectories, and close it with TMPFS_IMAGE_END.
+ *   Each entry is locked while it is written, so every file is captured
+ *   in a consistent state.  'depth' is the nesting of 'tdo'; a tree that
+ *   tmpfs_import_directory() would reject is not written.
+ *
+ ****************************************************************************/
+
+static int tmpfs_export_directory(struct tmpfs_image_s *img,
+                                  struct tmpfs_directory_s *tdo,
+                                  unsigned int depth)
+{
+  struct tmpfs_imgrec_s rec;
+  struct tmpfs_dirent_s *tde;
+  struct tmpfs_object_s *to;
+  LOS_DL_LIST *node;
+  int ret;
+
+  for (node = tdo->tdo_entry.pstNext; node != &tdo->tdo_entry;
+       node = node->pstNext)
     {
-      spin_lock(&tmpfs_alloc_unit_lock);
-      alloc = (g_tmpfs_alloc_unit > buflen) ? g_tmpfs_alloc_unit : buflen;
-      spin_unlock(&tmpfs_alloc_unit_lock);
-      data  = (char *)malloc(startpos + alloc);
-      if (!data)
+      tde = (struct tmpfs_dirent_s *)node;
+      to  = tde->tde_object;
+      if (tde->tde_inuse == false || to == NULL)
+        {
+          continue;
+        }
+
+      (void)memset_s(&rec, sizeof(rec), 0, sizeof(rec));
+      rec.tir_namelen = (uint16_t)strlen(tde->tde_name);
+      (void)memcpy_s(img->ti_name, sizeof(img->ti_name), tde->tde_name,
+                     rec.tir_namelen);
+
+      /* The entry is a child of the locked directory */
+
+      tmpfs_lock_object(to);
+
+      rec.tir_mode  = to->mode;
+      rec.tir_uid   = to->uid;
+      rec.tir_gid   = to->gid;
+      rec.tir_atime = to->to_atime;
+      rec.tir_mtime = to->to_mtime;
+      rec.tir_ctime = to->to_ctime;
+
+      if (to->to_type == TMPFS_DIRECTORY && depth >= TMPFS_IMAGE_MAXDEPTH)
         {
-          ret = -ENOSPC;
-          goto errout_with_lock;
+          ret = -EOVERFLOW;
         }
-      if (tfo->tfo_size)
+      else if (to->to_type == TMPFS_DIRECTORY)
         {
-          ret = memcpy_s(data, startpos + alloc, tfo->tfo_data, tfo->tfo_size);
-          if (ret != EOK)
+          rec.tir_type = TMPFS_IMAGE_DIRECTORY;
+          ret = tmpfs_image_put(img, &rec, sizeof(rec));
+          if (ret == OK)
+            {
+              ret = tmpfs_image_put(img, img->ti_name, rec.tir_namelen);
+            }
+
+          if (ret == OK)
             {
-              ret = -1;
-              free(data);
-              goto errout_with_lock;
+              ret = tmpfs_export_directory(img, (struct tmpfs_directory_s *)to,
+                                           depth + 1);
             }
-          free(tfo->tfo_data);
         }
-      if (startpos > tfo->tfo_size)
+      else
+        {
+          rec.tir_type = TMPFS_IMAGE_REGULAR;
+          ret = tmpfs_export_file(img, (struct tmpfs_file_s *)to, &rec);
+        }
+
+      tmpfs_unlock_object(to);
+      if (ret < 0)
         {
-          (void)memset_s(data + tfo->tfo_size, startpos + alloc - tfo->tfo_size, 0, startpos - tfo->tfo_size);
+          return ret;
         }
 
-      tfo->tfo_data = data;
-      tfo->tfo_size = startpos + alloc;
+      img->ti_nnodes++;
     }
 
-  /* Copy data from the memory object to the user buffer */
-  if (LOS_CopyToKernel(&tfo->tfo_data[startpos], nwritten, buffer, nwritten) != 0)
+  (void)memset_s(&rec, sizeof(rec), 0, sizeof(rec));
+  rec.tir_type = TMPFS_IMAGE_END;
+  return tmpfs_image_put(img, &rec, sizeof(rec));
+}
+
+/****************************************************************************
+ * Name: tmpfs_import_file
+ *
+ * Description:
+ *   Read the data extents of a regular file into the new, locked file
+ *   object 'tfo'.  The data goes straight into the file pages.
+ *
+ ****************************************************************************/
+
+static int tmpfs_import_file(struct tmpfs_image_s *img,
+                             struct tmpfs_file_s *tfo,
+                             const struct tmpfs_imgrec_s *rec)
+{
+  struct tmpfs_imgext_s ext;
+  size_t npages;
+  size_t next = 0;
+  size_t nbytes;
+  size_t i;
+  uint32_t n;
+  int ret;
+
+  if (rec->tir_size > SIZE_MAX - TMPFS_PAGE_MASK)
     {
-      ret = -EINVAL;
-      goto errout_with_lock;
+      return -EFBIG;
     }
-  filep->f_pos += nwritten;
 
-  /* Update the modified and access times of the node */
+  tfo->tfo_size = (size_t)rec->tir_size;
+  npages = (tfo->tfo_size + TMPFS_PAGE_MASK) >> TMPFS_PAGE_SHIFT;
 
-  tfo->tfo_ctime = tfo->tfo_mtime = tmpfs_timestamp();
+  for (n = 0; n < rec->tir_nextents; n++)
+    {
+      ret = tmpfs_image_get(img, &ext, sizeof(ext));
+      if (ret < 0)
+        {
+          return ret;
+        }
 
-  /* Release the lock on the file */
+      /* Extents are in ascending order and lie within the file */
 
-  tmpfs_unlock_file(tfo);
-  return nwritten;
+      if (ext.tie_first < next || ext.tie_first >= npages ||
+          ext.tie_npages == 0 || ext.tie_npages > npages - ext.tie_first)
+        {
+          return -EINVAL;
+        }
 
-errout_with_lock:
-  tmpfs_unlock_file(tfo);
-  return (ssize_t)ret;
+      next = (size_t)ext.tie_first + ext.tie_npages;
+      ret  = tmpfs_alloc_range(tfo, (loff_t)ext.tie_first << TMPFS_PAGE_SHIFT,
+                               (loff_t)next << TMPFS_PAGE_SHIFT);
+      if (ret < 0)
+        {
+          return ret;
+        }
+
+      for (i = ext.tie_first; i < next; i++)
+        {
+          nbytes = tfo->tfo_size - (i << TMPFS_PAGE_SHIFT);
+          if (nbytes > TMPFS_PAGE_SIZE)
+            {
+              nbytes = TMPFS_PAGE_SIZE;
+            }
+
+          ret = tmpfs_image_get(img, tfo->tfo_pages[i], nbytes);
+          if (ret < 0)
+            {
+              return ret;
+            }
+        }
+    }
+
+  return OK;
 }
 
 /****************************************************************************
- * Name: tmpfs_seek
+ * Name: tmpfs_import_setattr
  ****************************************************************************/
 
-off_t tmpfs_seek(struct file *filep, off_t offset, int whence)
+static void tmpfs_import_setattr(struct tmpfs_object_s *to,
+                                 const struct tmpfs_imgrec_s *rec)
 {
-  struct tmpfs_file_s *tfo;
-  off_t position;
-
-  DEBUGASSERT(filep->f_vnode != NULL);
+  to->mode     = (mode_t)rec->tir_mode;
+  to->uid      = rec->tir_uid;
+  to->gid      = rec->tir_gid;
+  to->to_atime = (time_t)rec->tir_atime;
+  to->to_mtime = (time_t)rec->tir_mtime;
+  to->to_ctime = (time_t)rec->tir_ctime;
+}
 
-  /* Recover our private data from the struct file instance */
+/****************************************************************************
+ * Name: tmpfs_import_directory
+ *
+ * Description:
+ *   Recreate the entries of the directory 'tdo' from the image, up to and
+ *   including its TMPFS_IMAGE_END record.  The attributes of a directory
+ *   are applied after its entries, which would otherwise update its times.
+ *
+ ****************************************************************************/
 
-  tfo = (struct tmpfs_file_s *)(filep->f_vnode->data);
-  if (tfo == NULL)
-    {
-      return -EINVAL;
-    }
-  /* Map the offset according to the whence option */
+static int tmpfs_import_directory(struct tmpfs_image_s *img,
+                                  struct tmpfs_s *fs,
+                                  struct tmpfs_directory_s *tdo,
+                                  unsigned int depth)
+{
+  struct tmpfs_directory_s *newtdo;
+  struct tmpfs_file_s *newtfo;
+  struct tmpfs_imgrec_s rec;
+  int ret;
 
-  switch (whence)
+  for (; ;)
     {
-      case SEEK_SET: /* The offset is set to offset bytes. */
-          position = offset;
-          break;
-
-      case SEEK_CUR: /* The offset is set to its current location plus
-                      * offset bytes. */
-          position = offset + filep->f_pos;
-          break;
+      ret = tmpfs_image_get(img, &rec, sizeof(rec));
+      if (ret < 0)
+        {
+          return ret;
+        }
 
-      case SEEK_END: /* The offset is set to the size of the file plus
-                      * offset bytes. */
-          position = offset + tfo->tfo_size;
-          break;
+      if (rec.tir_type == TMPFS_IMAGE_END)
+        {
+          return OK;
+        }
 
-      default:
+      if (rec.tir_namelen == 0 || rec.tir_namelen > NAME_MAX)
+        {
           return -EINVAL;
-    }
+        }
 
-  /* Attempts to set the position beyond the end of file will
-   * work if the file is open for write access.
-   *
-   * REVISIT: This simple implementation has no per-open storage that
-   * would be needed to retain the open flags.
-   */
-    if (position < 0)
-    {
-      return -EINVAL;
-    }
+      ret = tmpfs_image_get(img, img->ti_name, rec.tir_namelen);
+      if (ret < 0)
+        {
+          return ret;
+        }
+
+      img->ti_name[rec.tir_namelen] = '\0';
+      img->ti_nnodes++;
 
-  /* Save the new file position */
+      switch (rec.tir_type)
+        {
+          case TMPFS_IMAGE_DIRECTORY:
+            if (depth >= TMPFS_IMAGE_MAXDEPTH)
+              {
+                return -EINVAL;
+              }
+
+            ret = tmpfs_create_directory(fs, img->ti_name, tdo, &newtdo);
+            if (ret == OK)
+              {
+                ret = tmpfs_import_directory(img, fs, newtdo, depth + 1);
+                tmpfs_import_setattr((struct tmpfs_object_s *)newtdo, &rec);
+              }
+            break;
+
+          case TMPFS_IMAGE_REGULAR:
+            ret = tmpfs_create_file(fs, img->ti_name, tdo, &newtfo);
+            if (ret == OK)
+              {
+                ret = tmpfs_import_file(img, newtfo, &rec);
+                tmpfs_import_setattr((struct tmpfs_object_s *)newtfo, &rec);
+                tmpfs_release_lockedfile(newtfo);
+              }
+            break;
+
+          default:
+            ret = -EINVAL;
+            break;
+        }
 
-  filep->f_pos = position;
-  return position;
+      if (ret < 0)
+        {
+          return ret;
+        }
+    }
 }
 
 /****************************************************************************
- * Name: tmpfs_ioctl
+ * Name: tmpfs_import_discard
+ *
+ * Description:
+ *   Free everything below the directory 'tdo'.  Used to drop a partially
+ *   restored tree; nothing in it can be referenced yet.
+ *
  ****************************************************************************/
 
-int tmpfs_ioctl(struct file *filep, int cmd, unsigned long arg)
+static void tmpfs_import_discard(struct tmpfs_directory_s *tdo)
 {
-  return -EINVAL;
-}
+  struct tmpfs_dirent_s *tde;
+  struct tmpfs_object_s *to;
 
-/****************************************************************************
- * Name: tmpfs_sync
- ****************************************************************************/
+  while (!LOS_ListEmpty(&tdo->tdo_entry))
+    {
+      tde = (struct tmpfs_dirent_s *)tdo->tdo_entry.pstNext;
+      LOS_ListDelete(&tde->tde_node);
 
-int tmpfs_sync(struct file *filep)
-{
-  return 0;
+      to = tde->tde_object;
+      if (to != NULL && to->to_type == TMPFS_DIRECTORY)
+        {
+          tmpfs_import_discard((struct tmpfs_directory_s *)to);
+          tmpfs_free_directory((struct tmpfs_directory_s *)to);
+        }
+      else if (to != NULL)
+        {
+          tmpfs_free_file((struct tmpfs_file_s *)to);
+        }
+
+      tmpfs_free_dirent(tde);
+    }
+
+  tdo->tdo_nentries = 0;
+  tmpfs_dirhash_free(tdo);
 }
 
 /****************************************************************************
- * Name: tmpfs_opendir
+ * Name: tmpfs_import
+ *
+ * Description:
+ *   Populate the empty root directory of a new mount from the image on
+ *   'blkdev'.  On failure the root is left empty again.
+ *
  ****************************************************************************/
 
-int tmpfs_opendir(struct Vnode *vp, struct fs_dirent_s *dir)
+static int tmpfs_import(struct tmpfs_s *fs, const char *blkdev)
 {
-  struct tmpfs_s *fs;
   struct tmpfs_directory_s *tdo;
-  int ret = 0;
-  struct fs_tmpfsdir_s *tmp;
-
-  DEBUGASSERT(vp != NULL && dir != NULL);
-
-  /* Get the mountpoint private data from the inode structure */
-
-  fs = vp->originMount->data;
-  DEBUGASSERT(fs != NULL);
+  struct tmpfs_imghdr_s hdr;
+  struct tmpfs_image_s *img;
+  int ret;
 
-  tmp = (struct fs_tmpfsdir_s *)malloc(sizeof(struct fs_tmpfsdir_s));
-  if (!tmp)
+  img = (struct tmpfs_image_s *)kmm_malloc(sizeof(struct tmpfs_image_s));
+  if (img == NULL)
     {
-      return -ENOSPC;
+      return -ENOMEM;
     }
 
-  /* Get exclusive access to the file system */
+  (void)memset_s(img, sizeof(struct tmpfs_image_s), 0,
+                 sizeof(struct tmpfs_image_s));
 
-  tmpfs_lock(fs);
+  ret = bchlib_setup(blkdev, true, &img->ti_bch);
+  if (ret < 0)
+    {
+      goto errout_with_img;
+    }
 
-  /* Find the directory object associated with this relative path.
-   * If successful, this action will lock both the parent directory and
-   * the file object, adding one to the reference count of both.
-   * In the event that -ENOENT, there will still be a reference and
-   * lock on the returned directory.
-   */
+  img->ti_end = sizeof(hdr);
+  ret = tmpfs_image_get(img, &hdr, sizeof(hdr));
+  if (ret < 0)
+    {
+      goto errout_with_bch;
+    }
 
-  if (vp->data != NULL)
+  if (hdr.tih_magic != TMPFS_IMAGE_MAGIC)
     {
-      tdo = (struct tmpfs_directory_s *)vp->data;
+      ret = -ENOENT;
+      goto errout_with_bch;
     }
-  else
+
+  if (hdr.tih_version != TMPFS_IMAGE_VERSION ||
+      hdr.tih_pageshift != TMPFS_PAGE_SHIFT ||
+      hdr.tih_length > (uint64_t)LLONG_MAX - sizeof(hdr))
     {
-      tdo = (struct tmpfs_directory_s *)fs->tfs_root.tde_object;
+      ret = -EINVAL;
+      goto errout_with_bch;
     }
 
-  if (tdo == NULL)
+  img->ti_end      = (loff_t)(sizeof(hdr) + hdr.tih_length);
+  img->ti_checksum = 2166136261u;
+  img->ti_nnodes   = 0;
+
+  tdo = (struct tmpfs_directory_s *)fs->tfs_root.tde_object;
+  ret = tmpfs_import_directory(img, fs, tdo, 0);
+  if (ret == OK &&
+      (img->ti_offset != img->ti_end || img->ti_nnodes != hdr.tih_nnodes ||
+       img->ti_checksum != hdr.tih_checksum))
     {
-      free(tmp);
-      tmpfs_unlock(fs);
-      return -EINTR;
+      ret = -EINVAL;
     }
-  tmpfs_lock_directory(tdo);
-  tmp->tf_tdo   = tdo;
-  tmp->tf_index = 0;
-  dir->u.fs_dir = (fs_dir_s)tmp;
-  tdo->tdo_count++;
-  tdo->tdo_refs++;
-  tmpfs_unlock_directory(tdo);
 
-  /* Release the lock on the file system and return the result */
+  if (ret < 0)
+    {
+      tmpfs_import_discard(tdo);
+    }
 
-  tmpfs_unlock(fs);
+errout_with_bch:
+  (void)bchlib_teardown(img->ti_bch);
+errout_with_img:
+  kmm_free(img);
   return ret;
 }
 
 /****************************************************************************
- * Name: tmpfs_closedir
+ * Name: tmpfs_export
+ *
+ * Description:
+ *   Write an image of the mounted tmpfs to the block device 'blkdev'.  An
+ *   older image on the device is invalidated before the new one is
+ *   written.  Namespace changes that move entries between directories are
+ *   held off for the duration; every file is captured consistently, but
+ *   writers should be quiesced for a point-in-time image of the whole
+ *   tree.
+ *
+ * Returned Value:
+ *   Zero on success or a negated errno on failure; -EOVERFLOW if
+ *   directories are nested deeper than TMPFS_IMAGE_MAXDEPTH, which an
+ *   import would reject.
+ *
  ****************************************************************************/
 
-int tmpfs_closedir(struct Vnode *vp, struct fs_dirent_s *dir)
+int tmpfs_export(const char *blkdev)
 {
+  struct tmpfs_s *fs = &tmpfs_superblock;
   struct tmpfs_directory_s *tdo;
-  struct fs_tmpfsdir_s *tmp;
-
-  DEBUGASSERT(vp != NULL && dir != NULL);
+  struct tmpfs_imghdr_s hdr;
+  struct tmpfs_image_s *img;
+  int ret;
 
-  /* Get the directory structure from the dir argument */
+  if (blkdev == NULL)
+    {
+      return -EINVAL;
+    }
 
-  tmp = (struct fs_tmpfsdir_s *)dir->u.fs_dir;
-  if (tmp == NULL)
+  img = (struct tmpfs_image_s *)kmm_malloc(sizeof(struct tmpfs_image_s));
+  if (img == NULL)
     {
-      return -ENOENT;
+      return -ENOMEM;
     }
-  tdo = tmp->tf_tdo;
-  DEBUGASSERT(tdo != NULL);
 
-  /* Decrement the reference count on the directory object */
+  (void)memset_s(img, sizeof(struct tmpfs_image_s), 0,
+                 sizeof(struct tmpfs_image_s));
 
-  tmpfs_lock_directory(tdo);
-  if (tdo->tdo_count == 1)
+  ret = bchlib_setup(blkdev, false, &img->ti_bch);
+  if (ret < 0)
     {
-      LOS_DL_LIST *node = tdo->tdo_entry.pstNext;
-      struct tmpfs_dirent_s *tde;
-      while (node != &tdo->tdo_entry)
-        {
-          tde = (struct tmpfs_dirent_s *)node;
-          node = node->pstNext;
-          if (tde->tde_inuse == false)
-            {
-              LOS_ListDelete(&tde->tde_node);
-              kmm_free(tde);
-            }
-        }
+      goto errout_with_img;
     }
-  if (tdo->tdo_refs > 0)
+
+  /* Clear the header of any older image, then stream the records */
+
+  (void)memset_s(&hdr, sizeof(hdr), 0, sizeof(hdr));
+  ret = tmpfs_image_put(img, &hdr, sizeof(hdr));
+  if (ret < 0)
     {
-      tdo->tdo_refs--;
+      goto errout_with_bch;
     }
-  if (tdo->tdo_count > 0)
+
+  img->ti_checksum = 2166136261u;
+
+  /* The fs lock keeps the mount in place and holds off cross-directory
+   * renames.  Directories are locked parent first on the way down.
+   */
+
+  tmpfs_lock(fs);
+
+  tdo = (struct tmpfs_directory_s *)fs->tfs_root.tde_object;
+  if (tdo == NULL)
     {
-      tdo->tdo_count--;
+      tmpfs_unlock(fs);
+      ret = -ENODEV;
+      goto errout_with_bch;
     }
+
+  tmpfs_lock_directory(tdo);
+  ret = tmpfs_export_directory(img, tdo, 0);
   tmpfs_unlock_directory(tdo);
+  tmpfs_unlock(fs);
 
-  free(tmp);
+  if (ret < 0)
+    {
+      goto errout_with_bch;
+    }
 
-  return OK;
+  /* Finally make the image valid */
+
+  hdr.tih_magic     = TMPFS_IMAGE_MAGIC;
+  hdr.tih_version   = TMPFS_IMAGE_VERSION;
+  hdr.tih_pageshift = TMPFS_PAGE_SHIFT;
+  hdr.tih_nnodes    = img->ti_nnodes;
+  hdr.tih_checksum  = img->ti_checksum;
+  hdr.tih_length    = (uint64_t)(img->ti_offset - sizeof(hdr));
+
+  img->ti_offset = 0;
+  ret = tmpfs_image_put(img, &hdr, sizeof(hdr));
+
+errout_with_bch:
+  (void)bchlib_teardown(img->ti_bch);
+errout_with_img:
+  kmm_free(img);
+  return ret;
 }
 
+#else
+
 /****************************************************************************
- * Name: tmpfs_readdir
+ * Name: tmpfs_import / tmpfs_export
+ *
+ * Description:
+ *   Images need block device support.
+ *
  ****************************************************************************/
 
-int tmpfs_readdir(struct Vnode *vp, struct fs_dirent_s *dir)
+static int tmpfs_import(struct tmpfs_s *fs, const char *blkdev)
 {
-  struct tmpfs_directory_s *tdo;
-  unsigned int index;
-  int ret;
-  struct fs_tmpfsdir_s *tmp;
-  LOS_DL_LIST *node;
-  struct tmpfs_dirent_s *tde;
-
-  DEBUGASSERT(vp != NULL && dir != NULL);
-
-  /* Get the directory structure from the dir argument and lock it */
-
-  tmp = (struct fs_tmpfsdir_s *)dir->u.fs_dir;
-  if (tmp == NULL)
-    {
-      return -ENOENT;
-    }
+  return -ENOSYS;
+}
 
-  tdo = tmp->tf_tdo;
-  if (tdo == NULL)
-    {
-      return -ENOENT;
-    }
+int tmpfs_export(const char *blkdev)
+{
+  return -ENOSYS;
+}
 
-  tmpfs_lock_directory(tdo);
+#endif /* LOSCFG_FS_VFS_BLOCK_DEVICE */
 
-  /* Have we reached the end of the directory? */
+/****************************************************************************
+ * Name: tmpfs_parse_size
+ *
+ * Description:
+ *   Parse a byte count with an optional k, m or g suffix.
+ *
+ ****************************************************************************/
 
-  index = tmp->tf_index;
-  node = tdo->tdo_entry.pstNext;
-  while (node != &tdo->tdo_entry && index != 0)
-    {
-       node = node->pstNext;
-       index--;
-    }
+static int tmpfs_parse_size(const char *str, unsigned long long *size)
+{
+  unsigned long long value;
+  unsigned int shift;
+  char *end;
 
-  while (node != &tdo->tdo_entry)
+  if (*str < '0' || *str > '9')
     {
-      tde = (struct tmpfs_dirent_s *)node;
-      tmp->tf_index++;
-      if (tde->tde_inuse == true)
-       {
-         break;
-       }
-       node = node->pstNext;
+      return -EINVAL;
     }
 
-  if (node == &tdo->tdo_entry)
-    {
-      /* We signal the end of the directory by returning the special error:
-       * -ENOENT
-       */
-
-      PRINT_INFO("End of directory\n");
-      ret = -ENOENT;
-    }
-  else
+  value = strtoull(str, &end, 0);
+  switch (*end)
     {
-      struct tmpfs_object_s *to;
-
-      /* Does this entry refer to a file or a directory object? */
-
-      to  = tde->tde_object;
-      DEBUGASSERT(to != NULL);
-
-      if (to->to_type == TMPFS_DIRECTORY)
-        {
-          /* A directory */
-
-           dir->fd_dir[0].d_type = DT_DIR;
-        }
-      else /* to->to_type == TMPFS_REGULAR) */
-        {
-          /* A regular file */
+      case 'g':
+      case 'G':
+        shift = 30;
+        break;
 
-           dir->fd_dir[0].d_type = DT_REG;
-        }
+      case 'm':
+      case 'M':
+        shift = 20;
+        break;
 
-      /* Copy the entry name */
+      case 'k':
+      case 'K':
+        shift = 10;
+        break;
 
-      (void)strncpy_s(dir->fd_dir[0].d_name, NAME_MAX + 1, tde->tde_name, NAME_MAX);
+      case '\0':
+        shift = 0;
+        break;
 
-      dir->fd_position++;
-      dir->fd_dir[0].d_off = dir->fd_position;
-      dir->fd_dir[0].d_reclen = (uint16_t)sizeof(struct dirent);
+      default:
+        return -EINVAL;
+    }
 
-      ret = 1; // 1 means current file num is 1
+  if ((shift != 0 && end[1] != '\0') || value > (ULLONG_MAX >> shift))
+    {
+      return -EINVAL;
     }
 
-  tmpfs_unlock_directory(tdo);
-  return ret;
+  *size = value << shift;
+  return OK;
 }
 
 /****************************************************************************
- * Name: tmpfs_rewinddir
+ * Name: tmpfs_parse_options
+ *
+ * Description:
+ *   Apply the comma separated mount options in 'data':
+ *
+ *     size=<bytes>[k|m|g]  Limit the file data held by the mount.  Rounded
+ *                          up to whole pages.
+ *     nr_inodes=<n>[k|m|g] Limit the number of files and directories,
+ *                          including the root directory.
+ *     growth=<bytes>[k|m|g] Capacity reserved past the end of a file
+ *                          whenever a write extends it, at most
+ *                          CONFIG_FS_TMPFS_MAX_GROWTH.  Returned in
+ *                          '*growth', which is left alone if the option
+ *                          is not given.
+ *     restore=<blkdev>     Load the image written by tmpfs_export() from
+ *                          the block device at mount time.  The device
+ *                          path is returned in '*restore' for the caller
+ *                          to free.
+ *
+ *   For size= and nr_inodes=, a value of zero, or leaving the option out,
+ *   means no limit.
+ *
  ****************************************************************************/
 
-int tmpfs_rewinddir(struct Vnode *vp, struct fs_dirent_s *dir)
+static int tmpfs_parse_options(struct tmpfs_s *fs, const char *data,
+                               unsigned long long *growth, char **restore)
 {
-  struct fs_tmpfsdir_s *tmp;
-  PRINT_DEBUG("vp: %p dir: %p\n",  vp, dir);
-  DEBUGASSERT(vp != NULL && dir != NULL);
-  tmp = (struct fs_tmpfsdir_s *)dir->u.fs_dir;
+  unsigned long long value;
+  char *copy;
+  char *opt;
+  char *saveptr;
+  int ret = OK;
 
-  /* Set the readdir index to zero */
+  fs->tfs_maxpages = 0;
+  fs->tfs_maxnodes = 0;
 
-  tmp->tf_index = 0;
-  return OK;
-}
+  if (data == NULL || *data == '\0')
+    {
+      return OK;
+    }
 
-int tmpfs_truncate(struct Vnode *vp, off_t len)
-{
-  struct tmpfs_file_s *tfo = NULL;
+  copy = strdup(data);
+  if (copy == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  for (opt = strtok_r(copy, ",", &saveptr);
+       opt != NULL;
+       opt = strtok_r(NULL, ",", &saveptr))
+    {
+      if (strncmp(opt, "size=", 5) == 0)
+        {
+          ret = tmpfs_parse_size(opt + 5, &value);
+          if (ret < 0)
+            {
+              break;
+            }
+
+          value = (value >> TMPFS_PAGE_SHIFT) + ((value & TMPFS_PAGE_MASK) != 0);
+          fs->tfs_maxpages = (value > SIZE_MAX) ? SIZE_MAX : (size_t)value;
+        }
+      else if (strncmp(opt, "nr_inodes=", 10) == 0)
+        {
+          ret = tmpfs_parse_size(opt + 10, &value);
+          if (ret < 0)
+            {
+              break;
+            }
+
+          fs->tfs_maxnodes = (value > SIZE_MAX) ? SIZE_MAX : (size_t)value;
+        }
+      else if (strncmp(opt, "growth=", 7) == 0)
+        {
+          ret = tmpfs_parse_size(opt + 7, &value);
+          if (ret < 0)
+            {
+              break;
+            }
 
-  tfo = vp->data;
-  tfo->tfo_size = 0;
+          *growth = (value > CONFIG_FS_TMPFS_MAX_GROWTH) ?
+                    CONFIG_FS_TMPFS_MAX_GROWTH : value;
+        }
+      else if (strncmp(opt, "restore=", 8) == 0 && opt[8] != '\0')
+        {
+          if (*restore != NULL)
+            {
+              kmm_free(*restore);
+            }
+
+          *restore = strdup(opt + 8);
+          if (*restore == NULL)
+            {
+              ret = -ENOMEM;
+              break;
+            }
+        }
+      else
+        {
+          ret = -EINVAL;
+          break;
+        }
+    }
 
-  if (tfo->tfo_data)
+  if (ret < 0)
     {
-      free(tfo->tfo_data);
+      PRINT_ERR("tmpfs: bad mount option \"%s\"\n", opt);
+      if (*restore != NULL)
+        {
+          kmm_free(*restore);
+          *restore = NULL;
+        }
     }
 
-  return OK;
+  kmm_free(copy);
+  return ret;
 }
 
-
 /****************************************************************************
  * Name: tmpfs_mount
  ****************************************************************************/
@@ -1671,6 +3731,8 @@ int tmpfs_mount(struct Mount *mnt, struct Vnode *device, const void *data)
   struct tmpfs_directory_s *tdo;
   struct tmpfs_s *fs = &tmpfs_superblock;
   struct Vnode *vp = NULL;
+  unsigned long long growth = ULLONG_MAX;
+  char *restore = NULL;
   int ret;
 
   DEBUGASSERT(device == NULL);
@@ -1680,6 +3742,28 @@ int tmpfs_mount(struct Mount *mnt, struct Vnode *device, const void *data)
       return -EPERM;
     }
 
+  /* Apply the mount options before anything is charged against them */
+
+  spin_lock_init(&fs->tfs_statlock);
+  fs->tfs_npages = 0;
+  fs->tfs_nnodes = 0;
+  tmpfs_pool_init(fs);
+
+  ret = tmpfs_parse_options(fs, (const char *)data, &growth, &restore);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  /* Without growth= the default comes from los_set_ramfs_unit(), which may
+   * run concurrently.  Either way the reserve is limited by size=.
+   */
+
+  spin_lock(&g_tmpfs_growthlock);
+  fs->tfs_growth = tmpfs_clamp_growth(fs, (growth == ULLONG_MAX) ?
+                                      g_tmpfs_alloc_unit : growth);
+  spin_unlock(&g_tmpfs_growthlock);
+
   /* Create a root file system.  This is like a single directory entry in
    * the file system structure.
    */
@@ -1687,7 +3771,8 @@ int tmpfs_mount(struct Mount *mnt, struct Vnode *device, const void *data)
   tdo = tmpfs_alloc_directory();
   if (tdo == NULL)
     {
-      return -ENOSPC;
+      ret = -ENOSPC;
+      goto errout_with_restore;
     }
 
   LOS_ListInit(&fs->tfs_root.tde_node);
@@ -1704,10 +3789,23 @@ int tmpfs_mount(struct Mount *mnt, struct Vnode *device, const void *data)
   fs->tfs_exclsem.ts_count  = 0;
   sem_init(&fs->tfs_exclsem.ts_sem, 0, 1);
 
-  /* Return the new file system handle */
+  /* Reload the saved tree.  Without a usable image the mount simply
+   * starts out empty.
+   */
+
+  if (restore != NULL)
+    {
+      ret = tmpfs_import(fs, restore);
+      if (ret < 0)
+        {
+          PRINT_ERR("tmpfs: no image restored from %s: %d\n", restore, ret);
+        }
 
-  spin_lock_init(&tmpfs_alloc_unit_lock);
-  is_tmpfs_lock_init = true;
+      kmm_free(restore);
+      restore = NULL;
+    }
+
+  /* Return the new file system handle */
 
   ret = VnodeAlloc(&tmpfs_vops, &vp);
   if (ret != 0)
@@ -1733,6 +3831,14 @@ int tmpfs_mount(struct Mount *mnt, struct Vnode *device, const void *data)
 
 ERROR_WITH_FSWIN:
   return ret;
+
+errout_with_restore:
+  if (restore != NULL)
+    {
+      kmm_free(restore);
+    }
+
+  return ret;
 }
 
 /****************************************************************************
@@ -1766,14 +3872,13 @@ int tmpfs_unmount(struct Mount *mnt, struct Vnode **blkdriver)
 
   /* Now we can destroy the root file system and the file system itself. */
 
-  sem_destroy(&tdo->tdo_exclsem.ts_sem);
-  kmm_free(tdo);
+  tmpfs_free_directory(tdo);
+  tmpfs_pool_drain(fs);
 
   sem_destroy(&fs->tfs_exclsem.ts_sem);
   fs->tfs_root.tde_object = NULL;
 
   tmpfs_unlock(fs);
-  is_tmpfs_lock_init = false;
   return ret;
 
 errout_with_objects:
@@ -1806,43 +3911,32 @@ int tmpfs_lookup(struct Vnode *parent, const char *relPath, int len, struct Vnod
   fs = parent->originMount->data;
   DEBUGASSERT(fs != NULL && fs->tfs_root.tde_object != NULL);
 
-  tmpfs_lock(fs);
-
-  parent_tdo = (struct tmpfs_directory_s *)(parent->data);
+  /* Lock the parent directory only for as long as it takes to find the
+   * entry and pin the object it refers to.  Locks are always taken parent
+   * first, child second.
+   */
 
-  if (parent_tdo == NULL)
-    {
-      // if parent_tdo don't exist, find file in root.
-      ret = tmpfs_find_object(fs, filename, &to, NULL);
-      if (ret < 0)
-        {
-          goto errout_with_lock;
-        }
-    }
-  else
+  parent_tdo = tmpfs_vnode_directory(fs, parent);
+  if (parent_tdo == NULL || parent_tdo->tdo_type != TMPFS_DIRECTORY)
     {
-      if (parent_tdo->tdo_type != TMPFS_DIRECTORY)
-        {
-          ret = -ENOENT;
-          goto errout_with_lock;
-        }
-      // if parent_tdo exist£¬search for the relationship between parent_tdo and the current dirname.
-      tde = tmpfs_find_dirent(parent_tdo, filename);
-      if (tde == NULL)
-        {
-          ret = -ENOENT;
-          goto errout_with_lock;
-        }
-      to = tde->tde_object;
+      ret = -ENOENT;
+      goto errout;
     }
 
-  if (to == NULL)
+  tmpfs_lock_directory(parent_tdo);
+
+  tde = tmpfs_find_dirent(parent_tdo, filename);
+  if (tde == NULL || tde->tde_object == NULL)
     {
+      tmpfs_unlock_directory(parent_tdo);
       ret = -ENOENT;
-      goto errout_with_lock;
+      goto errout;
     }
+
+  to = tde->tde_object;
   tmpfs_lock_object(to);
   to->to_refs++;
+  tmpfs_unlock_directory(parent_tdo);
 
   (void)VfsHashGet(parent->originMount, (uint32_t)to, &vp, NULL, NULL);
   if (vp == NULL)
@@ -1851,7 +3945,7 @@ int tmpfs_lookup(struct Vnode *parent, const char *relPath, int len, struct Vnod
       if (ret != 0)
         {
           PRINTK("%s-%d \n", __FUNCTION__, __LINE__);
-          goto errout_with_objects;
+          goto errout_with_object;
         }
 
       vp->vop = parent->vop;
@@ -1870,14 +3964,10 @@ int tmpfs_lookup(struct Vnode *parent, const char *relPath, int len, struct Vnod
   *vpp = vp;
 
   tmpfs_release_lockedobject(to);
-  tmpfs_unlock(fs);
-
   return 0;
 
-errout_with_objects:
+errout_with_object:
   tmpfs_release_lockedobject(to);
-errout_with_lock:
-  tmpfs_unlock(fs);
 errout:
   return ret;
 }
@@ -1894,11 +3984,38 @@ int tmpfs_reclaim(struct Vnode *vp)
 
 int tmpfs_statfs(struct Mount *mp, struct statfs *sbp)
 {
+  struct tmpfs_s *fs = (struct tmpfs_s *)mp->data;
+
   (void)memset_s(sbp, sizeof(struct statfs), 0, sizeof(struct statfs));
 
   sbp->f_type = TMPFS_MAGIC;
   sbp->f_flags = mp->mountFlags;
+  sbp->f_bsize = TMPFS_PAGE_SIZE;
+  sbp->f_frsize = TMPFS_PAGE_SIZE;
+  sbp->f_namelen = NAME_MAX;
+
+  if (fs == NULL)
+    {
+      return OK;
+    }
+
+  /* As on Linux, an unlimited resource reports zero totals */
 
+  spin_lock(&fs->tfs_statlock);
+  if (fs->tfs_maxpages != 0)
+    {
+      sbp->f_blocks = fs->tfs_maxpages;
+      sbp->f_bfree  = fs->tfs_maxpages - fs->tfs_npages;
+      sbp->f_bavail = sbp->f_bfree;
+    }
+
+  if (fs->tfs_maxnodes != 0)
+    {
+      sbp->f_files = fs->tfs_maxnodes;
+      sbp->f_ffree = fs->tfs_maxnodes - fs->tfs_nnodes;
+    }
+
+  spin_unlock(&fs->tfs_statlock);
   return OK;
 }
 
@@ -1935,58 +4052,35 @@ int tmpfs_unlink(struct Vnode *parent, struct Vnode *node, const char *relpath)
 
   DEBUGASSERT(fs != NULL && fs->tfs_root.tde_object != NULL);
 
-  /* Get exclusive access to the file system */
-
-  tmpfs_lock(fs);
-
-  /* Find the file object and parent directory associated with this relative
-   * path.  If successful, tmpfs_find_file will lock both the file object
-   * and the parent directory and take one reference count on each.
-   */
-
-  parent_dir = (struct tmpfs_directory_s *)(parent->data);
-  if (parent_dir == NULL)
-    {
-      ret = tmpfs_find_file(fs, relpath, &tfo, &parent_dir);
-      if (ret < 0)
-        {
-          goto errout_with_lock;
-        }
-    }
-  else
-    {
-      tfo = (struct tmpfs_file_s *)node->data;
-    }
-
+  parent_dir = tmpfs_vnode_directory(fs, parent);
+  tfo = (struct tmpfs_file_s *)node->data;
   if (tfo == NULL || parent_dir == NULL)
     {
-      ret = -EISDIR;
-      goto errout_with_lock;
+      return -EISDIR;
     }
-  DEBUGASSERT(tfo != NULL);
+
+  /* Lock the parent directory, then the file */
+
   tmpfs_lock_directory(parent_dir);
   tmpfs_lock_file(tfo);
 
   /* Remove the file from parent directory */
+
   ret = tmpfs_remove_dirent(parent_dir, (struct tmpfs_object_s *)tfo);
   if (ret < 0)
     {
-      goto errout_with_objects;
+      tmpfs_unlock_file(tfo);
+      tmpfs_unlock_directory(parent_dir);
+      return ret;
     }
 
-  /* If the reference count is not one, then just mark the file as
-   * unlinked
+  /* If the file is still open, just mark it as unlinked.  The last close
+   * frees it.
    */
 
-  if (tfo->tfo_refs > 1)
+  if (tfo->tfo_refs > 0)
     {
-      /* Make the file object as unlinked */
-
       tfo->tfo_flags |= TFO_FLAG_UNLINKED;
-
-      /* Release the reference count on the file object */
-
-      tfo->tfo_refs--;
       tmpfs_unlock_file(tfo);
     }
 
@@ -1994,36 +4088,12 @@ int tmpfs_unlink(struct Vnode *parent, struct Vnode *node, const char *relpath)
 
   else
     {
-      sem_destroy(&tfo->tfo_exclsem.ts_sem);
-      kmm_free(tfo->tfo_data);
-      kmm_free(tfo);
+      tmpfs_free_file(tfo);
       node->data = NULL;
     }
 
-  /* Release the reference and lock on the parent directory */
-
-  if (parent_dir->tdo_refs > 0)
-    {
-      parent_dir->tdo_refs--;
-    }
   tmpfs_unlock_directory(parent_dir);
-  tmpfs_unlock(fs);
-
   return OK;
-
-errout_with_objects:
-  tmpfs_release_lockedfile(tfo);
-
-  if (parent_dir->tdo_refs > 0)
-    {
-      parent_dir->tdo_refs--;
-    }
-
-  tmpfs_unlock_directory(parent_dir);
-
-errout_with_lock:
-  tmpfs_unlock(fs);
-  return ret;
 }
 
 /****************************************************************************
@@ -2050,25 +4120,23 @@ int tmpfs_mkdir(struct Vnode *parent, const char *relpath, mode_t mode, struct V
   fs = parent->originMount->data;
   DEBUGASSERT(fs != NULL && fs->tfs_root.tde_object != NULL);
 
-  /* Get exclusive access to the file system */
-
-  tmpfs_lock(fs);
-
   if (parent->data != NULL)
     {
       parent_tdo = (struct tmpfs_directory_s *)(parent->data);
     }
-  /* Create the directory. */
+
+  /* Create the directory.  Only the parent directory is locked. */
+
   ret = tmpfs_create_directory(fs, relpath, parent_tdo, &tdo);
   if (ret != OK)
     {
-      goto errout_with_lock;
+      return ret;
     }
 
   ret = VnodeAlloc(&tmpfs_vops, &vp);
   if (ret != 0)
     {
-      goto errout_with_lock;
+      return ret;
     }
 
   tdo->mode = mode;
@@ -2084,9 +4152,6 @@ int tmpfs_mkdir(struct Vnode *parent, const char *relpath, mode_t mode, struct V
 
   ret = VfsHashInsert(vp, (uint32_t)tdo);
   *vpp = vp;
-
-errout_with_lock:
-  tmpfs_unlock(fs);
   return ret;
 }
 
@@ -2111,48 +4176,31 @@ int tmpfs_rmdir(struct Vnode *parent, struct Vnode *target, const char *dirname)
     }
   DEBUGASSERT(fs != NULL && fs->tfs_root.tde_object != NULL);
 
-  /* Get exclusive access to the file system */
-
-  tmpfs_lock(fs);
-
-  /* Find the directory object and parent directory associated with this
-   * relative path.  If successful, tmpfs_find_file will lock both the
-   * directory object and the parent directory and take one reference count
-   * on each.
-   */
-  parent_dir = (struct tmpfs_directory_s *)(parent->data);
-  if (parent_dir == NULL)
-    {
-      ret = tmpfs_find_directory(fs, dirname, &tdo, &parent_dir);
-      if (ret < 0)
-        {
-          goto errout_with_lock;
-        }
-    }
-  else
+  parent_dir = tmpfs_vnode_directory(fs, parent);
+  tdo = (struct tmpfs_directory_s *)target->data;
+  if (parent_dir == NULL || tdo == NULL || tdo->tdo_type != TMPFS_DIRECTORY)
     {
-      tdo = (struct tmpfs_directory_s *)target->data;
+      return -EISDIR;
     }
 
-  if (tdo == NULL || tdo->tdo_type != TMPFS_DIRECTORY)
-    {
-      ret = -EISDIR;
-      goto errout_with_lock;
-    }
+  /* Lock the parent directory, then the directory itself */
+
   tmpfs_lock_directory(parent_dir);
+  tmpfs_lock_directory(tdo);
 
   /* Is the directory empty?  We cannot remove directories that still
    * contain references to file system objects.  No can we remove the
-   * directory if there are outstanding references on it (other than
-   * our reference).
+   * directory if there are outstanding references on it.
    */
 
-  if (tdo->tdo_nentries > 0 || tdo->tdo_refs > 1)
+  if (tdo->tdo_nentries > 0 || tdo->tdo_refs > 0)
     {
       ret = -EBUSY;
       goto errout_with_objects;
     }
+
   /* Remove the directory from parent directory */
+
   ret = tmpfs_remove_dirent(parent_dir, (struct tmpfs_object_s *)tdo);
   if (ret < 0)
     {
@@ -2161,37 +4209,15 @@ int tmpfs_rmdir(struct Vnode *parent, struct Vnode *target, const char *dirname)
 
   /* Free the directory object */
 
-  sem_destroy(&tdo->tdo_exclsem.ts_sem);
-  kmm_free(tdo);
+  tmpfs_free_directory(tdo);
   target->data = NULL;
 
-  /* Release the reference and lock on the parent directory */
-
-  if (parent_dir->tdo_refs > 0)
-    {
-      parent_dir->tdo_refs--;
-    }
-
   tmpfs_unlock_directory(parent_dir);
-  tmpfs_unlock(fs);
-
   return OK;
 
 errout_with_objects:
-  if (tdo->tdo_refs > 0)
-    {
-      tdo->tdo_refs--;
-    }
   tmpfs_unlock_directory(tdo);
-
-  if (parent_dir->tdo_refs > 0)
-    {
-      parent_dir->tdo_refs--;
-    }
   tmpfs_unlock_directory(parent_dir);
-
-errout_with_lock:
-  tmpfs_unlock(fs);
   return ret;
 }
 
@@ -2207,8 +4233,9 @@ int tmpfs_rename(struct Vnode *oldVnode, struct Vnode *newParent, const char *ol
   struct tmpfs_dirent_s *tde;
   struct tmpfs_directory_s *tdo;
   struct tmpfs_file_s *tfo;
+  struct tmpfs_directory_s *first;
+  struct tmpfs_directory_s *second;
   struct tmpfs_s *fs;
-  struct tmpfs_s *new_fs;
   struct Vnode *old_parent_vnode;
 
   char *copy;
@@ -2248,100 +4275,112 @@ int tmpfs_rename(struct Vnode *oldVnode, struct Vnode *newParent, const char *ol
       return -ENOSPC;
     }
 
-  /* Get exclusive access to the file system */
-
-  tmpfs_lock(fs);
-
-  /* Separate the new path into the new file name and the path to the new
-   * parent directory.
-   */
-  newparent_tdo = (struct tmpfs_directory_s *)(newParent->data);
-  if (newparent_tdo == NULL)
+  newparent_tdo = tmpfs_vnode_directory(newParent->originMount->data, newParent);
+  old_parent_vnode = oldVnode->parent;
+  oldparent = tmpfs_vnode_directory(fs, old_parent_vnode);
+  old_to = (struct tmpfs_object_s *)oldVnode->data;
+  if (newparent_tdo == NULL || oldparent == NULL || old_to == NULL)
     {
-      new_fs = newParent->originMount->data;
-      newparent_tdo = (struct tmpfs_directory_s *)new_fs->tfs_root.tde_object;
-      if (newparent_tdo == NULL)
-        {
-          ret = -ENOTEMPTY;
-          goto errout_with_lock;
-        }
-      tmpfs_lock_directory(newparent_tdo);
-      newparent_tdo->tdo_refs++;
+      kmm_free(copy);
+      return -ENOTEMPTY;
     }
 
-  /* Find the old object at oldpath.  If successful, tmpfs_find_object()
-   * will lock both the object and the parent directory and will increment
-   * the reference count on both.
+  /* Lock both parent directories.  A rename within one directory needs
+   * only that directory.  Renames across directories are serialized by the
+   * file system lock, and take the ancestor first (or, for unrelated
+   * directories, the lower address first) so that they cannot deadlock
+   * against lookups, which lock from the parent down.
    */
-  old_parent_vnode = oldVnode->parent;
-  oldparent = (struct tmpfs_directory_s *)(old_parent_vnode->data);
-  old_to = (struct tmpfs_object_s *)oldVnode->data;
 
-  if (oldparent == NULL)
+  if (oldparent == newparent_tdo)
+    {
+      first  = oldparent;
+      second = NULL;
+    }
+  else
     {
-      oldparent = (struct tmpfs_directory_s *)fs->tfs_root.tde_object;
-      if (oldparent == NULL || old_to == NULL)
+      tmpfs_lock(fs);
+
+      if (tmpfs_vnode_isancestor(old_parent_vnode, newParent))
+        {
+          first  = oldparent;
+          second = newparent_tdo;
+        }
+      else if (tmpfs_vnode_isancestor(newParent, old_parent_vnode) ||
+               (uintptr_t)newparent_tdo < (uintptr_t)oldparent)
+        {
+          first  = newparent_tdo;
+          second = oldparent;
+        }
+      else
         {
-          ret = -ENOTEMPTY;
-          goto errout_with_newparent;
+          first  = oldparent;
+          second = newparent_tdo;
         }
     }
 
-  tmpfs_lock_directory(oldparent);
+  tmpfs_lock_directory(first);
+  if (second != NULL)
+    {
+      tmpfs_lock_directory(second);
+    }
+
   tmpfs_lock_object(old_to);
-  oldparent->tdo_refs++;
-  old_to->to_refs++;
+
   tde = tmpfs_find_dirent(newparent_tdo, copy);
   if (tde != NULL)
     {
       struct tmpfs_object_s *new_to = tde->tde_object;
 
+      /* Null rename, just return */
+
+      if (old_to == new_to)
+        {
+          ret = ENOERR;
+          goto errout_with_objects;
+        }
+
       /* Cannot rename a directory to a noempty directory */
 
-      if (tde->tde_object->to_type == TMPFS_DIRECTORY)
+      if (new_to->to_type == TMPFS_DIRECTORY)
         {
           tdo = (struct tmpfs_directory_s *)new_to;
           if (tdo->tdo_nentries != 0)
             {
               ret = -ENOTEMPTY;
-              goto errout_with_oldparent;
+              goto errout_with_objects;
             }
         }
 
-      /* Null rename, just return */
-
-      if (old_to == new_to)
-        {
-          ret = ENOERR;
-          goto errout_with_oldparent;
-        }
-
       /* Check that we are renaming like-for-like */
 
       if (old_to->to_type == TMPFS_REGULAR && new_to->to_type == TMPFS_DIRECTORY)
         {
           ret = -EISDIR;
-          goto errout_with_oldparent;
+          goto errout_with_objects;
         }
 
       if (old_to->to_type == TMPFS_DIRECTORY && new_to->to_type == TMPFS_REGULAR)
         {
           ret = -ENOTDIR;
-          goto errout_with_oldparent;
+          goto errout_with_objects;
         }
 
-      /* Now delete the destination directory entry */
+      /* Now delete the destination directory entry.  The replaced object is
+       * a child of the new parent, so it is locked after it.
+       */
 
+      tmpfs_lock_object(new_to);
       ret = tmpfs_remove_dirent(newparent_tdo, new_to);
       if (ret < 0)
         {
-          goto errout_with_oldparent;
+          tmpfs_unlock_object(new_to);
+          goto errout_with_objects;
         }
 
       if (new_to->to_type == TMPFS_DIRECTORY)
         {
-          (void)sem_destroy(&new_to->to_exclsem.ts_sem);
-          kmm_free(new_to);
+          tmpfs_free_directory((struct tmpfs_directory_s *)new_to);
         }
       else
         {
@@ -2351,15 +4390,14 @@ int tmpfs_rename(struct Vnode *oldVnode, struct Vnode *newParent, const char *ol
               /* Make the file object as unlinked */
 
               tfo->tfo_flags |= TFO_FLAG_UNLINKED;
+              tmpfs_unlock_object(new_to);
             }
 
           /* Otherwise we can free the object now */
 
           else
             {
-              (void)sem_destroy(&tfo->tfo_exclsem.ts_sem);
-              kmm_free(tfo->tfo_data);
-              kmm_free(tfo);
+              tmpfs_free_file(tfo);
             }
         }
     }
@@ -2369,7 +4407,7 @@ int tmpfs_rename(struct Vnode *oldVnode, struct Vnode *newParent, const char *ol
   ret = tmpfs_remove_dirent(oldparent, old_to);
   if (ret < 0)
     {
-      goto errout_with_oldparent;
+      goto errout_with_objects;
     }
 
   /* Add an entry to the new parent directory. */
@@ -2377,35 +4415,19 @@ int tmpfs_rename(struct Vnode *oldVnode, struct Vnode *newParent, const char *ol
   ret = tmpfs_add_dirent(&newparent_tdo, old_to, copy);
   oldVnode->parent = newParent;
 
-errout_with_oldparent:
-  if (oldparent == NULL)
-    {
-      tmpfs_unlock(fs);
-      kmm_free(copy);
-      return ret;
-    }
-  if (oldparent->tdo_refs > 0)
+errout_with_objects:
+  tmpfs_unlock_object(old_to);
+  if (second != NULL)
     {
-      oldparent->tdo_refs--;
+      tmpfs_unlock_directory(second);
     }
-  tmpfs_unlock_directory(oldparent);
-  tmpfs_release_lockedobject(old_to);
 
-errout_with_newparent:
-  if (newparent_tdo == NULL)
+  tmpfs_unlock_directory(first);
+  if (second != NULL)
     {
       tmpfs_unlock(fs);
-      kmm_free(copy);
-      return ret;
-    }
-  if (newparent_tdo->tdo_refs > 0)
-    {
-      newparent_tdo->tdo_refs--;
     }
-  tmpfs_unlock_directory(newparent_tdo);
 
-errout_with_lock:
-  tmpfs_unlock(fs);
   kmm_free(copy);
   return ret;
 }
@@ -2457,6 +4479,17 @@ static void tmpfs_stat_common(struct tmpfs_object_s *to,
   buf->st_size    = objsize;
   buf->st_blksize = 0;
   buf->st_blocks  = 0;
+
+  /* Report the memory behind a file, so that sparse files can be told
+   * apart from dense ones.
+   */
+
+  if (to->to_type == TMPFS_REGULAR)
+    {
+      buf->st_blksize = TMPFS_PAGE_SIZE;
+      buf->st_blocks  = ((struct tmpfs_file_s *)to)->tfo_nalloc *
+                        (TMPFS_PAGE_SIZE / 512);
+    }
   buf->st_atime   = to->to_atime;
   buf->st_mtime   = to->to_mtime;
   buf->st_ctime   = to->to_ctime;
@@ -2484,14 +4517,8 @@ int tmpfs_stat(struct Vnode *vp, struct stat *st)
   fs = vp->originMount->data;
   DEBUGASSERT(fs != NULL && fs->tfs_root.tde_object != NULL);
 
-  /* Get exclusive access to the file system */
-
-  tmpfs_lock(fs);
+  /* Only the object itself is locked */
 
-  /* Find the tmpfs object at the relpath.  If successful,
-   * tmpfs_find_object() will lock the object and increment the
-   * reference count on the object.
-   */
   if (vp->data != NULL)
     {
       to = (struct tmpfs_object_s *)vp->data;
@@ -2500,27 +4527,25 @@ int tmpfs_stat(struct Vnode *vp, struct stat *st)
     {
       to = fs->tfs_root.tde_object;
     }
+
+  if (to == NULL)
+    {
+      return -ENOENT;
+    }
+
   tmpfs_lock_object(to);
   to->to_refs++;
 
   /* We found it... Return information about the file object in the stat
    * buffer.
    */
-  if(to == NULL)
-    {
-      ret = -ENOENT;
-      goto errout_with_fslock;
-    }
-  DEBUGASSERT(to != NULL);
+
   tmpfs_stat_common(to, st);
 
   /* Unlock the object and return success */
 
   tmpfs_release_lockedobject(to);
   ret = OK;
-
-errout_with_fslock:
-  tmpfs_unlock(fs);
   return ret;
 }
 
@@ -27,7 +27,10 @@
  * Included Files
  ****************************************************************************/
 
+#include <dirent.h>
 #include <semaphore.h>
+#include <sys/stat.h>
+#include <linux/spinlock.h>
 
 #ifdef __cplusplus
 #if __cplusplus
@@ -48,6 +51,73 @@ extern "C" {
 
 #define TFO_FLAG_UNLINKED (1 << 0)  /* Bit 0: File is unlinked */
 
+/* File data is held in page-sized chunks that are allocated on demand */
+
+#define TMPFS_PAGE_SIZE   PAGE_SIZE
+#define TMPFS_PAGE_SHIFT  PAGE_SHIFT
+#define TMPFS_PAGE_MASK   (TMPFS_PAGE_SIZE - 1)
+
+/* Upper bound of the growth reserve of a file, whichever way it is set */
+
+#ifndef CONFIG_FS_TMPFS_MAX_GROWTH
+#  define CONFIG_FS_TMPFS_MAX_GROWTH (1024 * 1024)
+#endif
+
+/* Names up to this length (including the terminator) are kept inside the
+ * directory entry itself.
+ */
+
+#ifndef CONFIG_FS_TMPFS_INLINE_NAME
+#  define CONFIG_FS_TMPFS_INLINE_NAME 32
+#endif
+
+/* tmpfs ioctl commands */
+
+#define _TMPFSIOCBASE         (0x2d00)
+#define _TMPFSIOC(nr)         ((_TMPFSIOCBASE) | (nr))
+
+#define TMPFSIOC_GETGROWTH    _TMPFSIOC(0x0001)  /* Get the growth reserve of
+                                                  * a file in bytes.
+                                                  * Argument: size_t * */
+#define TMPFSIOC_SETGROWTH    _TMPFSIOC(0x0002)  /* Set the growth reserve of
+                                                  * a file in bytes, at most
+                                                  * CONFIG_FS_TMPFS_MAX_GROWTH.
+                                                  * Argument: size_t */
+#define TMPFSIOC_READDIRPLUS  _TMPFSIOC(0x0003)  /* Read directory entries
+                                                  * with their attributes.
+                                                  * Argument: struct
+                                                  * tmpfs_readdirplus_s * */
+#define TMPFSIOC_EXPORT       _TMPFSIOC(0x0004)  /* Write an image of the
+                                                  * whole mount to a block
+                                                  * device.  Needs
+                                                  * CAP_FS_FORMAT and write
+                                                  * access to the device.
+                                                  * Argument: const char *,
+                                                  * the device path */
+
+/* Images written by tmpfs_export() and read back with restore= */
+
+#define TMPFS_IMAGE_MAGIC     0x46504d54         /* "TMPF" */
+#define TMPFS_IMAGE_VERSION   1
+
+/* Record types of an image */
+
+#define TMPFS_IMAGE_DIRECTORY 1  /* Directory; its entries follow */
+#define TMPFS_IMAGE_REGULAR   2  /* Regular file; its extents follow */
+#define TMPFS_IMAGE_END       3  /* End of the current directory */
+
+/* Directory nesting written to and accepted from an image.  Deeper trees
+ * cannot be reached through a path of PATH_MAX bytes anyway.
+ */
+
+#define TMPFS_IMAGE_MAXDEPTH  (PATH_MAX / 2)
+
+/* Number of freed objects of each kind kept for reuse */
+
+#ifndef CONFIG_FS_TMPFS_POOL_MAX
+#  define CONFIG_FS_TMPFS_POOL_MAX 64
+#endif
+
 /****************************************************************************
  * Public Types
  ****************************************************************************/
@@ -83,10 +153,13 @@ struct tmpfs_sem_s
 
 struct tmpfs_dirent_s
 {
-  LOS_DL_LIST tde_node;
+  LOS_DL_LIST tde_node;              /* Entry in insertion (readdir) order */
+  struct tmpfs_dirent_s *tde_hnext;  /* Next entry in the same hash bucket */
   struct tmpfs_object_s *tde_object;
   char *tde_name;
+  uint32_t tde_hash;                 /* Hash of tde_name */
   bool tde_inuse;
+  char tde_iname[CONFIG_FS_TMPFS_INLINE_NAME]; /* Storage for short names */
 };
 
 /* The generic form of a TMPFS memory object */
@@ -131,6 +204,8 @@ struct tmpfs_directory_s
   uint8_t  tdo_count;    /* Number of times the directory was opened */
   uint16_t tdo_nentries; /* Number of directory entries */
   LOS_DL_LIST tdo_entry;
+  struct tmpfs_dirent_s **tdo_hash; /* Name index, NULL while small */
+  uint32_t tdo_nbuckets; /* Number of buckets in tdo_hash */
 };
 
 #define SIZEOF_TMPFS_DIRECTORY(n) \
@@ -164,12 +239,132 @@ struct tmpfs_file_s
   /* Remaining fields are unique to a directory object */
 
   uint8_t  tfo_flags;    /* See TFO_FLAG_* definitions */
-  size_t   tfo_size;     /* Valid file size */
-  char     *tfo_data;    /* File data pointer */
+  size_t   tfo_size;     /* Logical file size */
+  char     **tfo_pages;  /* Page table, NULL entries are holes */
+  size_t   tfo_npages;   /* Number of entries in tfo_pages */
+  size_t   tfo_nalloc;   /* Number of pages actually allocated, which may
+                          * extend past tfo_size */
+  size_t   tfo_growth;   /* Bytes to reserve past the end of file when a
+                          * write extends it */
 };
 
 #define SIZEOF_TMPFS_FILE(n) (sizeof(struct tmpfs_file_s) + (n) - 1)
 
+/* Object caches.  Freed objects are kept on a free list and handed out
+ * again before the heap is asked for more.
+ */
+
+enum tmpfs_pool_e
+{
+  TMPFS_POOL_FILE = 0,   /* struct tmpfs_file_s */
+  TMPFS_POOL_DIRECTORY,  /* struct tmpfs_directory_s */
+  TMPFS_POOL_DIRENT,     /* struct tmpfs_dirent_s */
+  TMPFS_NPOOLS
+};
+
+/* Usage counters of one object cache, as returned by tmpfs_get_poolinfo() */
+
+struct tmpfs_poolinfo_s
+{
+  size_t tpi_objsize;    /* Size of one object */
+  size_t tpi_inuse;      /* Objects currently handed out */
+  size_t tpi_peak;       /* Highest value of tpi_inuse */
+  size_t tpi_free;       /* Objects cached on the free list */
+  size_t tpi_hits;       /* Allocations served from the free list */
+  size_t tpi_misses;     /* Allocations that went to the heap */
+};
+
+struct tmpfs_poolobj_s
+{
+  struct tmpfs_poolobj_s *tpo_next;
+};
+
+struct tmpfs_pool_s
+{
+  struct tmpfs_poolobj_s *tp_free;  /* Free list */
+  struct tmpfs_poolinfo_s tp_info;
+};
+
+/* One entry returned by TMPFSIOC_READDIRPLUS */
+
+struct tmpfs_direntplus_s
+{
+  struct dirent tdp_dirent;  /* Name, type and d_off of the entry */
+  struct stat   tdp_stat;    /* What stat() would return for it */
+};
+
+/* Argument of TMPFSIOC_READDIRPLUS.  trp_offset counts the entries already
+ * returned; start at zero and pass the updated request back in to
+ * continue.  A call that returns no entries marks the end of the
+ * directory.
+ */
+
+struct tmpfs_readdirplus_s
+{
+  off_t  trp_offset;         /* In: entries to skip.  Out: next offset */
+  size_t trp_nentries;       /* In: room in trp_entries.  Out: returned */
+  struct tmpfs_direntplus_s *trp_entries;
+};
+
+/* Layout of a tmpfs image.  The header at offset zero is written last,
+ * once all records are on the device, so that an interrupted export leaves
+ * no valid image behind.  The records describe the tree depth first: the
+ * entries of the root, each directory record followed by the records of
+ * its entries and a closing TMPFS_IMAGE_END record.  A final
+ * TMPFS_IMAGE_END closes the root.
+ *
+ * Each record is followed by tir_namelen bytes of name (no terminator).
+ * A regular file record is then followed by tir_nextents extents, each
+ * one a struct tmpfs_imgext_s and the data of its pages.  The data of
+ * the last page of the file stops at tir_size.  Holes are not stored.
+ *
+ * All fields are in the byte order of the machine that wrote the image.
+ */
+
+struct tmpfs_imghdr_s
+{
+  uint32_t tih_magic;      /* TMPFS_IMAGE_MAGIC */
+  uint16_t tih_version;    /* TMPFS_IMAGE_VERSION */
+  uint16_t tih_pageshift;  /* TMPFS_PAGE_SHIFT of the writer */
+  uint32_t tih_nnodes;     /* Number of file and directory records */
+  uint32_t tih_checksum;   /* FNV-1a of all bytes after the header */
+  uint64_t tih_length;     /* Number of bytes after the header */
+};
+
+struct tmpfs_imgrec_s
+{
+  uint8_t  tir_type;       /* TMPFS_IMAGE_* */
+  uint8_t  tir_reserved;
+  uint16_t tir_namelen;    /* Length of the name that follows */
+  uint32_t tir_mode;
+  uint32_t tir_uid;
+  uint32_t tir_gid;
+  int64_t  tir_atime;
+  int64_t  tir_mtime;
+  int64_t  tir_ctime;
+  uint64_t tir_size;       /* Regular file: logical size */
+  uint32_t tir_nextents;   /* Regular file: number of extents */
+  uint32_t tir_reserved2;
+};
+
+struct tmpfs_imgext_s
+{
+  uint32_t tie_first;      /* Index of the first page */
+  uint32_t tie_npages;     /* Number of consecutive pages */
+};
+
+/* State of an export or import in progress */
+
+struct tmpfs_image_s
+{
+  void     *ti_bch;        /* bchlib handle of the device */
+  loff_t    ti_offset;     /* Device offset of the next transfer */
+  loff_t    ti_end;        /* Import: end of the records */
+  uint32_t  ti_checksum;   /* Running checksum of the records */
+  uint32_t  ti_nnodes;     /* Records counted so far */
+  char      ti_name[NAME_MAX + 1]; /* Name of the current record */
+};
+
 /* This structure represents one instance of a TMPFS file system */
 
 struct tmpfs_s
@@ -177,6 +372,18 @@ struct tmpfs_s
   /* The root directory */
   struct tmpfs_dirent_s tfs_root;
   struct tmpfs_sem_s tfs_exclsem;
+
+  /* Capacity accounting */
+
+  spinlock_t tfs_statlock;  /* Protects the counters and pools below */
+  size_t   tfs_npages;      /* Data pages in use */
+  size_t   tfs_maxpages;    /* Limit from size=, 0 if unlimited */
+  size_t   tfs_nnodes;      /* Files and directories in use */
+  size_t   tfs_maxnodes;    /* Limit from nr_inodes=, 0 if unlimited */
+  size_t   tfs_growth;      /* tfo_growth of new files, from growth=.
+                             * Protected by g_tmpfs_growthlock */
+
+  struct tmpfs_pool_s tfs_pools[TMPFS_NPOOLS];
 };
 
 /* This is the type used the tmpfs_statfs_callout to accumulate memory usage */
@@ -198,8 +405,22 @@ typedef int (*tmpfs_foreach_t)(struct tmpfs_directory_s *tdo,
  * Public Data
  ****************************************************************************/
 
+/* Set the growth reserve given to files created from now on */
+
 extern void los_set_ramfs_unit(off_t size);
 
+/* Return the usage counters of the object caches, indexed by
+ * enum tmpfs_pool_e.
+ */
+
+extern void tmpfs_get_poolinfo(struct tmpfs_poolinfo_s info[TMPFS_NPOOLS]);
+
+/* Write an image of the mounted tmpfs to the block device 'blkdev', to be
+ * loaded again by mounting with restore=<blkdev>.
+ */
+
+extern int tmpfs_export(const char *blkdev);
+
 #endif
 
 #ifdef __cplusplus
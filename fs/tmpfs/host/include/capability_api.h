@@ -0,0 +1,40 @@
+/****************************************************************************
+ * fs/tmpfs/host/include/capability_api.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/* Host build: capabilities.  The tests hold all of them. */
+
+#ifndef __FS_TMPFS_HOST_INCLUDE_CAPABILITY_API_H
+#define __FS_TMPFS_HOST_INCLUDE_CAPABILITY_API_H
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define CAP_FS_FORMAT   13
+
+/****************************************************************************
+ * Public Function Prototypes
+ ****************************************************************************/
+
+BOOL IsCapPermit(UINT32 capIndex);
+
+#endif /* __FS_TMPFS_HOST_INCLUDE_CAPABILITY_API_H */
@@ -0,0 +1,68 @@
+/****************************************************************************
+ * fs/tmpfs/host/include/fs/dirent_fs.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/* Host build: open directories. */
+
+#ifndef __FS_TMPFS_HOST_INCLUDE_FS_DIRENT_FS_H
+#define __FS_TMPFS_HOST_INCLUDE_FS_DIRENT_FS_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <dirent.h>
+#include <sys/types.h>
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define MAX_DIRENT_NUM 14
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+struct tmpfs_directory_s;
+struct tmpfs_dirent_s;
+
+typedef void *fs_dir_s;
+
+struct fs_tmpfsdir_s
+{
+  struct tmpfs_directory_s *tf_tdo;   /* Directory being enumerated */
+  unsigned int tf_index;              /* Entry index to return next */
+  struct tmpfs_dirent_s *tf_last;     /* Entry returned last */
+};
+
+struct fs_dirent_s
+{
+  union
+  {
+    fs_dir_s fs_dir;
+  } u;
+  off_t fd_position;
+  int read_cnt;
+  struct dirent fd_dir[MAX_DIRENT_NUM];
+};
+
+#endif /* __FS_TMPFS_HOST_INCLUDE_FS_DIRENT_FS_H */
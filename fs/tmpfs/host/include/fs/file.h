@@ -0,0 +1,65 @@
+/****************************************************************************
+ * fs/tmpfs/host/include/fs/file.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/* Host build: open files and their operations. */
+
+#ifndef __FS_TMPFS_HOST_INCLUDE_FS_FILE_H
+#define __FS_TMPFS_HOST_INCLUDE_FS_FILE_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "vfs_config.h"
+#include "los_vm_map.h"
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+struct Vnode;
+
+struct file
+{
+  int f_oflags;
+  loff_t f_pos;
+  struct Vnode *f_vnode;
+};
+
+struct file_operations_vfs
+{
+  off_t   (*seek)(struct file *filep, off_t offset, int whence);
+  ssize_t (*write)(struct file *filep, const char *buffer, size_t buflen);
+  ssize_t (*read)(struct file *filep, char *buffer, size_t buflen);
+  int     (*ioctl)(struct file *filep, int cmd, unsigned long arg);
+  int     (*mmap)(struct file *filep, LosVmMapRegion *region);
+  int     (*close)(struct file *filep);
+  int     (*fallocate)(struct file *filep, int mode, off_t offset,
+                       off_t len);
+  int     (*fallocate64)(struct file *filep, int mode, off64_t offset,
+                         off64_t len);
+  int     (*fsync)(struct file *filep);
+};
+
+#endif /* __FS_TMPFS_HOST_INCLUDE_FS_FILE_H */
@@ -0,0 +1,120 @@
+/****************************************************************************
+ * fs/tmpfs/host/include/fs/fs.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/* Host build: vnodes and the vnode hash. */
+
+#ifndef __FS_TMPFS_HOST_INCLUDE_FS_FS_H
+#define __FS_TMPFS_HOST_INCLUDE_FS_FS_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "fs/file.h"
+#include "fs/mount.h"
+#include "fs/dirent_fs.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define WRITE_OP        2
+
+#define TMPFS_MAGIC     0x01021994
+
+#define __st_atim32     st_atim
+#define __st_mtim32     st_mtim
+#define __st_ctim32     st_ctim
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+enum VnodeType
+{
+  VNODE_TYPE_UNKNOWN,
+  VNODE_TYPE_REG,
+  VNODE_TYPE_DIR,
+  VNODE_TYPE_BLK,
+  VNODE_TYPE_CHR,
+};
+
+struct Vnode
+{
+  enum VnodeType type;
+  uid_t uid;
+  gid_t gid;
+  mode_t mode;
+  void *data;
+  struct VnodeOps *vop;
+  struct file_operations_vfs *fop;
+  struct Vnode *parent;
+  struct Mount *originMount;
+  uint32_t hash;                  /* Key in the vnode hash */
+  struct Vnode *hashNext;         /* Next vnode in the hash */
+};
+
+struct VnodeOps
+{
+  int (*Lookup)(struct Vnode *parent, const char *name, int len,
+                struct Vnode **vpp);
+  int (*Getattr)(struct Vnode *vnode, struct stat *st);
+  int (*Opendir)(struct Vnode *vnode, struct fs_dirent_s *dir);
+  int (*Readdir)(struct Vnode *vnode, struct fs_dirent_s *dir);
+  ssize_t (*ReadPage)(struct Vnode *vnode, char *buffer, off_t pos);
+  ssize_t (*WritePage)(struct Vnode *vnode, char *buffer, off_t pos,
+                       size_t buflen);
+  int (*Rename)(struct Vnode *src, struct Vnode *dstParent,
+                const char *srcName, const char *dstName);
+  int (*Mkdir)(struct Vnode *parent, const char *dirName, mode_t mode,
+               struct Vnode **vpp);
+  int (*Create)(struct Vnode *parent, const char *name, int mode,
+                struct Vnode **vpp);
+  int (*Unlink)(struct Vnode *parent, struct Vnode *vnode,
+                const char *fileName);
+  int (*Rmdir)(struct Vnode *parent, struct Vnode *vnode,
+               const char *dirName);
+  int (*Reclaim)(struct Vnode *vnode);
+  int (*Closedir)(struct Vnode *vnode, struct fs_dirent_s *dir);
+  int (*Close)(struct Vnode *vnode);
+  int (*Rewinddir)(struct Vnode *vnode, struct fs_dirent_s *dir);
+  int (*Truncate)(struct Vnode *vnode, off_t len);
+};
+
+/****************************************************************************
+ * Public Function Prototypes
+ ****************************************************************************/
+
+int VnodeAlloc(struct VnodeOps *vop, struct Vnode **vpp);
+int VnodeFree(struct Vnode *vnode);
+int VnodeHold(void);
+int VnodeDrop(void);
+int VnodeLookup(const char *path, struct Vnode **vpp, uint32_t flags);
+int VfsHashGet(const struct Mount *mount, uint32_t hashKey,
+               struct Vnode **vpp, int (*fn)(struct Vnode *, void *),
+               void *arg);
+int VfsHashInsert(struct Vnode *vnode, uint32_t hashKey);
+int VfsVnodePermissionCheck(const struct Vnode *node, int accMode);
+
+#endif /* __FS_TMPFS_HOST_INCLUDE_FS_FS_H */
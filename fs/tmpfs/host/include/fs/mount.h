@@ -0,0 +1,55 @@
+/****************************************************************************
+ * fs/tmpfs/host/include/fs/mount.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/* Host build: mounts and their operations. */
+
+#ifndef __FS_TMPFS_HOST_INCLUDE_FS_MOUNT_H
+#define __FS_TMPFS_HOST_INCLUDE_FS_MOUNT_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <sys/statfs.h>
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+struct Vnode;
+
+struct Mount
+{
+  struct Vnode *vnodeBeCovered;   /* Vnode the mount is on */
+  struct Vnode *vnodeCovered;     /* Root vnode of the mount */
+  void *data;                     /* Private data of the file system */
+  unsigned long mountFlags;
+};
+
+struct MountOps
+{
+  int (*Mount)(struct Mount *mount, struct Vnode *vnode, const void *data);
+  int (*Unmount)(struct Mount *mount, struct Vnode **blkdriver);
+  int (*Statfs)(struct Mount *mount, struct statfs *sbp);
+};
+
+#endif /* __FS_TMPFS_HOST_INCLUDE_FS_MOUNT_H */
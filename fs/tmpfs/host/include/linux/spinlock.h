@@ -0,0 +1,55 @@
+/****************************************************************************
+ * fs/tmpfs/host/include/linux/spinlock.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/* Host build: spinlocks on top of mutexes. */
+
+#ifndef __FS_TMPFS_HOST_INCLUDE_LINUX_SPINLOCK_H
+#define __FS_TMPFS_HOST_INCLUDE_LINUX_SPINLOCK_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <pthread.h>
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define DEFINE_SPINLOCK(x) \
+  spinlock_t x = { PTHREAD_MUTEX_INITIALIZER }
+
+#define spin_lock_init(lock) \
+  (void)pthread_mutex_init(&(lock)->mutex, NULL)
+#define spin_lock(lock)    (void)pthread_mutex_lock(&(lock)->mutex)
+#define spin_unlock(lock)  (void)pthread_mutex_unlock(&(lock)->mutex)
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+typedef struct
+{
+  pthread_mutex_t mutex;
+} spinlock_t;
+
+#endif /* __FS_TMPFS_HOST_INCLUDE_LINUX_SPINLOCK_H */
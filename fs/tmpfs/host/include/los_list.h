@@ -0,0 +1,107 @@
+/****************************************************************************
+ * fs/tmpfs/host/include/los_list.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/* Host build: the LiteOS doubly linked list used by tmpfs. */
+
+#ifndef __FS_TMPFS_HOST_INCLUDE_LOS_LIST_H
+#define __FS_TMPFS_HOST_INCLUDE_LOS_LIST_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+typedef struct LOS_DL_LIST
+{
+  struct LOS_DL_LIST *pstPrev;
+  struct LOS_DL_LIST *pstNext;
+} LOS_DL_LIST;
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define LOS_OFF_SET_OF(type, member) ((size_t)&((type *)0)->member)
+
+#define LOS_DL_LIST_ENTRY(item, type, member) \
+  ((type *)(void *)((char *)(item) - LOS_OFF_SET_OF(type, member)))
+
+#define LOS_DL_LIST_FOR_EACH_ENTRY(item, list, type, member) \
+  for (item = LOS_DL_LIST_ENTRY((list)->pstNext, type, member); \
+       &(item)->member != (list); \
+       item = LOS_DL_LIST_ENTRY((item)->member.pstNext, type, member))
+
+#define LOS_DL_LIST_FOR_EACH_ENTRY_SAFE(item, next, list, type, member) \
+  for (item = LOS_DL_LIST_ENTRY((list)->pstNext, type, member), \
+       next = LOS_DL_LIST_ENTRY((item)->member.pstNext, type, member); \
+       &(item)->member != (list); \
+       item = next, \
+       next = LOS_DL_LIST_ENTRY((item)->member.pstNext, type, member))
+
+/****************************************************************************
+ * Inline Functions
+ ****************************************************************************/
+
+static inline void LOS_ListInit(LOS_DL_LIST *list)
+{
+  list->pstNext = list;
+  list->pstPrev = list;
+}
+
+static inline void LOS_ListAdd(LOS_DL_LIST *list, LOS_DL_LIST *node)
+{
+  node->pstNext = list->pstNext;
+  node->pstPrev = list;
+  list->pstNext->pstPrev = node;
+  list->pstNext = node;
+}
+
+static inline void LOS_ListTailInsert(LOS_DL_LIST *list, LOS_DL_LIST *node)
+{
+  LOS_ListAdd(list->pstPrev, node);
+}
+
+static inline void LOS_ListHeadInsert(LOS_DL_LIST *list, LOS_DL_LIST *node)
+{
+  LOS_ListAdd(list, node);
+}
+
+static inline void LOS_ListDelete(LOS_DL_LIST *node)
+{
+  node->pstNext->pstPrev = node->pstPrev;
+  node->pstPrev->pstNext = node->pstNext;
+  node->pstNext = NULL;
+  node->pstPrev = NULL;
+}
+
+static inline bool LOS_ListEmpty(LOS_DL_LIST *list)
+{
+  return list->pstNext == list;
+}
+
+#endif /* __FS_TMPFS_HOST_INCLUDE_LOS_LIST_H */
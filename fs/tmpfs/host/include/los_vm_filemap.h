@@ -0,0 +1,41 @@
+/****************************************************************************
+ * fs/tmpfs/host/include/los_vm_filemap.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/* Host build: file mappings. */
+
+#ifndef __FS_TMPFS_HOST_INCLUDE_LOS_VM_FILEMAP_H
+#define __FS_TMPFS_HOST_INCLUDE_LOS_VM_FILEMAP_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include "los_vm_map.h"
+
+/****************************************************************************
+ * Public Function Prototypes
+ ****************************************************************************/
+
+struct file;
+int OsVfsFileMmap(struct file *filep, LosVmMapRegion *region);
+
+#endif /* __FS_TMPFS_HOST_INCLUDE_LOS_VM_FILEMAP_H */
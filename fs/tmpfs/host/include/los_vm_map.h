@@ -0,0 +1,104 @@
+/****************************************************************************
+ * fs/tmpfs/host/include/los_vm_map.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/* Host build: the parts of the address space model used by tmpfs. */
+
+#ifndef __FS_TMPFS_HOST_INCLUDE_LOS_VM_MAP_H
+#define __FS_TMPFS_HOST_INCLUDE_LOS_VM_MAP_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stddef.h>
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define LOS_ERRNO_VM_INVALID_ARGS    EINVAL
+#define LOS_ERRNO_VM_NO_MEMORY       ENOMEM
+
+#define VM_MAP_REGION_FLAG_SHARED    (1U << 4)
+#define VM_MAP_PF_FLAG_WRITE         (1U << 0)
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+struct Vnode;
+struct VmMapRegion;
+struct VmPgFault;
+
+typedef unsigned long VM_OFFSET_T;
+
+typedef struct
+{
+  int unused;
+} LosArchMmu;
+
+struct VmFileOps
+{
+  void (*open)(struct VmMapRegion *region, struct VmFileOps *fops);
+  void (*close)(struct VmMapRegion *region, struct VmFileOps *fops);
+  int  (*fault)(struct VmMapRegion *region, struct VmPgFault *pageFault);
+  void (*remove)(struct VmMapRegion *region, LosArchMmu *archMmu,
+                 VM_OFFSET_T offset);
+};
+
+typedef struct VmMapRegion
+{
+  struct
+  {
+    VADDR_T base;
+    UINT32 size;
+  } range;
+  UINT32 regionFlags;
+  VM_OFFSET_T pgOff;
+  union
+  {
+    struct
+    {
+      int f_oflags;
+      struct Vnode *vnode;
+      struct VmFileOps *vmFOps;
+    } rf;
+  } unTypeData;
+} LosVmMapRegion;
+
+typedef struct VmPgFault
+{
+  UINT32 flags;
+  VM_OFFSET_T pgoff;
+  VADDR_T *vaddr;
+  VADDR_T *pageKVaddr;
+} LosVmPgFault;
+
+/****************************************************************************
+ * Public Function Prototypes
+ ****************************************************************************/
+
+int LOS_ArchMmuQuery(const LosArchMmu *archMmu, VADDR_T vaddr,
+                     PADDR_T *paddr, UINT32 *flags);
+int LOS_ArchMmuUnmap(LosArchMmu *archMmu, VADDR_T vaddr, size_t count);
+
+#endif /* __FS_TMPFS_HOST_INCLUDE_LOS_VM_MAP_H */
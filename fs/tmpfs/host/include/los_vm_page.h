@@ -0,0 +1,45 @@
+/****************************************************************************
+ * fs/tmpfs/host/include/los_vm_page.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/* Host build: physical page descriptors. */
+
+#ifndef __FS_TMPFS_HOST_INCLUDE_LOS_VM_PAGE_H
+#define __FS_TMPFS_HOST_INCLUDE_LOS_VM_PAGE_H
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+typedef struct VmPage
+{
+  Atomic refCounts;
+} LosVmPage;
+
+/****************************************************************************
+ * Public Function Prototypes
+ ****************************************************************************/
+
+LosVmPage *LOS_VmPageGet(PADDR_T paddr);
+void *OsVmPageToVaddr(LosVmPage *page);
+LosVmPage *OsVmVaddrToPage(void *ptr);
+
+#endif /* __FS_TMPFS_HOST_INCLUDE_LOS_VM_PAGE_H */
@@ -0,0 +1,88 @@
+/****************************************************************************
+ * fs/tmpfs/host/include/tmpfs_host.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/* Host build: the definitions that the kernel build environment provides
+ * to every tmpfs source.  Included ahead of each source by the Makefile. */
+
+#ifndef __FS_TMPFS_HOST_INCLUDE_TMPFS_HOST_H
+#define __FS_TMPFS_HOST_INCLUDE_TMPFS_HOST_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "los_list.h"
+#include "securec.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define OK              0
+#define ENOERR          0
+#define LOS_OK          0
+#define FAR
+#define FALSE           0
+#define TRUE            1
+#define VOID            void
+#define get_errno()     errno
+#define PRINT_ERR       printf
+#define PRINT_INFO(...)
+#define PRINT_DEBUG(...)
+
+#define kmm_malloc(size) malloc(size)
+#define kmm_free(ptr)    free(ptr)
+
+#define PAGE_SHIFT      12
+#define PAGE_SIZE       (1UL << PAGE_SHIFT)
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+typedef int             BOOL;
+typedef uint32_t        UINT32;
+typedef unsigned long   UINTPTR;
+typedef unsigned long   VADDR_T;
+typedef unsigned long   PADDR_T;
+
+typedef struct
+{
+  volatile int counter;
+} Atomic;
+
+/****************************************************************************
+ * Inline Functions
+ ****************************************************************************/
+
+static inline void LOS_AtomicSet(Atomic *v, int setVal)
+{
+  __atomic_store_n(&v->counter, setVal, __ATOMIC_SEQ_CST);
+}
+
+#endif /* __FS_TMPFS_HOST_INCLUDE_TMPFS_HOST_H */
@@ -0,0 +1,516 @@
+/****************************************************************************
+ * fs/tmpfs/host/tmpfs_os.c
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/* Host implementations of the kernel services used by tmpfs.  Pages come
+ * from the C heap and every block device is one in-memory image.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "securec.h"
+#include "user_copy.h"
+#include "capability_api.h"
+#include "los_task.h"
+#include "los_vm_phys.h"
+#include "los_vm_filemap.h"
+#include "fs/fs.h"
+#include "fs/driver.h"
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct host_page_s
+{
+  LosVmPage hp_page;
+  char hp_data[PAGE_SIZE];
+};
+
+struct host_blkdev_s
+{
+  char *hb_data;                  /* Contents of the device */
+  size_t hb_size;                 /* Bytes written so far */
+  bool hb_readonly;
+};
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static pthread_mutex_t g_vnodelock = PTHREAD_MUTEX_INITIALIZER;
+static struct Vnode *g_vnodehash;
+static struct Vnode g_blkvnode =
+{
+  .type = VNODE_TYPE_BLK,
+  .mode = S_IFBLK | 0600,
+};
+
+static struct host_blkdev_s g_blkdev;
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: memset_s
+ ****************************************************************************/
+
+int memset_s(void *dest, size_t destMax, int c, size_t count)
+{
+  if (dest == NULL || count > destMax)
+    {
+      return -1;
+    }
+
+  (void)memset(dest, c, count);
+  return EOK;
+}
+
+/****************************************************************************
+ * Name: memcpy_s
+ ****************************************************************************/
+
+int memcpy_s(void *dest, size_t destMax, const void *src, size_t count)
+{
+  if (dest == NULL || src == NULL || count > destMax)
+    {
+      return -1;
+    }
+
+  (void)memmove(dest, src, count);
+  return EOK;
+}
+
+/****************************************************************************
+ * Name: strncpy_s
+ ****************************************************************************/
+
+int strncpy_s(char *dest, size_t destMax, const char *src, size_t count)
+{
+  size_t len;
+
+  if (dest == NULL || src == NULL || destMax == 0)
+    {
+      return -1;
+    }
+
+  len = strnlen(src, count);
+  if (len >= destMax)
+    {
+      dest[0] = '\0';
+      return -1;
+    }
+
+  (void)memcpy(dest, src, len);
+  dest[len] = '\0';
+  return EOK;
+}
+
+/****************************************************************************
+ * Name: LOS_CopyFromKernel
+ *
+ * Description:
+ *   The tests run in a single address space
+ *
+ ****************************************************************************/
+
+int LOS_CopyFromKernel(void *dest, size_t max, const void *src, size_t count)
+{
+  return memcpy_s(dest, max, src, count);
+}
+
+/****************************************************************************
+ * Name: LOS_CopyToKernel
+ ****************************************************************************/
+
+int LOS_CopyToKernel(void *dest, size_t max, const void *src, size_t count)
+{
+  return memcpy_s(dest, max, src, count);
+}
+
+/****************************************************************************
+ * Name: LOS_StrncpyFromUser
+ *
+ * Description:
+ *   Returns the length of the string, or 'count' if it does not fit
+ *
+ ****************************************************************************/
+
+int LOS_StrncpyFromUser(char *dst, const char *src, int count)
+{
+  size_t len = strnlen(src, (size_t)count);
+
+  (void)memcpy(dst, src, (len < (size_t)count) ? len + 1 : len);
+  return (int)len;
+}
+
+/****************************************************************************
+ * Name: LOS_UserMemClear
+ ****************************************************************************/
+
+int LOS_UserMemClear(unsigned char *buf, size_t len)
+{
+  (void)memset(buf, 0, len);
+  return 0;
+}
+
+/****************************************************************************
+ * Name: IsCapPermit
+ ****************************************************************************/
+
+BOOL IsCapPermit(UINT32 capIndex)
+{
+  (void)capIndex;
+  return TRUE;
+}
+
+/****************************************************************************
+ * Name: LOS_CurTaskIDGet
+ ****************************************************************************/
+
+UINT32 LOS_CurTaskIDGet(void)
+{
+  return (UINT32)gettid();
+}
+
+/****************************************************************************
+ * Name: LOS_PhysPageAlloc
+ ****************************************************************************/
+
+LosVmPage *LOS_PhysPageAlloc(void)
+{
+  struct host_page_s *hp;
+
+  hp = (struct host_page_s *)calloc(1, sizeof(struct host_page_s));
+  return (hp != NULL) ? &hp->hp_page : NULL;
+}
+
+/****************************************************************************
+ * Name: LOS_PhysPageFree
+ ****************************************************************************/
+
+void LOS_PhysPageFree(LosVmPage *page)
+{
+  free(LOS_DL_LIST_ENTRY(page, struct host_page_s, hp_page));
+}
+
+/****************************************************************************
+ * Name: OsVmPageToVaddr
+ ****************************************************************************/
+
+void *OsVmPageToVaddr(LosVmPage *page)
+{
+  return LOS_DL_LIST_ENTRY(page, struct host_page_s, hp_page)->hp_data;
+}
+
+/****************************************************************************
+ * Name: OsVmVaddrToPage
+ ****************************************************************************/
+
+LosVmPage *OsVmVaddrToPage(void *ptr)
+{
+  return &LOS_DL_LIST_ENTRY(ptr, struct host_page_s, hp_data)->hp_page;
+}
+
+/****************************************************************************
+ * Name: LOS_VmPageGet
+ ****************************************************************************/
+
+LosVmPage *LOS_VmPageGet(PADDR_T paddr)
+{
+  (void)paddr;
+  return NULL;
+}
+
+/****************************************************************************
+ * Name: LOS_ArchMmuQuery
+ *
+ * Description:
+ *   Nothing is ever mapped on the host
+ *
+ ****************************************************************************/
+
+int LOS_ArchMmuQuery(const LosArchMmu *archMmu, VADDR_T vaddr,
+                     PADDR_T *paddr, UINT32 *flags)
+{
+  (void)archMmu;
+  (void)vaddr;
+  (void)paddr;
+  (void)flags;
+  return -ENOENT;
+}
+
+/****************************************************************************
+ * Name: LOS_ArchMmuUnmap
+ ****************************************************************************/
+
+int LOS_ArchMmuUnmap(LosArchMmu *archMmu, VADDR_T vaddr, size_t count)
+{
+  (void)archMmu;
+  (void)vaddr;
+  (void)count;
+  return 0;
+}
+
+/****************************************************************************
+ * Name: OsVfsFileMmap
+ ****************************************************************************/
+
+int OsVfsFileMmap(struct file *filep, LosVmMapRegion *region)
+{
+  (void)filep;
+  (void)region;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: VnodeAlloc
+ ****************************************************************************/
+
+int VnodeAlloc(struct VnodeOps *vop, struct Vnode **vpp)
+{
+  struct Vnode *vp;
+
+  vp = (struct Vnode *)calloc(1, sizeof(struct Vnode));
+  if (vp == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  vp->vop = vop;
+  *vpp = vp;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: VnodeFree
+ *
+ * Description:
+ *   Reclaim a vnode and drop it from the hash, as the VFS does once the
+ *   object behind it is gone
+ *
+ ****************************************************************************/
+
+int VnodeFree(struct Vnode *vnode)
+{
+  struct Vnode **pp;
+
+  if (vnode->vop != NULL && vnode->vop->Reclaim != NULL)
+    {
+      (void)vnode->vop->Reclaim(vnode);
+    }
+
+  (void)pthread_mutex_lock(&g_vnodelock);
+  for (pp = &g_vnodehash; *pp != NULL; pp = &(*pp)->hashNext)
+    {
+      if (*pp == vnode)
+        {
+          *pp = vnode->hashNext;
+          break;
+        }
+    }
+
+  (void)pthread_mutex_unlock(&g_vnodelock);
+  free(vnode);
+  return OK;
+}
+
+/****************************************************************************
+ * Name: VnodeHold
+ ****************************************************************************/
+
+int VnodeHold(void)
+{
+  (void)pthread_mutex_lock(&g_vnodelock);
+  return OK;
+}
+
+/****************************************************************************
+ * Name: VnodeDrop
+ ****************************************************************************/
+
+int VnodeDrop(void)
+{
+  (void)pthread_mutex_unlock(&g_vnodelock);
+  return OK;
+}
+
+/****************************************************************************
+ * Name: VnodeLookup
+ *
+ * Description:
+ *   Every path under /dev names the in-memory block device
+ *
+ ****************************************************************************/
+
+int VnodeLookup(const char *path, struct Vnode **vpp, uint32_t flags)
+{
+  (void)flags;
+
+  if (strncmp(path, "/dev/", 5) != 0)
+    {
+      return -ENOENT;
+    }
+
+  *vpp = &g_blkvnode;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: VfsVnodePermissionCheck
+ ****************************************************************************/
+
+int VfsVnodePermissionCheck(const struct Vnode *node, int accMode)
+{
+  (void)node;
+  (void)accMode;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: VfsHashGet
+ ****************************************************************************/
+
+int VfsHashGet(const struct Mount *mount, uint32_t hashKey,
+               struct Vnode **vpp, int (*fn)(struct Vnode *, void *),
+               void *arg)
+{
+  struct Vnode *vp;
+
+  (void)fn;
+  (void)arg;
+
+  *vpp = NULL;
+  (void)pthread_mutex_lock(&g_vnodelock);
+  for (vp = g_vnodehash; vp != NULL; vp = vp->hashNext)
+    {
+      if (vp->originMount == mount && vp->hash == hashKey)
+        {
+          *vpp = vp;
+          break;
+        }
+    }
+
+  (void)pthread_mutex_unlock(&g_vnodelock);
+  return OK;
+}
+
+/****************************************************************************
+ * Name: VfsHashInsert
+ ****************************************************************************/
+
+int VfsHashInsert(struct Vnode *vnode, uint32_t hashKey)
+{
+  (void)pthread_mutex_lock(&g_vnodelock);
+  vnode->hash     = hashKey;
+  vnode->hashNext = g_vnodehash;
+  g_vnodehash     = vnode;
+  (void)pthread_mutex_unlock(&g_vnodelock);
+  return OK;
+}
+
+/****************************************************************************
+ * Name: bchlib_setup
+ ****************************************************************************/
+
+int bchlib_setup(const char *blkdev, bool readonly, void **handle)
+{
+  if (strncmp(blkdev, "/dev/", 5) != 0)
+    {
+      return -ENOENT;
+    }
+
+  g_blkdev.hb_readonly = readonly;
+  *handle = &g_blkdev;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: bchlib_teardown
+ ****************************************************************************/
+
+int bchlib_teardown(void *handle)
+{
+  (void)handle;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: bchlib_read
+ ****************************************************************************/
+
+ssize_t bchlib_read(void *handle, char *buffer, loff_t offset, size_t len)
+{
+  struct host_blkdev_s *bch = (struct host_blkdev_s *)handle;
+
+  if ((size_t)offset >= bch->hb_size)
+    {
+      return 0;
+    }
+
+  if (len > bch->hb_size - (size_t)offset)
+    {
+      len = bch->hb_size - (size_t)offset;
+    }
+
+  (void)memcpy(buffer, bch->hb_data + offset, len);
+  return (ssize_t)len;
+}
+
+/****************************************************************************
+ * Name: bchlib_write
+ ****************************************************************************/
+
+ssize_t bchlib_write(void *handle, const char *buffer, loff_t offset,
+                     size_t len)
+{
+  struct host_blkdev_s *bch = (struct host_blkdev_s *)handle;
+  char *data;
+
+  if (bch->hb_readonly)
+    {
+      return -EACCES;
+    }
+
+  if ((size_t)offset + len > bch->hb_size)
+    {
+      data = (char *)realloc(bch->hb_data, (size_t)offset + len);
+      if (data == NULL)
+        {
+          return -ENOSPC;
+        }
+
+      (void)memset(data + bch->hb_size, 0,
+                   (size_t)offset + len - bch->hb_size);
+      bch->hb_data = data;
+      bch->hb_size = (size_t)offset + len;
+    }
+
+  (void)memcpy(bch->hb_data + offset, buffer, len);
+  return (ssize_t)len;
+}
@@ -0,0 +1,297 @@
+/****************************************************************************
+ * fs/tmpfs/host/tmpfs_test.c
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.  The
+ * ASF licenses this file to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance with the
+ * License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.  See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ *
+ ****************************************************************************/
+
+/* Host test of the tmpfs image.  fs_tmpfs.c is built unchanged against
+ * the services of tmpfs_os.c.  A chain of directories one deeper than an
+ * import accepts must fail TMPFSIOC_EXPORT, and the deepest chain that
+ * can be exported must come back whole from restore=.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include "fs/fs.h"
+#include "fs_tmpfs.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define TEST_BLKDEV      "/dev/tmpfsimg"
+#define TEST_DIRNAME     "d"
+
+/****************************************************************************
+ * External Function Prototypes
+ ****************************************************************************/
+
+int tmpfs_mount(struct Mount *mnt, struct Vnode *device, const void *data);
+int tmpfs_unmount(struct Mount *mnt, struct Vnode **blkdriver);
+int tmpfs_lookup(struct Vnode *parent, const char *name, int len,
+                 struct Vnode **vpp);
+int tmpfs_mkdir(struct Vnode *parent, const char *relpath, mode_t mode,
+                struct Vnode **vpp);
+int tmpfs_rmdir(struct Vnode *parent, struct Vnode *target,
+                const char *dirname);
+int tmpfs_ioctl(struct file *filep, int cmd, unsigned long arg);
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct Vnode g_mountpt =
+{
+  .type = VNODE_TYPE_DIR,
+  .mode = S_IFDIR | 0777,
+};
+
+static struct Mount g_mount =
+{
+  .vnodeBeCovered = &g_mountpt,
+};
+
+/* g_chain[0] is the root of the mount, g_chain[i] the directory at depth
+ * i below it.
+ */
+
+static struct Vnode *g_chain[TMPFS_IMAGE_MAXDEPTH + 2];
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: test_mount
+ ****************************************************************************/
+
+static int test_mount(const char *options)
+{
+  int ret;
+
+  ret = tmpfs_mount(&g_mount, NULL, options);
+  g_chain[0] = g_mount.vnodeCovered;
+  return ret;
+}
+
+/****************************************************************************
+ * Name: test_unmount
+ ****************************************************************************/
+
+static int test_unmount(void)
+{
+  int ret;
+
+  ret = tmpfs_unmount(&g_mount, NULL);
+  if (ret == OK)
+    {
+      (void)VnodeFree(g_chain[0]);
+    }
+
+  return ret;
+}
+
+/****************************************************************************
+ * Name: test_mkchain
+ *
+ * Description:
+ *   Extend the chain of directories from depth 'from' to depth 'to'.
+ *
+ ****************************************************************************/
+
+static int test_mkchain(int from, int to)
+{
+  int ret = OK;
+  int i;
+
+  for (i = from + 1; i <= to && ret == OK; i++)
+    {
+      ret = tmpfs_mkdir(g_chain[i - 1], TEST_DIRNAME, S_IFDIR | 0777,
+                        &g_chain[i]);
+    }
+
+  return ret;
+}
+
+/****************************************************************************
+ * Name: test_rmchain
+ *
+ * Description:
+ *   Remove the directories of the chain below depth 'to', deepest first.
+ *
+ ****************************************************************************/
+
+static int test_rmchain(int from, int to)
+{
+  int ret = OK;
+  int i;
+
+  for (i = from; i > to && ret == OK; i--)
+    {
+      ret = tmpfs_rmdir(g_chain[i - 1], g_chain[i], TEST_DIRNAME);
+      if (ret == OK)
+        {
+          (void)VnodeFree(g_chain[i]);
+        }
+    }
+
+  return ret;
+}
+
+/****************************************************************************
+ * Name: test_depth
+ *
+ * Description:
+ *   Look the chain up again from the root and return its depth.
+ *
+ ****************************************************************************/
+
+static int test_depth(void)
+{
+  int depth = 0;
+
+  while (depth < TMPFS_IMAGE_MAXDEPTH + 1 &&
+         tmpfs_lookup(g_chain[depth], TEST_DIRNAME, strlen(TEST_DIRNAME),
+                      &g_chain[depth + 1]) == OK)
+    {
+      depth++;
+    }
+
+  return depth;
+}
+
+/****************************************************************************
+ * Name: test_export
+ ****************************************************************************/
+
+static int test_export(void)
+{
+  struct file file;
+
+  (void)memset(&file, 0, sizeof(file));
+  file.f_vnode = g_chain[0];
+  return tmpfs_ioctl(&file, TMPFSIOC_EXPORT, (unsigned long)TEST_BLKDEV);
+}
+
+/****************************************************************************
+ * Name: test_export_depth
+ *
+ * Description:
+ *   Export a chain one directory deeper than an import accepts, then the
+ *   deepest chain that it does accept.
+ *
+ ****************************************************************************/
+
+static int test_export_depth(void)
+{
+  int ret;
+
+  ret = test_mount(NULL);
+  if (ret != OK)
+    {
+      printf("mount: %d\n", ret);
+      return -1;
+    }
+
+  ret = test_mkchain(0, TMPFS_IMAGE_MAXDEPTH + 1);
+  if (ret != OK)
+    {
+      printf("mkdir: %d\n", ret);
+      return -1;
+    }
+
+  ret = test_export();
+  printf("export of depth %d: %d\n", TMPFS_IMAGE_MAXDEPTH + 1, ret);
+  if (ret != -EOVERFLOW)
+    {
+      return -1;
+    }
+
+  ret = test_rmchain(TMPFS_IMAGE_MAXDEPTH + 1, TMPFS_IMAGE_MAXDEPTH);
+  if (ret == OK)
+    {
+      ret = test_export();
+      printf("export of depth %d: %d\n", TMPFS_IMAGE_MAXDEPTH, ret);
+    }
+
+  if (ret != OK || test_rmchain(TMPFS_IMAGE_MAXDEPTH, 0) != OK)
+    {
+      return -1;
+    }
+
+  return (test_unmount() == OK) ? 0 : -1;
+}
+
+/****************************************************************************
+ * Name: test_restore_depth
+ *
+ * Description:
+ *   Restore the image written last by test_export_depth().
+ *
+ ****************************************************************************/
+
+static int test_restore_depth(void)
+{
+  int depth;
+  int ret;
+
+  ret = test_mount("restore=" TEST_BLKDEV);
+  if (ret != OK)
+    {
+      printf("mount: %d\n", ret);
+      return -1;
+    }
+
+  depth = test_depth();
+  printf("restored depth: %d\n", depth);
+  if (depth != TMPFS_IMAGE_MAXDEPTH || test_rmchain(depth, 0) != OK)
+    {
+      return -1;
+    }
+
+  return (test_unmount() == OK) ? 0 : -1;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+int main(int argc, char **argv)
+{
+  int ret;
+
+  (void)argc;
+  (void)argv;
+
+  ret = test_export_depth();
+  if (ret == 0)
+    {
+      ret = test_restore_depth();
+    }
+
+  printf("%s\n", (ret == 0) ? "PASS" : "FAIL");
+  return (ret == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
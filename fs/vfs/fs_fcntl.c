@@ -29,6 +29,7 @@
 #include "errno.h"
 #include "assert.h"
 #include "vnode.h"
+#include "fs/file.h"
 
 #if defined(LOSCFG_NET_LWIP_SACK)
 #include "lwip/sockets.h"
@@ -40,6 +41,10 @@
 #define FNDELAY     O_NDELAY
 #define FFCNTL      (FNONBLOCK | FNDELAY | FAPPEND | FFSYNC | FASYNC)
 
+#ifdef LOSCFG_KERNEL_PIPE
+extern int pipecommon_ioctl(struct file *filep, int cmd, unsigned long arg);
+#endif
+
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
@@ -219,6 +224,43 @@ int file_vfcntl(struct file *filep, int cmd, va_list ap)
         err = ENOSYS; /* Not implemented */
         break;
 
+      case F_SETPIPE_SZ:
+        /* Change the capacity of the pipe referred to by fd to at least
+         * the third argument, arg, taken as type int, and return the new
+         * capacity.
+         */
+
+      case F_GETPIPE_SZ:
+        /* Return the capacity of the pipe referred to by fd. */
+
+        {
+          int arg = (cmd == F_SETPIPE_SZ) ? va_arg(ap, int) : 0;
+
+          if (cmd == F_SETPIPE_SZ && arg <= 0)
+            {
+              err = EINVAL;
+              break;
+            }
+
+          /* Only pipes and FIFOs implement these commands */
+
+#ifdef LOSCFG_KERNEL_PIPE
+          if (filep->ops != NULL && filep->ops->ioctl == pipecommon_ioctl)
+            {
+              ret = pipecommon_ioctl(filep, cmd, (unsigned long)arg);
+              if (ret < 0)
+                {
+                  err = -ret;
+                }
+
+              break;
+            }
+#endif
+
+          err = EBADF;
+        }
+        break;
+
       default:
         err = EINVAL;
         break;
@@ -35,6 +35,48 @@
 #  define CONFIG_LIB_SENDFILE_BUFSIZE 512
 #endif
 
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: sendfile_splice
+ *
+ * Description:
+ *   Transfer with splice() when one of the descriptors is a pipe.  Returns
+ *   -ENOSYS, without transferring anything, if neither is.
+ *
+ ****************************************************************************/
+
+static ssize_t sendfile_splice(int outfd, int infd, off_t *offset, size_t count)
+{
+  ssize_t ntransferred = 0;
+  ssize_t nbytes;
+
+  while ((size_t)ntransferred < count)
+    {
+      nbytes = splice(infd, offset, outfd, NULL, count - ntransferred, 0);
+      if (nbytes < 0)
+        {
+          if (ntransferred > 0)
+            {
+              break;
+            }
+
+          return (get_errno() == EINVAL) ? -ENOSYS : VFS_ERROR;
+        }
+
+      if (nbytes == 0)
+        {
+          break;
+        }
+
+      ntransferred += nbytes;
+    }
+
+  return ntransferred;
+}
+
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
@@ -51,6 +93,9 @@
  *   performance than simple reds() and writes(). The data is read directly
  *   into the net buffer and the whole tcp window is filled if possible.
  *
+ *   If either descriptor is a pipe, the data is moved with splice()
+ *   without going through the I/O buffer.
+ *
  *   NOTE: This interface is *not* specified in POSIX.1-2001, or other
  *   standards.  The implementation here is very similar to the Linux
  *   sendfile interface.  Other UNIX systems implement sendfile() with
@@ -94,6 +139,14 @@ ssize_t sendfile(int outfd, int infd, off_t *offset, size_t count)
   size_t  ntransferred;
   bool endxfr;
 
+  /* Move data to or from a pipe without the I/O buffer */
+
+  nbytesread = sendfile_splice(outfd, infd, offset, count);
+  if (nbytesread != -ENOSYS)
+    {
+      return nbytesread;
+    }
+
   /* Get the current file position. */
 
   if (offset)
@@ -0,0 +1,195 @@
+/****************************************************************************
+ * fs/vfs/fs_splice.c
+ *
+ * Copyright (c) 2023 Huawei Device Co., Ltd. All rights reserved.
+ * Based on NuttX originally from nuttx source (nuttx/fs/ and nuttx/drivers/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include "vfs_config.h"
+
+#include <fs/file.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#ifndef SPLICE_F_NONBLOCK
+#  define SPLICE_F_NONBLOCK 2
+#endif
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+#ifdef LOSCFG_KERNEL_PIPE
+extern int pipecommon_ioctl(struct file *filep, int cmd, unsigned long arg);
+extern ssize_t pipecommon_spliceread(struct file *filep, struct file *outfilep,
+                                     size_t len, bool nonblock);
+extern ssize_t pipecommon_splicewrite(struct file *filep, struct file *infilep,
+                                      size_t len, bool nonblock);
+#endif
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: splice_ispipe
+ ****************************************************************************/
+
+static bool splice_ispipe(struct file *filep)
+{
+#ifdef LOSCFG_KERNEL_PIPE
+  return filep->ops != NULL && filep->ops->ioctl == pipecommon_ioctl;
+#else
+  return false;
+#endif
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: splice
+ *
+ * Description:
+ *   splice() moves data between a pipe and another file descriptor without
+ *   copying it through a buffer of the caller.  The file or driver on the
+ *   other side reads directly into, or writes directly out of, the circular
+ *   buffer of the pipe, so each byte is copied once instead of twice as
+ *   with read() and write() (or sendfile()) through an intermediate buffer.
+ *
+ *   NOTE: As with Linux, one of the descriptors must refer to a pipe.
+ *   Splicing between two pipes is not supported.
+ *
+ * Input Parameters:
+ *   fdin   - The descriptor to move data from
+ *   offin  - If 'fdin' is not a pipe and 'offin' is not NULL, the offset to
+ *            read from.  It is updated on return and the file position of
+ *            'fdin' is left unchanged.  Must be NULL if 'fdin' is a pipe.
+ *   fdout  - The descriptor to move data to
+ *   offout - As 'offin', for 'fdout'.
+ *   len    - The maximum number of bytes to move
+ *   flags  - SPLICE_F_NONBLOCK to not wait on the pipe.  Other flags are
+ *            accepted and ignored.
+ *
+ * Returned Value:
+ *   The number of bytes moved, 0 at end of input, or -1 with errno set:
+ *
+ *   EINVAL - Neither or both descriptors refer to a pipe.
+ *   ESPIPE - An offset was given for a pipe.
+ *   EAGAIN - SPLICE_F_NONBLOCK was given and the pipe is empty (or full).
+ *
+ ****************************************************************************/
+
+ssize_t splice(int fdin, off_t *offin, int fdout, off_t *offout,
+               size_t len, unsigned int flags)
+{
+  struct file *infilep = NULL;
+  struct file *outfilep = NULL;
+  struct file *filep;
+  off_t *offset;
+  off_t savepos = 0;
+  bool inpipe;
+  bool outpipe;
+  bool nonblock = (flags & SPLICE_F_NONBLOCK) != 0;
+  ssize_t ret;
+  int err;
+
+  ret = fs_getfilep(fdin, &infilep);
+  if (ret < 0)
+    {
+      err = -ret;
+      goto errout;
+    }
+
+  ret = fs_getfilep(fdout, &outfilep);
+  if (ret < 0)
+    {
+      err = -ret;
+      goto errout;
+    }
+
+  inpipe  = splice_ispipe(infilep);
+  outpipe = splice_ispipe(outfilep);
+  if (inpipe == outpipe)
+    {
+      err = EINVAL;
+      goto errout;
+    }
+
+  if ((inpipe && offin != NULL) || (outpipe && offout != NULL))
+    {
+      err = ESPIPE;
+      goto errout;
+    }
+
+  /* Position the file on the other side of the pipe */
+
+  filep  = inpipe ? outfilep : infilep;
+  offset = inpipe ? offout : offin;
+  if (offset != NULL)
+    {
+      savepos = file_seek(filep, 0, SEEK_CUR);
+      if (savepos == (off_t)-1 || file_seek(filep, *offset, SEEK_SET) == (off_t)-1)
+        {
+          return VFS_ERROR;
+        }
+    }
+
+#ifdef LOSCFG_KERNEL_PIPE
+  if (inpipe)
+    {
+      ret = pipecommon_spliceread(infilep, outfilep, len, nonblock);
+    }
+  else
+    {
+      ret = pipecommon_splicewrite(outfilep, infilep, len, nonblock);
+    }
+#else
+  (void)nonblock;
+  ret = -EINVAL;
+#endif
+
+  /* Return the new offset and restore the file position */
+
+  if (offset != NULL)
+    {
+      *offset = file_seek(filep, 0, SEEK_CUR);
+      (void)file_seek(filep, savepos, SEEK_SET);
+    }
+
+  if (ret < 0)
+    {
+      err = -ret;
+      goto errout;
+    }
+
+  return ret;
+
+errout:
+  set_errno(err);
+  return VFS_ERROR;
+}
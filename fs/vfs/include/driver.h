@@ -293,6 +293,49 @@ int find_blockdriver(const char *pathname, int mountflags,
 int close_blockdriver(struct Vnode *vnode);
 #endif
 
+#ifdef LOSCFG_FS_VFS_BLOCK_DEVICE
+
+/****************************************************************************
+ * Name: bchlib_setup
+ *
+ * Description:
+ *   Open the block driver 'blkdev' for byte-addressed access through the
+ *   BCH sector cache.  The handle returned in 'handle' is passed to
+ *   bchlib_read(), bchlib_write() and finally bchlib_teardown().
+ *
+ * Returned Value:
+ *   Zero on success or a negated errno on failure.
+ *
+ ****************************************************************************/
+
+int bchlib_setup(const char *blkdev, bool readonly, void **handle);
+
+/****************************************************************************
+ * Name: bchlib_teardown
+ *
+ * Description:
+ *   Write back any cached data and close the block driver.
+ *
+ ****************************************************************************/
+
+int bchlib_teardown(void *handle);
+
+/****************************************************************************
+ * Name: bchlib_read / bchlib_write
+ *
+ * Description:
+ *   Transfer 'len' bytes at byte 'offset' of the device.  Return the number
+ *   of bytes transferred, which is short at the end of the device or on an
+ *   I/O error.
+ *
+ ****************************************************************************/
+
+ssize_t bchlib_read(void *handle, char *buffer, loff_t offset, size_t len);
+ssize_t bchlib_write(void *handle, const char *buffer, loff_t offset,
+                     size_t len);
+
+#endif /* LOSCFG_FS_VFS_BLOCK_DEVICE */
+
 #ifdef __cplusplus
 #if __cplusplus
 }
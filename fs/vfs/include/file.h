@@ -521,6 +521,18 @@ struct filelist *sched_getfiles(void);
  ****************************************************************************/
 ssize_t sendfile(int outfd, int infd, off_t *offset, size_t count);
 
+/* fs/fs_splice.c ***************************************************/
+/****************************************************************************
+ * Name: splice
+ *
+ * Description:
+ *   Move data between a pipe and another file descriptor without an
+ *   intermediate buffer.
+ *
+ ****************************************************************************/
+ssize_t splice(int fdin, off_t *offin, int fdout, off_t *offout,
+               size_t len, unsigned int flags);
+
 /**
  * @ingroup  fs
  * @brief get the path by a given file fd.
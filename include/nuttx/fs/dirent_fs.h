@@ -129,10 +129,12 @@ struct fs_cromfsdir_s
  */
 
 struct tmpfs_directory_s;               /* Forward reference */
+struct tmpfs_dirent_s;                  /* Forward reference */
 struct fs_tmpfsdir_s
 {
   struct tmpfs_directory_s *tf_tdo; /* Directory being enumerated */
   unsigned int tf_index;                /* Directory index */
+  struct tmpfs_dirent_s *tf_last;   /* Last entry visited, NULL at start */
 };
 
 #ifdef CONFIG_FS_BINFS
@@ -49,6 +49,17 @@
 
 #include "semaphore.h"
 
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* fcntl() commands to query and change the capacity of a pipe or FIFO.
+ * The values are those of Linux.
+ */
+
+#define F_SETPIPE_SZ 1031
+#define F_GETPIPE_SZ 1032
+
 #ifdef __cplusplus
 #if __cplusplus
 extern "C" {
@@ -80,6 +91,18 @@ struct filelist *sched_getfiles(void);
  ****************************************************************************/
 ssize_t sendfile(int outfd, int infd, off_t *offset, size_t count);
 
+/* fs/fs_splice.c ***************************************************/
+/****************************************************************************
+ * Name: splice
+ *
+ * Description:
+ *   Move data between a pipe and another file descriptor without an
+ *   intermediate buffer.
+ *
+ ****************************************************************************/
+ssize_t splice(int fdin, off_t *offin, int fdout, off_t *offout,
+               size_t len, unsigned int flags);
+
 /**
  * @ingroup  fs
  * @brief get the path by a given file fd.